@@ -43,11 +43,18 @@
 #include "Common/config.h"
 #include "Common/MediaSource.h"
 #include "Http/HttpSession.h"
+#include "Http/HttpFileCache.h"
+#include "Http/HttpCompressor.h"
 #include "Http/HttpRequester.h"
+#include "Http/HlsPlayer.h"
 #include "Player/PlayerProxy.h"
 #include "Pusher/PusherProxy.h"
 #include "Rtp/RtpProcess.h"
 #include "Record/MP4Reader.h"
+#include "Record/MP4Index.h"
+#include "Record/MP4Exporter.h"
+#include "Record/RecordCatalog.h"
+#include "Record/StoragePool.h"
 
 #if defined(ENABLE_RTPPROXY)
 #include "Rtp/RtpServer.h"
@@ -416,6 +423,91 @@ static inline string getPusherKey(const string &schema, const string &vhost, con
     return schema + "/" + vhost + "/" + app + "/" + stream + "/" + MD5(dst_url).hexdigest();
 }
 
+/**
+ * 流式输出的json列表回复，格式为{"code":0,"total":总数,"data":[...]}
+ * 每次发送时才序列化下一批元素，不一次性构造整个Json::Value树，内存与列表长度无关
+ * Json list response output in a streaming way, the format is {"code":0,"total":total,"data":[...]}
+ * The next batch of items is serialized only when sending, the whole Json::Value tree is not built at once,
+ * so the memory is independent of the list length
+ */
+class JsonListBody : public HttpBody {
+public:
+    // 序列化第index个元素，返回false表示该元素已失效，跳过
+    // Serialize the index-th item, return false to skip an expired item
+    using Serializer = function<bool(size_t index, Value &item)>;
+
+    /**
+     * @param total 列表总数
+     * @param allArgs 请求参数，支持offset/count分页与fields字段筛选(逗号分隔)
+     * @param serializer 元素序列化函数
+     * @param total total number of items
+     * @param allArgs request arguments, offset/count for pagination and fields (comma separated) for field selection
+     * @param serializer item serializer
+     */
+    JsonListBody(size_t total, const ArgsMap &allArgs, Serializer serializer) {
+        _total = total;
+        _index = allArgs["offset"].empty() ? 0 : std::min(allArgs["offset"].as<size_t>(), total);
+        auto count = allArgs["count"].empty() ? 0 : allArgs["count"].as<size_t>();
+        _end = count ? std::min(_index + count, total) : total;
+        if (!allArgs["fields"].empty()) {
+            _fields = split(allArgs["fields"], ",");
+        }
+        _serializer = std::move(serializer);
+        StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        _writer.reset(builder.newStreamWriter());
+    }
+
+    int64_t remainSize() override { return _finished ? 0 : -1; }
+
+    Buffer::Ptr readData(size_t size) override {
+        if (_finished) {
+            return nullptr;
+        }
+        _ss.str("");
+        if (!_started) {
+            _started = true;
+            _ss << "{\"code\":" << API::Success << ",\"total\":" << _total << ",\"data\":[";
+        }
+        while (_index < _end && (size_t)_ss.tellp() < size) {
+            Value item;
+            if (!_serializer(_index++, item)) {
+                continue;
+            }
+            if (!_fields.empty()) {
+                Value selected(objectValue);
+                for (auto &field : _fields) {
+                    if (item.isMember(field)) {
+                        selected[field] = std::move(item[field]);
+                    }
+                }
+                item = std::move(selected);
+            }
+            if (_count++) {
+                _ss << ",";
+            }
+            _writer->write(item, &_ss);
+        }
+        if (_index >= _end) {
+            _finished = true;
+            _ss << "]}";
+        }
+        return std::make_shared<BufferString>(_ss.str());
+    }
+
+private:
+    bool _started = false;
+    bool _finished = false;
+    size_t _total;
+    size_t _index;
+    size_t _end;
+    size_t _count = 0;
+    vector<string> _fields;
+    Serializer _serializer;
+    stringstream _ss;
+    std::unique_ptr<StreamWriter> _writer;
+};
+
 static void fillSockInfo(Value& val, SockInfo* info) {
     val["peer_ip"] = info->get_peer_ip();
     val["peer_port"] = info->get_peer_port();
@@ -587,6 +679,57 @@ void getStatisticJson(const function<void(Value &val)> &cb) {
 
     val["RtpPacket"] = (Json::UInt64)(ObjectStatistic<RtpPacket>::count());
     val["RtmpPacket"] = (Json::UInt64)(ObjectStatistic<RtmpPacket>::count());
+    getWebHookStatistic(val["WebHook"]);
+    getWebHookAuthCacheStatistic(val["WebHookAuthCache"]);
+
+    auto file_cache = HttpFileCache::Instance().getStatistic();
+    auto &cache_val = val["HttpFileCache"];
+    cache_val["items"] = (Json::UInt64)file_cache.items;
+    cache_val["bytes"] = (Json::UInt64)file_cache.bytes;
+    cache_val["capacity"] = (Json::UInt64)file_cache.capacity;
+    cache_val["hits"] = (Json::UInt64)file_cache.hits;
+    cache_val["misses"] = (Json::UInt64)file_cache.misses;
+    cache_val["notModified"] = (Json::UInt64)file_cache.not_modified;
+    cache_val["evictions"] = (Json::UInt64)file_cache.evictions;
+    cache_val["invalidations"] = (Json::UInt64)file_cache.invalidations;
+
+    auto compressor = HttpCompressor::getStatistic();
+    auto &compress_val = val["HttpCompressor"];
+    compress_val["compressed"] = (Json::UInt64)compressor.compressed;
+    compress_val["bytesIn"] = (Json::UInt64)compressor.bytes_in;
+    compress_val["bytesOut"] = (Json::UInt64)compressor.bytes_out;
+    compress_val["cpuUs"] = (Json::UInt64)compressor.cpu_us;
+    compress_val["precompressed"] = (Json::UInt64)compressor.precompressed;
+    compress_val["precompressedSaved"] = (Json::UInt64)compressor.precompressed_saved;
+#if ENABLE_MP4
+    auto mp4_index = MP4Index::getStatistic();
+    auto &index_val = val["MP4Index"];
+    index_val["items"] = (Json::UInt64)mp4_index.items;
+    index_val["bytes"] = (Json::UInt64)mp4_index.bytes;
+    index_val["hits"] = (Json::UInt64)mp4_index.hits;
+    index_val["misses"] = (Json::UInt64)mp4_index.misses;
+    index_val["loads"] = (Json::UInt64)mp4_index.loads;
+    index_val["saves"] = (Json::UInt64)mp4_index.saves;
+
+    auto &pool_val = val["StoragePool"];
+    pool_val = Value(arrayValue);
+    for (auto &disk : StoragePool::Instance().getStatistic()) {
+        Value disk_val;
+        disk_val["root"] = disk.root;
+        disk_val["totalBytes"] = (Json::UInt64)disk.total_bytes;
+        disk_val["freeBytes"] = (Json::UInt64)disk.free_bytes;
+        disk_val["writers"] = (Json::UInt64)disk.writers;
+        disk_val["queueDepth"] = (Json::UInt64)disk.queue_depth;
+        disk_val["writes"] = (Json::UInt64)disk.writes;
+        disk_val["writeBytes"] = (Json::UInt64)disk.write_bytes;
+        disk_val["writeErrors"] = (Json::UInt64)disk.write_errors;
+        disk_val["writeRate"] = (Json::UInt64)disk.write_rate;
+        disk_val["flushLatencyUs"] = (Json::UInt64)disk.flush_latency_us;
+        disk_val["syncLatencyUs"] = (Json::UInt64)disk.sync_latency_us;
+        disk_val["healthy"] = disk.healthy;
+        pool_val.append(disk_val);
+    }
+#endif
 #ifdef ENABLE_MEM_DEBUG
     auto bytes = getTotalMemUsage();
     val["totalMemUsage"] = (Json::UInt64) bytes;
@@ -780,6 +923,33 @@ void getThreadsLoad(TaskExecutorGetterImp &getter, API_ARGS_MAP_ASYNC) {
     });
 }
 
+#if ENABLE_MP4
+// 导出普通mp4时的临时文件目录，不放在录像文件夹中，以免被录像列表接口当作录像
+// Temporary folder for exporting plain mp4 files, it is kept out of the record folders so that it is not listed as recordings
+static string exportTempDir() {
+    GET_CONFIG(string, recordPath, Protocol::kMP4SavePath);
+    return File::absolutePath(".export/", recordPath);
+}
+
+// 导出的文件必须位于录像目录或存储池中
+// Exported files must be in the record path or the storage pool
+static bool isRecordFile(const string &path) {
+    if (path.find("..") != string::npos) {
+        return false;
+    }
+    GET_CONFIG(string, recordPath, Protocol::kMP4SavePath);
+    auto roots = StoragePool::Instance().getRoots();
+    roots.emplace_back(File::absolutePath("", recordPath, true));
+    for (auto &root : roots) {
+        auto dir = end_with(root, "/") ? root : root + "/";
+        if (start_with(path, dir)) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
 /**
  * 安装api接口
  * 所有api都支持GET和POST两种方式
@@ -982,13 +1152,26 @@ void installWebApi() {
     // Test url1 (get streams with virtual host "__defaultVost__") http://127.0.0.1/index/api/getMediaList?vhost=__defaultVost__
     // 测试url2(获取rtsp类型的流) http://127.0.0.1/index/api/getMediaList?schema=rtsp  [AUTO-TRANSLATED:21c2c15d]
     // Test url2 (get rtsp type streams) http://127.0.0.1/index/api/getMediaList?schema=rtsp
-    api_regist("/index/api/getMediaList",[](API_ARGS_MAP){
+    // 测试url3(分页并只返回部分字段) http://127.0.0.1/index/api/getMediaList?offset=0&count=100&fields=schema,app,stream,readerCount
+    // Test url3 (paginated, only some fields are returned) http://127.0.0.1/index/api/getMediaList?offset=0&count=100&fields=schema,app,stream,readerCount
+    api_regist("/index/api/getMediaList",[](API_ARGS_MAP_ASYNC){
         CHECK_SECRET();
         // 获取所有MediaSource列表  [AUTO-TRANSLATED:7bf16dc2]
         // Get all MediaSource lists
+        // 此处只保存弱引用，发送时才逐个序列化
+        // Only weak references are kept here, they are serialized one by one when sending
+        auto media_list = std::make_shared<vector<std::weak_ptr<MediaSource> > >();
         MediaSource::for_each_media([&](const MediaSource::Ptr &media) {
-            val["data"].append(makeMediaSourceJson(*media));
+            media_list->emplace_back(media);
         }, allArgs["schema"], allArgs["vhost"], allArgs["app"], allArgs["stream"]);
+        invoker(200, headerOut, std::make_shared<JsonListBody>(media_list->size(), allArgs, [media_list](size_t index, Value &item) {
+            auto media = (*media_list)[index].lock();
+            if (!media) {
+                return false;
+            }
+            item = makeMediaSourceJson(*media);
+            return true;
+        }));
     });
 
     // 测试url http://127.0.0.1/index/api/isMediaOnline?schema=rtsp&vhost=__defaultVhost__&app=live&stream=obs  [AUTO-TRANSLATED:126a75e8]
@@ -1012,14 +1195,15 @@ void installWebApi() {
         }
         src->getPlayerList(
             [=](const std::list<toolkit::Any> &info_list) mutable {
-                val["code"] = API::Success;
-                auto &data = val["data"];
-                data = Value(arrayValue);
-                for (auto &info : info_list) {
-                    auto &obj = info.get<Value>();
-                    data.append(std::move(obj));
-                }
-                invoker(200, headerOut, val.toStyledString());
+                auto player_list = std::make_shared<vector<toolkit::Any> >(info_list.begin(), info_list.end());
+                invoker(200, headerOut, std::make_shared<JsonListBody>(player_list->size(), allArgs, [player_list](size_t index, Value &item) {
+                    auto &info = (*player_list)[index];
+                    item = std::move(info.get<Value>());
+                    // 序列化后立即释放
+                    // Release it right after serialization
+                    info = toolkit::Any();
+                    return true;
+                }));
             },
             [](toolkit::Any &&info) -> toolkit::Any {
                 auto obj = std::make_shared<Value>();
@@ -1119,12 +1303,14 @@ void installWebApi() {
     // You can filter by local port and remote ip
     // 测试url(筛选某端口下的tcp会话) http://127.0.0.1/index/api/getAllSession?local_port=1935  [AUTO-TRANSLATED:ef845193]
     // Test url (filter tcp session under a certain port) http://127.0.0.1/index/api/getAllSession?local_port=1935
-    api_regist("/index/api/getAllSession",[](API_ARGS_MAP){
+    // 支持offset/count分页以及fields字段筛选
+    // Supports offset/count pagination and fields selection
+    api_regist("/index/api/getAllSession",[](API_ARGS_MAP_ASYNC){
         CHECK_SECRET();
-        Value jsession;
         uint16_t local_port = allArgs["local_port"].as<uint16_t>();
         string peer_ip = allArgs["peer_ip"];
 
+        auto session_list = std::make_shared<vector<pair<string, std::weak_ptr<Session> > > >();
         SessionMap::Instance().for_each_session([&](const string &id,const Session::Ptr &session){
             if(local_port != 0 && local_port != session->get_local_port()){
                 return;
@@ -1132,11 +1318,19 @@ void installWebApi() {
             if(!peer_ip.empty() && peer_ip != session->get_peer_ip()){
                 return;
             }
-            fillSockInfo(jsession, session.get());
-            jsession["id"] = id;
-            jsession["typeid"] = toolkit::demangle(typeid(*session).name());
-            val["data"].append(jsession);
+            session_list->emplace_back(id, session);
         });
+        invoker(200, headerOut, std::make_shared<JsonListBody>(session_list->size(), allArgs, [session_list](size_t index, Value &item) {
+            auto &pr = (*session_list)[index];
+            auto session = pr.second.lock();
+            if (!session) {
+                return false;
+            }
+            fillSockInfo(item, session.get());
+            item["id"] = pr.first;
+            item["typeid"] = toolkit::demangle(typeid(*session).name());
+            return true;
+        }));
     });
 
     // 断开tcp连接，比如说可以断开rtsp、rtmp播放器等  [AUTO-TRANSLATED:9147ffec]
@@ -1156,6 +1350,15 @@ void installWebApi() {
     });
 
 
+    // 清除on_play/on_publish/on_rtsp_auth鉴权结果缓存，vhost/app/stream为空时不过滤
+    // Clear the on_play/on_publish/on_rtsp_auth authentication result cache, no filtering when vhost/app/stream is empty
+    // 测试url http://127.0.0.1/index/api/clearAuthCache?app=live&stream=test
+    // Test url http://127.0.0.1/index/api/clearAuthCache?app=live&stream=test
+    api_regist("/index/api/clearAuthCache", [](API_ARGS_MAP) {
+        CHECK_SECRET();
+        val["count_hit"] = (Json::UInt64)clearWebHookAuthCache(allArgs["vhost"], allArgs["app"], allArgs["stream"]);
+    });
+
     // 批量断开tcp连接，比如说可以断开rtsp、rtmp播放器等  [AUTO-TRANSLATED:fef59eb8]
     // Batch disconnect tcp connections, for example, you can disconnect rtsp, rtmp players, etc.
     // 测试url http://127.0.0.1/index/api/kick_sessions?local_port=1935  [AUTO-TRANSLATED:5891b482]
@@ -1909,8 +2112,26 @@ void installWebApi() {
             throw ApiRetException("can not find the proxy", API::NotFound);
         }
 
-        val["data"] = ToJson(proxy);
-        invoker(200, headerOut, val.toStyledString());
+        // 切换到拉流线程访问播放器
+        // Switch to the thread of the proxy to access the player
+        proxy->getPoller()->async([proxy, val, headerOut, invoker]() mutable {
+            val["data"] = ToJson(proxy);
+            if (auto hls = dynamic_pointer_cast<HlsPlayer>(proxy->getDelegate())) {
+                // hls拉流的切片下载与预取统计
+                // Segment download and prefetch statistics of hls pulling
+                auto stat = hls->getFetchStatistic();
+                auto &item = val["data"]["hlsFetch"];
+                item["segments"] = (Json::UInt64)stat.segments;
+                item["failed"] = (Json::UInt64)stat.failed;
+                item["lastFetchMS"] = (Json::UInt64)stat.last_fetch_ms;
+                item["maxFetchMS"] = (Json::UInt64)stat.max_fetch_ms;
+                item["avgFetchMS"] = (Json::UInt64)(stat.segments ? stat.total_fetch_ms / stat.segments : 0);
+                item["prefetchHits"] = (Json::UInt64)stat.prefetch_hits;
+                item["prefetchStalls"] = (Json::UInt64)stat.prefetch_stalls;
+                item["bufferedSec"] = stat.buffered_sec;
+            }
+            invoker(200, headerOut, val.toStyledString());
+        });
     });
 
     // 删除录像文件夹  [AUTO-TRANSLATED:821aed07]
@@ -1920,10 +2141,10 @@ void installWebApi() {
         CHECK_SECRET();
         CHECK_ARGS("vhost", "app", "stream");
         auto tuple = MediaTuple{allArgs["vhost"], allArgs["app"], allArgs["stream"], ""};
-        auto record_path = Recorder::getRecordPath(Recorder::type_mp4, tuple, allArgs["customized_path"]);
+        string sub_path;
         auto period = allArgs["period"];
         if (!period.empty()) {
-            record_path = record_path + period + "/";
+            sub_path = period + "/";
         }
 
         bool recording = false;
@@ -1931,7 +2152,7 @@ void installWebApi() {
         if (!name.empty()) {
             // 删除指定文件  [AUTO-TRANSLATED:e8ee7bfa]
             // Delete the specified file
-            record_path += name;
+            sub_path += name;
         } else {
             // 删除文件夹，先判断该流是否正在录制中  [AUTO-TRANSLATED:9f124786]
             // Delete the folder, first check if the stream is being recorded
@@ -1940,23 +2161,48 @@ void installWebApi() {
                 recording = true;
             }
         }
-        val["path"] = record_path;
-        if (!recording) {
-            val["code"] = File::delete_file(record_path, true);
-            return;
-        }
-        File::scanDir(record_path, [](const string &path, bool is_dir) {
-            if (is_dir) {
-                return true;
+        // 配置了存储池时录像分布在各磁盘上，逐个磁盘删除
+        // With the storage pool configured the recordings are spread over the disks, delete them disk by disk
+        auto folders = Recorder::getRecordPaths(Recorder::type_mp4, tuple, allArgs["customized_path"]);
+        val["path"] = folders.front() + sub_path;
+        int code = 0;
+        for (auto &folder : folders) {
+            auto record_path = folder + sub_path;
+            if (folder != folders.front() && !File::is_dir(record_path) && !File::fileExist(record_path)) {
+                continue;
+            }
+#if ENABLE_MP4
+            if (!name.empty() && end_with(record_path, ".mp4")) {
+                MP4Index::remove(record_path);
             }
-            if (path.find("/.") == std::string::npos) {
-                File::delete_file(path);
+#endif
+            if (!recording) {
+                auto ret = File::delete_file(record_path, true);
+                code = code ? code : ret;
             } else {
-                TraceL << "Ignore tmp mp4 file: " << path;
+                File::scanDir(record_path, [](const string &path, bool is_dir) {
+                    if (is_dir) {
+                        return true;
+                    }
+                    if (path.find("/.") == std::string::npos) {
+                        File::delete_file(path);
+                    } else {
+                        TraceL << "Ignore tmp mp4 file: " << path;
+                    }
+                    return true;
+                }, true, true);
+                File::deleteEmptyDir(record_path);
             }
-            return true;
-        }, true, true);
-        File::deleteEmptyDir(record_path);
+            GET_CONFIG(bool, enableCatalog, Record::kEnableCatalog);
+            if (enableCatalog) {
+                // 从录像目录中移除已被删除的录像，删除失败的录像仍然保留
+                // Remove the deleted recordings from the recording catalog, recordings failed to delete are kept
+                RecordCatalog::get(folder)->erase(sub_path);
+            }
+        }
+        if (!recording) {
+            val["code"] = code;
+        }
     });
 
     api_regist("/index/api/deleteSnapDirectory", [](API_ARGS_MAP) {
@@ -1975,40 +2221,144 @@ void installWebApi() {
         CHECK_SECRET();
         CHECK_ARGS("vhost", "app", "stream");
         auto tuple = MediaTuple{allArgs["vhost"], allArgs["app"], allArgs["stream"], ""};
-        auto record_path = Recorder::getRecordPath(Recorder::type_mp4, tuple, allArgs["customized_path"]);
         auto period = allArgs["period"];
 
         // 判断是获取mp4文件列表还是获取文件夹列表  [AUTO-TRANSLATED:b9c86d2f]
         // Determine whether to get the mp4 file list or the folder list
         bool search_mp4 = period.size() == sizeof("2020-02-01") - 1;
-        if (search_mp4) {
-            record_path = record_path + period + "/";
-        }
-
-        Json::Value paths(arrayValue);
-        // 这是筛选日期，获取文件夹列表  [AUTO-TRANSLATED:786fa49d]
-        // This is to filter the date and get the folder list
-        File::scanDir(record_path, [&](const string &path, bool isDir) {
-            auto pos = path.rfind('/');
-            if (pos != string::npos) {
-                string relative_path = path.substr(pos + 1);
-                if (search_mp4) {
-                    if (!isDir) {
-                        // 我们只收集mp4文件，对文件夹不感兴趣  [AUTO-TRANSLATED:254d9f25]
-                        // We only collect mp4 files, we are not interested in folders
+        string sub_path = search_mp4 ? period + "/" : "";
+
+        // 配置了存储池时遍历各磁盘上的录像文件夹，paths为合并后的结果，disks为各磁盘上的结果
+        // With the storage pool configured the record folders on all disks are scanned,
+        // paths is the merged result and disks are the results of each disk
+        set<string> merged;
+        Json::Value disks(arrayValue);
+        auto folders = Recorder::getRecordPaths(Recorder::type_mp4, tuple, allArgs["customized_path"]);
+        for (auto &folder : folders) {
+            auto record_path = folder + sub_path;
+            Json::Value paths(arrayValue);
+            // 这是筛选日期，获取文件夹列表  [AUTO-TRANSLATED:786fa49d]
+            // This is to filter the date and get the folder list
+            File::scanDir(record_path, [&](const string &path, bool isDir) {
+                auto pos = path.rfind('/');
+                if (pos != string::npos) {
+                    string relative_path = path.substr(pos + 1);
+                    if (search_mp4) {
+                        if (!isDir && end_with(relative_path, ".mp4")) {
+                            // 我们只收集mp4文件，对文件夹不感兴趣  [AUTO-TRANSLATED:254d9f25]
+                            // We only collect mp4 files, we are not interested in folders
+                            paths.append(relative_path);
+                            merged.emplace(relative_path);
+                        }
+                    } else if (isDir && relative_path.find(period) == 0) {
+                        // 匹配到对应日期的文件夹  [AUTO-TRANSLATED:cd3d10b9]
+                        // Match the folder for the corresponding date
                         paths.append(relative_path);
+                        merged.emplace(relative_path);
                     }
-                } else if (isDir && relative_path.find(period) == 0) {
-                    // 匹配到对应日期的文件夹  [AUTO-TRANSLATED:cd3d10b9]
-                    // Match the folder for the corresponding date
-                    paths.append(relative_path);
                 }
+                return true;
+            }, false);
+            if (folders.size() > 1 && !paths.empty()) {
+                Json::Value disk;
+                disk["rootPath"] = record_path;
+                disk["paths"] = std::move(paths);
+                disks.append(std::move(disk));
             }
-            return true;
-        }, false);
+        }
 
-        val["data"]["rootPath"] = record_path;
+        Json::Value paths(arrayValue);
+        for (auto &path : merged) {
+            paths.append(path);
+        }
+        val["data"]["rootPath"] = folders.front() + sub_path;
         val["data"]["paths"] = paths;
+        if (folders.size() > 1) {
+            val["data"]["disks"] = std::move(disks);
+        }
+    });
+
+    // 按时间段查询录像目录，返回时间段内的录像文件与缺失区间
+    // Query the recording catalog by time range, return the recording files and gaps in the range
+    // http://127.0.0.1/index/api/getRecordCatalog?vhost=__defaultVhost__&app=live&stream=ss&type=1&start_ms=1700000000000&end_ms=1700003600000
+    api_regist("/index/api/getRecordCatalog", [](API_ARGS_MAP) {
+        CHECK_SECRET();
+        CHECK_ARGS("vhost", "app", "stream");
+        auto tuple = MediaTuple{allArgs["vhost"], allArgs["app"], allArgs["stream"], ""};
+        auto type = allArgs["type"].empty() ? Recorder::type_mp4 : (Recorder::type)allArgs["type"].as<int>();
+        auto record_path = Recorder::getRecordPath(type, tuple, allArgs["customized_path"]);
+        if (type == Recorder::type_hls || type == Recorder::type_hls_fmp4) {
+            // hls录像保存在m3u8文件所在文件夹
+            // Hls recordings are saved in the folder of the m3u8 file
+            record_path = record_path.substr(0, record_path.rfind('/') + 1);
+        } else if (type != Recorder::type_mp4) {
+            throw InvalidArgsException("Unsupported record type");
+        }
+        auto start_ms = allArgs["start_ms"].empty() ? 0 : allArgs["start_ms"].as<uint64_t>();
+        auto end_ms = allArgs["end_ms"].empty() ? getCurrentMillisecond(true) : allArgs["end_ms"].as<uint64_t>();
+        // 间隔小于该值时不视为录像缺失，默认1秒
+        // Intervals shorter than this are not regarded as missing recordings, 1 second by default
+        auto gap_ms = allArgs["gap_ms"].empty() ? 1000 : allArgs["gap_ms"].as<uint64_t>();
+
+        // 配置了存储池时mp4录像分布在各磁盘上，合并各磁盘录像文件夹的目录，每个录像的path相对于其所在的rootPath
+        // With the storage pool configured mp4 recordings are spread over the disks, the catalogs of the record folders on all disks
+        // are merged, and the path of each recording is relative to its rootPath
+        auto folders = type == Recorder::type_mp4 ? Recorder::getRecordPaths(type, tuple, allArgs["customized_path"]) : vector<string> { record_path };
+        vector<pair<string, RecordCatalog::Item> > found;
+        for (auto &folder : folders) {
+            for (auto &item : RecordCatalog::get(folder)->query(start_ms, end_ms)) {
+                found.emplace_back(folder, std::move(item));
+            }
+        }
+        if (type == Recorder::type_hls || type == Recorder::type_hls_fmp4) {
+            // hls与hls.fmp4录像保存在同一文件夹，按切片后缀区分
+            // Hls and hls.fmp4 recordings are saved in the same folder, distinguish them by the segment suffix
+            auto suffix = type == Recorder::type_hls ? ".ts" : ".mp4";
+            found.erase(remove_if(found.begin(), found.end(), [&](const pair<string, RecordCatalog::Item> &pr) { return !end_with(pr.second.path, suffix); }), found.end());
+        }
+        stable_sort(found.begin(), found.end(), [](const pair<string, RecordCatalog::Item> &a, const pair<string, RecordCatalog::Item> &b) {
+            return a.second.start_ms < b.second.start_ms;
+        });
+        vector<RecordCatalog::Item> items;
+        for (auto &pr : found) {
+            items.emplace_back(pr.second);
+        }
+
+        Value files(arrayValue);
+        // 时间段内的mp4文件以;拼接，可直接作为loadMP4File的file_path参数连续点播
+        // Mp4 files in the range are joined by ;, which can be used as the file_path param of loadMP4File to play them continuously
+        string file_path;
+        for (auto &pr : found) {
+            auto &item = pr.second;
+            Value obj;
+            obj["rootPath"] = pr.first;
+            obj["path"] = item.path;
+            obj["start_ms"] = (Json::UInt64)item.start_ms;
+            obj["end_ms"] = (Json::UInt64)item.end_ms;
+            obj["size"] = (Json::UInt64)item.size;
+            obj["offset"] = (Json::UInt64)item.offset;
+            obj["key_frames"] = item.key_frames;
+            files.append(std::move(obj));
+            if (type == Recorder::type_mp4) {
+                file_path += (file_path.empty() ? "" : ";") + pr.first + item.path;
+            }
+        }
+        Value gaps(arrayValue);
+        // 未指定开始时间时，从第一个录像开始检测缺失
+        // Detect gaps from the first recording when the start time is not specified
+        auto gap_start = start_ms || items.empty() ? start_ms : items.front().start_ms;
+        for (auto &gap : RecordCatalog::findGaps(items, gap_start, end_ms, gap_ms)) {
+            Value obj;
+            obj["start_ms"] = (Json::UInt64)gap.start_ms;
+            obj["end_ms"] = (Json::UInt64)gap.end_ms;
+            gaps.append(std::move(obj));
+        }
+        val["data"]["rootPath"] = record_path;
+        val["data"]["files"] = std::move(files);
+        val["data"]["gaps"] = std::move(gaps);
+        if (type == Recorder::type_mp4) {
+            val["data"]["file_path"] = file_path;
+        }
     });
 
     static auto responseSnap = [](const string &snap_path,
@@ -2220,6 +2570,60 @@ void installWebApi() {
         obj->safeShutdown(SockException(Err_shutdown, "deleted by http api"));
         invoker(200, headerOut, "");
     });
+
+    // 获取rtc transport的发送端带宽估计等信息
+    // Get the send-side bandwidth estimation and other information of the rtc transport
+    // 测试url http://127.0.0.1/index/api/getWebRtcInfo?id=xxx
+    // Test url http://127.0.0.1/index/api/getWebRtcInfo?id=xxx
+    api_regist("/index/api/getWebRtcInfo", [](API_ARGS_MAP_ASYNC) {
+        CHECK_SECRET();
+        CHECK_ARGS("id");
+        auto obj = WebRtcTransportManager::Instance().getItem(allArgs["id"]);
+        if (!obj) {
+            throw ApiRetException("can not find the rtc transport", API::NotFound);
+        }
+        // 切换到transport所在线程访问
+        // Switch to the thread of the transport to access it
+        obj->getPoller()->async([obj, val, headerOut, invoker]() mutable {
+            auto &data = val["data"];
+            data["id"] = obj->getIdentifier();
+            data["bytesUsage"] = (Json::UInt64)obj->getBytesUsage();
+            data["duration"] = (Json::UInt64)obj->getDuration();
+            auto &bwe = obj->getBwe();
+            if (bwe) {
+                auto &item = data["bwe"];
+                item["targetBitrate"] = bwe->getTargetBitrate();
+                item["delayBasedBitrate"] = bwe->getDelayBasedBitrate();
+                item["lossBasedBitrate"] = bwe->getLossBasedBitrate();
+                item["ackedBitrate"] = bwe->getAckedBitrate();
+                item["sendBitrate"] = bwe->getSendBitrate();
+                item["lossRate"] = bwe->getLossRate();
+                item["state"] = SendSideBwe::getStateName(bwe->getState());
+                item["trend"] = bwe->getTrend();
+                item["threshold"] = bwe->getThreshold();
+            }
+            auto &pacer = obj->getPacer();
+            if (pacer) {
+                auto &item = data["pacer"];
+                item["pacingRate"] = pacer->getPacingRate();
+                for (int i = 0; i < (int)RtcPacer::Priority::max; ++i) {
+                    auto priority = (RtcPacer::Priority)i;
+                    auto &stats = pacer->getStats(priority);
+                    Value queue;
+                    queue["name"] = RtcPacer::getPriorityName(priority);
+                    queue["packets"] = (Json::UInt64)stats.packets;
+                    queue["bytes"] = (Json::UInt64)stats.bytes;
+                    queue["enqueued"] = (Json::UInt64)stats.enqueued;
+                    queue["sent"] = (Json::UInt64)stats.sent;
+                    queue["dropped"] = (Json::UInt64)stats.dropped;
+                    queue["avgDelayMs"] = stats.avg_delay_ms;
+                    queue["maxDelayMs"] = (Json::UInt64)stats.max_delay_ms;
+                    item["queues"].append(queue);
+                }
+            }
+            invoker(200, headerOut, val.toStyledString());
+        });
+    });
 #endif
 
 #if defined(ENABLE_VERSION)
@@ -2259,6 +2663,106 @@ void installWebApi() {
         reader->startReadMP4(0, true, allArgs["file_repeat"]);
         val["data"]["duration_ms"] = (Json::UInt64)reader->getDemuxer()->getDurationMS();
     });
+
+    // 清理上次异常退出时遗留的导出临时文件
+    // Clean up the temporary export files left by the last abnormal exit
+    File::delete_file(exportTempDir(), true);
+
+    // 导出录像片段为mp4/fmp4，按磁盘速度复制sample，起点向前对齐到关键帧
+    // Export a recording clip as mp4/fmp4, samples are copied at disk speed, the start is aligned backward to a key frame
+    // http://127.0.0.1/index/api/exportMP4?vhost=__defaultVhost__&app=live&stream=ss&start_ms=1700000000000&end_ms=1700000600000&fmp4=1
+    api_regist("/index/api/exportMP4", [](API_ARGS_MAP_ASYNC) {
+        CHECK_SECRET();
+        CHECK_ARGS("start_ms", "end_ms");
+        auto start_ms = allArgs["start_ms"].as<uint64_t>();
+        auto end_ms = allArgs["end_ms"].as<uint64_t>();
+        if (start_ms >= end_ms) {
+            throw InvalidArgsException("end_ms must be greater than start_ms");
+        }
+        // 默认导出fmp4，边生成边发送；普通mp4需要先生成完整文件才能发送
+        // fmp4 is exported by default, which is sent while being produced; a plain mp4 can only be sent after the whole file is produced
+        auto fmp4 = allArgs["fmp4"].empty() ? true : allArgs["fmp4"].as<bool>();
+        string files = allArgs["file_path"];
+        string name;
+        // 导出区间结束位置距离最后一个文件末尾的时长
+        // Duration from the end of the export range to the end of the last file
+        uint64_t tail_ms = 0;
+        if (!files.empty()) {
+            // 指定file_path(多个文件以;分隔)时，start_ms与end_ms为相对第一个文件开头的偏移
+            // When file_path is specified (multiple files separated by ;), start_ms and end_ms are offsets from the beginning of the first file
+            for (auto &file : split(files, ";")) {
+                if (!isRecordFile(file)) {
+                    throw AuthException("You can not export files outside the record path");
+                }
+            }
+            name = "export_" + to_string(start_ms) + "_" + to_string(end_ms) + ".mp4";
+        } else {
+            // 否则按录像目录查找时间段内的mp4录像，start_ms与end_ms为unix时间戳
+            // Otherwise the mp4 recordings in the range are found by the recording catalog, start_ms and end_ms are unix timestamps
+            CHECK_ARGS("vhost", "app", "stream");
+            auto tuple = MediaTuple{allArgs["vhost"], allArgs["app"], allArgs["stream"], ""};
+            // 配置了存储池时合并各磁盘上的录像，录像的path改为绝对路径
+            // With the storage pool configured the recordings on all disks are merged, with their paths made absolute
+            vector<RecordCatalog::Item> items;
+            for (auto &folder : Recorder::getRecordPaths(Recorder::type_mp4, tuple, allArgs["customized_path"])) {
+                for (auto &item : RecordCatalog::get(folder)->query(start_ms, end_ms)) {
+                    if (end_with(item.path, ".mp4")) {
+                        item.path = folder + item.path;
+                        items.emplace_back(std::move(item));
+                    }
+                }
+            }
+            if (items.empty()) {
+                throw ApiRetException("can not find any recording in the range", API::NotFound);
+            }
+            stable_sort(items.begin(), items.end(), [](const RecordCatalog::Item &a, const RecordCatalog::Item &b) { return a.start_ms < b.start_ms; });
+            for (auto &item : items) {
+                files += (files.empty() ? "" : ";") + item.path;
+            }
+            tail_ms = items.back().end_ms > end_ms ? items.back().end_ms - end_ms : 0;
+            end_ms -= items.front().start_ms;
+            start_ms = start_ms > items.front().start_ms ? start_ms - items.front().start_ms : 0;
+            name = tuple.stream + "_" + to_string(items.front().start_ms + start_ms) + ".mp4";
+        }
+
+        // 打开与复制mp4文件较为耗时，在后台线程执行
+        // Opening and copying mp4 files is time-consuming, so it is executed in the background thread
+        WorkThreadPool::Instance().getExecutor()->async([=]() mutable {
+            try {
+                auto exporter = std::make_shared<MP4Exporter>(files);
+                if (tail_ms) {
+                    end_ms = exporter->getDurationMS() > tail_ms ? exporter->getDurationMS() - tail_ms : 0;
+                }
+                if (!exporter->setRange(start_ms, end_ms)) {
+                    throw std::invalid_argument("the range is out of the recordings");
+                }
+                headerOut["Content-Type"] = HttpFileManager::getContentType(".mp4");
+                headerOut["Content-Disposition"] = "attachment; filename=\"" + name + "\"";
+                if (fmp4) {
+                    invoker(200, headerOut, exporter->exportFmp4());
+                    return;
+                }
+                auto tmp_path = exportTempDir() + to_string(getCurrentMicrosecond()) + ".tmp";
+                try {
+                    exporter->exportFile(tmp_path);
+                } catch (...) {
+                    File::delete_file(tmp_path);
+                    throw;
+                }
+                // 打开后即可删除临时文件，文件在发送完毕后释放
+                // The temporary file can be deleted once opened, it is released after being sent
+                auto body = std::make_shared<HttpFileBody>(tmp_path, false);
+                File::delete_file(tmp_path);
+                invoker(200, headerOut, body);
+            } catch (std::exception &ex) {
+                WarnL << "Export mp4 failed: " << files << ", " << ex.what();
+                headerOut.clear();
+                val["code"] = API::OtherFailed;
+                val["msg"] = ex.what();
+                invoker(200, headerOut, val.toStyledString());
+            }
+        });
+    });
 #endif
 
     GET_CONFIG_FUNC(std::set<std::string>, download_roots, API::kDownloadRoot, [](const string &str) -> std::set<std::string> {
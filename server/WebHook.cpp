@@ -8,7 +8,10 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <list>
+#include <deque>
 #include <sstream>
+#include <unordered_map>
 #include "Util/logger.h"
 #include "Util/onceToken.h"
 #include "Util/NoticeCenter.h"
@@ -52,6 +55,11 @@ const string kOnRtpServerTimeout = HOOK_FIELD "on_rtp_server_timeout";
 const string kAliveInterval = HOOK_FIELD "alive_interval";
 const string kRetry = HOOK_FIELD "retry";
 const string kRetryDelay = HOOK_FIELD "retry_delay";
+const string kMaxConnection = HOOK_FIELD "max_connection";
+const string kBatchIntervalMS = HOOK_FIELD "batch_interval_ms";
+const string kAuthCacheSec = HOOK_FIELD "auth_cache_sec";
+const string kAuthFailCacheSec = HOOK_FIELD "auth_fail_cache_sec";
+const string kAuthCacheSize = HOOK_FIELD "auth_cache_size";
 
 static onceToken token([]() {
     mINI::Instance()[kEnable] = false;
@@ -78,6 +86,11 @@ static onceToken token([]() {
     mINI::Instance()[kAliveInterval] = 30.0;
     mINI::Instance()[kRetry] = 1;
     mINI::Instance()[kRetryDelay] = 3.0;
+    mINI::Instance()[kMaxConnection] = 32;
+    mINI::Instance()[kBatchIntervalMS] = 0;
+    mINI::Instance()[kAuthCacheSec] = 0;
+    mINI::Instance()[kAuthFailCacheSec] = 0;
+    mINI::Instance()[kAuthCacheSize] = 10000;
     mINI::Instance()[kStreamChangedSchemas] = "rtsp/rtmp/fmp4/ts/hls/hls.fmp4";
 });
 } // namespace Hook
@@ -96,6 +109,10 @@ static onceToken token([]() {
 
 } // namespace Cluster
 
+// hook服务器明确拒绝鉴权时的错误前缀，用于区分网络错误
+// Error prefix when the hook server explicitly rejects the authentication, used to distinguish it from network errors
+static const char kAuthFailedTag[] = "[auth failed]";
+
 static void parse_http_response(const SockException &ex, const Parser &res, const function<void(const Value &, const string &, bool)> &fun) {
     bool should_retry = true;
     if (ex) {
@@ -126,7 +143,7 @@ static void parse_http_response(const SockException &ex, const Parser &res, cons
     }
     should_retry = false;
     if (code.asInt64() != 0) {
-        auto errStr = StrPrinter << "[auth failed]: code:" << code << " msg:" << result["msg"] << endl;
+        auto errStr = StrPrinter << kAuthFailedTag << ": code:" << code << " msg:" << result["msg"] << endl;
         fun(Json::nullValue, errStr, should_retry);
         return;
     }
@@ -170,26 +187,343 @@ string getVhost(const HttpArgs &value) {
 
 static atomic<uint64_t> s_hook_index { 0 };
 
+/**
+ * 每个hook url对应一个连接池，复用keep-alive连接并限制并发数，超出并发数的请求排队等待
+ * 另外支持把无需回复的hook事件合并为json数组批量上报
+ * Each hook url owns a connection pool, which reuses keep-alive connections and limits the concurrency,
+ * requests exceeding the concurrency limit are queued.
+ * It also supports merging hook events that need no reply into a json array and reporting them in batch
+ */
+class WebHookPool : public std::enable_shared_from_this<WebHookPool> {
+public:
+    using Ptr = std::shared_ptr<WebHookPool>;
+
+    struct Request {
+        using Ptr = std::shared_ptr<Request>;
+        std::string body;
+        std::string content_type;
+        std::string vhost;
+        // 入队计时，用于计算排队耗时和判断排队超时
+        // Enqueue ticker, used to calculate queuing time and check queuing timeout
+        Ticker ticker;
+        HttpRequester::HttpRequesterResult on_result;
+    };
+
+    WebHookPool(std::string url) : _url(std::move(url)) {}
+
+    static Ptr get(const std::string &url) {
+        lock_guard<mutex> lck(s_mtx);
+        auto &ret = s_pools[url];
+        if (!ret) {
+            ret = std::make_shared<WebHookPool>(url);
+        }
+        return ret;
+    }
+
+    static void for_each(const function<void(const Ptr &)> &cb) {
+        decltype(s_pools) copy;
+        {
+            lock_guard<mutex> lck(s_mtx);
+            copy = s_pools;
+        }
+        for (auto &pr : copy) {
+            cb(pr.second);
+        }
+    }
+
+    void request(Request::Ptr req) {
+        GET_CONFIG(uint32_t, max_connection, Hook::kMaxConnection);
+        HttpRequester::Ptr requester;
+        bool start_timer = false;
+        {
+            lock_guard<mutex> lck(_mtx);
+            ++_total;
+            if (max_connection && _busy >= max_connection) {
+                // 并发数已满，排队等待空闲连接
+                // The concurrency limit is reached, wait in queue for an idle connection
+                _queue.emplace_back(std::move(req));
+                _max_queue = MAX(_max_queue, _queue.size());
+                start_timer = !_expire_timer;
+                _expire_timer = true;
+            } else {
+                ++_busy;
+                if (!_idle.empty()) {
+                    requester = std::move(_idle.back());
+                    _idle.pop_back();
+                }
+            }
+        }
+        if (start_timer) {
+            startExpireTimer();
+        }
+        if (req) {
+            startRequest(std::move(requester), std::move(req));
+        }
+    }
+
+    void batch(ArgsType body) {
+        GET_CONFIG(uint32_t, batch_ms, Hook::kBatchIntervalMS);
+        bool flush_now, start_timer;
+        {
+            lock_guard<mutex> lck(_mtx);
+            _batch.emplace_back(std::move(body));
+            start_timer = _batch.size() == 1;
+            flush_now = _batch.size() >= kMaxBatchSize;
+        }
+        if (flush_now) {
+            flushBatch();
+            return;
+        }
+        if (start_timer) {
+            weak_ptr<WebHookPool> weak_self = shared_from_this();
+            EventPollerPool::Instance().getPoller()->doDelayTask(batch_ms, [weak_self]() {
+                if (auto strong_self = weak_self.lock()) {
+                    strong_self->flushBatch();
+                }
+                return 0;
+            });
+        }
+    }
+
+    void getStatistic(Value &val) {
+        lock_guard<mutex> lck(_mtx);
+        val["url"] = _url;
+        val["busy"] = (Json::UInt64)_busy;
+        val["idle"] = (Json::UInt64)_idle.size();
+        val["queue"] = (Json::UInt64)_queue.size();
+        val["maxQueue"] = (Json::UInt64)_max_queue;
+        val["total"] = (Json::UInt64)_total;
+        val["completed"] = (Json::UInt64)_completed;
+        val["failed"] = (Json::UInt64)_failed;
+        val["queueTimeout"] = (Json::UInt64)_queue_timeout;
+        val["reused"] = (Json::UInt64)_reused;
+        val["batches"] = (Json::UInt64)_batches;
+        val["batchedEvents"] = (Json::UInt64)_batched_events;
+        val["avgLatencyMS"] = (Json::UInt64)(_completed ? _total_latency_ms / _completed : 0);
+        val["maxLatencyMS"] = (Json::UInt64)_max_latency_ms;
+        val["avgQueueMS"] = (Json::UInt64)(_completed ? _total_queue_ms / _completed : 0);
+        val["maxQueueMS"] = (Json::UInt64)_max_queue_ms;
+    }
+
+private:
+    void startRequest(HttpRequester::Ptr requester, Request::Ptr req) {
+        if (requester) {
+            lock_guard<mutex> lck(_mtx);
+            ++_reused;
+        } else {
+            requester = std::make_shared<HttpRequester>();
+        }
+        auto self = shared_from_this();
+        // 不能同步执行，因为上个请求的回调可能还未返回(HttpRequester在回调返回后才会清空回调)
+        // Must not run synchronously, because the callback of the previous request may not have returned yet
+        // (HttpRequester clears its callback only after the callback returns)
+        requester->getPoller()->async([self, requester, req]() {
+            GET_CONFIG(float, hook_timeoutSec, Hook::kTimeoutSec);
+            auto queue_ms = req->ticker.elapsedTime();
+            requester->clear();
+            requester->setMethod("POST");
+            requester->setBody(req->body);
+            requester->addHeader("Content-Type", req->content_type);
+            if (!req->vhost.empty()) {
+                requester->addHeader("X-VHOST", req->vhost);
+            }
+            Ticker ticker;
+            try {
+                requester->startRequester(self->_url, [self, requester, req, ticker, queue_ms](const SockException &ex, const Parser &res) {
+                    self->onResult(requester, ex, ticker.elapsedTime(), queue_ms);
+                    req->on_result(ex, res);
+                }, hook_timeoutSec);
+            } catch (std::exception &ex) {
+                // 一般是url非法
+                // Usually the url is invalid
+                SockException err(Err_other, ex.what());
+                self->onResult(nullptr, err, 0, queue_ms);
+                req->on_result(err, Parser());
+            }
+        }, false);
+    }
+
+    // 所有连接都卡住时不会有请求完成，需要定时清理排队超时的请求，队列清空后定时器停止
+    // No request completes when all the connections are stuck, so the requests timed out in the queue are expired
+    // by a timer, which stops once the queue is empty
+    void startExpireTimer() {
+        weak_ptr<WebHookPool> weak_self = shared_from_this();
+        EventPollerPool::Instance().getPoller()->doDelayTask(kExpireIntervalMS, [weak_self]() -> uint64_t {
+            auto strong_self = weak_self.lock();
+            if (!strong_self || !strong_self->expireQueue()) {
+                return 0;
+            }
+            return kExpireIntervalMS;
+        });
+    }
+
+    // 返回队列是否仍有请求
+    // Return whether there are still requests in the queue
+    bool expireQueue() {
+        GET_CONFIG(float, hook_timeoutSec, Hook::kTimeoutSec);
+        std::vector<Request::Ptr> expired;
+        bool ret;
+        {
+            lock_guard<mutex> lck(_mtx);
+            // 队列按入队时间排序，超时的请求都在队首
+            // The queue is ordered by enqueue time, so the timed out requests are all at the front
+            while (!_queue.empty() && _queue.front()->ticker.elapsedTime() > hook_timeoutSec * 1000) {
+                ++_queue_timeout;
+                expired.emplace_back(std::move(_queue.front()));
+                _queue.pop_front();
+            }
+            ret = !_queue.empty();
+            _expire_timer = ret;
+        }
+        for (auto &req : expired) {
+            req->on_result(SockException(Err_timeout, "wait in webhook queue timeout"), Parser());
+        }
+        return ret;
+    }
+
+    void onResult(const HttpRequester::Ptr &requester, const SockException &ex, uint64_t latency_ms, uint64_t queue_ms) {
+        GET_CONFIG(uint32_t, max_connection, Hook::kMaxConnection);
+        GET_CONFIG(float, hook_timeoutSec, Hook::kTimeoutSec);
+        // 网络异常的连接不再复用
+        // Connections with network errors are not reused
+        auto next_requester = ex ? nullptr : requester;
+        Request::Ptr next;
+        std::vector<Request::Ptr> expired;
+        {
+            lock_guard<mutex> lck(_mtx);
+            ++_completed;
+            if (ex) {
+                ++_failed;
+            }
+            _total_latency_ms += latency_ms;
+            _max_latency_ms = MAX(_max_latency_ms, latency_ms);
+            _total_queue_ms += queue_ms;
+            _max_queue_ms = MAX(_max_queue_ms, queue_ms);
+
+            while (!_queue.empty()) {
+                auto req = std::move(_queue.front());
+                _queue.pop_front();
+                if (req->ticker.elapsedTime() > hook_timeoutSec * 1000) {
+                    // 排队超时
+                    // Queuing timeout
+                    ++_queue_timeout;
+                    expired.emplace_back(std::move(req));
+                    continue;
+                }
+                next = std::move(req);
+                break;
+            }
+            if (!next) {
+                --_busy;
+                if (next_requester && (!max_connection || _idle.size() < max_connection)) {
+                    _idle.emplace_back(std::move(next_requester));
+                }
+            }
+        }
+        for (auto &req : expired) {
+            req->on_result(SockException(Err_timeout, "wait in webhook queue timeout"), Parser());
+        }
+        if (next) {
+            startRequest(std::move(next_requester), std::move(next));
+        }
+    }
+
+    void flushBatch() {
+        GET_CONFIG(uint32_t, hook_retry, Hook::kRetry);
+        Value array(arrayValue);
+        {
+            lock_guard<mutex> lck(_mtx);
+            if (_batch.empty()) {
+                return;
+            }
+            for (auto &body : _batch) {
+                array.append(std::move(body));
+            }
+            _batched_events += _batch.size();
+            ++_batches;
+            _batch.clear();
+        }
+        sendBatch(std::make_shared<std::string>(array.toStyledString()), hook_retry);
+    }
+
+    void sendBatch(std::shared_ptr<std::string> body, uint32_t retry) {
+        GET_CONFIG(float, retry_delay, Hook::kRetryDelay);
+        auto req = std::make_shared<Request>();
+        req->body = *body;
+        req->content_type = "application/json";
+        weak_ptr<WebHookPool> weak_self = shared_from_this();
+        req->on_result = [weak_self, body, retry](const SockException &ex, const Parser &res) mutable {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            if (!ex && res.status() == "200") {
+                return;
+            }
+            WarnL << "batch hook " << strong_self->_url << " failed: " << (ex ? ex.what() : res.status());
+            if (retry-- > 0) {
+                EventPollerPool::Instance().getPoller()->doDelayTask(MAX(retry_delay, 0.0) * 1000, [weak_self, body, retry]() {
+                    if (auto strong_self = weak_self.lock()) {
+                        strong_self->sendBatch(body, retry);
+                    }
+                    return 0;
+                });
+            }
+        };
+        request(std::move(req));
+    }
+
+private:
+    // 单次批量上报的最大事件数
+    // Maximum number of events in a single batch report
+    static constexpr size_t kMaxBatchSize = 100;
+    // 清理排队超时请求的间隔
+    // Interval to expire the requests timed out in the queue
+    static constexpr uint64_t kExpireIntervalMS = 500;
+    static mutex s_mtx;
+    static unordered_map<std::string, Ptr> s_pools;
+
+    std::string _url;
+    mutex _mtx;
+    size_t _busy = 0;
+    std::vector<HttpRequester::Ptr> _idle;
+    std::deque<Request::Ptr> _queue;
+    // 排队超时清理定时器是否在运行
+    // Whether the queue expiring timer is running
+    bool _expire_timer = false;
+    std::vector<ArgsType> _batch;
+
+    size_t _max_queue = 0;
+    uint64_t _total = 0;
+    uint64_t _completed = 0;
+    uint64_t _failed = 0;
+    uint64_t _queue_timeout = 0;
+    uint64_t _reused = 0;
+    uint64_t _batches = 0;
+    uint64_t _batched_events = 0;
+    uint64_t _total_latency_ms = 0;
+    uint64_t _max_latency_ms = 0;
+    uint64_t _total_queue_ms = 0;
+    uint64_t _max_queue_ms = 0;
+};
+
+mutex WebHookPool::s_mtx;
+unordered_map<std::string, WebHookPool::Ptr> WebHookPool::s_pools;
+
 void do_http_hook(const string &url, const ArgsType &body, const function<void(const Value &, const string &)> &func, uint32_t retry) {
     GET_CONFIG(string, mediaServerId, General::kMediaServerId);
-    GET_CONFIG(float, hook_timeoutSec, Hook::kTimeoutSec);
     GET_CONFIG(float, retry_delay, Hook::kRetryDelay);
 
     const_cast<ArgsType &>(body)["mediaServerId"] = mediaServerId;
     const_cast<ArgsType &>(body)["hook_index"] = (Json::UInt64)(s_hook_index++);
 
-    auto requester = std::make_shared<HttpRequester>();
-    requester->setMethod("POST");
-    auto bodyStr = to_string(body);
-    requester->setBody(bodyStr);
-    requester->addHeader("Content-Type", getContentType(body));
-    auto vhost = getVhost(body);
-    if (!vhost.empty()) {
-        requester->addHeader("X-VHOST", vhost);
-    }
+    auto req = std::make_shared<WebHookPool::Request>();
+    req->body = to_string(body);
+    req->content_type = getContentType(body);
+    req->vhost = getVhost(body);
+    auto bodyStr = req->body;
     Ticker ticker;
-    requester->startRequester(url, [url, func, bodyStr, body, requester, ticker, retry](const SockException &ex, const Parser &res) mutable {
-        onceToken token(nullptr, [&]() mutable { requester.reset(); });
+    req->on_result = [url, func, bodyStr, body, ticker, retry](const SockException &ex, const Parser &res) mutable {
         parse_http_response(ex, res, [&](const Value &obj, const string &err, bool should_retry) {
             if (!err.empty()) {
                 // hook失败  [AUTO-TRANSLATED:68231f46]
@@ -197,7 +531,7 @@ void do_http_hook(const string &url, const ArgsType &body, const function<void(c
                 WarnL << "hook " << url << " " << ticker.elapsedTime() << "ms,failed" << err << ":" << bodyStr;
 
                 if (retry-- > 0 && should_retry) {
-                    requester->getPoller()->doDelayTask(MAX(retry_delay, 0.0) * 1000, [url, body, func, retry] {
+                    EventPollerPool::Instance().getPoller()->doDelayTask(MAX(retry_delay, 0.0) * 1000, [url, body, func, retry] {
                         do_http_hook(url, body, func, retry);
                         return 0;
                     });
@@ -216,7 +550,8 @@ void do_http_hook(const string &url, const ArgsType &body, const function<void(c
                 func(obj, err);
             }
         });
-    }, hook_timeoutSec);
+    };
+    WebHookPool::get(url)->request(std::move(req));
 }
 
 void do_http_hook(const string &url, const ArgsType &body, const function<void(const Value &, const string &)> &func) {
@@ -224,6 +559,205 @@ void do_http_hook(const string &url, const ArgsType &body, const function<void(c
     do_http_hook(url, body, func, hook_retry);
 }
 
+/**
+ * 触发无需回复的hook事件，开启批量上报时合并为json数组上报
+ * Trigger a hook event that needs no reply, merged into a json array when batch reporting is enabled
+ */
+static void do_http_hook_batch(const string &url, ArgsType body) {
+#ifdef JSON_ARGS
+    GET_CONFIG(uint32_t, batch_ms, Hook::kBatchIntervalMS);
+    if (batch_ms) {
+        GET_CONFIG(string, mediaServerId, General::kMediaServerId);
+        body["mediaServerId"] = mediaServerId;
+        body["hook_index"] = (Json::UInt64)(s_hook_index++);
+        WebHookPool::get(url)->batch(std::move(body));
+        return;
+    }
+#endif
+    do_http_hook(url, body, nullptr);
+}
+
+/**
+ * 鉴权结果缓存，避免同一播放器/推流器短时间内重复触发鉴权hook
+ * 相同的鉴权请求并发时只触发一次hook，其他请求等待该hook结果
+ * Authentication result cache, avoiding repeated authentication hooks triggered by the same player/pusher in a short time.
+ * Concurrent identical authentication requests trigger the hook only once, the others wait for its result
+ */
+class WebHookAuthCache {
+public:
+    using onResult = function<void(const Value &, const string &)>;
+
+    static WebHookAuthCache &Instance() {
+        static WebHookAuthCache s_instance;
+        return s_instance;
+    }
+
+    static bool enabled() {
+        GET_CONFIG(float, cache_sec, Hook::kAuthCacheSec);
+        GET_CONFIG(float, fail_cache_sec, Hook::kAuthFailCacheSec);
+        return cache_sec > 0 || fail_cache_sec > 0;
+    }
+
+    void request(const string &key, const MediaTuple &tuple, const string &url, const ArgsType &body, const onResult &cb) {
+        bool hit = false;
+        Value obj;
+        string err;
+        {
+            lock_guard<mutex> lck(_mtx);
+            auto it = _map.find(key);
+            if (it != _map.end() && it->second->expire_ms > getCurrentMillisecond(true)) {
+                // 命中缓存，移至lru头部
+                // Cache hit, move to the head of lru
+                _lru.splice(_lru.begin(), _lru, it->second);
+                ++_hits;
+                hit = true;
+                obj = it->second->obj;
+                err = it->second->err;
+            } else {
+                if (it != _map.end()) {
+                    _lru.erase(it->second);
+                    _map.erase(it);
+                }
+                ++_misses;
+                auto &waiters = _pending[key];
+                waiters.emplace_back(cb);
+                if (waiters.size() > 1) {
+                    // 已有相同的鉴权请求在进行中
+                    // An identical authentication request is in progress
+                    return;
+                }
+            }
+        }
+        if (hit) {
+            cb(obj, err);
+            return;
+        }
+        do_http_hook(url, body, [key, tuple](const Value &obj, const string &err) {
+            WebHookAuthCache::Instance().onHookResult(key, tuple, obj, err);
+        });
+    }
+
+    size_t clear(const string &vhost, const string &app, const string &stream) {
+        lock_guard<mutex> lck(_mtx);
+        size_t count = 0;
+        for (auto it = _lru.begin(); it != _lru.end();) {
+            if ((!vhost.empty() && vhost != it->tuple.vhost) || (!app.empty() && app != it->tuple.app)
+                || (!stream.empty() && stream != it->tuple.stream)) {
+                ++it;
+                continue;
+            }
+            _map.erase(it->key);
+            it = _lru.erase(it);
+            ++count;
+        }
+        return count;
+    }
+
+    void getStatistic(Value &val) {
+        lock_guard<mutex> lck(_mtx);
+        val["size"] = (Json::UInt64)_lru.size();
+        val["pending"] = (Json::UInt64)_pending.size();
+        val["hits"] = (Json::UInt64)_hits;
+        val["misses"] = (Json::UInt64)_misses;
+    }
+
+private:
+    struct Item {
+        string key;
+        MediaTuple tuple;
+        Value obj;
+        string err;
+        uint64_t expire_ms;
+    };
+
+    void onHookResult(const string &key, const MediaTuple &tuple, const Value &obj, const string &err) {
+        GET_CONFIG(float, cache_sec, Hook::kAuthCacheSec);
+        GET_CONFIG(float, fail_cache_sec, Hook::kAuthFailCacheSec);
+        GET_CONFIG(uint32_t, cache_size, Hook::kAuthCacheSize);
+
+        float ttl = 0;
+        if (err.empty()) {
+            // hook回复中的cache_sec字段优先，为0时不缓存
+            // The cache_sec field in the hook reply takes precedence, 0 means no caching
+            ttl = obj.isMember("cache_sec") ? obj["cache_sec"].asFloat() : cache_sec;
+        } else if (err.compare(0, sizeof(kAuthFailedTag) - 1, kAuthFailedTag) == 0) {
+            // 仅缓存hook服务器明确拒绝的结果，网络错误等不缓存
+            // Only cache results explicitly rejected by the hook server, network errors etc. are not cached
+            ttl = fail_cache_sec;
+        }
+
+        std::vector<onResult> waiters;
+        {
+            lock_guard<mutex> lck(_mtx);
+            auto it = _pending.find(key);
+            if (it != _pending.end()) {
+                waiters.swap(it->second);
+                _pending.erase(it);
+            }
+            if (ttl > 0 && cache_size) {
+                auto map_it = _map.find(key);
+                if (map_it != _map.end()) {
+                    _lru.erase(map_it->second);
+                    _map.erase(map_it);
+                }
+                _lru.emplace_front(Item { key, tuple, obj, err, getCurrentMillisecond(true) + (uint64_t)(ttl * 1000) });
+                _map.emplace(key, _lru.begin());
+                while (_lru.size() > cache_size) {
+                    _map.erase(_lru.back().key);
+                    _lru.pop_back();
+                }
+            }
+        }
+        for (auto &cb : waiters) {
+            cb(obj, err);
+        }
+    }
+
+private:
+    mutex _mtx;
+    uint64_t _hits = 0;
+    uint64_t _misses = 0;
+    std::list<Item> _lru;
+    unordered_map<string, std::list<Item>::iterator> _map;
+    unordered_map<string, std::vector<onResult>> _pending;
+};
+
+/**
+ * 触发鉴权hook，开启鉴权缓存时优先使用缓存结果
+ * @param type hook类型
+ * @param extra 除流信息、url参数、ip外其他影响鉴权结果的参数
+ * Trigger an authentication hook, cached results are preferred when the authentication cache is enabled
+ * @param type hook type
+ * @param extra Other arguments affecting the authentication result besides the stream info, url params and ip
+ */
+static void do_auth_hook(const char *type, const MediaInfo &args, const string &ip, const string &extra, const string &url, const ArgsType &body,
+                         const function<void(const Value &, const string &)> &func) {
+    if (!WebHookAuthCache::enabled()) {
+        do_http_hook(url, body, func);
+        return;
+    }
+    _StrPrinter key;
+    key << type << '\n' << args.shortUrl() << '\n' << args.params << '\n' << ip << '\n' << extra;
+    WebHookAuthCache::Instance().request(key, args, url, body, func);
+}
+
+size_t clearWebHookAuthCache(const string &vhost, const string &app, const string &stream) {
+    return WebHookAuthCache::Instance().clear(vhost, app, stream);
+}
+
+void getWebHookAuthCacheStatistic(Value &val) {
+    WebHookAuthCache::Instance().getStatistic(val);
+}
+
+void getWebHookStatistic(Value &val) {
+    val = Value(arrayValue);
+    WebHookPool::for_each([&](const WebHookPool::Ptr &pool) {
+        Value item;
+        pool->getStatistic(item);
+        val.append(std::move(item));
+    });
+}
+
 void dumpMediaTuple(const MediaTuple &tuple, Json::Value& item);
 
 static ArgsType make_json(const MediaInfo &args) {
@@ -373,7 +907,7 @@ void installWebHook() {
         body["originTypeStr"] = getOriginTypeString(type);
         // 执行hook  [AUTO-TRANSLATED:1df68201]
         // Execute hook
-        do_http_hook(hook_publish, body, [invoker](const Value &obj, const string &err) mutable {
+        do_auth_hook("on_publish", args, sender.get_peer_ip(), std::to_string((int)type), hook_publish, body, [invoker](const Value &obj, const string &err) mutable {
             if (err.empty()) {
                 // 推流鉴权成功  [AUTO-TRANSLATED:e4285dab]
                 // Push stream authentication succeeded
@@ -398,7 +932,7 @@ void installWebHook() {
         body["id"] = sender.getIdentifier();
         // 执行hook  [AUTO-TRANSLATED:1df68201]
         // Execute hook
-        do_http_hook(hook_play, body, [invoker](const Value &obj, const string &err) { invoker(err); });
+        do_auth_hook("on_play", args, sender.get_peer_ip(), "", hook_play, body, [invoker](const Value &obj, const string &err) { invoker(err); });
     });
 
     NoticeCenter::Instance().addListener(&web_hook_tag, Broadcast::kBroadcastFlowReport, [](BroadcastFlowReportArgs) {
@@ -415,7 +949,7 @@ void installWebHook() {
         body["id"] = sender.getIdentifier();
         // 执行hook  [AUTO-TRANSLATED:1df68201]
         // Execute hook
-        do_http_hook(hook_flowreport, body, nullptr);
+        do_http_hook_batch(hook_flowreport, std::move(body));
     });
 
     static const string unAuthedRealm = "unAuthedRealm";
@@ -466,7 +1000,8 @@ void installWebHook() {
         body["realm"] = realm;
         // 执行hook  [AUTO-TRANSLATED:1df68201]
         // Execute hook
-        do_http_hook(hook_rtsp_auth, body, [invoker](const Value &obj, const string &err) {
+        auto extra = realm + '\n' + user_name + '\n' + (must_no_encrypt ? "1" : "0");
+        do_auth_hook("on_rtsp_auth", args, sender.get_peer_ip(), extra, hook_rtsp_auth, body, [invoker](const Value &obj, const string &err) {
             if (!err.empty()) {
                 // 认证失败  [AUTO-TRANSLATED:70cf56ff]
                 // Authentication failed
@@ -512,7 +1047,7 @@ void installWebHook() {
         }
         // 执行hook  [AUTO-TRANSLATED:1df68201]
         // Execute hook
-        do_http_hook(hook_stream_changed, body, nullptr);
+        do_http_hook_batch(hook_stream_changed, std::move(body));
     });
 
     GET_CONFIG_FUNC(vector<string>, origin_urls, Cluster::kOriginUrl, [](const string &str) {
@@ -572,11 +1107,15 @@ void installWebHook() {
         ArgsType body;
         body["start_time"] = (Json::UInt64)info.start_time;
         body["file_size"] = (Json::UInt64)info.file_size;
+        body["file_offset"] = (Json::UInt64)info.file_offset;
         body["time_len"] = info.time_len;
         body["file_path"] = info.file_path;
         body["file_name"] = info.file_name;
         body["folder"] = info.folder;
         body["url"] = info.url;
+        body["io_bytes"] = (Json::UInt64)info.io_bytes;
+        body["moov_in_place"] = info.moov_in_place;
+        body["key_frames"] = info.key_frames;
         dumpMediaTuple(info, body);
         return body;
     };
@@ -48,4 +48,30 @@ void onProcessExited();
  * [AUTO-TRANSLATED:8ffdd09b]
  */
 void do_http_hook(const std::string &url, const ArgsType &body, const std::function<void(const Json::Value &, const std::string &)> &func = nullptr);
+
+/**
+ * 获取各hook地址连接池的统计信息(并发数、排队数、耗时等)
+ * Get the statistics of the connection pool of each hook url (concurrency, queue size, latency, etc.)
+ */
+void getWebHookStatistic(Json::Value &val);
+
+/**
+ * 清除鉴权结果缓存(on_play/on_publish/on_rtsp_auth)
+ * @param vhost 虚拟主机，为空则不过滤
+ * @param app 应用名，为空则不过滤
+ * @param stream 流id，为空则不过滤
+ * @return 清除的缓存条数
+ * Clear the authentication result cache (on_play/on_publish/on_rtsp_auth)
+ * @param vhost Virtual host, no filtering if empty
+ * @param app Application name, no filtering if empty
+ * @param stream Stream id, no filtering if empty
+ * @return Number of cleared cache entries
+ */
+size_t clearWebHookAuthCache(const std::string &vhost, const std::string &app, const std::string &stream);
+
+/**
+ * 获取鉴权结果缓存的统计信息(条数、命中数等)
+ * Get the statistics of the authentication result cache (size, hits, etc.)
+ */
+void getWebHookAuthCacheStatistic(Json::Value &val);
 #endif //ZLMEDIAKIT_WEBHOOK_H
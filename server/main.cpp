@@ -356,11 +356,11 @@ int start_main(int argc,char *argv[]) {
         // webrtc udp服务器  [AUTO-TRANSLATED:157a64e5]
         // webrtc udp server
         auto rtcSrv_udp = std::make_shared<UdpServer>();
-        rtcSrv_udp->setOnCreateSocket([](const EventPoller::Ptr &poller, const Buffer::Ptr &buf, struct sockaddr *, int) {
+        rtcSrv_udp->setOnCreateSocket([](const EventPoller::Ptr &poller, const Buffer::Ptr &buf, struct sockaddr *addr, int) {
             if (!buf) {
                 return Socket::createSocket(poller, false);
             }
-            auto new_poller = WebRtcSession::queryPoller(buf);
+            auto new_poller = WebRtcSession::queryPoller(buf, addr);
             if (!new_poller) {
                 // 该数据对应的webrtc对象未找到，丢弃之  [AUTO-TRANSLATED:d401f8cb]
                 // The webrtc object corresponding to this data is not found, discard it
@@ -44,11 +44,27 @@ string findSubString(const char *buf, const char *start, const char *end, size_t
     return string(msg_start, msg_end);
 }
 
+static inline bool isTrimChar(char ch) {
+    return ch == ' ' || ch == '\r' || ch == '\n' || ch == '\t';
+}
+
+static inline void trimRange(const char *&start, const char *&end) {
+    while (start < end && isTrimChar(*start)) {
+        ++start;
+    }
+    while (end > start && isTrimChar(*(end - 1))) {
+        --end;
+    }
+}
+
 void Parser::parse(const char *buf, size_t size) {
     clear();
+    // 所有分隔符查找都限定在buf范围内，memchr由libc做了向量化优化
+    // All delimiter searches are bounded by buf, memchr is vectorized by libc
+    auto buf_end = buf + size;
     auto ptr = buf;
     while (true) {
-        auto next_line = strchr(ptr, '\n');
+        auto next_line = (const char *)memchr(ptr, '\n', buf_end - ptr);
         auto offset = 1;
         CHECK(next_line && next_line > ptr);
         if (*(next_line - 1) == '\r') {
@@ -56,34 +72,41 @@ void Parser::parse(const char *buf, size_t size) {
             offset = 2;
         }
         if (ptr == buf) {
-            auto blank = strchr(ptr, ' ');
+            auto blank = (const char *)memchr(ptr, ' ', next_line - ptr);
             CHECK(blank > ptr && blank < next_line);
-           _method = std::string(ptr, blank - ptr);
-            auto next_blank = strchr(blank + 1, ' ');
+            _method.assign(ptr, blank);
+            auto next_blank = (const char *)memchr(blank + 1, ' ', next_line - blank - 1);
             CHECK(next_blank && next_blank < next_line);
-            _url.assign(blank + 1, next_blank);
-            auto pos = _url.find('?');
-            if (pos != string::npos) {
-                _params = _url.substr(pos + 1);
-                _url_args = parseArgs(_params);
-                _url = _url.substr(0, pos);
+            auto mark = (const char *)memchr(blank + 1, '?', next_blank - blank - 1);
+            if (mark) {
+                _url.assign(blank + 1, mark);
+                _params.assign(mark + 1, next_blank);
+            } else {
+                _url.assign(blank + 1, next_blank);
             }
-            _protocol = std::string(next_blank + 1, next_line);
+            _protocol.assign(next_blank + 1, next_line);
         } else {
-            auto pos = strchr(ptr, ':');
+            auto pos = (const char *)memchr(ptr, ':', next_line - ptr);
             CHECK(pos > ptr && pos < next_line);
-            std::string key { ptr, static_cast<std::size_t>(pos - ptr) };
-            std::string value;
-            if (pos[1] == ' ') {
-                value.assign(pos + 2, next_line);
-            } else {
-                value.assign(pos + 1, next_line);
-            }
-            _headers.emplace_force(trim(std::move(key)), trim(std::move(value)));
+            auto key_start = ptr;
+            auto key_end = pos;
+            auto value_start = pos[1] == ' ' ? pos + 2 : pos + 1;
+            auto value_end = next_line;
+            trimRange(key_start, key_end);
+            trimRange(value_start, value_end);
+            HeaderItem item;
+            item.key_offset = key_start - buf;
+            item.key_size = key_end - key_start;
+            item.value_offset = value_start - buf;
+            item.value_size = value_end - value_start;
+            _header_items.emplace_back(std::move(item));
         }
         ptr = next_line + offset;
-        if (strncmp(ptr, "\r\n", 2) == 0) { // 协议解析完毕
-            _content.assign(ptr + 2, buf + size);
+        if (buf_end - ptr >= 2 && ptr[0] == '\r' && ptr[1] == '\n') { // 协议解析完毕
+            // 只拷贝协议头部分，header均以偏移量引用它
+            // Only copy the protocol header part, all headers reference it by offset
+            _buffer.assign(buf, ptr);
+            _content.assign(ptr + 2, buf_end);
             break;
         }
     }
@@ -119,11 +142,27 @@ const std::string &Parser::statusStr() const {
 static std::string kNull;
 
 const string &Parser::operator[](const char *name) const {
-    auto it = _headers.find(name);
-    if (it == _headers.end()) {
-        return kNull;
+    if (_headers_built) {
+        auto it = _headers.find(name);
+        if (it == _headers.end()) {
+            return kNull;
+        }
+        return it->second;
     }
-    return it->second;
+    // header数量很少，线性查找比multimap更快且无需内存分配
+    // There are only a few headers, linear search is faster than multimap and needs no allocation
+    auto name_size = strlen(name);
+    for (auto &item : _header_items) {
+        if (item.key_size != name_size || strncasecmp(_buffer.data() + item.key_offset, name, name_size) != 0) {
+            continue;
+        }
+        if (!item.cached) {
+            item.value.assign(_buffer.data() + item.value_offset, item.value_size);
+            item.cached = true;
+        }
+        return item.value;
+    }
+    return kNull;
 }
 
 const string &Parser::content() const {
@@ -136,6 +175,10 @@ void Parser::clear() {
     _params.clear();
     _protocol.clear();
     _content.clear();
+    _buffer.clear();
+    _header_items.clear();
+    _headers_built = false;
+    _url_args_built = false;
     _headers.clear();
     _url_args.clear();
 }
@@ -152,11 +195,31 @@ void Parser::setContent(string content) {
     _content = std::move(content);
 }
 
+void Parser::buildHeaders() const {
+    _headers_built = true;
+    for (auto &item : _header_items) {
+        // 已缓存的value可能已被operator[]返回给外部持有引用，只能拷贝不能移动
+        // A cached value may have been returned by operator[] and referenced outside, so it is copied rather than moved
+        _headers.emplace_force(std::string(_buffer.data() + item.key_offset, item.key_size),
+                               std::string(_buffer.data() + item.value_offset, item.value_size));
+    }
+    // 此后以_headers为准，_header_items不再用于查找，但保留到clear()以保证已返回的引用有效
+    // From now on _headers is authoritative, _header_items is no longer used for lookups,
+    // but kept until clear() so that the references returned earlier stay valid
+}
+
 StrCaseMap &Parser::getHeader() const {
+    if (!_headers_built) {
+        buildHeaders();
+    }
     return _headers;
 }
 
 StrCaseMap &Parser::getUrlArgs() const {
+    if (!_url_args_built) {
+        _url_args_built = true;
+        _url_args = parseArgs(_params);
+    }
     return _url_args;
 }
 
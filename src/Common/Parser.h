@@ -13,6 +13,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include "Util/util.h"
 
 namespace mediakit {
@@ -62,8 +63,8 @@ public:
 // rtsp/http/sip parsing class
 class Parser {
 public:
-    // 解析http/rtsp/sip请求，需要确保buf以\0结尾  [AUTO-TRANSLATED:552953af]
-    // Parse http/rtsp/sip request, ensure buf ends with \0
+    // 解析http/rtsp/sip请求，只在[buf, buf + size)范围内查找  [AUTO-TRANSLATED:552953af]
+    // Parse http/rtsp/sip request, only searches within [buf, buf + size)
     void parse(const char *buf, size_t size);
 
     // 获取命令字，如GET/POST  [AUTO-TRANSLATED:34750f3d]
@@ -126,12 +127,34 @@ public:
 
     static std::string mergeUrl(const std::string &base_url, const std::string &path);
 
+private:
+    // header在_buffer中的位置，value在首次被查询时才拷贝为std::string
+    // Position of the header in _buffer, the value is copied into std::string only when it is queried for the first time
+    struct HeaderItem {
+        uint32_t key_offset;
+        uint32_t key_size;
+        uint32_t value_offset;
+        uint32_t value_size;
+        mutable bool cached = false;
+        mutable std::string value;
+    };
+
+    void buildHeaders() const;
+
 private:
     std::string _method;
     std::string _url;
     std::string _protocol;
     std::string _content;
     std::string _params;
+    // 协议头原始数据，只拷贝一次，header以偏移量形式引用该缓存
+    // Raw protocol header data, copied only once, headers reference this buffer by offset
+    std::string _buffer;
+    std::vector<HeaderItem> _header_items;
+    // getHeader()/getUrlArgs()被调用时才构建，构建后以map为准(外部可能修改)
+    // Built only when getHeader()/getUrlArgs() is called, after that the map is authoritative (it may be modified externally)
+    mutable bool _headers_built = false;
+    mutable bool _url_args_built = false;
     mutable StrCaseMap _headers;
     mutable StrCaseMap _url_args;
 };
@@ -65,6 +65,7 @@ const string kBroadcastRtcSctpFailed = "kBroadcastRtcSctpFailed";
 const string kBroadcastRtcSctpClosed = "kBroadcastRtcSctpClosed";
 const string kBroadcastRtcSctpSend = "kBroadcastRtcSctpSend";
 const string kBroadcastRtcSctpReceived = "kBroadcastRtcSctpReceived";
+const string kBroadcastRtcBweChanged = "kBroadcastRtcBweChanged";
 const string kBroadcastPlayerCountChanged = "kBroadcastPlayerCountChanged";
 
 } // namespace Broadcast
@@ -192,6 +193,14 @@ const string kForbidCacheSuffix = HTTP_FIELD "forbidCacheSuffix";
 const string kForwardedIpHeader = HTTP_FIELD "forwarded_ip_header";
 const string kAllowCrossDomains = HTTP_FIELD "allow_cross_domains";
 const string kAllowIPRange = HTTP_FIELD "allow_ip_range";
+const string kEnableHttp2 = HTTP_FIELD "enableHttp2";
+const string kHttp2MaxStreams = HTTP_FIELD "http2MaxStreams";
+const string kFileCacheSize = HTTP_FIELD "fileCacheSize";
+const string kFileCacheMaxFileSize = HTTP_FIELD "fileCacheMaxFileSize";
+const string kCompressMinSize = HTTP_FIELD "compressMinSize";
+const string kGzipLevel = HTTP_FIELD "gzipLevel";
+const string kBrotliQuality = HTTP_FIELD "brotliQuality";
+const string kEnablePrecompressed = HTTP_FIELD "precompressed";
 
 static onceToken token([]() {
     mINI::Instance()[kSendBufSize] = 64 * 1024;
@@ -216,6 +225,14 @@ static onceToken token([]() {
     mINI::Instance()[kForwardedIpHeader] = "";
     mINI::Instance()[kAllowCrossDomains] = 1;
     mINI::Instance()[kAllowIPRange] = "::1,127.0.0.1,172.16.0.0-172.31.255.255,192.168.0.0-192.168.255.255,10.0.0.0-10.255.255.255";
+    mINI::Instance()[kEnableHttp2] = 0;
+    mINI::Instance()[kHttp2MaxStreams] = 100;
+    mINI::Instance()[kFileCacheSize] = 0;
+    mINI::Instance()[kFileCacheMaxFileSize] = 512;
+    mINI::Instance()[kCompressMinSize] = 1024;
+    mINI::Instance()[kGzipLevel] = 6;
+    mINI::Instance()[kBrotliQuality] = 4;
+    mINI::Instance()[kEnablePrecompressed] = 0;
 });
 
 } // namespace Http
@@ -323,14 +340,36 @@ const string kFileBufSize = RECORD_FIELD "fileBufSize";
 const string kFastStart = RECORD_FIELD "fastStart";
 const string kFileRepeat = RECORD_FIELD "fileRepeat";
 const string kEnableFmp4 = RECORD_FIELD "enableFmp4";
+const string kFmp4SyncMS = RECORD_FIELD "fmp4SyncMS";
+const string kFmp4Defragment = RECORD_FIELD "fmp4Defragment";
+const string kMoovReserveMaxSize = RECORD_FIELD "moovReserveMaxSize";
+const string kReadAheadMS = RECORD_FIELD "readAheadMS";
+const string kReadThreads = RECORD_FIELD "readThreads";
+const string kTrickPlaySpeed = RECORD_FIELD "trickPlaySpeed";
+const string kEnableIndex = RECORD_FIELD "enableIndex";
+const string kIndexCacheSize = RECORD_FIELD "indexCacheSize";
+const string kEnableCatalog = RECORD_FIELD "enableCatalog";
+const string kStoragePool = RECORD_FIELD "storagePool";
+const string kStorageMinFreeMB = RECORD_FIELD "storageMinFreeMB";
 
 static onceToken token([]() {
     mINI::Instance()[kAppName] = "record";
     mINI::Instance()[kSampleMS] = 500;
     mINI::Instance()[kFileBufSize] = 64 * 1024;
-    mINI::Instance()[kFastStart] = false;
+    mINI::Instance()[kFastStart] = 0;
     mINI::Instance()[kFileRepeat] = false;
     mINI::Instance()[kEnableFmp4] = false;
+    mINI::Instance()[kFmp4SyncMS] = 5000;
+    mINI::Instance()[kFmp4Defragment] = false;
+    mINI::Instance()[kMoovReserveMaxSize] = 16 * 1024;
+    mINI::Instance()[kReadAheadMS] = 3000;
+    mINI::Instance()[kReadThreads] = 0;
+    mINI::Instance()[kTrickPlaySpeed] = 4;
+    mINI::Instance()[kEnableIndex] = true;
+    mINI::Instance()[kIndexCacheSize] = 64;
+    mINI::Instance()[kEnableCatalog] = true;
+    mINI::Instance()[kStoragePool] = "";
+    mINI::Instance()[kStorageMinFreeMB] = 1024;
 });
 } // namespace Record
 
@@ -347,6 +386,8 @@ const string kFileBufSize = HLS_FIELD "fileBufSize";
 const string kBroadcastRecordTs = HLS_FIELD "broadcastRecordTs";
 const string kDeleteDelaySec = HLS_FIELD "deleteDelaySec";
 const string kFastRegister = HLS_FIELD "fastRegister";
+const string kMP4Vod = HLS_FIELD "mp4Vod";
+const string kArchive = HLS_FIELD "archive";
 
 static onceToken token([]() {
     mINI::Instance()[kSegmentDuration] = 2;
@@ -358,6 +399,8 @@ static onceToken token([]() {
     mINI::Instance()[kBroadcastRecordTs] = false;
     mINI::Instance()[kDeleteDelaySec] = 10;
     mINI::Instance()[kFastRegister] = false;
+    mINI::Instance()[kMP4Vod] = true;
+    mINI::Instance()[kArchive] = false;
 });
 } // namespace Hls
 
@@ -410,6 +453,7 @@ const string kRtspSpeed = "rtsp_speed";
 const string kLatency = "latency";
 const string kPassPhrase = "passPhrase";
 const string kCustomHeader = "custom_header";
+const string kHlsPrefetch = "hls_prefetch";
 } // namespace Client
 
 } // namespace mediakit
@@ -156,6 +156,11 @@ extern const std::string kBroadcastRtcSctpSend;
 extern const std::string kBroadcastRtcSctpReceived;
 #define BroadcastRtcSctpReceivedArgs WebRtcTransport& sender, uint16_t &streamId, uint32_t &ppid, const uint8_t *&msg, size_t &len
 
+// rtc播放器发送端带宽估计变化，state: 0(normal), 1(underusing), 2(overusing)
+// rtc player send-side bandwidth estimation changed, state: 0(normal), 1(underusing), 2(overusing)
+extern const std::string kBroadcastRtcBweChanged;
+#define BroadcastRtcBweChangedArgs WebRtcTransport& sender, uint32_t &bitrate_bps, float &loss_rate, int &state
+
 // 观看人数变化广播  [AUTO-TRANSLATED:5b246b54]
 // broadcast viewer count changes
 extern const std::string kBroadcastPlayerCountChanged;
@@ -382,6 +387,30 @@ extern const std::string kAllowCrossDomains;
 // 允许访问http api和http文件索引的ip地址范围白名单，置空情况下不做限制  [AUTO-TRANSLATED:ab939863]
 // Whitelist of IP address ranges allowed to access HTTP API and HTTP file index. No restrictions are imposed when empty
 extern const std::string kAllowIPRange;
+// 是否启用http/2(h2c prior knowledge与Upgrade: h2c)
+// Whether to enable http/2 (h2c prior knowledge and Upgrade: h2c)
+extern const std::string kEnableHttp2;
+// http/2单个连接最大并发流数
+// Maximum concurrent streams of a single http/2 connection
+extern const std::string kHttp2MaxStreams;
+// http小文件内存缓存总大小，单位MB，置0关闭
+// Total size of the http small file memory cache in MB, 0 to disable
+extern const std::string kFileCacheSize;
+// 可以缓存的最大文件大小，单位KB
+// Maximum size of a file that can be cached in KB
+extern const std::string kFileCacheMaxFileSize;
+// http api等动态回复启用压缩的最小body大小，单位字节，置0关闭
+// Minimum body size in bytes to compress dynamic responses such as http api, 0 to disable
+extern const std::string kCompressMinSize;
+// gzip压缩等级(1~9)
+// gzip compression level (1~9)
+extern const std::string kGzipLevel;
+// brotli压缩质量(0~11)
+// brotli compression quality (0~11)
+extern const std::string kBrotliQuality;
+// 静态文件是否优先回复预压缩的.br/.gz文件
+// Whether static files prefer the precompressed .br/.gz files
+extern const std::string kEnablePrecompressed;
 } // namespace Http
 
 // //////////SHELL配置///////////  [AUTO-TRANSLATED:f023ec45]
@@ -493,13 +522,50 @@ extern const std::string kSampleMS;
 extern const std::string kFileBufSize;
 // mp4录制完成后是否进行二次关键帧索引写入头部  [AUTO-TRANSLATED:53cfdcb5]
 // Whether to perform secondary keyframe index writing to the header after MP4 recording is completed
+// 0: 关闭，1: 关闭文件时重写整个文件，2: 在文件头部预留moov空间，关闭时原地写入
+// 0: disabled, 1: rewrite the whole file on close, 2: reserve space for moov at the head of the file and write it in place on close
 extern const std::string kFastStart;
+// fastStart=2时最大的moov预留大小，单位KB，估算的moov超过该值时改为录制fmp4
+// Maximum moov reservation in KB when fastStart=2, fmp4 is recorded instead if the estimated moov exceeds it
+extern const std::string kMoovReserveMaxSize;
 // mp4文件是否重头循环读取  [AUTO-TRANSLATED:69ac72de]
 // Whether to loop read the MP4 file from the beginning
 extern const std::string kFileRepeat;
 // mp4录制文件是否采用fmp4格式  [AUTO-TRANSLATED:12559ae0]
 // Whether to use fmp4 format for MP4 recording files
 extern const std::string kEnableFmp4;
+// fmp4录制时将已写入的分片同步到磁盘的间隔，单位毫秒，置0关闭
+// Interval in milliseconds to sync written fragments to the disk when recording fmp4, 0 to disable
+extern const std::string kFmp4SyncMS;
+// fmp4录制完成后是否在后台转换为普通mp4(moov+单个mdat)
+// Whether to convert the fmp4 recording to a plain mp4 (moov + single mdat) in the background after it is finished
+extern const std::string kFmp4Defragment;
+// mp4点播预读时长，单位毫秒，置0时关闭预读并在poller线程同步读文件
+// Read-ahead duration of mp4 vod in milliseconds, 0 disables read-ahead and reads the file synchronously in the poller thread
+extern const std::string kReadAheadMS;
+// mp4点播读文件线程数，置0时为cpu核数
+// Number of file reading threads of mp4 vod, 0 means the number of cpu cores
+extern const std::string kReadThreads;
+// mp4点播倍速不小于该值且有视频时只读取并输出关键帧，置0关闭
+// Only key frames are read and output when the mp4 vod speed is not less than this value and there is video, 0 to disable
+extern const std::string kTrickPlaySpeed;
+// mp4录制完成后是否生成sample索引文件(xxx.mp4.idx)，点播时加载索引无需解析moov
+// Whether to generate a sample index file (xxx.mp4.idx) after mp4 recording, vod loads the index without parsing moov
+extern const std::string kEnableIndex;
+// mp4索引内存缓存大小，单位MB
+// Size of the mp4 index memory cache in MB
+extern const std::string kIndexCacheSize;
+// 是否在每个流的录像目录下维护录像目录文件(.catalog)，记录每个mp4文件/hls切片的起止时间，用于按时间段快速查询录像
+// Whether to maintain a catalog file (.catalog) in the record folder of each stream, which records the start and end time
+// of each mp4 file/hls segment, to query recordings by time range quickly
+extern const std::string kEnableCatalog;
+// mp4录像存储池，多个磁盘挂载点以分号分隔，为空则不启用，录像保存在recordPath下
+// Storage pool of mp4 recordings, multiple disk mount points separated by semicolons,
+// disabled if empty and recordings are saved under recordPath
+extern const std::string kStoragePool;
+// 存储池磁盘剩余空间低于该值时不再分配新的录像，单位MB
+// A disk of the storage pool takes no new recordings when its free space is below this value, in MB
+extern const std::string kStorageMinFreeMB;
 } // namespace Record
 
 // //////////HLS相关配置///////////  [AUTO-TRANSLATED:873cc84c]
@@ -532,6 +598,13 @@ extern const std::string kDeleteDelaySec;
 // 如果设置为1，则第一个切片长度强制设置为1个GOP  [AUTO-TRANSLATED:fbbb651d]
 // If set to 1, the length of the first slice is forced to be 1 GOP
 extern const std::string kFastRegister;
+// 是否允许通过xxx.mp4/index.m3u8以hls方式点播带索引的mp4录像，切片按需从mp4生成
+// Whether to allow vod of indexed mp4 recordings as hls by xxx.mp4/index.m3u8, segments are generated from the mp4 on demand
+extern const std::string kMP4Vod;
+// 保留切片时，是否把切片追加写入每小时一个的归档文件，m3u8通过EXT-X-BYTERANGE引用切片在归档文件中的区间
+// Whether to append segments into one archive file per hour when segments are kept,
+// the m3u8 references the range of each segment in the archive file by EXT-X-BYTERANGE
+extern const std::string kArchive;
 } // namespace Hls
 
 // //////////Rtp代理相关配置///////////  [AUTO-TRANSLATED:7b285587]
@@ -639,6 +712,9 @@ extern const std::string kLatency;
 extern const std::string kPassPhrase;
 // 自定义rtsp/http头
 extern const std::string kCustomHeader;
+// hls拉流时提前并行下载的切片数，0(默认)为逐个下载
+// Number of segments downloaded ahead in parallel when pulling hls, 0 (default) downloads them one by one
+extern const std::string kHlsPrefetch;
 } // namespace Client
 } // namespace mediakit
 
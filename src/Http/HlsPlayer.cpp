@@ -53,7 +53,7 @@ void HlsPlayer::teardown_l(const SockException &ex) {
             // If the retry count has reached the maximum number of times, and the slice list is empty, and there are no slices being downloaded, then it is considered a failure to close the player
             // If the retry count has reached the maximum number of times, and the segments list is empty, and there is no segment being downloaded,
             // the player is considered to be closed due to failure
-            if (_ts_list.empty() && !(_http_ts_player && _http_ts_player->waitResponse()) && _try_fetch_index_times >= MAX_TRY_FETCH_INDEX_TIMES) {
+            if (_ts_list.empty() && !isFetchingSegment() && _try_fetch_index_times >= MAX_TRY_FETCH_INDEX_TIMES) {
                 onShutdown(ex);
             } else {
                 _try_fetch_index_times += 1;
@@ -74,9 +74,17 @@ void HlsPlayer::teardown_l(const SockException &ex) {
             onShutdown(ex);
         }
     }
+    if (_statistic.segments) {
+        InfoL << "Hls segments downloaded:" << _statistic.segments << ", failed:" << _statistic.failed
+              << ", avg fetch ms:" << _statistic.total_fetch_ms / _statistic.segments << ", max fetch ms:" << _statistic.max_fetch_ms
+              << ", prefetch hits:" << _statistic.prefetch_hits << ", stalls:" << _statistic.prefetch_stalls << ", url:" << _play_url;
+    }
     _timer.reset();
     _timer_ts.reset();
     _http_ts_player.reset();
+    _prefetch_list.clear();
+    _prefetch_head.reset();
+    _idle_ts_players.clear();
     shutdown(ex);
 }
 
@@ -84,6 +92,53 @@ void HlsPlayer::teardown() {
     teardown_l(SockException(Err_shutdown, "teardown"));
 }
 
+HttpTSPlayer::Ptr HlsPlayer::createTSPlayer() {
+    if (!_idle_ts_players.empty()) {
+        // 复用空闲的keep-alive连接
+        // Reuse an idle keep-alive connection
+        auto ret = std::move(_idle_ts_players.back());
+        _idle_ts_players.pop_back();
+        // 每次请求新的ts片段时重置HttpTSPlayer状态
+        ret->clear();
+        ret->setProxyUrl((*this)[Client::kProxyUrl]);
+        return ret;
+    }
+    weak_ptr<HlsPlayer> weak_self = static_pointer_cast<HlsPlayer>(shared_from_this());
+    auto ret = std::make_shared<HttpTSPlayer>(getPoller());
+    ret->setProxyUrl((*this)[Client::kProxyUrl]);
+    ret->setAllowResendRequest(true);
+    ret->setOnCreateSocket([weak_self](const EventPoller::Ptr &poller) {
+        auto strong_self = weak_self.lock();
+        if (strong_self) {
+            return strong_self->createSocket();
+        }
+        return Socket::createSocket(poller, true);
+    });
+    if (!(*this)[Client::kNetAdapter].empty()) {
+        ret->setNetAdapter((*this)[Client::kNetAdapter]);
+    }
+    return ret;
+}
+
+size_t HlsPlayer::prefetchDepth() {
+    auto &depth = (*this)[Client::kHlsPrefetch];
+    return depth.empty() ? 0 : depth.as<size_t>();
+}
+
+bool HlsPlayer::isFetchingSegment() const {
+    return (_http_ts_player && _http_ts_player->waitResponse()) || _prefetch_head || !_prefetch_list.empty();
+}
+
+HlsPlayer::FetchStatistic HlsPlayer::getFetchStatistic() const {
+    auto ret = _statistic;
+    for (auto &prefetch : _prefetch_list) {
+        if (prefetch->done && !prefetch->err) {
+            ret.buffered_sec += prefetch->segment.duration;
+        }
+    }
+    return ret;
+}
+
 void HlsPlayer::fetchSegment() {
     if (_ts_list.empty()) {
         // 如果是点播文件，播放列表为空代表文件播放结束，关闭播放器: #2628  [AUTO-TRANSLATED:c2d0b647]
@@ -100,6 +155,10 @@ void HlsPlayer::fetchSegment() {
         fetchIndexFile();
         return;
     }
+    if (prefetchDepth()) {
+        fetchPrefetchedSegment();
+        return;
+    }
     if (_http_ts_player && _http_ts_player->waitResponse()) {
         // 播放器目前还存活，正在下载中  [AUTO-TRANSLATED:c18d8446]
         // The player is still alive and is currently downloading
@@ -107,16 +166,7 @@ void HlsPlayer::fetchSegment() {
     }
     weak_ptr<HlsPlayer> weak_self = static_pointer_cast<HlsPlayer>(shared_from_this());
     if (!_http_ts_player) {
-        _http_ts_player = std::make_shared<HttpTSPlayer>(getPoller());
-        _http_ts_player->setProxyUrl((*this)[Client::kProxyUrl]);
-        _http_ts_player->setAllowResendRequest(true);
-        _http_ts_player->setOnCreateSocket([weak_self](const EventPoller::Ptr &poller) {
-            auto strong_self = weak_self.lock();
-            if (strong_self) {
-                return strong_self->createSocket();
-            }
-            return Socket::createSocket(poller, true);
-        });
+        _http_ts_player = createTSPlayer();
         auto benchmark_mode = (*this)[Client::kBenchmarkMode].as<int>();
         if (!benchmark_mode) {
             _http_ts_player->setOnPacket([weak_self](const char *data, size_t len) {
@@ -130,10 +180,6 @@ void HlsPlayer::fetchSegment() {
                 strong_self->onPacket(data, len);
             });
         }
-
-        if (!(*this)[Client::kNetAdapter].empty()) {
-            _http_ts_player->setNetAdapter((*this)[Client::kNetAdapter]);
-        }
     } else {
         // 每次请求新的ts片段时重置HttpTSPlayer状态
         _http_ts_player->clear();
@@ -150,46 +196,8 @@ void HlsPlayer::fetchSegment() {
         if (!strong_self) {
             return;
         }
-        if (err) {
-            WarnL << "Download ts segment " << url << " failed:" << err;
-            if (err.getErrCode() == Err_timeout) {
-                strong_self->_timeout_multiple = MAX(strong_self->_timeout_multiple + 1, MAX_TIMEOUT_MULTIPLE);
-            } else {
-                strong_self->_timeout_multiple = MAX(strong_self->_timeout_multiple - 1, MIN_TIMEOUT_MULTIPLE);
-            }
-            strong_self->_ts_download_failed_count++;
-            if (strong_self->_ts_download_failed_count > MAX_TS_DOWNLOAD_FAILED_COUNT) {
-                WarnL << "ts segment " << url << " download failed count is " << strong_self->_ts_download_failed_count << ", teardown player";
-                strong_self->teardown_l(SockException(Err_shutdown, "ts segment download failed"));
-                return;
-            }
-        } else {
-            strong_self->_ts_download_failed_count = 0;
-        }
-        // 提前0.5秒下载好，支持点播文件控制下载速度: #2628  [AUTO-TRANSLATED:82247326]
-        // Download 0.5 seconds in advance to support on-demand file download speed control: #2628
-        // Download 0.5 seconds in advance to support video-on-demand files to control download speed: #2628
-        auto delay = duration - 0.5 - ticker.elapsedTime() / 1000.0f;
-        if (delay > 2.0) {
-            // 提前1秒下载  [AUTO-TRANSLATED:852349aa]
-            // Download 1 second in advance
-            // Download 1 second in advance
-            delay -= 1.0;
-        } else if (delay <= 0) {
-            // 延时最小10ms  [AUTO-TRANSLATED:fbb3665e]
-            // Delay a minimum of 10ms
-            // Delay at least 10ms
-            delay = 0.01;
-        }
-        // 延时下载下一个切片  [AUTO-TRANSLATED:26eb528d]
-        // Delay downloading the next slice
-        strong_self->_timer_ts.reset(new Timer(delay, [weak_self]() {
-            auto strong_self = weak_self.lock();
-            if (strong_self) {
-                strong_self->fetchSegment();
-            }
-            return false;
-        }, strong_self->getPoller()));
+        auto elapsed_ms = ticker.elapsedTime();
+        strong_self->onSegmentComplete(err, url, duration, elapsed_ms, elapsed_ms);
     });
 
     _http_ts_player->setMethod("GET");
@@ -200,6 +208,152 @@ void HlsPlayer::fetchSegment() {
     _http_ts_player->sendRequest(url);
 }
 
+void HlsPlayer::prefetchSegments() {
+    auto depth = prefetchDepth();
+    auto it = _ts_list.begin();
+    std::advance(it, MIN(_prefetch_list.size(), _ts_list.size()));
+    weak_ptr<HlsPlayer> weak_self = static_pointer_cast<HlsPlayer>(shared_from_this());
+    auto benchmark_mode = (*this)[Client::kBenchmarkMode].as<int>();
+    for (; _prefetch_list.size() < depth && it != _ts_list.end(); ++it) {
+        auto prefetch = std::make_shared<Prefetch>();
+        prefetch->segment = *it;
+        prefetch->client = createTSPlayer();
+        weak_ptr<Prefetch> weak_prefetch = prefetch;
+        if (!benchmark_mode) {
+            prefetch->client->setOnPacket([weak_prefetch](const char *data, size_t len) {
+                if (auto prefetch = weak_prefetch.lock()) {
+                    prefetch->data.append(data, len);
+                }
+            });
+        }
+        prefetch->client->setOnComplete([weak_self, weak_prefetch](const SockException &err) {
+            auto strong_self = weak_self.lock();
+            auto prefetch = weak_prefetch.lock();
+            if (!strong_self || !prefetch) {
+                return;
+            }
+            prefetch->done = true;
+            prefetch->err = err;
+            prefetch->fetch_ms = prefetch->ticker.elapsedTime();
+            if (err) {
+                WarnL << "Prefetch ts segment " << prefetch->segment.url << " failed:" << err;
+            }
+            // 在回调外归还连接，防止回调被覆盖
+            // Return the connection outside of the callback so that the callback is not overwritten
+            strong_self->getPoller()->async([weak_self, prefetch]() {
+                auto strong_self = weak_self.lock();
+                if (!strong_self) {
+                    return;
+                }
+                if (prefetch->err) {
+                    // 下载失败的连接状态不确定，直接释放，不再复用
+                    // The state of a failed connection is unknown, release it instead of reusing it
+                    prefetch->client = nullptr;
+                } else {
+                    strong_self->_idle_ts_players.emplace_back(std::move(prefetch->client));
+                }
+                if (strong_self->_prefetch_head == prefetch) {
+                    strong_self->_prefetch_head = nullptr;
+                    strong_self->playPrefetchedSegment(prefetch);
+                }
+                strong_self->prefetchSegments();
+            }, false);
+        });
+        prefetch->client->setMethod("GET");
+        prefetch->client->setCompleteTimeout(_timeout_multiple * prefetch->segment.duration * 1000);
+        prefetch->client->sendRequest(prefetch->segment.url);
+        _prefetch_list.emplace_back(std::move(prefetch));
+    }
+}
+
+void HlsPlayer::fetchPrefetchedSegment() {
+    if (_prefetch_head) {
+        // 上一个切片还在下载中
+        // The previous segment is still downloading
+        return;
+    }
+    prefetchSegments();
+    auto prefetch = std::move(_prefetch_list.front());
+    _prefetch_list.pop_front();
+    _ts_list.pop_front();
+
+    // 轮到播放时开始计时，用于计算下一个切片的播放延时
+    // Start timing when it is its turn to play, used to compute the delay of the next segment
+    prefetch->play_ticker.resetTime();
+    if (prefetch->done) {
+        ++_statistic.prefetch_hits;
+        playPrefetchedSegment(prefetch);
+    } else {
+        // 缓冲耗尽，等待下载完毕后再播放
+        // The buffer ran out, play it after the download finishes
+        ++_statistic.prefetch_stalls;
+        WarnL << "Prefetch buffer ran out, waiting for ts segment:" << prefetch->segment.url;
+        _prefetch_head = std::move(prefetch);
+    }
+    prefetchSegments();
+}
+
+void HlsPlayer::playPrefetchedSegment(const Prefetch::Ptr &prefetch) {
+    if (!prefetch->err && !prefetch->data.empty()) {
+        // 收到ts包  [AUTO-TRANSLATED:334862da]
+        // Received ts packet
+        onPacket(prefetch->data.data(), prefetch->data.size());
+    }
+    prefetch->data.clear();
+    onSegmentComplete(prefetch->err, prefetch->segment.url, prefetch->segment.duration, prefetch->fetch_ms, prefetch->play_ticker.elapsedTime());
+}
+
+void HlsPlayer::onSegmentComplete(const SockException &err, const string &url, float duration, uint64_t fetch_ms, uint64_t elapsed_ms) {
+    if (err) {
+        WarnL << "Download ts segment " << url << " failed:" << err;
+        if (err.getErrCode() == Err_timeout) {
+            _timeout_multiple = MAX(_timeout_multiple + 1, MAX_TIMEOUT_MULTIPLE);
+        } else {
+            _timeout_multiple = MAX(_timeout_multiple - 1, MIN_TIMEOUT_MULTIPLE);
+        }
+        ++_statistic.failed;
+        _ts_download_failed_count++;
+        if (_ts_download_failed_count > MAX_TS_DOWNLOAD_FAILED_COUNT) {
+            WarnL << "ts segment " << url << " download failed count is " << _ts_download_failed_count << ", teardown player";
+            teardown_l(SockException(Err_shutdown, "ts segment download failed"));
+            return;
+        }
+    } else {
+        _ts_download_failed_count = 0;
+        ++_statistic.segments;
+        _statistic.last_fetch_ms = fetch_ms;
+        _statistic.total_fetch_ms += fetch_ms;
+        _statistic.max_fetch_ms = MAX(_statistic.max_fetch_ms, fetch_ms);
+    }
+    // 提前0.5秒下载好，支持点播文件控制下载速度: #2628  [AUTO-TRANSLATED:82247326]
+    // Download 0.5 seconds in advance to support on-demand file download speed control: #2628
+    // Download 0.5 seconds in advance to support video-on-demand files to control download speed: #2628
+    auto delay = duration - 0.5 - elapsed_ms / 1000.0f;
+    if (delay > 2.0) {
+        // 提前1秒下载  [AUTO-TRANSLATED:852349aa]
+        // Download 1 second in advance
+        // Download 1 second in advance
+        delay -= 1.0;
+    } else if (delay <= 0) {
+        // 延时最小10ms  [AUTO-TRANSLATED:fbb3665e]
+        // Delay a minimum of 10ms
+        // Delay at least 10ms
+        delay = 0.01;
+    }
+    // 延时下载下一个切片  [AUTO-TRANSLATED:26eb528d]
+    // Delay downloading the next slice
+    weak_ptr<HlsPlayer> weak_self = static_pointer_cast<HlsPlayer>(shared_from_this());
+    _segment_scheduled = true;
+    _timer_ts.reset(new Timer(delay, [weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (strong_self) {
+            strong_self->_segment_scheduled = false;
+            strong_self->fetchSegment();
+        }
+        return false;
+    }, getPoller()));
+}
+
 bool HlsPlayer::onParsed(bool is_m3u8_inner, int64_t sequence, const map<int, ts_segment> &ts_map) {
     if (!is_m3u8_inner) {
         // 这是ts播放列表  [AUTO-TRANSLATED:7ce3d81b]
@@ -246,7 +400,16 @@ bool HlsPlayer::onParsed(bool is_m3u8_inner, int64_t sequence, const map<int, ts
             _ts_url_cache.erase(_ts_url_sort.front());
             _ts_url_sort.pop_front();
         }
-        fetchSegment();
+        if (prefetchDepth()) {
+            // 新切片立即开始预取，播放仍按切片时长定时进行
+            // New segments start prefetching at once, while playing is still timed by the segment duration
+            prefetchSegments();
+            if (!_segment_scheduled) {
+                fetchSegment();
+            }
+        } else {
+            fetchSegment();
+        }
     } else {
         // 这是m3u8列表,我们播放最高清的子hls  [AUTO-TRANSLATED:6e6981ef]
         // This is the m3u8 list, we play the highest definition sub-hls
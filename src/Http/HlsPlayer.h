@@ -76,6 +76,31 @@ public:
     size_t getRecvSpeed() override;
     size_t getRecvTotalBytes() override;
 
+    struct FetchStatistic {
+        // 下载成功与失败的切片数
+        // Number of segments downloaded successfully and failed
+        uint64_t segments = 0;
+        uint64_t failed = 0;
+        // 切片下载耗时，单位毫秒
+        // Segment download time in milliseconds
+        uint64_t last_fetch_ms = 0;
+        uint64_t max_fetch_ms = 0;
+        uint64_t total_fetch_ms = 0;
+        // 轮到播放时已经预取完毕与仍在下载的切片数
+        // Number of segments already prefetched and still downloading when it is their turn to play
+        uint64_t prefetch_hits = 0;
+        uint64_t prefetch_stalls = 0;
+        // 已经预取完毕但还未播放的时长，单位秒
+        // Duration prefetched but not played yet in seconds
+        float buffered_sec = 0;
+    };
+
+    /**
+     * 获取切片下载统计
+     * Get segment download statistics
+     */
+    FetchStatistic getFetchStatistic() const;
+
 protected:
     /**
      * 收到ts包
@@ -104,6 +129,28 @@ private:
     void fetchSegment();
     void teardown_l(const toolkit::SockException &ex);
     void fetchIndexFile();
+    void fetchPrefetchedSegment();
+    void prefetchSegments();
+    void onSegmentComplete(const toolkit::SockException &err, const std::string &url, float duration, uint64_t fetch_ms, uint64_t elapsed_ms);
+    bool isFetchingSegment() const;
+    size_t prefetchDepth();
+    HttpTSPlayer::Ptr createTSPlayer();
+
+private:
+    struct Prefetch {
+        using Ptr = std::shared_ptr<Prefetch>;
+        ts_segment segment;
+        HttpTSPlayer::Ptr client;
+        std::string data;
+        bool done = false;
+        toolkit::SockException err;
+        // 下载与轮到播放的计时
+        // Timing of the download and of the turn to play
+        toolkit::Ticker ticker;
+        toolkit::Ticker play_ticker;
+        uint64_t fetch_ms = 0;
+    };
+    void playPrefetchedSegment(const Prefetch::Ptr &prefetch);
 
 private:
     struct UrlComp {
@@ -130,6 +177,19 @@ private:
     int _timeout_multiple = MIN_TIMEOUT_MULTIPLE;
     int _try_fetch_index_times = 0;
     int _ts_download_failed_count = 0;
+    // 下一个切片是否已经定时播放
+    // Whether the next segment is already scheduled to play
+    bool _segment_scheduled = false;
+    // 与_ts_list头部一一对应的预取中的切片
+    // Prefetching segments corresponding one to one to the head of _ts_list
+    std::list<Prefetch::Ptr> _prefetch_list;
+    // 轮到播放但还未下载完毕的切片
+    // The segment whose turn to play has come but is not downloaded yet
+    Prefetch::Ptr _prefetch_head;
+    // 空闲的http连接，保持keep-alive供后续切片复用
+    // Idle http connections kept alive for later segments
+    std::vector<HttpTSPlayer::Ptr> _idle_ts_players;
+    FetchStatistic _statistic;
 
 protected:
     size_t _recvtotalbytes = 0;
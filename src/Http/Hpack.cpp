@@ -0,0 +1,517 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <algorithm>
+#include "Hpack.h"
+
+using namespace std;
+
+namespace mediakit {
+
+// rfc7541 附录A 静态表
+// rfc7541 Appendix A static table
+static const HpackTable::Entry s_static_table[] = {
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" },
+};
+
+static constexpr size_t kStaticTableSize = sizeof(s_static_table) / sizeof(s_static_table[0]);
+
+// 每个表项额外占用32字节(rfc7541 4.1)
+// Each entry takes 32 extra bytes (rfc7541 4.1)
+static constexpr size_t kEntryOverhead = 32;
+
+// rfc7541 附录B 霍夫曼编码表, {code, bits}
+// rfc7541 Appendix B huffman code table, {code, bits}
+static const struct {
+    uint32_t code;
+    uint8_t bits;
+} s_huffman_table[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+    {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+    {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+    {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+    {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+    {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+    {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+    {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+    {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+    {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+    {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+    {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+    {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+    {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+    {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+    {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+    {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+    {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+    {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+    {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+    {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+    {0x3fffffff, 30},
+};
+
+static constexpr uint16_t kHuffmanEOS = 256;
+
+namespace {
+// 霍夫曼解码二叉树，只在首次使用时构建一次
+// Huffman decoding binary tree, built once on first use
+class HuffmanTree {
+public:
+    struct Node {
+        int32_t child[2] = { -1, -1 };
+        int32_t symbol = -1;
+    };
+
+    static const HuffmanTree &Instance() {
+        static HuffmanTree s_instance;
+        return s_instance;
+    }
+
+    const vector<Node> &nodes() const { return _nodes; }
+
+private:
+    HuffmanTree() {
+        _nodes.reserve(512);
+        _nodes.emplace_back();
+        for (int symbol = 0; symbol <= kHuffmanEOS; ++symbol) {
+            auto code = s_huffman_table[symbol].code;
+            auto bits = s_huffman_table[symbol].bits;
+            size_t node = 0;
+            for (int i = bits - 1; i >= 0; --i) {
+                auto bit = (code >> i) & 0x01;
+                if (_nodes[node].child[bit] == -1) {
+                    _nodes[node].child[bit] = (int32_t)_nodes.size();
+                    _nodes.emplace_back();
+                }
+                node = _nodes[node].child[bit];
+            }
+            _nodes[node].symbol = symbol;
+        }
+    }
+
+private:
+    vector<Node> _nodes;
+};
+} // namespace
+
+namespace Hpack {
+
+bool huffmanDecode(const uint8_t *data, size_t len, string &out) {
+    auto &nodes = HuffmanTree::Instance().nodes();
+    size_t node = 0;
+    // 当前未完成符号的比特数以及是否全为1(填充必须为EOS的前缀且不超过7比特)
+    // Bit count of the unfinished symbol and whether they are all ones (padding must be an EOS prefix of at most 7 bits)
+    size_t pending_bits = 0;
+    bool all_ones = true;
+    for (size_t i = 0; i < len; ++i) {
+        for (int shift = 7; shift >= 0; --shift) {
+            auto bit = (data[i] >> shift) & 0x01;
+            auto next = nodes[node].child[bit];
+            if (next == -1) {
+                return false;
+            }
+            ++pending_bits;
+            all_ones = all_ones && bit;
+            auto &child = nodes[next];
+            if (child.symbol == -1) {
+                node = next;
+                continue;
+            }
+            if (child.symbol == kHuffmanEOS) {
+                return false;
+            }
+            out.push_back((char)child.symbol);
+            node = 0;
+            pending_bits = 0;
+            all_ones = true;
+        }
+    }
+    return pending_bits < 8 && all_ones;
+}
+
+size_t huffmanEncodedSize(const uint8_t *data, size_t len) {
+    size_t bits = 0;
+    for (size_t i = 0; i < len; ++i) {
+        bits += s_huffman_table[data[i]].bits;
+    }
+    return (bits + 7) / 8;
+}
+
+void huffmanEncode(const uint8_t *data, size_t len, string &out) {
+    uint64_t acc = 0;
+    size_t acc_bits = 0;
+    for (size_t i = 0; i < len; ++i) {
+        auto &item = s_huffman_table[data[i]];
+        acc = (acc << item.bits) | item.code;
+        acc_bits += item.bits;
+        while (acc_bits >= 8) {
+            acc_bits -= 8;
+            out.push_back((char)(acc >> acc_bits));
+        }
+    }
+    if (acc_bits) {
+        // 使用EOS的高位(全1)填充
+        // Pad with the most significant bits of EOS (all ones)
+        out.push_back((char)((acc << (8 - acc_bits)) | (0xFF >> acc_bits)));
+    }
+}
+
+void encodeInteger(string &out, uint8_t flags, uint8_t prefix_bits, uint64_t value) {
+    uint8_t max_prefix = (uint8_t)((1 << prefix_bits) - 1);
+    if (value < max_prefix) {
+        out.push_back((char)(flags | value));
+        return;
+    }
+    out.push_back((char)(flags | max_prefix));
+    value -= max_prefix;
+    while (value >= 128) {
+        out.push_back((char)(0x80 | (value & 0x7F)));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+void encodeString(string &out, const string &str) {
+    auto huffman_size = huffmanEncodedSize((uint8_t *)str.data(), str.size());
+    if (huffman_size < str.size()) {
+        encodeInteger(out, 0x80, 7, huffman_size);
+        huffmanEncode((uint8_t *)str.data(), str.size(), out);
+        return;
+    }
+    encodeInteger(out, 0x00, 7, str.size());
+    out.append(str);
+}
+
+static bool decodeInteger(const uint8_t *&ptr, const uint8_t *end, uint8_t prefix_bits, uint64_t &value) {
+    if (ptr >= end) {
+        return false;
+    }
+    uint8_t max_prefix = (uint8_t)((1 << prefix_bits) - 1);
+    value = *ptr++ & max_prefix;
+    if (value < max_prefix) {
+        return true;
+    }
+    for (int shift = 0; ptr < end; shift += 7) {
+        if (shift > 28) {
+            // 整数溢出，超过了任何合理的长度或索引
+            // Integer overflow, larger than any sane length or index
+            return false;
+        }
+        auto byte = *ptr++;
+        value += (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool decodeString(const uint8_t *&ptr, const uint8_t *end, string &out) {
+    if (ptr >= end) {
+        return false;
+    }
+    bool huffman = *ptr & 0x80;
+    uint64_t len;
+    if (!decodeInteger(ptr, end, 7, len) || len > (uint64_t)(end - ptr)) {
+        return false;
+    }
+    out.clear();
+    if (huffman) {
+        out.reserve(len * 8 / 5);
+        if (!huffmanDecode(ptr, len, out)) {
+            return false;
+        }
+    } else {
+        out.assign((const char *)ptr, len);
+    }
+    ptr += len;
+    return true;
+}
+
+} // namespace Hpack
+
+////////////////////////////////////////////////////////////////////////////////////
+
+const HpackTable::Entry *HpackTable::get(size_t index) const {
+    if (index == 0) {
+        return nullptr;
+    }
+    if (index <= kStaticTableSize) {
+        return &s_static_table[index - 1];
+    }
+    index -= kStaticTableSize + 1;
+    if (index >= _entries.size()) {
+        return nullptr;
+    }
+    return &_entries[index];
+}
+
+size_t HpackTable::find(const string &name, const string &value, size_t &name_index) const {
+    name_index = 0;
+    for (size_t i = 0; i < kStaticTableSize; ++i) {
+        auto &entry = s_static_table[i];
+        if (entry.first != name) {
+            continue;
+        }
+        if (entry.second == value) {
+            return i + 1;
+        }
+        if (!name_index) {
+            name_index = i + 1;
+        }
+    }
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        auto &entry = _entries[i];
+        if (entry.first != name) {
+            continue;
+        }
+        if (entry.second == value) {
+            return i + 1 + kStaticTableSize;
+        }
+        if (!name_index) {
+            name_index = i + 1 + kStaticTableSize;
+        }
+    }
+    return 0;
+}
+
+void HpackTable::add(string name, string value) {
+    auto size = name.size() + value.size() + kEntryOverhead;
+    if (size > _max_size) {
+        // 大于整个表时清空动态表(rfc7541 4.4)
+        // Larger than the whole table empties the dynamic table (rfc7541 4.4)
+        evict(0);
+        return;
+    }
+    evict(_max_size - size);
+    _size += size;
+    _entries.emplace_front(std::move(name), std::move(value));
+}
+
+void HpackTable::setMaxSize(size_t size) {
+    _max_size = size;
+    evict(size);
+}
+
+void HpackTable::evict(size_t max_size) {
+    while (_size > max_size && !_entries.empty()) {
+        auto &entry = _entries.back();
+        _size -= entry.first.size() + entry.second.size() + kEntryOverhead;
+        _entries.pop_back();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+bool HpackDecoder::decode(const uint8_t *data, size_t len, const onHeader &cb) {
+    auto ptr = data;
+    auto end = data + len;
+    string name, value;
+    bool header_decoded = false;
+    while (ptr < end) {
+        auto byte = *ptr;
+        uint64_t index;
+        if (byte & 0x80) {
+            // 完全索引的header(rfc7541 6.1)
+            // Indexed header field (rfc7541 6.1)
+            if (!Hpack::decodeInteger(ptr, end, 7, index)) {
+                return false;
+            }
+            auto entry = _table.get(index);
+            if (!entry) {
+                return false;
+            }
+            name = entry->first;
+            value = entry->second;
+            header_decoded = true;
+            cb(name, value);
+            continue;
+        }
+
+        if ((byte & 0xE0) == 0x20) {
+            // 动态表大小更新，只能出现在header block开头(rfc7541 4.2, 6.3)
+            // Dynamic table size update, only allowed at the beginning of a header block (rfc7541 4.2, 6.3)
+            if (header_decoded || !Hpack::decodeInteger(ptr, end, 5, index) || index > _max_table_size) {
+                return false;
+            }
+            _table.setMaxSize(index);
+            continue;
+        }
+
+        // 字面量header: 0x40 增量索引, 0x00 不索引, 0x10 永不索引(rfc7541 6.2)
+        // Literal header field: 0x40 incremental indexing, 0x00 without indexing, 0x10 never indexed (rfc7541 6.2)
+        bool indexing = byte & 0x40;
+        if (!Hpack::decodeInteger(ptr, end, indexing ? 6 : 4, index)) {
+            return false;
+        }
+        if (index) {
+            auto entry = _table.get(index);
+            if (!entry) {
+                return false;
+            }
+            name = entry->first;
+        } else if (!Hpack::decodeString(ptr, end, name)) {
+            return false;
+        }
+        if (!Hpack::decodeString(ptr, end, value)) {
+            return false;
+        }
+        if (indexing) {
+            _table.add(name, value);
+        }
+        header_decoded = true;
+        cb(name, value);
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+void HpackEncoder::setMaxTableSize(size_t size) {
+    // 限制编码器动态表的上限为默认值4096，节省内存
+    // Cap the encoder dynamic table at the default 4096 bytes to save memory
+    size = std::min<size_t>(size, 4096);
+    if (size == _table.maxSize() && !_size_changed) {
+        return;
+    }
+    _size_changed = true;
+    _min_size = std::min(_min_size, size);
+    _table.setMaxSize(size);
+}
+
+void HpackEncoder::beginBlock(string &out) {
+    if (!_size_changed) {
+        return;
+    }
+    // 若期间表大小被调小过，需要先告知最小值，再告知最终值(rfc7541 4.2)
+    // If the size shrank in between, the smallest value must be signaled before the final one (rfc7541 4.2)
+    if (_min_size < _table.maxSize()) {
+        Hpack::encodeInteger(out, 0x20, 5, _min_size);
+    }
+    Hpack::encodeInteger(out, 0x20, 5, _table.maxSize());
+    _size_changed = false;
+    _min_size = SIZE_MAX;
+}
+
+static bool shouldIndex(const string &name) {
+    // 每次回复都变化的头不加入动态表，避免挤掉可复用的表项
+    // Headers that change on every response are not added to the dynamic table, to avoid evicting reusable entries
+    static const char *s_volatile_headers[] = { "date", "content-length", "content-range", "etag", "last-modified", "set-cookie" };
+    for (auto header : s_volatile_headers) {
+        if (name == header) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void HpackEncoder::encode(string &out, const string &name, const string &value) {
+    size_t name_index;
+    auto index = _table.find(name, value, name_index);
+    if (index) {
+        Hpack::encodeInteger(out, 0x80, 7, index);
+        return;
+    }
+    if (shouldIndex(name)) {
+        Hpack::encodeInteger(out, 0x40, 6, name_index);
+        _table.add(name, value);
+    } else {
+        Hpack::encodeInteger(out, 0x00, 4, name_index);
+    }
+    if (!name_index) {
+        Hpack::encodeString(out, name);
+    }
+    Hpack::encodeString(out, value);
+}
+
+} // namespace mediakit
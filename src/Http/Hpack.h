@@ -0,0 +1,116 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_HPACK_H
+#define ZLMEDIAKIT_HPACK_H
+
+#include <deque>
+#include <string>
+#include <cstdint>
+#include <functional>
+
+namespace mediakit {
+
+/**
+ * hpack动态表(rfc7541 2.3.2)，索引从静态表之后(62)开始
+ * Hpack dynamic table (rfc7541 2.3.2), indexes start after the static table (62)
+ */
+class HpackTable {
+public:
+    using Entry = std::pair<std::string, std::string>;
+
+    /**
+     * 根据索引获取表项(包含静态表)，索引非法时返回nullptr
+     * Get an entry by index (static table included), returns nullptr if the index is invalid
+     */
+    const Entry *get(size_t index) const;
+
+    /**
+     * 查找表项(包含静态表)
+     * @param name_index 仅name匹配的表项索引，未找到为0
+     * @return name与value都匹配的表项索引，未找到为0
+     * Find an entry (static table included)
+     * @param name_index index of an entry whose name matches, 0 if not found
+     * @return index of an entry whose name and value both match, 0 if not found
+     */
+    size_t find(const std::string &name, const std::string &value, size_t &name_index) const;
+
+    void add(std::string name, std::string value);
+    void setMaxSize(size_t size);
+    size_t maxSize() const { return _max_size; }
+
+private:
+    void evict(size_t max_size);
+
+private:
+    size_t _size = 0;
+    size_t _max_size = 4096;
+    std::deque<Entry> _entries;
+};
+
+class HpackDecoder {
+public:
+    using onHeader = std::function<void(std::string &name, std::string &value)>;
+
+    /**
+     * 解码一个完整的header block
+     * @return false代表压缩错误(COMPRESSION_ERROR)，连接必须关闭
+     * Decode a complete header block
+     * @return false means a compression error (COMPRESSION_ERROR), the connection must be closed
+     */
+    bool decode(const uint8_t *data, size_t len, const onHeader &cb);
+
+    /**
+     * 设置本端SETTINGS_HEADER_TABLE_SIZE，对端的动态表大小更新不得超过该值
+     * Set the local SETTINGS_HEADER_TABLE_SIZE, table size updates from the peer must not exceed it
+     */
+    void setMaxTableSize(size_t size) { _max_table_size = size; }
+
+private:
+    HpackTable _table;
+    size_t _max_table_size = 4096;
+};
+
+class HpackEncoder {
+public:
+    /**
+     * 编码一个header并追加到out
+     * Encode a header and append it to out
+     */
+    void encode(std::string &out, const std::string &name, const std::string &value);
+
+    /**
+     * 对端SETTINGS_HEADER_TABLE_SIZE改变，下个header block开头会携带动态表大小更新
+     * The peer SETTINGS_HEADER_TABLE_SIZE changed, a table size update is emitted at the start of the next header block
+     */
+    void setMaxTableSize(size_t size);
+
+    /**
+     * 开始一个新的header block
+     * Start a new header block
+     */
+    void beginBlock(std::string &out);
+
+private:
+    bool _size_changed = false;
+    size_t _min_size = SIZE_MAX;
+    HpackTable _table;
+};
+
+namespace Hpack {
+void encodeInteger(std::string &out, uint8_t flags, uint8_t prefix_bits, uint64_t value);
+void encodeString(std::string &out, const std::string &str);
+bool huffmanDecode(const uint8_t *data, size_t len, std::string &out);
+void huffmanEncode(const uint8_t *data, size_t len, std::string &out);
+size_t huffmanEncodedSize(const uint8_t *data, size_t len);
+} // namespace Hpack
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_HPACK_H
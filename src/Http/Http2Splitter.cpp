@@ -0,0 +1,880 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "Http2Splitter.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/base64.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+const string Http2Splitter::kPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+static constexpr size_t kFrameHeaderSize = 9;
+// 本端接收帧的最大负载(SETTINGS_MAX_FRAME_SIZE默认值)
+// Maximum payload of frames received locally (default SETTINGS_MAX_FRAME_SIZE)
+static constexpr uint32_t kMaxFrameSize = 16384;
+// 本端流与连接的接收窗口，数据收到后立即归还窗口
+// Local stream and connection receive windows, the window is returned as soon as data is received
+static constexpr uint32_t kInitialWindowSize = 1024 * 1024;
+static constexpr uint32_t kConnectionWindowSize = 16 * 1024 * 1024;
+// 单个请求header block的最大字节数
+// Maximum bytes of a single request header block
+static constexpr uint32_t kMaxHeaderListSize = 64 * 1024;
+static constexpr int64_t kMaxWindowSize = 0x7FFFFFFF;
+
+enum : uint8_t {
+    FLAG_ACK = 0x01,
+    FLAG_END_STREAM = 0x01,
+    FLAG_END_HEADERS = 0x04,
+    FLAG_PADDED = 0x08,
+    FLAG_PRIORITY = 0x20,
+};
+
+enum : uint16_t {
+    SETTINGS_HEADER_TABLE_SIZE = 0x1,
+    SETTINGS_ENABLE_PUSH = 0x2,
+    SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+    SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+    SETTINGS_MAX_FRAME_SIZE = 0x5,
+    SETTINGS_MAX_HEADER_LIST_SIZE = 0x6,
+    SETTINGS_NO_RFC7540_PRIORITIES = 0x9,
+};
+
+static inline uint32_t loadBE24(const uint8_t *ptr) {
+    return (ptr[0] << 16) | (ptr[1] << 8) | ptr[2];
+}
+
+static inline uint32_t loadBE32(const uint8_t *ptr) {
+    return ((uint32_t)ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+}
+
+static inline void writeBE32(char *ptr, uint32_t value) {
+    ptr[0] = (char)(value >> 24);
+    ptr[1] = (char)(value >> 16);
+    ptr[2] = (char)(value >> 8);
+    ptr[3] = (char)value;
+}
+
+static void writeFrameHeader(char *ptr, uint32_t len, uint8_t type, uint8_t flags, uint32_t stream_id) {
+    ptr[0] = (char)(len >> 16);
+    ptr[1] = (char)(len >> 8);
+    ptr[2] = (char)len;
+    ptr[3] = (char)type;
+    ptr[4] = (char)flags;
+    writeBE32(ptr + 5, stream_id & 0x7FFFFFFF);
+}
+
+static void appendSetting(string &out, uint16_t id, uint32_t value) {
+    char buf[6];
+    buf[0] = (char)(id >> 8);
+    buf[1] = (char)id;
+    writeBE32(buf + 2, value);
+    out.append(buf, sizeof(buf));
+}
+
+void Http2Splitter::startHttp2(uint32_t max_streams, size_t max_body_size) {
+    _started = true;
+    _max_streams = max_streams;
+    _max_body_size = max_body_size;
+
+    string settings;
+    appendSetting(settings, SETTINGS_MAX_CONCURRENT_STREAMS, max_streams);
+    appendSetting(settings, SETTINGS_INITIAL_WINDOW_SIZE, kInitialWindowSize);
+    appendSetting(settings, SETTINGS_MAX_HEADER_LIST_SIZE, kMaxHeaderListSize);
+    // 只支持rfc9218优先级，告知客户端不必发送rfc7540优先级树
+    // Only rfc9218 priorities are supported, tell the client not to send the rfc7540 priority tree
+    appendSetting(settings, SETTINGS_NO_RFC7540_PRIORITIES, 1);
+    sendFrame(SETTINGS, 0, 0, settings.data(), settings.size());
+    // 连接级窗口只能通过WINDOW_UPDATE调大
+    // The connection level window can only be enlarged through WINDOW_UPDATE
+    sendWindowUpdate(0, kConnectionWindowSize - 65535);
+}
+
+bool Http2Splitter::upgradeHttp2(const string &settings) {
+    // base64url转标准base64
+    // base64url to standard base64
+    string base64 = settings;
+    for (auto &ch : base64) {
+        if (ch == '-') {
+            ch = '+';
+        } else if (ch == '_') {
+            ch = '/';
+        }
+    }
+    while (base64.size() % 4) {
+        base64.push_back('=');
+    }
+    auto payload = decodeBase64(base64);
+    if (payload.size() % 6 || !applySettings((uint8_t *)payload.data(), payload.size())) {
+        return false;
+    }
+    // 升级的请求成为半关闭(remote)状态的stream 1
+    // The upgraded request becomes stream 1 in the half-closed (remote) state
+    auto &stream = _streams[1];
+    stream.id = 1;
+    stream.send_window = _peer_initial_window;
+    stream.remote_closed = true;
+    _last_stream_id = 1;
+    return true;
+}
+
+void Http2Splitter::inputHttp2(const char *data, size_t len) {
+    if (_error) {
+        return;
+    }
+    string merged;
+    if (!_remain_data.empty()) {
+        merged = std::move(_remain_data);
+        merged.append(data, len);
+        data = merged.data();
+        len = merged.size();
+    }
+    auto ptr = (const uint8_t *)data;
+    auto end = ptr + len;
+
+    if (!_preface_received) {
+        auto size = std::min(len, kPreface.size());
+        if (memcmp(ptr, kPreface.data(), size)) {
+            connectionError(H2_PROTOCOL_ERROR, "invalid http2 connection preface");
+            return;
+        }
+        if (size < kPreface.size()) {
+            _remain_data.assign((const char *)ptr, len);
+            return;
+        }
+        ptr += size;
+        _preface_received = true;
+    }
+
+    while (ptr < end && !_error) {
+        auto used = onFrame(ptr, end - ptr);
+        if (!used) {
+            break;
+        }
+        ptr += used;
+    }
+    if (ptr < end && !_error) {
+        _remain_data.assign((const char *)ptr, end - ptr);
+    }
+}
+
+size_t Http2Splitter::onFrame(const uint8_t *data, size_t len) {
+    if (len < kFrameHeaderSize) {
+        return 0;
+    }
+    auto payload_len = loadBE24(data);
+    if (payload_len > kMaxFrameSize) {
+        connectionError(H2_FRAME_SIZE_ERROR, "http2 frame too large");
+        return 0;
+    }
+    if (len < kFrameHeaderSize + payload_len) {
+        return 0;
+    }
+    uint8_t type = data[3];
+    uint8_t flags = data[4];
+    uint32_t stream_id = loadBE32(data + 5) & 0x7FFFFFFF;
+    auto payload = data + kFrameHeaderSize;
+
+    if (_continuation_stream_id && (type != CONTINUATION || stream_id != _continuation_stream_id)) {
+        // header block必须连续(rfc9113 6.10)
+        // A header block must be contiguous (rfc9113 6.10)
+        connectionError(H2_PROTOCOL_ERROR, "http2 header block interrupted");
+        return 0;
+    }
+
+    switch (type) {
+        case DATA: onDataFrame(stream_id, flags, payload, payload_len); break;
+        case HEADERS: onHeadersFrame(stream_id, flags, payload, payload_len); break;
+        case CONTINUATION: {
+            if (!_continuation_stream_id) {
+                connectionError(H2_PROTOCOL_ERROR, "unexpected http2 CONTINUATION frame");
+                break;
+            }
+            if (_header_block.size() + payload_len > kMaxHeaderListSize) {
+                connectionError(H2_ENHANCE_YOUR_CALM, "http2 header block too large");
+                break;
+            }
+            _header_block.append((const char *)payload, payload_len);
+            if (flags & FLAG_END_HEADERS) {
+                auto id = _continuation_stream_id;
+                _continuation_stream_id = 0;
+                onHeaderBlock(id, _continuation_flags);
+            }
+            break;
+        }
+        case PRIORITY: {
+            // rfc7540优先级树已废弃，只校验长度
+            // The rfc7540 priority tree is deprecated, only the length is checked
+            if (payload_len != 5) {
+                resetHttp2Stream(stream_id, H2_FRAME_SIZE_ERROR);
+            }
+            break;
+        }
+        case RST_STREAM: {
+            if (!stream_id || payload_len != 4) {
+                connectionError(!stream_id ? H2_PROTOCOL_ERROR : H2_FRAME_SIZE_ERROR, "invalid http2 RST_STREAM frame");
+                break;
+            }
+            closeStream(stream_id);
+            break;
+        }
+        case SETTINGS: onSettingsFrame(flags, payload, payload_len); break;
+        case PUSH_PROMISE: connectionError(H2_PROTOCOL_ERROR, "client must not send http2 PUSH_PROMISE"); break;
+        case PING: {
+            if (stream_id || payload_len != 8) {
+                connectionError(stream_id ? H2_PROTOCOL_ERROR : H2_FRAME_SIZE_ERROR, "invalid http2 PING frame");
+                break;
+            }
+            if (!(flags & FLAG_ACK)) {
+                sendFrame(PING, FLAG_ACK, 0, (const char *)payload, payload_len);
+            }
+            break;
+        }
+        case GOAWAY: {
+            // 对端不再发起新的流，已有的流继续处理，连接由对端关闭或超时关闭
+            // The peer will not start new streams, existing streams continue, the connection is closed by the peer or by timeout
+            if (payload_len >= 8) {
+                DebugL << "http2 GOAWAY received, error code: " << loadBE32(payload + 4);
+            }
+            break;
+        }
+        case WINDOW_UPDATE: onWindowUpdateFrame(stream_id, payload, payload_len); break;
+        case PRIORITY_UPDATE: onPriorityUpdateFrame(payload, payload_len); break;
+        // 未知类型帧必须忽略(rfc9113 5.5)
+        // Frames of unknown types must be ignored (rfc9113 5.5)
+        default: break;
+    }
+    return kFrameHeaderSize + payload_len;
+}
+
+void Http2Splitter::onDataFrame(uint32_t stream_id, uint8_t flags, const uint8_t *payload, size_t len) {
+    if (!stream_id) {
+        connectionError(H2_PROTOCOL_ERROR, "http2 DATA frame on stream 0");
+        return;
+    }
+    // 流量控制按整个负载(包括填充)计算，立即归还连接窗口
+    // Flow control counts the whole payload (padding included), the connection window is returned at once
+    auto flow_len = len;
+    if (flags & FLAG_PADDED) {
+        if (!len || payload[0] >= len) {
+            connectionError(H2_PROTOCOL_ERROR, "invalid http2 DATA padding");
+            return;
+        }
+        len -= payload[0] + 1;
+        payload += 1;
+    }
+    if (flow_len) {
+        sendWindowUpdate(0, flow_len);
+    }
+
+    auto stream = findStream(stream_id);
+    if (!stream || stream->remote_closed) {
+        if (stream_id > _last_stream_id) {
+            connectionError(H2_PROTOCOL_ERROR, "http2 DATA frame on idle stream");
+        } else if (stream) {
+            resetHttp2Stream(stream_id, H2_STREAM_CLOSED);
+        }
+        // 已经关闭的流，忽略其数据
+        // Data of an already closed stream is ignored
+        return;
+    }
+
+    if (stream->body.size() + len > _max_body_size) {
+        // body太大，提前回复413并以NO_ERROR重置流，让客户端停止发送(rfc9113 8.1)，此后该流的DATA帧被忽略
+        // 回复结束时checkStreamClosed通常已经重置了流，这里确保流一定被重置且不会重复回复
+        // The body is too large, reply 413 early and reset the stream with NO_ERROR so that the client stops
+        // sending (rfc9113 8.1), later DATA frames of the stream are ignored.
+        // checkStreamClosed usually resets the stream when the response ends, make sure it is reset and never replied twice
+        WarnL << "http2 request body is too large: " << stream->body.size() + len << " > " << _max_body_size;
+        sendHttp2Headers(stream_id, 413, StrCaseMap(), true);
+        if (findStream(stream_id)) {
+            resetHttp2Stream(stream_id, H2_NO_ERROR);
+        }
+        return;
+    }
+    stream->body.append((const char *)payload, len);
+
+    if (flags & FLAG_END_STREAM) {
+        stream->remote_closed = true;
+        dispatchRequest(*stream);
+        return;
+    }
+    if (flow_len) {
+        sendWindowUpdate(stream_id, flow_len);
+    }
+}
+
+void Http2Splitter::onHeadersFrame(uint32_t stream_id, uint8_t flags, const uint8_t *payload, size_t len) {
+    if (!stream_id) {
+        connectionError(H2_PROTOCOL_ERROR, "http2 HEADERS frame on stream 0");
+        return;
+    }
+    size_t pad_len = 0;
+    if (flags & FLAG_PADDED) {
+        if (!len) {
+            connectionError(H2_PROTOCOL_ERROR, "invalid http2 HEADERS padding");
+            return;
+        }
+        pad_len = payload[0];
+        payload += 1;
+        len -= 1;
+    }
+    if (flags & FLAG_PRIORITY) {
+        // 跳过rfc7540的依赖与权重
+        // Skip the rfc7540 dependency and weight
+        if (len < 5) {
+            connectionError(H2_PROTOCOL_ERROR, "invalid http2 HEADERS priority");
+            return;
+        }
+        payload += 5;
+        len -= 5;
+    }
+    if (pad_len > len) {
+        connectionError(H2_PROTOCOL_ERROR, "invalid http2 HEADERS padding");
+        return;
+    }
+    _header_block.assign((const char *)payload, len - pad_len);
+    if (!(flags & FLAG_END_HEADERS)) {
+        _continuation_stream_id = stream_id;
+        _continuation_flags = flags;
+        return;
+    }
+    onHeaderBlock(stream_id, flags);
+}
+
+void Http2Splitter::onHeaderBlock(uint32_t stream_id, uint8_t flags) {
+    bool end_stream = flags & FLAG_END_STREAM;
+    auto stream = findStream(stream_id);
+    if (stream) {
+        // 已存在的流只可能是trailer，解码以保持hpack状态同步，内容忽略
+        // An existing stream can only carry trailers, decode them to keep the hpack state in sync and ignore the content
+        bool ok = _decoder.decode((uint8_t *)_header_block.data(), _header_block.size(), [](string &, string &) {});
+        _header_block.clear();
+        if (!ok) {
+            connectionError(H2_COMPRESSION_ERROR, "http2 hpack decode failed");
+            return;
+        }
+        if (stream->remote_closed || !end_stream) {
+            resetHttp2Stream(stream_id, stream->remote_closed ? H2_STREAM_CLOSED : H2_PROTOCOL_ERROR);
+            return;
+        }
+        stream->remote_closed = true;
+        dispatchRequest(*stream);
+        return;
+    }
+
+    if (!(stream_id & 0x01) || stream_id <= _last_stream_id) {
+        connectionError(H2_PROTOCOL_ERROR, "invalid http2 stream id");
+        return;
+    }
+    _last_stream_id = stream_id;
+
+    Stream new_stream;
+    new_stream.id = stream_id;
+    new_stream.send_window = _peer_initial_window;
+    new_stream.remote_closed = end_stream;
+    bool malformed = false;
+    if (!decodeRequest(new_stream, malformed)) {
+        connectionError(H2_COMPRESSION_ERROR, "http2 hpack decode failed");
+        return;
+    }
+    if (malformed) {
+        resetHttp2Stream(stream_id, H2_PROTOCOL_ERROR);
+        return;
+    }
+    if (_streams.size() >= _max_streams) {
+        resetHttp2Stream(stream_id, H2_REFUSED_STREAM);
+        return;
+    }
+    auto &ref = _streams.emplace(stream_id, std::move(new_stream)).first->second;
+    if (end_stream) {
+        dispatchRequest(ref);
+    }
+}
+
+bool Http2Splitter::decodeRequest(Stream &stream, bool &malformed) {
+    string method, path, authority, cookie, headers;
+    bool regular_header = false;
+    auto ok = _decoder.decode((uint8_t *)_header_block.data(), _header_block.size(), [&](string &name, string &value) {
+        if (name.empty()) {
+            malformed = true;
+            return;
+        }
+        if (name[0] == ':') {
+            // 伪头必须在普通头之前(rfc9113 8.3)
+            // Pseudo headers must precede regular headers (rfc9113 8.3)
+            if (regular_header) {
+                malformed = true;
+            } else if (name == ":method") {
+                method = value;
+            } else if (name == ":path") {
+                path = value;
+            } else if (name == ":authority") {
+                authority = value;
+            } else if (name != ":scheme") {
+                malformed = true;
+            }
+            return;
+        }
+        regular_header = true;
+        for (auto ch : name) {
+            if (ch >= 'A' && ch <= 'Z') {
+                malformed = true;
+                return;
+            }
+        }
+        if (name == "cookie") {
+            // cookie可能被拆分为多个头(rfc9113 8.2.3)
+            // The cookie may be split into several headers (rfc9113 8.2.3)
+            if (!cookie.empty()) {
+                cookie += "; ";
+            }
+            cookie += value;
+            return;
+        }
+        if (name == "host") {
+            if (authority.empty()) {
+                authority = value;
+            }
+            return;
+        }
+        if (name == "priority") {
+            stream.client_priority = true;
+            parsePriority(stream, value);
+        }
+        headers += name;
+        headers += ": ";
+        headers += value;
+        headers += "\r\n";
+    });
+    _header_block.clear();
+    if (!ok) {
+        return false;
+    }
+    if (method.empty() || path.empty() || path[0] != '/') {
+        malformed = true;
+    }
+    if (malformed) {
+        return true;
+    }
+
+    // 转换为http/1.1格式交给Parser解析，复用http/1.1的处理逻辑
+    // Convert to the http/1.1 format and let Parser parse it, so the http/1.1 handling logic is reused
+    string request;
+    request.reserve(method.size() + path.size() + authority.size() + cookie.size() + headers.size() + 64);
+    request += method;
+    request += ' ';
+    request += path;
+    request += " HTTP/2.0\r\n";
+    if (!authority.empty()) {
+        request += "host: ";
+        request += authority;
+        request += "\r\n";
+    }
+    if (!cookie.empty()) {
+        request += "cookie: ";
+        request += cookie;
+        request += "\r\n";
+    }
+    request += headers;
+    request += "\r\n";
+    stream.parser.parse(request.data(), request.size());
+    return true;
+}
+
+void Http2Splitter::dispatchRequest(Stream &stream) {
+    // 回调中流可能被关闭(从map中移除)，先移出parser
+    // The stream may be closed (removed from the map) in the callback, so move the parser out first
+    Parser parser = std::move(stream.parser);
+    parser.setContent(std::move(stream.body));
+    stream.body.clear();
+    onHttp2Request(stream.id, parser);
+}
+
+void Http2Splitter::onSettingsFrame(uint8_t flags, const uint8_t *payload, size_t len) {
+    if (flags & FLAG_ACK) {
+        if (len) {
+            connectionError(H2_FRAME_SIZE_ERROR, "http2 SETTINGS ack with payload");
+        }
+        return;
+    }
+    if (len % 6) {
+        connectionError(H2_FRAME_SIZE_ERROR, "invalid http2 SETTINGS length");
+        return;
+    }
+    if (!applySettings(payload, len)) {
+        return;
+    }
+    sendFrame(SETTINGS, FLAG_ACK, 0, nullptr, 0);
+    // 初始窗口可能变大
+    // The initial window may have grown
+    flushHttp2Data();
+}
+
+bool Http2Splitter::applySettings(const uint8_t *payload, size_t len) {
+    for (size_t i = 0; i + 6 <= len; i += 6) {
+        uint16_t id = (payload[i] << 8) | payload[i + 1];
+        uint32_t value = loadBE32(payload + i + 2);
+        switch (id) {
+            case SETTINGS_HEADER_TABLE_SIZE: _encoder.setMaxTableSize(value); break;
+            case SETTINGS_ENABLE_PUSH: {
+                if (value > 1) {
+                    connectionError(H2_PROTOCOL_ERROR, "invalid http2 SETTINGS_ENABLE_PUSH");
+                    return false;
+                }
+                break;
+            }
+            case SETTINGS_INITIAL_WINDOW_SIZE: {
+                if (value > kMaxWindowSize) {
+                    connectionError(H2_FLOW_CONTROL_ERROR, "invalid http2 SETTINGS_INITIAL_WINDOW_SIZE");
+                    return false;
+                }
+                // 初始窗口的变化作用于所有已存在的流(rfc9113 6.9.2)
+                // The change of the initial window applies to all existing streams (rfc9113 6.9.2)
+                int64_t delta = (int64_t)value - _peer_initial_window;
+                for (auto &pr : _streams) {
+                    pr.second.send_window += delta;
+                    if (pr.second.send_window > kMaxWindowSize) {
+                        connectionError(H2_FLOW_CONTROL_ERROR, "http2 stream window overflow");
+                        return false;
+                    }
+                }
+                _peer_initial_window = value;
+                break;
+            }
+            case SETTINGS_MAX_FRAME_SIZE: {
+                if (value < 16384 || value > 16777215) {
+                    connectionError(H2_PROTOCOL_ERROR, "invalid http2 SETTINGS_MAX_FRAME_SIZE");
+                    return false;
+                }
+                _peer_max_frame_size = value;
+                break;
+            }
+            // 未知设置必须忽略
+            // Unknown settings must be ignored
+            default: break;
+        }
+    }
+    return true;
+}
+
+void Http2Splitter::onWindowUpdateFrame(uint32_t stream_id, const uint8_t *payload, size_t len) {
+    if (len != 4) {
+        connectionError(H2_FRAME_SIZE_ERROR, "invalid http2 WINDOW_UPDATE length");
+        return;
+    }
+    auto increment = loadBE32(payload) & 0x7FFFFFFF;
+    if (!stream_id) {
+        if (!increment) {
+            connectionError(H2_PROTOCOL_ERROR, "http2 WINDOW_UPDATE with zero increment");
+            return;
+        }
+        _send_window += increment;
+        if (_send_window > kMaxWindowSize) {
+            connectionError(H2_FLOW_CONTROL_ERROR, "http2 connection window overflow");
+            return;
+        }
+    } else {
+        auto stream = findStream(stream_id);
+        if (!stream) {
+            // 已关闭的流可能还会收到WINDOW_UPDATE
+            // A closed stream may still receive WINDOW_UPDATE
+            return;
+        }
+        if (!increment) {
+            resetHttp2Stream(stream_id, H2_PROTOCOL_ERROR);
+            return;
+        }
+        stream->send_window += increment;
+        if (stream->send_window > kMaxWindowSize) {
+            resetHttp2Stream(stream_id, H2_FLOW_CONTROL_ERROR);
+            return;
+        }
+    }
+    flushHttp2Data();
+}
+
+void Http2Splitter::onPriorityUpdateFrame(const uint8_t *payload, size_t len) {
+    if (len < 4) {
+        connectionError(H2_FRAME_SIZE_ERROR, "invalid http2 PRIORITY_UPDATE length");
+        return;
+    }
+    auto stream = findStream(loadBE32(payload) & 0x7FFFFFFF);
+    if (!stream) {
+        return;
+    }
+    stream->client_priority = true;
+    parsePriority(*stream, string((const char *)payload + 4, len - 4));
+}
+
+void Http2Splitter::parsePriority(Stream &stream, const string &value) {
+    // 结构化字段字典，例如: u=1, i
+    // Structured field dictionary, for example: u=1, i
+    for (auto &item : split(value, ",")) {
+        auto member = trim(item);
+        if (member.size() == 3 && member[0] == 'u' && member[1] == '=' && member[2] >= '0' && member[2] <= '7') {
+            stream.urgency = member[2] - '0';
+        } else if (member == "i" || member == "i=?1") {
+            stream.incremental = true;
+        } else if (member == "i=?0") {
+            stream.incremental = false;
+        }
+    }
+}
+
+void Http2Splitter::setHttp2Priority(uint32_t stream_id, uint8_t urgency, bool incremental, bool force) {
+    auto stream = findStream(stream_id);
+    if (!stream || (stream->client_priority && !force)) {
+        return;
+    }
+    stream->urgency = std::min<uint8_t>(urgency, 7);
+    stream->incremental = incremental;
+}
+
+void Http2Splitter::sendHttp2Headers(uint32_t stream_id, int status, const StrCaseMap &headers, bool end_stream) {
+    auto stream = findStream(stream_id);
+    if (!stream || stream->local_closed) {
+        return;
+    }
+
+    string block;
+    _encoder.beginBlock(block);
+    _encoder.encode(block, ":status", to_string(status));
+    string name;
+    for (auto &pr : headers) {
+        name = pr.first;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        // 连接相关的头在http/2中是非法的(rfc9113 8.2.2)
+        // Connection specific headers are illegal in http/2 (rfc9113 8.2.2)
+        if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" || name == "upgrade" || name == "proxy-connection") {
+            continue;
+        }
+        _encoder.encode(block, name, pr.second);
+    }
+
+    // 超过对端最大帧长时拆分为CONTINUATION帧
+    // Split into CONTINUATION frames when larger than the peer maximum frame size
+    size_t offset = 0;
+    uint8_t type = HEADERS;
+    do {
+        auto size = std::min<size_t>(block.size() - offset, _peer_max_frame_size);
+        uint8_t flags = (offset + size == block.size()) ? FLAG_END_HEADERS : 0;
+        if (type == HEADERS && end_stream) {
+            flags |= FLAG_END_STREAM;
+        }
+        sendFrame(type, flags, stream_id, block.data() + offset, size);
+        offset += size;
+        type = CONTINUATION;
+    } while (offset < block.size());
+
+    if (end_stream) {
+        stream->local_closed = true;
+        checkStreamClosed(*stream);
+    }
+}
+
+void Http2Splitter::sendHttp2Data(uint32_t stream_id, Buffer::Ptr buffer, bool end_stream) {
+    auto stream = findStream(stream_id);
+    if (!stream || stream->local_closed || stream->end_pending) {
+        return;
+    }
+    if (buffer && buffer->size()) {
+        stream->pending_bytes += buffer->size();
+        stream->pending.emplace_back(std::move(buffer));
+    }
+    stream->end_pending = end_stream;
+    flushHttp2Data();
+}
+
+size_t Http2Splitter::http2PendingSize(uint32_t stream_id) const {
+    auto it = _streams.find(stream_id);
+    return it == _streams.end() ? 0 : it->second.pending_bytes;
+}
+
+bool Http2Splitter::isHttp2StreamWritable(uint32_t stream_id) const {
+    auto it = _streams.find(stream_id);
+    return it != _streams.end() && !it->second.local_closed && !it->second.end_pending;
+}
+
+Http2Splitter::Stream *Http2Splitter::nextStreamToSend() {
+    // 先按urgency排序；同urgency下非incremental的流按id顺序独占发送，incremental的流轮转发送(rfc9218 10)
+    // Sort by urgency first; within the same urgency non-incremental streams are sent exclusively in id order,
+    // incremental streams are sent round-robin (rfc9218 10)
+    Stream *best = nullptr;
+    Stream *first_incremental = nullptr;
+    for (auto &pr : _streams) {
+        auto &stream = pr.second;
+        if (stream.local_closed) {
+            continue;
+        }
+        bool ready = stream.pending_bytes ? (stream.send_window > 0 && _send_window > 0) : stream.end_pending;
+        if (!ready) {
+            continue;
+        }
+        if (best && stream.urgency > best->urgency) {
+            continue;
+        }
+        if (best && stream.urgency < best->urgency) {
+            best = nullptr;
+            first_incremental = nullptr;
+        }
+        if (!stream.incremental) {
+            if (!best || best->incremental) {
+                best = &stream;
+            }
+            continue;
+        }
+        if (best && !best->incremental) {
+            continue;
+        }
+        if (!first_incremental) {
+            first_incremental = &stream;
+        }
+        if (!best || (best->id <= _last_sent_stream_id && stream.id > _last_sent_stream_id)) {
+            best = &stream;
+        }
+    }
+    if (best && best->incremental && best->id <= _last_sent_stream_id) {
+        // 轮转回绕
+        // Round-robin wraps around
+        best = first_incremental;
+    }
+    return best;
+}
+
+void Http2Splitter::flushHttp2Data() {
+    if (_flushing || _error) {
+        return;
+    }
+    _flushing = true;
+    vector<uint32_t> writable;
+    while (!isHttp2SendBlocked()) {
+        auto stream = nextStreamToSend();
+        if (!stream) {
+            break;
+        }
+        auto stream_id = stream->id;
+        _last_sent_stream_id = stream_id;
+        if (!stream->pending_bytes) {
+            // 只剩结束标记，空DATA帧不受流量控制
+            // Only the end flag is left, an empty DATA frame is not flow controlled
+            sendFrame(DATA, FLAG_END_STREAM, stream_id, nullptr, 0);
+            stream->local_closed = true;
+            checkStreamClosed(*stream);
+            continue;
+        }
+
+        auto &front = stream->pending.front();
+        auto size = std::min<int64_t>(front->size() - stream->pending_offset, std::min(_send_window, stream->send_window));
+        size = std::min<int64_t>(size, _peer_max_frame_size);
+        bool end_stream = stream->end_pending && (size_t)size == stream->pending_bytes;
+
+        auto header = BufferRaw::create();
+        header->setCapacity(kFrameHeaderSize);
+        writeFrameHeader(header->data(), size, DATA, end_stream ? FLAG_END_STREAM : 0, stream_id);
+        header->setSize(kFrameHeaderSize);
+        onHttp2Send(std::move(header));
+        // 负载直接引用原始buffer，避免拷贝
+        // The payload references the original buffer directly to avoid copying
+        if (!stream->pending_offset && (size_t)size == front->size()) {
+            onHttp2Send(front);
+        } else {
+            onHttp2Send(std::make_shared<BufferOffset<Buffer::Ptr>>(front, stream->pending_offset, size));
+        }
+
+        _send_window -= size;
+        stream->send_window -= size;
+        stream->pending_bytes -= size;
+        stream->pending_offset += size;
+        if (stream->pending_offset == front->size()) {
+            stream->pending.pop_front();
+            stream->pending_offset = 0;
+        }
+
+        if (end_stream) {
+            stream->local_closed = true;
+            checkStreamClosed(*stream);
+        } else if (!stream->pending_bytes && !stream->end_pending) {
+            writable.emplace_back(stream_id);
+        }
+    }
+    _flushing = false;
+
+    for (auto stream_id : writable) {
+        onHttp2StreamWritable(stream_id);
+    }
+}
+
+void Http2Splitter::resetHttp2Stream(uint32_t stream_id, ErrorCode error) {
+    char payload[4];
+    writeBE32(payload, error);
+    sendFrame(RST_STREAM, 0, stream_id, payload, sizeof(payload));
+    closeStream(stream_id);
+}
+
+void Http2Splitter::sendFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const char *payload, size_t len) {
+    auto buffer = BufferRaw::create();
+    buffer->setCapacity(kFrameHeaderSize + len);
+    writeFrameHeader(buffer->data(), len, type, flags, stream_id);
+    if (len) {
+        memcpy(buffer->data() + kFrameHeaderSize, payload, len);
+    }
+    buffer->setSize(kFrameHeaderSize + len);
+    onHttp2Send(std::move(buffer));
+}
+
+void Http2Splitter::sendWindowUpdate(uint32_t stream_id, uint32_t increment) {
+    char payload[4];
+    writeBE32(payload, increment & 0x7FFFFFFF);
+    sendFrame(WINDOW_UPDATE, 0, stream_id, payload, sizeof(payload));
+}
+
+void Http2Splitter::connectionError(ErrorCode error, const string &err) {
+    if (_error) {
+        return;
+    }
+    string payload(8, '\0');
+    writeBE32(&payload[0], _last_stream_id);
+    writeBE32(&payload[4], error);
+    payload += err;
+    sendFrame(GOAWAY, 0, 0, payload.data(), payload.size());
+    _error = true;
+    onHttp2Error(err);
+}
+
+Http2Splitter::Stream *Http2Splitter::findStream(uint32_t stream_id) {
+    auto it = _streams.find(stream_id);
+    return it == _streams.end() ? nullptr : &it->second;
+}
+
+void Http2Splitter::checkStreamClosed(Stream &stream) {
+    if (stream.local_closed && stream.remote_closed) {
+        closeStream(stream.id);
+    } else if (stream.local_closed) {
+        // 回复已经发送完毕而请求还未结束，不再需要请求的剩余部分(rfc9113 8.1)
+        // The response is complete while the request is not, the rest of the request is no longer needed (rfc9113 8.1)
+        resetHttp2Stream(stream.id, H2_NO_ERROR);
+    }
+}
+
+void Http2Splitter::closeStream(uint32_t stream_id) {
+    if (_streams.erase(stream_id)) {
+        onHttp2StreamClosed(stream_id);
+    }
+}
+
+} // namespace mediakit
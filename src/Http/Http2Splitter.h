@@ -0,0 +1,255 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_HTTP2SPLITTER_H
+#define ZLMEDIAKIT_HTTP2SPLITTER_H
+
+#include <map>
+#include <deque>
+#include <string>
+#include <cstdint>
+#include "Hpack.h"
+#include "Common/Parser.h"
+#include "Network/Buffer.h"
+
+namespace mediakit {
+
+/**
+ * http/2服务端协议解析与打包(rfc9113)，不涉及socket
+ * 支持多路复用、hpack、双向流量控制以及基于rfc9218(priority头与PRIORITY_UPDATE帧)的发送优先级调度
+ * Http/2 server side protocol parsing and packaging (rfc9113), independent of the socket.
+ * Supports stream multiplexing, hpack, flow control in both directions and send scheduling
+ * based on rfc9218 priorities (priority header and PRIORITY_UPDATE frame).
+ */
+class Http2Splitter {
+public:
+    enum FrameType : uint8_t {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PUSH_PROMISE = 0x5,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9,
+        PRIORITY_UPDATE = 0x10,
+    };
+
+    enum ErrorCode : uint32_t {
+        H2_NO_ERROR = 0x0,
+        H2_PROTOCOL_ERROR = 0x1,
+        H2_INTERNAL_ERROR = 0x2,
+        H2_FLOW_CONTROL_ERROR = 0x3,
+        H2_SETTINGS_TIMEOUT = 0x4,
+        H2_STREAM_CLOSED = 0x5,
+        H2_FRAME_SIZE_ERROR = 0x6,
+        H2_REFUSED_STREAM = 0x7,
+        H2_CANCEL = 0x8,
+        H2_COMPRESSION_ERROR = 0x9,
+        H2_CONNECT_ERROR = 0xa,
+        H2_ENHANCE_YOUR_CALM = 0xb,
+        H2_INADEQUATE_SECURITY = 0xc,
+        H2_HTTP_1_1_REQUIRED = 0xd,
+    };
+
+    // 客户端连接序言
+    // Client connection preface
+    static const std::string kPreface;
+
+    virtual ~Http2Splitter() = default;
+
+    /**
+     * 开始http/2会话，发送本端SETTINGS
+     * @param max_streams 最大并发流数
+     * @param max_body_size 请求body最大字节数，超过后回复413
+     * Start the http/2 session and send the local SETTINGS
+     * @param max_streams maximum concurrent streams
+     * @param max_body_size maximum request body size in bytes, 413 is replied beyond it
+     */
+    void startHttp2(uint32_t max_streams, size_t max_body_size);
+
+    /**
+     * 通过http/1.1 Upgrade: h2c进入http/2，原请求成为stream 1(rfc7540 3.2)
+     * @param settings HTTP2-Settings头(base64url编码的SETTINGS负载)
+     * @return false代表HTTP2-Settings非法
+     * Enter http/2 through http/1.1 Upgrade: h2c, the original request becomes stream 1 (rfc7540 3.2)
+     * @param settings HTTP2-Settings header (base64url encoded SETTINGS payload)
+     * @return false means HTTP2-Settings is invalid
+     */
+    bool upgradeHttp2(const std::string &settings);
+
+    /**
+     * 输入收到的数据(包含客户端连接序言)，可能触发onHttp2Request等回调
+     * Input received data (client connection preface included), may trigger onHttp2Request and other callbacks
+     */
+    void inputHttp2(const char *data, size_t len);
+
+    /**
+     * 发送回复头
+     * @param headers 回复头，连接相关的头(Connection/Keep-Alive等)会被忽略
+     * @param end_stream 是否没有body
+     * Send response headers
+     * @param headers response headers, connection specific headers (Connection/Keep-Alive etc.) are ignored
+     * @param end_stream whether there is no body
+     */
+    void sendHttp2Headers(uint32_t stream_id, int status, const StrCaseMap &headers, bool end_stream);
+
+    /**
+     * 发送body数据，受流量控制与优先级调度约束，可能先缓存在流中
+     * @param buffer 数据，可以为空
+     * @param end_stream 是否为最后一段数据
+     * Send body data, subject to flow control and priority scheduling, may be buffered in the stream first
+     * @param buffer data, may be null
+     * @param end_stream whether it is the last piece of data
+     */
+    void sendHttp2Data(uint32_t stream_id, toolkit::Buffer::Ptr buffer, bool end_stream);
+
+    /**
+     * 重置流
+     * Reset a stream
+     */
+    void resetHttp2Stream(uint32_t stream_id, ErrorCode error);
+
+    /**
+     * 设置流的发送优先级(rfc9218)
+     * @param urgency 0~7，越小越优先
+     * @param incremental 同优先级下是否与其他流轮转发送
+     * @param force 客户端已经指定优先级时是否覆盖
+     * Set the send priority of a stream (rfc9218)
+     * @param urgency 0~7, lower is more urgent
+     * @param incremental whether to round-robin with other streams of the same urgency
+     * @param force whether to override the priority already specified by the client
+     */
+    void setHttp2Priority(uint32_t stream_id, uint8_t urgency, bool incremental, bool force = false);
+
+    /**
+     * 在流量窗口与socket允许的情况下发送缓存的body数据
+     * Send buffered body data as long as the flow control windows and the socket allow
+     */
+    void flushHttp2Data();
+
+    /**
+     * 流中还未发送的body字节数
+     * Body bytes not yet sent in the stream
+     */
+    size_t http2PendingSize(uint32_t stream_id) const;
+
+    /**
+     * 流是否存在且还可以发送回复
+     * Whether the stream exists and can still send a response
+     */
+    bool isHttp2StreamWritable(uint32_t stream_id) const;
+
+    bool isHttp2() const { return _started; }
+
+protected:
+    /**
+     * 收到一个完整的请求(头与body)，parser中的协议为HTTP/2.0，:authority转换为Host头
+     * Received a complete request (headers and body), the protocol in parser is HTTP/2.0, :authority is converted to the Host header
+     */
+    virtual void onHttp2Request(uint32_t stream_id, Parser &parser) = 0;
+
+    /**
+     * 打包好的http/2数据
+     * Packaged http/2 data
+     */
+    virtual void onHttp2Send(toolkit::Buffer::Ptr buffer) = 0;
+
+    /**
+     * 连接错误，已发送GOAWAY，连接应该关闭
+     * Connection error, GOAWAY was sent, the connection should be closed
+     */
+    virtual void onHttp2Error(const std::string &err) = 0;
+
+    /**
+     * 流中缓存的body数据已经发送完毕，可以继续写入
+     * The body data buffered in the stream has been sent, more can be written
+     */
+    virtual void onHttp2StreamWritable(uint32_t stream_id) {}
+
+    /**
+     * 流关闭(发送完毕或被对端重置)
+     * Stream closed (sending finished or reset by the peer)
+     */
+    virtual void onHttp2StreamClosed(uint32_t stream_id) {}
+
+    /**
+     * socket发送缓存是否已满，满时暂停发送body数据
+     * Whether the socket send buffer is full, sending body data is paused when it is
+     */
+    virtual bool isHttp2SendBlocked() { return false; }
+
+private:
+    struct Stream {
+        uint32_t id = 0;
+        int64_t send_window = 0;
+        uint8_t urgency = 3;
+        bool incremental = false;
+        bool client_priority = false;
+        bool remote_closed = false;
+        bool local_closed = false;
+        bool end_pending = false;
+        size_t pending_bytes = 0;
+        size_t pending_offset = 0;
+        std::deque<toolkit::Buffer::Ptr> pending;
+        std::string body;
+        Parser parser;
+    };
+
+    size_t onFrame(const uint8_t *data, size_t len);
+    void onDataFrame(uint32_t stream_id, uint8_t flags, const uint8_t *payload, size_t len);
+    void onHeadersFrame(uint32_t stream_id, uint8_t flags, const uint8_t *payload, size_t len);
+    void onHeaderBlock(uint32_t stream_id, uint8_t flags);
+    void onSettingsFrame(uint8_t flags, const uint8_t *payload, size_t len);
+    void onWindowUpdateFrame(uint32_t stream_id, const uint8_t *payload, size_t len);
+    void onPriorityUpdateFrame(const uint8_t *payload, size_t len);
+    bool applySettings(const uint8_t *payload, size_t len);
+    bool decodeRequest(Stream &stream, bool &malformed);
+    void dispatchRequest(Stream &stream);
+    void sendFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const char *payload, size_t len);
+    void sendWindowUpdate(uint32_t stream_id, uint32_t increment);
+    void connectionError(ErrorCode error, const std::string &err);
+    Stream *findStream(uint32_t stream_id);
+    Stream *nextStreamToSend();
+    void closeStream(uint32_t stream_id);
+    void checkStreamClosed(Stream &stream);
+    static void parsePriority(Stream &stream, const std::string &value);
+
+private:
+    bool _started = false;
+    bool _preface_received = false;
+    bool _flushing = false;
+    bool _error = false;
+    uint32_t _max_streams = 100;
+    size_t _max_body_size = 0;
+    uint32_t _last_stream_id = 0;
+    // CONTINUATION帧未结束时的流id与标记
+    // Stream id and flags while CONTINUATION frames are pending
+    uint32_t _continuation_stream_id = 0;
+    uint8_t _continuation_flags = 0;
+    std::string _header_block;
+    // 对端设置
+    // Peer settings
+    uint32_t _peer_max_frame_size = 16384;
+    uint32_t _peer_initial_window = 65535;
+    int64_t _send_window = 65535;
+    // 轮转发送的游标
+    // Round-robin cursor
+    uint32_t _last_sent_stream_id = 0;
+    std::string _remain_data;
+    std::map<uint32_t, Stream> _streams;
+    HpackDecoder _decoder;
+    HpackEncoder _encoder;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_HTTP2SPLITTER_H
@@ -400,4 +400,48 @@ Buffer::Ptr HttpBufferBody::readData(size_t size) {
     return Buffer::Ptr(std::move(_buffer));
 }
 
+HttpChunkedBody::HttpChunkedBody(HttpBody::Ptr body) {
+    _body = std::move(body);
+}
+
+int64_t HttpChunkedBody::remainSize() {
+    return _finished ? 0 : -1;
+}
+
+Buffer::Ptr HttpChunkedBody::readData(size_t size) {
+    return toChunk(_body->readData(size));
+}
+
+void HttpChunkedBody::readDataAsync(size_t size, const function<void(const Buffer::Ptr &buf)> &cb) {
+    weak_ptr<HttpBody> weak_self = shared_from_this();
+    _body->readDataAsync(size, [weak_self, cb](const Buffer::Ptr &buf) {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        cb(static_pointer_cast<HttpChunkedBody>(strong_self)->toChunk(buf));
+    });
+}
+
+Buffer::Ptr HttpChunkedBody::toChunk(const Buffer::Ptr &buf) {
+    if (_finished) {
+        return nullptr;
+    }
+    if (!buf || !buf->size()) {
+        // 最后一个长度为0的chunk
+        // The last chunk with zero length
+        _finished = true;
+        return std::make_shared<BufferString>("0\r\n\r\n");
+    }
+    char head[32];
+    auto head_size = snprintf(head, sizeof(head), "%zx\r\n", buf->size());
+    auto ret = BufferRaw::create();
+    ret->setCapacity(head_size + buf->size() + 2);
+    memcpy(ret->data(), head, head_size);
+    memcpy(ret->data() + head_size, buf->data(), buf->size());
+    memcpy(ret->data() + head_size + buf->size(), "\r\n", 2);
+    ret->setSize(head_size + buf->size() + 2);
+    return ret;
+}
+
 } // namespace mediakit
@@ -215,6 +215,28 @@ private:
     HttpFileBody::Ptr _fileBody;
 };
 
+/**
+ * 以chunked编码(Transfer-Encoding: chunked)输出长度不固定的body，发送完毕后无需关闭连接
+ * Output a body of unknown length with chunked encoding (Transfer-Encoding: chunked),
+ * so the connection need not be closed after sending
+ */
+class HttpChunkedBody : public HttpBody {
+public:
+    using Ptr = std::shared_ptr<HttpChunkedBody>;
+    HttpChunkedBody(HttpBody::Ptr body);
+
+    int64_t remainSize() override;
+    toolkit::Buffer::Ptr readData(size_t size) override;
+    void readDataAsync(size_t size, const std::function<void(const toolkit::Buffer::Ptr &buf)> &cb) override;
+
+private:
+    toolkit::Buffer::Ptr toChunk(const toolkit::Buffer::Ptr &buf);
+
+private:
+    bool _finished = false;
+    HttpBody::Ptr _body;
+};
+
 }//namespace mediakit
 
 #endif //ZLMEDIAKIT_FILEREADER_H
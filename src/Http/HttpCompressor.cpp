@@ -0,0 +1,305 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "HttpCompressor.h"
+
+#if defined(ENABLE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(ENABLE_BROTLI)
+#include <brotli/encode.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+static atomic<uint64_t> s_compressed { 0 };
+static atomic<uint64_t> s_bytes_in { 0 };
+static atomic<uint64_t> s_bytes_out { 0 };
+static atomic<uint64_t> s_cpu_us { 0 };
+static atomic<uint64_t> s_precompressed { 0 };
+static atomic<uint64_t> s_precompressed_saved { 0 };
+
+bool HttpCompressor::isAccepted(const string &accept_encoding, const string &encoding) {
+    for (auto &item : split(accept_encoding, ",")) {
+        auto params = split(item, ";");
+        if (params.empty() || strcasecmp(trim(params[0]).data(), encoding.data())) {
+            continue;
+        }
+        for (size_t i = 1; i < params.size(); ++i) {
+            auto &param = trim(params[i]);
+            if (start_with(param, "q=")) {
+                return atof(param.data() + 2) > 0;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool HttpCompressor::isCompressible(const string &content_type) {
+    auto type = strToLower(content_type);
+    return start_with(type, "text/") || type.find("json") != string::npos || type.find("javascript") != string::npos
+        || type.find("xml") != string::npos || type.find("mpegurl") != string::npos || type.find("dash+xml") != string::npos;
+}
+
+// 流式编码器，每次压缩一块数据并把结果追加到out
+// Streaming encoder, each call compresses a piece of data and appends the result to out
+class HttpEncoder {
+public:
+    using Ptr = std::shared_ptr<HttpEncoder>;
+    virtual ~HttpEncoder() = default;
+
+    /**
+     * @param finish 是否为最后一块数据，为true时输出编码结尾
+     * @return 是否成功
+     * @param finish whether it is the last piece of data, the end of the encoding is output if true
+     * @return whether it succeeded
+     */
+    virtual bool encode(const char *data, size_t size, bool finish, string &out) = 0;
+};
+
+#if defined(ENABLE_ZLIB)
+class GzipEncoder : public HttpEncoder {
+public:
+    ~GzipEncoder() override {
+        if (_inited) {
+            deflateEnd(&_stream);
+        }
+    }
+
+    bool init(int level) {
+        memset(&_stream, 0, sizeof(_stream));
+        // windowBits + 16: 输出gzip格式
+        // windowBits + 16: output gzip format
+        _inited = deflateInit2(&_stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        return _inited;
+    }
+
+    bool encode(const char *data, size_t size, bool finish, string &out) override {
+        _stream.next_in = (Bytef *)data;
+        _stream.avail_in = (uInt)size;
+        while (true) {
+            auto used = out.size();
+            out.resize(used + kOutputSize);
+            _stream.next_out = (Bytef *)&out[used];
+            _stream.avail_out = (uInt)kOutputSize;
+            auto ret = deflate(&_stream, finish ? Z_FINISH : Z_NO_FLUSH);
+            out.resize(used + kOutputSize - _stream.avail_out);
+            if (finish) {
+                if (ret == Z_STREAM_END) {
+                    return true;
+                }
+                if (ret != Z_OK) {
+                    return false;
+                }
+                continue;
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                return false;
+            }
+            // 输入已消耗完且输出缓存未满，说明没有待输出的数据
+            // The input is consumed and the output buffer is not full, so there is no pending output
+            if (ret == Z_BUF_ERROR || (!_stream.avail_in && _stream.avail_out)) {
+                return true;
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kOutputSize = 16 * 1024;
+    bool _inited = false;
+    z_stream _stream;
+};
+#endif
+
+#if defined(ENABLE_BROTLI)
+class BrotliEncoder : public HttpEncoder {
+public:
+    ~BrotliEncoder() override {
+        if (_encoder) {
+            BrotliEncoderDestroyInstance(_encoder);
+        }
+    }
+
+    bool init(int quality, int64_t size_hint) {
+        _encoder = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (!_encoder) {
+            return false;
+        }
+        BrotliEncoderSetParameter(_encoder, BROTLI_PARAM_QUALITY, quality);
+        BrotliEncoderSetParameter(_encoder, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+        if (size_hint > 0) {
+            BrotliEncoderSetParameter(_encoder, BROTLI_PARAM_SIZE_HINT, (uint32_t)std::min<int64_t>(size_hint, UINT32_MAX));
+        }
+        return true;
+    }
+
+    bool encode(const char *data, size_t size, bool finish, string &out) override {
+        size_t avail_in = size;
+        auto next_in = (const uint8_t *)data;
+        auto op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+        do {
+            size_t avail_out = 0;
+            if (!BrotliEncoderCompressStream(_encoder, op, &avail_in, &next_in, &avail_out, nullptr, nullptr)) {
+                return false;
+            }
+            size_t out_size = 0;
+            auto out_data = BrotliEncoderTakeOutput(_encoder, &out_size);
+            out.append((const char *)out_data, out_size);
+        } while (avail_in || BrotliEncoderHasMoreOutput(_encoder) || (finish && !BrotliEncoderIsFinished(_encoder)));
+        return true;
+    }
+
+private:
+    BrotliEncoderState *_encoder = nullptr;
+};
+#endif
+
+// 边读取边压缩的body，每次readData只压缩原body的一块数据，长度未知，http/1.1下以chunked方式回复
+// A body compressed while being read, each readData only compresses one piece of the original body,
+// its length is unknown so it is replied chunked over http/1.1
+class HttpCompressedBody : public HttpBody {
+public:
+    HttpCompressedBody(HttpBody::Ptr body, HttpEncoder::Ptr encoder) {
+        _body = std::move(body);
+        _encoder = std::move(encoder);
+    }
+
+    int64_t remainSize() override { return _finished ? 0 : -1; }
+
+    Buffer::Ptr readData(size_t size) override {
+        string out;
+        while (out.empty() && !_finished) {
+            auto buffer = _body->readData(size);
+            auto start = getCurrentMicrosecond(true);
+            bool ok;
+            if (buffer) {
+                s_bytes_in += buffer->size();
+                ok = _encoder->encode(buffer->data(), buffer->size(), false, out);
+            } else {
+                _finished = true;
+                ok = _encoder->encode(nullptr, 0, true, out);
+            }
+            s_cpu_us += getCurrentMicrosecond(true) - start;
+            if (!ok) {
+                // 编码器初始化成功后不会出错，此处仅为防御
+                // The encoder does not fail once initialized, this is only defensive
+                WarnL << "Compress http response failed";
+                _finished = true;
+                return nullptr;
+            }
+        }
+        s_bytes_out += out.size();
+        return out.empty() ? nullptr : std::make_shared<BufferString>(std::move(out));
+    }
+
+private:
+    bool _finished = false;
+    HttpBody::Ptr _body;
+    HttpEncoder::Ptr _encoder;
+};
+
+HttpBody::Ptr HttpCompressor::compress(const string &accept_encoding, StrCaseMap &header, const HttpBody::Ptr &body) {
+    GET_CONFIG(size_t, minSize, Http::kCompressMinSize);
+    // 长度未知(remainSize返回-1)的body，如分批序列化的api列表，同样边读取边压缩，不会被整体读入内存
+    // A body of unknown length (remainSize returns -1), such as an api list serialized in batches,
+    // is also compressed while being read and is never read into memory as a whole
+    if (!minSize || !body || (body->remainSize() >= 0 && body->remainSize() < (int64_t)minSize) || accept_encoding.empty()) {
+        return body;
+    }
+    if (header.find("Content-Encoding") != header.end()) {
+        return body;
+    }
+    // 未指定Content-Type时，HttpSession::sendResponse缺省使用text/plain
+    // HttpSession::sendResponse uses text/plain by default when Content-Type is not specified
+    auto it = header.find("Content-Type");
+    if (!isCompressible(it == header.end() ? "text/plain" : it->second)) {
+        return body;
+    }
+
+    string encoding;
+    HttpEncoder::Ptr encoder;
+#if defined(ENABLE_BROTLI)
+    if (!encoder && isAccepted(accept_encoding, "br")) {
+        GET_CONFIG(int, brotliQuality, Http::kBrotliQuality);
+        auto br = std::make_shared<BrotliEncoder>();
+        if (br->init(brotliQuality, body->remainSize())) {
+            encoder = std::move(br);
+            encoding = "br";
+        }
+    }
+#endif
+#if defined(ENABLE_ZLIB)
+    if (!encoder && isAccepted(accept_encoding, "gzip")) {
+        GET_CONFIG(int, gzipLevel, Http::kGzipLevel);
+        auto gzip = std::make_shared<GzipEncoder>();
+        if (gzip->init(gzipLevel)) {
+            encoder = std::move(gzip);
+            encoding = "gzip";
+        }
+    }
+#endif
+    if (!encoder) {
+        // 不支持客户端接受的编码，或编码器初始化失败(此时body尚未被读取)，回复原body
+        // The encodings accepted by the client are not supported, or the encoder failed to initialize
+        // (the body has not been read yet), reply the original body
+        return body;
+    }
+
+    s_compressed += 1;
+    header["Content-Encoding"] = encoding;
+    header["Vary"] = "Accept-Encoding";
+    return std::make_shared<HttpCompressedBody>(body, std::move(encoder));
+}
+
+vector<pair<string, string> > HttpCompressor::precompressedSuffixes(const string &accept_encoding) {
+    vector<pair<string, string> > ret;
+    GET_CONFIG(bool, enable, Http::kEnablePrecompressed);
+    if (!enable || accept_encoding.empty()) {
+        return ret;
+    }
+    if (isAccepted(accept_encoding, "br")) {
+        ret.emplace_back(".br", "br");
+    }
+    if (isAccepted(accept_encoding, "gzip")) {
+        ret.emplace_back(".gz", "gzip");
+    }
+    return ret;
+}
+
+void HttpCompressor::onPrecompressed(uint64_t original_size, uint64_t compressed_size) {
+    s_precompressed += 1;
+    if (original_size > compressed_size) {
+        s_precompressed_saved += original_size - compressed_size;
+    }
+}
+
+HttpCompressor::Statistic HttpCompressor::getStatistic() {
+    Statistic ret;
+    ret.compressed = s_compressed;
+    ret.bytes_in = s_bytes_in;
+    ret.bytes_out = s_bytes_out;
+    ret.cpu_us = s_cpu_us;
+    ret.precompressed = s_precompressed;
+    ret.precompressed_saved = s_precompressed_saved;
+    return ret;
+}
+
+} // namespace mediakit
@@ -0,0 +1,95 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_HTTPCOMPRESSOR_H
+#define ZLMEDIAKIT_HTTPCOMPRESSOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "HttpBody.h"
+#include "Common/Parser.h"
+
+namespace mediakit {
+
+/**
+ * http回复压缩(Content-Encoding: br/gzip)
+ * 动态回复(http api等)按Accept-Encoding协商后流式压缩，静态文件优先使用预压缩的.br/.gz文件
+ * Http response compression (Content-Encoding: br/gzip)
+ * Dynamic responses (http api etc.) are compressed in a streaming way after negotiating Accept-Encoding,
+ * static files prefer the precompressed .br/.gz files
+ */
+class HttpCompressor {
+public:
+    struct Statistic {
+        // 动态压缩的回复数
+        // Number of dynamically compressed responses
+        uint64_t compressed = 0;
+        // 动态压缩前后字节数
+        // Bytes before and after dynamic compression
+        uint64_t bytes_in = 0;
+        uint64_t bytes_out = 0;
+        // 动态压缩耗时，单位微秒
+        // Time spent on dynamic compression in microseconds
+        uint64_t cpu_us = 0;
+        // 回复预压缩文件的次数与节省的字节数
+        // Number of precompressed file responses and the bytes saved
+        uint64_t precompressed = 0;
+        uint64_t precompressed_saved = 0;
+    };
+
+    /**
+     * Accept-Encoding是否接受该编码(q=0视为不接受)
+     * Whether Accept-Encoding accepts the encoding (q=0 means not accepted)
+     */
+    static bool isAccepted(const std::string &accept_encoding, const std::string &encoding);
+
+    /**
+     * 是否为值得压缩的文本类型
+     * Whether it is a text type worth compressing
+     */
+    static bool isCompressible(const std::string &content_type);
+
+    /**
+     * 按需压缩动态回复，压缩后添加Content-Encoding与Vary头
+     * @param accept_encoding 请求的Accept-Encoding头
+     * @param header 回复头
+     * @param body 回复body
+     * @return 边读取边压缩的body(长度未知)，不满足压缩条件或编码器初始化失败时返回原body
+     * Compress a dynamic response on demand, Content-Encoding and Vary headers are added after compression
+     * @param accept_encoding Accept-Encoding header of the request
+     * @param header response headers
+     * @param body response body
+     * @return a body compressed while being read (of unknown length), or the original body if the compression
+     *         conditions are not met or the encoder fails to initialize
+     */
+    static HttpBody::Ptr compress(const std::string &accept_encoding, StrCaseMap &header, const HttpBody::Ptr &body);
+
+    /**
+     * 选择静态文件可用的预压缩文件
+     * @param accept_encoding 请求的Accept-Encoding头
+     * @return 按优先级排列的预压缩文件后缀与编码名
+     * Select the precompressed file suffixes usable for a static file
+     * @param accept_encoding Accept-Encoding header of the request
+     * @return precompressed file suffixes and encoding names in order of preference
+     */
+    static std::vector<std::pair<std::string, std::string> > precompressedSuffixes(const std::string &accept_encoding);
+
+    /**
+     * 记录一次预压缩文件回复
+     * Record a precompressed file response
+     */
+    static void onPrecompressed(uint64_t original_size, uint64_t compressed_size);
+
+    static Statistic getStatistic();
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_HTTPCOMPRESSOR_H
@@ -0,0 +1,372 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <ctime>
+#include <cinttypes>
+#include <sys/stat.h>
+#if defined(__linux__) || defined(__linux)
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+#include "Poller/EventPoller.h"
+#include "Common/config.h"
+#include "HttpConst.h"
+#include "HttpFileCache.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+INSTANCE_IMP(HttpFileCache);
+
+HttpFileCache::~HttpFileCache() {
+#if defined(__linux__) || defined(__linux)
+    if (_inotify_fd != -1) {
+        close(_inotify_fd);
+    }
+#endif
+}
+
+static bool statFile(const string &path, uint64_t &size, uint64_t &mtime) {
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(path.data(), &st) != 0 || (st.st_mode & _S_IFDIR)) {
+        return false;
+    }
+    mtime = (uint64_t)st.st_mtime * 1000000000ULL;
+#else
+    struct stat st;
+    if (stat(path.data(), &st) != 0 || S_ISDIR(st.st_mode)) {
+        return false;
+    }
+#if defined(__APPLE__)
+    mtime = (uint64_t)st.st_mtimespec.tv_sec * 1000000000ULL + st.st_mtimespec.tv_nsec;
+#else
+    mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+#endif
+    size = st.st_size;
+    return true;
+}
+
+static string httpDate(time_t tt) {
+    struct tm tm;
+#if defined(_WIN32)
+    gmtime_s(&tm, &tt);
+#else
+    gmtime_r(&tt, &tm);
+#endif
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return buf;
+}
+
+static string dirName(const string &path) {
+    auto pos = path.rfind('/');
+    return pos == string::npos ? "." : path.substr(0, pos);
+}
+
+static Buffer::Ptr loadFile(const string &path, uint64_t size) {
+    std::shared_ptr<FILE> fp(fopen(path.data(), "rb"), [](FILE *fp) {
+        if (fp) {
+            fclose(fp);
+        }
+    });
+    if (!fp) {
+        return nullptr;
+    }
+    auto ret = BufferRaw::create();
+    ret->setCapacity(size + 1);
+    // 多读一个字节用于确认文件没有变大
+    // Read one more byte to make sure the file has not grown
+    auto read = fread(ret->data(), 1, size + 1, fp.get());
+    if (read != size) {
+        return nullptr;
+    }
+    ret->setSize(size);
+    return ret;
+}
+
+HttpFileCache::Item::Ptr HttpFileCache::makeItem(const string &path) {
+    auto item = std::make_shared<Item>();
+    if (!statFile(path, item->size, item->mtime)) {
+        return nullptr;
+    }
+    GET_CONFIG(string, charSet, Http::kCharSet);
+    item->path = path;
+    item->content_type = HttpConst::getHttpContentType(path.data()) + "; charset=" + charSet;
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%" PRIx64 "-%" PRIx64 "\"", item->mtime, item->size);
+    item->etag = etag;
+    item->last_modified = httpDate((time_t)(item->mtime / 1000000000ULL));
+    return item;
+}
+
+HttpFileCache::Item::Ptr HttpFileCache::get(const string &path, bool use_cache) {
+    GET_CONFIG(size_t, cacheSizeMB, Http::kFileCacheSize);
+    GET_CONFIG(size_t, maxFileSizeKB, Http::kFileCacheMaxFileSize);
+    size_t capacity = cacheSizeMB * 1024 * 1024;
+    if (!use_cache || !capacity) {
+        if (!capacity) {
+            // 缓存被关闭，释放内存
+            // The cache is disabled, release the memory
+            lock_guard<mutex> lck(_mtx);
+            evict(0);
+        }
+        return makeItem(path);
+    }
+
+    Item::Ptr cached;
+    bool watched = false;
+    {
+        lock_guard<mutex> lck(_mtx);
+        // 配置可能被调小
+        // The configuration may have been reduced
+        evict(capacity);
+        auto it = _entries.find(path);
+        if (it != _entries.end()) {
+            cached = it->second.item;
+            watched = it->second.watched;
+        }
+    }
+
+    if (cached && !watched) {
+        // 没有inotify监听，通过stat确认文件未修改
+        // Without an inotify watch, make sure the file is unmodified by stat
+        uint64_t size, mtime;
+        if (!statFile(path, size, mtime) || size != cached->size || mtime != cached->mtime) {
+            invalidate(path);
+            cached = nullptr;
+        }
+    }
+
+    if (cached) {
+        lock_guard<mutex> lck(_mtx);
+        auto it = _entries.find(path);
+        if (it != _entries.end()) {
+            _lru.splice(_lru.begin(), _lru, it->second.lru);
+        }
+        ++_statistic.hits;
+        return cached;
+    }
+
+    auto item = makeItem(path);
+    if (!item || item->size > maxFileSizeKB * 1024 || item->size > capacity) {
+        return item;
+    }
+
+    // 先添加目录监听再读取文件，防止读取后的修改被遗漏
+    // Add the directory watch before reading the file, so that modifications after reading are not missed
+    auto dir = dirName(path);
+    uint64_t generation = 0;
+    {
+        lock_guard<mutex> lck(_mtx);
+        ++_statistic.misses;
+        watched = watch(dir);
+        if (watched) {
+            generation = _watches[dir].generation;
+        }
+    }
+    auto data = loadFile(path, item->size);
+    uint64_t size, mtime;
+    if (!data || !statFile(path, size, mtime) || size != item->size || mtime != item->mtime) {
+        // 读取期间文件被修改
+        // The file was modified while reading
+        lock_guard<mutex> lck(_mtx);
+        if (watched) {
+            unwatch(dir);
+        }
+        return item;
+    }
+
+    auto cached_item = std::make_shared<Item>(*item);
+    cached_item->data = std::move(data);
+    lock_guard<mutex> lck(_mtx);
+    if (watched) {
+        // 读取后的stat与插入之间到达的事件已被处理(此时没有缓存项可失效)，目录的监听序号变化时放弃插入
+        // An event that arrives between the stat after reading and the insert has already been handled
+        // (with no entry to invalidate), so give up the insert if the sequence number of the directory watch changed
+        auto it = _watches.find(dir);
+        if (it == _watches.end() || it->second.generation != generation) {
+            unwatch(dir);
+            return item;
+        }
+    }
+    erase(path);
+    Entry &entry = _entries[path];
+    entry.item = cached_item;
+    entry.dir = std::move(dir);
+    entry.watched = watched;
+    _lru.emplace_front(path);
+    entry.lru = _lru.begin();
+    _bytes += cached_item->size;
+    evict(capacity);
+    return cached_item;
+}
+
+void HttpFileCache::invalidate(const string &path) {
+    lock_guard<mutex> lck(_mtx);
+    if (_entries.find(path) != _entries.end()) {
+        ++_statistic.invalidations;
+        erase(path);
+    }
+}
+
+void HttpFileCache::onNotModified() {
+    lock_guard<mutex> lck(_mtx);
+    ++_statistic.not_modified;
+}
+
+HttpFileCache::Statistic HttpFileCache::getStatistic() {
+    GET_CONFIG(size_t, cacheSizeMB, Http::kFileCacheSize);
+    lock_guard<mutex> lck(_mtx);
+    auto ret = _statistic;
+    ret.items = _entries.size();
+    ret.bytes = _bytes;
+    ret.capacity = cacheSizeMB * 1024 * 1024;
+    return ret;
+}
+
+void HttpFileCache::evict(size_t capacity) {
+    while (_bytes > capacity && !_lru.empty()) {
+        ++_statistic.evictions;
+        erase(_lru.back());
+    }
+}
+
+void HttpFileCache::erase(const string &path) {
+    auto it = _entries.find(path);
+    if (it == _entries.end()) {
+        return;
+    }
+    _bytes -= it->second.item->size;
+    _lru.erase(it->second.lru);
+    if (it->second.watched) {
+        unwatch(it->second.dir);
+    }
+    _entries.erase(it);
+}
+
+bool HttpFileCache::watch(const string &dir) {
+#if defined(__linux__) || defined(__linux)
+    auto it = _watches.find(dir);
+    if (it != _watches.end()) {
+        ++it->second.ref;
+        return true;
+    }
+    if (_inotify_fd == -1) {
+        _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify_fd == -1) {
+            WarnL << "inotify_init1 failed, http file cache falls back to stat:" << get_uv_errmsg(false);
+            return false;
+        }
+        weak_ptr<HttpFileCache> weak_self = shared_from_this();
+        EventPollerPool::Instance().getPoller()->addEvent(_inotify_fd, EventPoller::Event_Read, [weak_self](int event) {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->onInotifyEvent();
+            }
+        });
+    }
+    auto wd = inotify_add_watch(_inotify_fd, dir.data(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if (wd == -1) {
+        // 可能是达到了max_user_watches限制，退化为stat校验
+        // Probably max_user_watches is reached, fall back to stat validation
+        WarnL << "inotify_add_watch " << dir << " failed:" << get_uv_errmsg(false);
+        return false;
+    }
+    auto &w = _watches[dir];
+    w.wd = wd;
+    w.ref = 1;
+    w.generation = ++_generation;
+    _watch_dirs[wd] = dir;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HttpFileCache::unwatch(const string &dir) {
+#if defined(__linux__) || defined(__linux)
+    auto it = _watches.find(dir);
+    if (it == _watches.end() || --it->second.ref) {
+        return;
+    }
+    inotify_rm_watch(_inotify_fd, it->second.wd);
+    _watch_dirs.erase(it->second.wd);
+    _watches.erase(it);
+#endif
+}
+
+void HttpFileCache::onInotifyEvent() {
+#if defined(__linux__) || defined(__linux)
+    char buf[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        auto len = read(_inotify_fd, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+        lock_guard<mutex> lck(_mtx);
+        for (char *ptr = buf; ptr < buf + len;) {
+            auto event = (struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 事件丢失，清空缓存
+                // Events were lost, clear the cache
+                for (auto &pr : _watches) {
+                    pr.second.generation = ++_generation;
+                }
+                _statistic.invalidations += _entries.size();
+                while (!_lru.empty()) {
+                    erase(_lru.back());
+                }
+                continue;
+            }
+            auto it = _watch_dirs.find(event->wd);
+            if (it == _watch_dirs.end()) {
+                continue;
+            }
+            auto dir = it->second;
+            auto w = _watches.find(dir);
+            if (w != _watches.end()) {
+                w->second.generation = ++_generation;
+            }
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // 目录本身被删除或移动，该目录下的缓存全部失效
+                // The directory itself was deleted or moved, all entries under it are invalidated
+                if (event->mask & IN_IGNORED) {
+                    _watches.erase(dir);
+                    _watch_dirs.erase(event->wd);
+                }
+                for (auto entry = _entries.begin(); entry != _entries.end();) {
+                    auto cur = entry++;
+                    if (cur->second.dir == dir) {
+                        ++_statistic.invalidations;
+                        erase(cur->first);
+                    }
+                }
+                continue;
+            }
+            if (event->len) {
+                auto path = dir + "/" + event->name;
+                if (_entries.find(path) != _entries.end()) {
+                    ++_statistic.invalidations;
+                    erase(path);
+                }
+            }
+        }
+    }
+#endif
+}
+
+} // namespace mediakit
@@ -0,0 +1,130 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_HTTPFILECACHE_H
+#define ZLMEDIAKIT_HTTPFILECACHE_H
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "Network/Buffer.h"
+
+namespace mediakit {
+
+/**
+ * http小文件内存缓存
+ * 按路径+修改时间缓存文件内容以及预先生成的Content-Type/ETag/Last-Modified头，按lru淘汰，总大小受http.fileCacheSize限制
+ * linux下通过inotify监听文件所在目录，文件变更后立即失效，命中时无需stat；其他平台命中时通过stat校验
+ * Http small file memory cache
+ * Caches file contents and the pre-generated Content-Type/ETag/Last-Modified headers by path + modification time,
+ * evicted in lru order, the total size is limited by http.fileCacheSize.
+ * On linux the directory of the file is watched by inotify so that the entry is invalidated as soon as the file changes,
+ * and hits need no stat; on other platforms hits are validated by stat.
+ */
+class HttpFileCache : public std::enable_shared_from_this<HttpFileCache> {
+public:
+    class Item {
+    public:
+        using Ptr = std::shared_ptr<const Item>;
+        std::string path;
+        uint64_t size = 0;
+        // 修改时间，单位纳秒
+        // Modification time in nanoseconds
+        uint64_t mtime = 0;
+        std::string content_type;
+        std::string etag;
+        std::string last_modified;
+        // 文件内容，未缓存时为空
+        // File content, null when not cached
+        toolkit::Buffer::Ptr data;
+    };
+
+    struct Statistic {
+        size_t items = 0;
+        size_t bytes = 0;
+        size_t capacity = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t not_modified = 0;
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+    };
+
+    ~HttpFileCache();
+    static HttpFileCache &Instance();
+
+    /**
+     * 获取文件信息
+     * @param path 文件路径
+     * @param use_cache 是否允许缓存文件内容，为false时只获取文件信息
+     * @return 文件不存在或为目录时返回nullptr
+     * Get file information
+     * @param path file path
+     * @param use_cache whether the file content can be cached, only the file information is got when false
+     * @return nullptr if the file does not exist or is a directory
+     */
+    Item::Ptr get(const std::string &path, bool use_cache);
+
+    /**
+     * 使缓存失效
+     * Invalidate a cache entry
+     */
+    void invalidate(const std::string &path);
+
+    /**
+     * 记录一次304回复
+     * Record a 304 response
+     */
+    void onNotModified();
+
+    Statistic getStatistic();
+
+private:
+    HttpFileCache() = default;
+    Item::Ptr makeItem(const std::string &path);
+    void evict(size_t capacity);
+    void erase(const std::string &path);
+    bool watch(const std::string &dir);
+    void unwatch(const std::string &dir);
+    void onInotifyEvent();
+
+private:
+    struct Entry {
+        Item::Ptr item;
+        std::string dir;
+        bool watched = false;
+        std::list<std::string>::iterator lru;
+    };
+    struct Watch {
+        int wd = -1;
+        size_t ref = 0;
+        // 监听创建或最近一次收到事件时的序号，用于发现读取文件期间发生的修改
+        // Sequence number at which the watch was created or last received an event,
+        // used to detect modifications made while a file is being read
+        uint64_t generation = 0;
+    };
+
+    std::mutex _mtx;
+    size_t _bytes = 0;
+    Statistic _statistic;
+    int _inotify_fd = -1;
+    uint64_t _generation = 0;
+    // 最近访问的在前
+    // Most recently used first
+    std::list<std::string> _lru;
+    std::unordered_map<std::string, Entry> _entries;
+    std::unordered_map<std::string, Watch> _watches;
+    std::unordered_map<int, std::string> _watch_dirs;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_HTTPFILECACHE_H
@@ -14,8 +14,13 @@
 #include "Common/config.h"
 #include "Common/strCoding.h"
 #include "Record/HlsMediaSource.h"
+#include "Record/HlsMakerImp.h"
+#include "Record/MP4HlsPackager.h"
+#include "Thread/WorkThreadPool.h"
 #include "HttpConst.h"
 #include "HttpSession.h"
+#include "HttpFileCache.h"
+#include "HttpCompressor.h"
 #include "HttpFileManager.h"
 
 using namespace std;
@@ -468,6 +473,41 @@ static string pathCat(const string &a, const string &b){
     return a + '/' + b;
 }
 
+#if defined(ENABLE_MP4) && defined(ENABLE_HLS)
+/**
+ * 以hls方式点播mp4录像，m3u8与ts切片在后台线程按需生成
+ * Vod of an mp4 recording as hls, the m3u8 and ts segments are generated on demand in a background thread
+ */
+static void accessMP4Hls(Session &sender, const Parser &parser, const MediaInfo &media_info, const string &mp4_file, const string &resource,
+                         const HttpFileManager::invoker &cb) {
+    weak_ptr<Session> weakSession = static_pointer_cast<Session>(sender.shared_from_this());
+    canAccessPath(sender, parser, media_info, false, [cb, mp4_file, resource, weakSession](const string &err_msg, const HttpServerCookie::Ptr &cookie) {
+        if (!weakSession.lock()) {
+            return;
+        }
+        StrCaseMap headerOut;
+        if (cookie) {
+            headerOut["Set-Cookie"] = cookie->getCookie(cookie->getAttach<HttpCookieAttachment>()._path);
+        }
+        if (!err_msg.empty()) {
+            cb(401, "text/html", headerOut, std::make_shared<HttpStringBody>(err_msg));
+            return;
+        }
+        WorkThreadPool::Instance().getExecutor()->async([cb, mp4_file, resource, headerOut]() mutable {
+            string content;
+            if (!MP4HlsPackager::make(mp4_file, resource, content)) {
+                sendNotFound(cb);
+                return;
+            }
+            // 录像文件不再变化，生成的内容可以被cdn与浏览器缓存
+            // Recordings no longer change, so the generated content can be cached by cdn and browsers
+            headerOut["Cache-Control"] = "public, max-age=86400";
+            cb(200, HttpFileManager::getContentType(resource.data()), headerOut, std::make_shared<HttpStringBody>(std::move(content)));
+        });
+    });
+}
+#endif
+
 /**
  * 访问文件
  * @param sender 事件触发者
@@ -486,6 +526,13 @@ static string pathCat(const string &a, const string &b){
  */
 static void accessFile(Session &sender, const Parser &parser, const MediaInfo &media_info, const string &file_path, const HttpFileManager::invoker &cb) {
     bool is_hls = end_with(file_path, kHlsSuffix) || end_with(file_path, kHlsFMP4Suffix);
+#if defined(ENABLE_MP4) && defined(ENABLE_HLS)
+    string mp4_file, resource;
+    if (!is_hls && MP4HlsPackager::parsePath(file_path, mp4_file, resource)) {
+        accessMP4Hls(sender, parser, media_info, mp4_file, resource, cb);
+        return;
+    }
+#endif
     if (!is_hls && !File::fileExist(file_path)) {
         // 文件不存在且不是hls,那么直接返回404  [AUTO-TRANSLATED:7aae578b]
         // The file does not exist and is not hls, so directly return 404
@@ -549,7 +596,11 @@ static void accessFile(Session &sender, const Parser &parser, const MediaInfo &m
                     break;
                 }
             }
-            invoker.responseFile(parser.getHeader(), httpHeader, file_content.empty() ? file_path : file_content, !is_hls && !is_forbid_cache, file_content.empty());
+            // hls归档文件持续增长且按range访问，不使用mmap与内存缓存，按range从文件读取后发送
+            // Hls archive files keep growing and are accessed by range, so the range is read from the file and sent
+            // without mmap or memory cache
+            auto use_mmap = !is_hls && !is_forbid_cache && !HlsMakerImp::isArchiveFile(file_path);
+            invoker.responseFile(parser.getHeader(), httpHeader, file_content.empty() ? file_path : file_content, use_mmap, file_content.empty());
         };
 
         if (!is_hls || !cookie) {
@@ -768,45 +819,121 @@ void HttpResponseInvokerImp::responseFile(const StrCaseMap &requestHeader,
     // file is the file path
     GET_CONFIG(string, charSet, Http::kCharSet);
     StrCaseMap &httpHeader = const_cast<StrCaseMap &>(responseHeader);
-    auto fileBody = std::make_shared<HttpFileBody>(file, use_mmap);
-    if (fileBody->remainSize() < 0) {
-        // 打开文件失败  [AUTO-TRANSLATED:1f0405cb]
-        // Failed to open file
+    StrCaseMap &headerIn = const_cast<StrCaseMap &>(requestHeader);
+    auto sendNotFound = [&]() {
         GET_CONFIG(string, notFound, Http::kNotFound);
-
         auto strContentType = StrPrinter << "text/html; charset=" << charSet << endl;
         httpHeader["Content-Type"] = strContentType;
         (*this)(404, httpHeader, notFound);
+    };
+    // 小文件从内存缓存读取，同时获取预先生成的回复头
+    // Small files are read from the memory cache, together with the pre-generated response headers
+    auto item = HttpFileCache::Instance().get(file, use_mmap);
+    if (!item) {
+        // 打开文件失败  [AUTO-TRANSLATED:1f0405cb]
+        // Failed to open file
+        sendNotFound();
+        return;
+    }
+
+    // 非range请求优先回复预压缩的.br/.gz文件，预压缩文件早于原文件时视为过期
+    // 只有文本类文件才查找预压缩文件，ts/mp4等切片不额外stat
+    // Non-range requests prefer the precompressed .br/.gz files, which are considered stale if older than the original file,
+    // only text files look for precompressed files, so ts/mp4 segments etc. do not cost extra stat calls
+    auto origin = item;
+    auto file_path = file;
+    auto &strRange = headerIn["Range"];
+    if (strRange.empty() && HttpCompressor::isCompressible(HttpFileManager::getContentType(file.data()))) {
+        for (auto &pr : HttpCompressor::precompressedSuffixes(headerIn["Accept-Encoding"])) {
+            auto compressed = HttpFileCache::Instance().get(file + pr.first, use_mmap);
+            if (compressed && compressed->mtime >= origin->mtime) {
+                item = compressed;
+                file_path = file + pr.first;
+                httpHeader.emplace("Content-Encoding", pr.second);
+                httpHeader.emplace("Vary", "Accept-Encoding");
+                break;
+            }
+        }
+    }
+
+    // 预压缩文件使用其自身的ETag，以便与未压缩的回复区分
+    // The precompressed file uses its own ETag to distinguish it from the uncompressed response
+    httpHeader.emplace("ETag", item->etag);
+    httpHeader.emplace("Last-Modified", origin->last_modified);
+
+    // 条件请求，文件未修改时回复304
+    // Conditional request, reply 304 if the file is not modified
+    auto &if_none_match = headerIn["If-None-Match"];
+    auto &if_modified_since = headerIn["If-Modified-Since"];
+    bool not_modified = false;
+    if (!if_none_match.empty()) {
+        not_modified = if_none_match.find(item->etag) != string::npos || if_none_match == "*";
+    } else if (!if_modified_since.empty()) {
+        not_modified = if_modified_since == origin->last_modified;
+    }
+    if (not_modified) {
+        HttpFileCache::Instance().onNotModified();
+        (*this)(304, httpHeader, HttpBody::Ptr());
         return;
     }
 
+    HttpBody::Ptr body;
+    HttpFileBody::Ptr fileBody;
+    if (!item->data) {
+        fileBody = std::make_shared<HttpFileBody>(file_path, use_mmap);
+        if (fileBody->remainSize() < 0) {
+            sendNotFound();
+            return;
+        }
+    }
+    auto fileSize = fileBody ? fileBody->remainSize() : (int64_t)item->data->size();
+
     // 尝试添加Content-Type  [AUTO-TRANSLATED:2c08b371]
     // Try to add Content-Type
-    httpHeader.emplace("Content-Type", HttpConst::getHttpContentType(file.data()) + "; charset=" + charSet);
+    httpHeader.emplace("Content-Type", origin->content_type);
 
-    auto &strRange = const_cast<StrCaseMap &>(requestHeader)["Range"];
+    auto &ifRange = headerIn["If-Range"];
     int code = 200;
-    if (!strRange.empty()) {
+    if (!strRange.empty() && (ifRange.empty() || ifRange == item->etag || ifRange == item->last_modified)) {
         // 分节下载  [AUTO-TRANSLATED:01920230]
         // Segmented download
         code = 206;
         auto iRangeStart = atoll(findSubString(strRange.data(), "bytes=", "-").data());
         auto iRangeEnd = atoll(findSubString(strRange.data(), "-", nullptr).data());
-        auto fileSize = fileBody->remainSize();
         if (iRangeEnd == 0) {
             iRangeEnd = fileSize - 1;
         }
+        if (iRangeStart < 0 || iRangeStart > iRangeEnd || iRangeEnd >= fileSize) {
+            // 范围非法
+            // Invalid range
+            httpHeader.erase("Content-Type");
+            httpHeader.emplace("Content-Range", StrPrinter << "bytes */" << fileSize << endl);
+            (*this)(416, httpHeader, HttpBody::Ptr());
+            return;
+        }
         // 设置文件范围  [AUTO-TRANSLATED:aa51fd28]
         // Set file range
-        fileBody->setRange(iRangeStart, iRangeEnd - iRangeStart + 1);
+        if (fileBody) {
+            fileBody->setRange(iRangeStart, iRangeEnd - iRangeStart + 1);
+        } else {
+            body = std::make_shared<HttpBufferBody>(std::make_shared<BufferOffset<Buffer::Ptr>>(item->data, iRangeStart, iRangeEnd - iRangeStart + 1));
+        }
         // 分节下载返回Content-Range头  [AUTO-TRANSLATED:4b78e7b6]
         // Segmented download returns Content-Range header
         httpHeader.emplace("Content-Range", StrPrinter << "bytes " << iRangeStart << "-" << iRangeEnd << "/" << fileSize << endl);
     }
+    if (fileBody) {
+        body = fileBody;
+    } else if (!body) {
+        body = std::make_shared<HttpBufferBody>(item->data);
+    }
+    if (item != origin) {
+        HttpCompressor::onPrecompressed(origin->size, item->size);
+    }
 
     // 回复文件  [AUTO-TRANSLATED:5d91a916]
     // Reply file
-    (*this)(code, httpHeader, fileBody);
+    (*this)(code, httpHeader, body);
 }
 
 HttpResponseInvokerImp::operator bool(){
@@ -15,6 +15,7 @@
 #include "Common/strCoding.h"
 #include "HttpSession.h"
 #include "HttpConst.h"
+#include "HttpCompressor.h"
 #include "Util/base64.h"
 #include "Util/SHA1.h"
 
@@ -55,9 +56,8 @@ void HttpSession::onHttpRequest_OPTIONS() {
     sendResponse(200, true, nullptr, header);
 }
 
-ssize_t HttpSession::onRecvHeader(const char *header, size_t len) {
-    using func_type = void (HttpSession::*)();
-    static unordered_map<string, func_type> s_func_map;
+const unordered_map<string, HttpSession::HttpRequestHandler> &HttpSession::getRequestHandlers() {
+    static unordered_map<string, HttpRequestHandler> s_func_map;
     static onceToken token([]() {
         s_func_map.emplace("GET", &HttpSession::onHttpRequest_GET);
         s_func_map.emplace("POST", &HttpSession::onHttpRequest_POST);
@@ -67,10 +67,25 @@ ssize_t HttpSession::onRecvHeader(const char *header, size_t len) {
         s_func_map.emplace("HEAD", &HttpSession::onHttpRequest_HEAD);
         s_func_map.emplace("OPTIONS", &HttpSession::onHttpRequest_OPTIONS);
     });
+    return s_func_map;
+}
+
+ssize_t HttpSession::onRecvHeader(const char *header, size_t len) {
+    auto &s_func_map = getRequestHandlers();
 
     _parser.parse(header, len);
+    if (checkHttp2Preface()) {
+        // 后续都是http/2数据
+        // The following are all http/2 data
+        return -1;
+    }
     CHECK(_parser.url()[0] == '/');
     _origin = _parser["Origin"];
+    _support_chunked = _parser.protocol() != "HTTP/1.0";
+
+    if (checkHttp2Upgrade()) {
+        return 0;
+    }
 
     urlDecode(_parser);
     auto &cmd = _parser.method();
@@ -169,19 +184,23 @@ void HttpSession::onRecv(const Buffer::Ptr &pBuf) {
 
 void HttpSession::onError(const SockException &err) {
     if (_is_live_stream) {
-        // flv/ts播放器  [AUTO-TRANSLATED:5b444fd9]
-        // flv/ts player
-        uint64_t duration = _ticker.createdTime() / 1000;
-        WarnP(this) << "FLV/TS/FMP4播放器(" << _media_info.shortUrl() << ")断开:" << err << ",耗时(s):" << duration;
-
-        GET_CONFIG(uint32_t, iFlowThreshold, General::kFlowThreshold);
-        if (_total_bytes_usage >= iFlowThreshold * 1024) {
-            NOTICE_EMIT(BroadcastFlowReportArgs, Broadcast::kBroadcastFlowReport, _media_info, _total_bytes_usage, duration, true, *this);
-        }
+        reportLiveStreamFlow(err);
         return;
     }
 }
 
+void HttpSession::reportLiveStreamFlow(const SockException &err) {
+    // flv/ts播放器  [AUTO-TRANSLATED:5b444fd9]
+    // flv/ts player
+    uint64_t duration = _ticker.createdTime() / 1000;
+    WarnP(this) << "FLV/TS/FMP4播放器(" << _media_info.shortUrl() << ")断开:" << err << ",耗时(s):" << duration;
+
+    GET_CONFIG(uint32_t, iFlowThreshold, General::kFlowThreshold);
+    if (_total_bytes_usage >= iFlowThreshold * 1024) {
+        NOTICE_EMIT(BroadcastFlowReportArgs, Broadcast::kBroadcastFlowReport, _media_info, _total_bytes_usage, duration, true, *this);
+    }
+}
+
 void HttpSession::setTimeoutSec(size_t keep_alive_sec) {
     if (!keep_alive_sec) {
         GET_CONFIG(size_t, s_keep_alive_sec, Http::kKeepAliveSecond);
@@ -313,11 +332,12 @@ bool HttpSession::checkLiveStream(const string &schema, const string &url_suffix
     }
 
     bool close_flag = !strcasecmp(_parser["Connection"].data(), "close");
+    auto stream_id = _h2_stream_id;
     weak_ptr<HttpSession> weak_self = static_pointer_cast<HttpSession>(shared_from_this());
 
     // 鉴权结果回调  [AUTO-TRANSLATED:021df191]
     // Authentication result callback
-    auto onRes = [cb, weak_self, close_flag](const string &err) {
+    auto onRes = [cb, weak_self, close_flag, stream_id](const string &err) {
         auto strong_self = weak_self.lock();
         if (!strong_self) {
             // 本对象已经销毁  [AUTO-TRANSLATED:713e0f23]
@@ -325,6 +345,7 @@ bool HttpSession::checkLiveStream(const string &schema, const string &url_suffix
             return;
         }
 
+        strong_self->_h2_stream_id = stream_id;
         if (!err.empty()) {
             // 播放鉴权失败  [AUTO-TRANSLATED:64f99eeb]
             // Playback authentication failed
@@ -334,19 +355,25 @@ bool HttpSession::checkLiveStream(const string &schema, const string &url_suffix
 
         // 异步查找直播流  [AUTO-TRANSLATED:7cde5dac]
         // Asynchronously find live stream
-        MediaSource::findAsync(strong_self->_media_info, strong_self, [weak_self, close_flag, cb](const MediaSource::Ptr &src) {
+        MediaSource::findAsync(strong_self->_media_info, strong_self, [weak_self, close_flag, cb, stream_id](const MediaSource::Ptr &src) {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 // 本对象已经销毁  [AUTO-TRANSLATED:713e0f23]
                 // This object has been destroyed
                 return;
             }
+            strong_self->_h2_stream_id = stream_id;
             if (!src) {
                 // 未找到该流  [AUTO-TRANSLATED:2699ef82]
                 // Stream not found
                 strong_self->sendNotFound(close_flag);
+            } else if (strong_self->_is_live_stream) {
+                // http/2连接上同时只能播放一路直播
+                // Only one live stream can be played at a time on a http/2 connection
+                strong_self->sendResponse(503, close_flag, nullptr, KeyValue(), std::make_shared<HttpStringBody>("only one live stream per connection"));
             } else {
                 strong_self->_is_live_stream = true;
+                strong_self->_h2_live_stream_id = stream_id;
                 // 触发回调  [AUTO-TRANSLATED:ae2ff258]
                 // Trigger callback
                 cb(src);
@@ -404,7 +431,7 @@ bool HttpSession::checkLiveStreamFMP4(const function<void()> &cb) {
                 // This object has been destroyed
                 return;
             }
-            strong_self->shutdown(SockException(Err_shutdown, "fmp4 ring buffer detached"));
+            strong_self->shutdownLiveStream(SockException(Err_shutdown, "fmp4 ring buffer detached"));
         });
         _fmp4_reader->setReadCB([weak_self](const FMP4MediaSource::RingDataType &fmp4_list) {
             auto strong_self = weak_self.lock();
@@ -454,7 +481,7 @@ bool HttpSession::checkLiveStreamTS(const function<void()> &cb) {
                 // This object has been destroyed
                 return;
             }
-            strong_self->shutdown(SockException(Err_shutdown, "ts ring buffer detached"));
+            strong_self->shutdownLiveStream(SockException(Err_shutdown, "ts ring buffer detached"));
         });
         _ts_reader->setReadCB([weak_self](const TSMediaSource::RingDataType &ts_list) {
             auto strong_self = weak_self.lock();
@@ -513,7 +540,7 @@ bool HttpSession::checkLiveStreamFlv(const function<void()> &cb) {
 void HttpSession::onHttpRequest_GET() {
     // 先看看是否为WebSocket请求  [AUTO-TRANSLATED:98cd3a86]
     // First check if it is a WebSocket request
-    if (checkWebSocket()) {
+    if (!isHttp2() && checkWebSocket()) {
         // 后续都是websocket body数据  [AUTO-TRANSLATED:c4fcbdcf]
         // The following are all websocket body data
         _on_recv_body = [this](const char *data, size_t len) {
@@ -550,18 +577,20 @@ void HttpSession::onHttpRequest_GET() {
     }
 
     bool bClose = !strcasecmp(_parser["Connection"].data(), "close");
+    auto stream_id = _h2_stream_id;
     weak_ptr<HttpSession> weak_self = static_pointer_cast<HttpSession>(shared_from_this());
-    HttpFileManager::onAccessPath(*this, _parser, [weak_self, bClose](int code, const string &content_type,
-                                                                      const StrCaseMap &responseHeader, const HttpBody::Ptr &body) {
+    HttpFileManager::onAccessPath(*this, _parser, [weak_self, bClose, stream_id](int code, const string &content_type,
+                                                                                 const StrCaseMap &responseHeader, const HttpBody::Ptr &body) {
         auto strong_self = weak_self.lock();
         if (!strong_self) {
             return;
         }
-        strong_self->async([weak_self, bClose, code, content_type, responseHeader, body]() {
+        strong_self->async([weak_self, bClose, stream_id, code, content_type, responseHeader, body]() {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 return;
             }
+            strong_self->_h2_stream_id = stream_id;
             strong_self->sendResponse(code, bClose, content_type.data(), responseHeader, body);
         });
     });
@@ -671,9 +700,12 @@ void HttpSession::sendResponse(int code,
         size = body->remainSize();
     }
 
-    if (no_content_length) {
+    bool chunked = !no_content_length && size < 0 && _support_chunked && !isHttp2();
+    if (no_content_length || chunked) {
         // http-flv直播是Keep-Alive类型  [AUTO-TRANSLATED:0ef3adfe]
         // Http-flv live broadcast is Keep-Alive type
+        // 长度不固定的body使用chunked编码，发送完毕后无需关闭连接
+        // A body of unknown length uses chunked encoding, so the connection need not be closed after sending
         bClose = false;
     } else if ((size_t)size >= SIZE_MAX || size < 0) {
         // 不固定长度的body，那么发送完body后应该关闭socket，以便浏览器做下载完毕的判断  [AUTO-TRANSLATED:fc714997]
@@ -699,10 +731,12 @@ void HttpSession::sendResponse(int code,
         headerOut.emplace("Keep-Alive", std::move(keepAliveString));
     }
 
-    if (!no_content_length && size >= 0 && (size_t)size < SIZE_MAX) {
+    if (!no_content_length && code != 304 && size >= 0 && (size_t)size < SIZE_MAX) {
         // 文件长度为固定值,且不是http-flv强制设置Content-Length  [AUTO-TRANSLATED:185c02a8]
         // The file length is a fixed value, and it is not http-flv that forcibly sets Content-Length
         headerOut["Content-Length"] = to_string(size);
+    } else if (chunked) {
+        headerOut["Transfer-Encoding"] = "chunked";
     }
 
     if (size && !pcContentType) {
@@ -720,6 +754,11 @@ void HttpSession::sendResponse(int code,
         headerOut.emplace("Content-Type", std::move(strContentType));
     }
 
+    if (isHttp2()) {
+        sendHttp2Response(code, headerOut, body, no_content_length);
+        return;
+    }
+
     // 发送http头  [AUTO-TRANSLATED:cca51598]
     // Send http header
     string str;
@@ -767,7 +806,8 @@ void HttpSession::sendResponse(int code,
 
     // 发送http body  [AUTO-TRANSLATED:e9fc35d6]
     // Send http body
-    AsyncSenderData::Ptr data = std::make_shared<AsyncSenderData>(static_pointer_cast<HttpSession>(shared_from_this()), body, bClose);
+    AsyncSenderData::Ptr data = std::make_shared<AsyncSenderData>(static_pointer_cast<HttpSession>(shared_from_this()),
+                                                                  chunked ? std::make_shared<HttpChunkedBody>(body) : body, bClose);
     getSock()->setOnFlush([data]() { return AsyncSender::onSocketFlushed(data); });
     AsyncSender::onSocketFlushed(data);
 }
@@ -781,22 +821,29 @@ void HttpSession::urlDecode(Parser &parser) {
 
 bool HttpSession::emitHttpEvent(bool doInvoke) {
     bool bClose = !strcasecmp(_parser["Connection"].data(), "close");
+    auto stream_id = _h2_stream_id;
+    auto accept_encoding = _parser["Accept-Encoding"];
     // ///////////////////异步回复Invoker///////////////////////////////  [AUTO-TRANSLATED:6d0c5fda]
     // ///////////////////Asynchronous reply Invoker///////////////////////////////
     weak_ptr<HttpSession> weak_self = static_pointer_cast<HttpSession>(shared_from_this());
-    HttpResponseInvoker invoker = [weak_self, bClose](int code, const KeyValue &headerOut, const HttpBody::Ptr &body) {
+    HttpResponseInvoker invoker = [weak_self, bClose, stream_id, accept_encoding](int code, const KeyValue &headerOut, const HttpBody::Ptr &body) {
         auto strong_self = weak_self.lock();
         if (!strong_self) {
             return;
         }
-        strong_self->async([weak_self, bClose, code, headerOut, body]() {
+        strong_self->async([weak_self, bClose, stream_id, accept_encoding, code, headerOut, body]() {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 // 本对象已经销毁  [AUTO-TRANSLATED:713e0f23]
                 // This object has been destroyed
                 return;
             }
-            strong_self->sendResponse(code, bClose, nullptr, headerOut, body);
+            strong_self->_h2_stream_id = stream_id;
+            // 按Accept-Encoding压缩api回复
+            // Compress the api response according to Accept-Encoding
+            auto header = headerOut;
+            auto compressed = HttpCompressor::compress(accept_encoding, header, body);
+            strong_self->sendResponse(code, bClose, nullptr, header, compressed);
         });
     };
     // /////////////////广播HTTP事件///////////////////////////  [AUTO-TRANSLATED:fff9769c]
@@ -848,7 +895,10 @@ void HttpSession::onWrite(const Buffer::Ptr &buffer, bool flush) {
     }
 
     _ticker.resetTime();
-    if (!_live_over_websocket) {
+    if (_h2_live_stream_id) {
+        _total_bytes_usage += buffer->size();
+        sendHttp2Data(_h2_live_stream_id, buffer, false);
+    } else if (!_live_over_websocket) {
         _total_bytes_usage += buffer->size();
         send(buffer);
     } else {
@@ -867,6 +917,22 @@ void HttpSession::onWrite(const Buffer::Ptr &buffer, bool flush) {
     }
 }
 
+void HttpSession::onWriteRaw(const Buffer::Ptr &buffer, bool flush) {
+    if (flush) {
+        HttpSession::setSendFlushFlag(true);
+    }
+    _ticker.resetTime();
+    _total_bytes_usage += buffer->size();
+    if (_h2_live_stream_id) {
+        sendHttp2Data(_h2_live_stream_id, buffer, false);
+    } else {
+        send(buffer);
+    }
+    if (flush) {
+        HttpSession::setSendFlushFlag(false);
+    }
+}
+
 void HttpSession::onWebSocketEncodeData(Buffer::Ptr buffer) {
     _total_bytes_usage += buffer->size();
     send(std::move(buffer));
@@ -888,11 +954,209 @@ void HttpSession::onWebSocketDecodeComplete(const WebSocketHeader &header_in) {
 }
 
 void HttpSession::onDetach() {
-    shutdown(SockException(Err_shutdown, "rtmp ring buffer detached"));
+    shutdownLiveStream(SockException(Err_shutdown, "rtmp ring buffer detached"));
 }
 
 std::shared_ptr<FlvMuxer> HttpSession::getSharedPtr() {
     return dynamic_pointer_cast<FlvMuxer>(shared_from_this());
 }
 
+void HttpSession::shutdownLiveStream(const SockException &ex) {
+    if (!isHttp2()) {
+        shutdown(ex);
+        return;
+    }
+    if (!_is_live_stream) {
+        return;
+    }
+    // http/2下只结束直播所在的流，连接上的其他请求不受影响
+    // Under http/2 only the stream carrying the live stream is finished, other requests on the connection are not affected
+    reportLiveStreamFlow(ex);
+    auto stream_id = _h2_live_stream_id;
+    _is_live_stream = false;
+    _h2_live_stream_id = 0;
+    _total_bytes_usage = 0;
+    _ts_reader = nullptr;
+    _fmp4_reader = nullptr;
+    FlvMuxer::stop();
+    sendHttp2Data(stream_id, nullptr, true);
+}
+
+bool HttpSession::checkHttp2Preface() {
+    // http/2客户端连接序言的前半部分会被当做http/1.1请求头解析出来
+    // The first half of the http/2 client connection preface is parsed as an http/1.1 request header
+    if (_parser.method() != "PRI" || _parser.url() != "*" || _parser.protocol() != "HTTP/2.0") {
+        return false;
+    }
+    GET_CONFIG(bool, enable_http2, Http::kEnableHttp2);
+    if (!enable_http2) {
+        return false;
+    }
+    if (!isHttp2()) {
+        // h2c prior knowledge
+        startHttp2Session();
+    }
+    static const string s_preface_head = "PRI * HTTP/2.0\r\n\r\n";
+    inputHttp2(s_preface_head.data(), s_preface_head.size());
+    _on_recv_body = [this](const char *data, size_t len) {
+        inputHttp2(data, len);
+        return true;
+    };
+    _parser.clear();
+    return true;
+}
+
+bool HttpSession::checkHttp2Upgrade() {
+    GET_CONFIG(bool, enable_http2, Http::kEnableHttp2);
+    if (!enable_http2 || isHttp2() || strcasecmp(_parser["Upgrade"].data(), "h2c")) {
+        return false;
+    }
+    auto &settings = _parser["HTTP2-Settings"];
+    auto &content_len = _parser["Content-Length"];
+    if (settings.empty() || (!content_len.empty() && content_len != "0")) {
+        // 带body的请求不升级，按http/1.1处理(rfc7540 3.2)
+        // Requests with a body are not upgraded and are handled as http/1.1 (rfc7540 3.2)
+        return false;
+    }
+    SockSender::send("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    startHttp2Session();
+    if (!upgradeHttp2(settings)) {
+        shutdown(SockException(Err_shutdown, "invalid HTTP2-Settings header"));
+        return true;
+    }
+    // 升级前的请求在stream 1上回复
+    // The request before the upgrade is answered on stream 1
+    Parser parser = std::move(_parser);
+    _parser.clear();
+    onHttp2Request(1, parser);
+    return true;
+}
+
+void HttpSession::startHttp2Session() {
+    GET_CONFIG(uint32_t, max_streams, Http::kHttp2MaxStreams);
+    startHttp2(max_streams, _max_req_size);
+    // socket可写时继续发送各个流缓存的数据
+    // Continue sending the data buffered in each stream when the socket becomes writable
+    weak_ptr<HttpSession> weak_self = static_pointer_cast<HttpSession>(shared_from_this());
+    getSock()->setOnFlush([weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return false;
+        }
+        strong_self->flushHttp2Data();
+        return true;
+    });
+}
+
+void HttpSession::onHttp2Request(uint32_t stream_id, Parser &parser) {
+    _ticker.resetTime();
+    _parser = std::move(parser);
+    _h2_stream_id = stream_id;
+    _origin = _parser["Origin"];
+
+    // 服务端默认优先级: 播放列表先于分片发送，客户端指定了priority时以客户端为准
+    // Server side default priority: playlists are sent before segments, the priority specified by the client wins
+    auto &url = _parser.url();
+    if (end_with(url, ".m3u8") || end_with(url, ".mpd")) {
+        setHttp2Priority(stream_id, 1, false);
+    }
+
+    urlDecode(_parser);
+    auto &handlers = getRequestHandlers();
+    auto it = handlers.find(_parser.method());
+    if (it == handlers.end()) {
+        WarnP(this) << "Http method not supported: " << _parser.method();
+        sendResponse(405, false);
+    } else {
+        (this->*(it->second))();
+    }
+    _parser.clear();
+}
+
+void HttpSession::sendHttp2Response(int code, const KeyValue &header, const HttpBody::Ptr &body, bool no_content_length) {
+    auto stream_id = _h2_stream_id;
+    if (!isHttp2StreamWritable(stream_id)) {
+        // 回复前流已经被客户端重置
+        // The stream was reset by the client before the response
+        return;
+    }
+    bool has_body = body && body->remainSize();
+    // 直播(no_content_length)的负载后续通过onWrite发送
+    // The payload of a live stream (no_content_length) is sent later through onWrite
+    sendHttp2Headers(stream_id, code, header, !has_body && !no_content_length);
+    _ticker.resetTime();
+    if (!has_body) {
+        return;
+    }
+    _h2_bodies[stream_id].body = body;
+    readHttp2Body(stream_id);
+}
+
+void HttpSession::readHttp2Body(uint32_t stream_id) {
+    auto it = _h2_bodies.find(stream_id);
+    if (it == _h2_bodies.end() || it->second.reading) {
+        return;
+    }
+    it->second.reading = true;
+    auto body = it->second.body;
+    GET_CONFIG(uint32_t, sendBufSize, Http::kSendBufSize);
+    weak_ptr<HttpSession> weak_self = static_pointer_cast<HttpSession>(shared_from_this());
+    body->readDataAsync(sendBufSize, [weak_self, stream_id, body](const Buffer::Ptr &buffer) {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        strong_self->async([weak_self, stream_id, body, buffer]() {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                // 本对象已经销毁  [AUTO-TRANSLATED:713e0f23]
+                // This object has been destroyed
+                return;
+            }
+            strong_self->onHttp2BodyData(stream_id, body, buffer);
+        }, false);
+    });
+}
+
+void HttpSession::onHttp2BodyData(uint32_t stream_id, const HttpBody::Ptr &body, const Buffer::Ptr &buffer) {
+    auto it = _h2_bodies.find(stream_id);
+    if (it == _h2_bodies.end() || it->second.body != body) {
+        // 流已经被重置
+        // The stream has been reset
+        return;
+    }
+    it->second.reading = false;
+    _ticker.resetTime();
+    bool end_stream = !buffer || !buffer->size() || !body->remainSize();
+    if (end_stream) {
+        _h2_bodies.erase(it);
+    }
+    // 流中数据发送完毕后会触发onHttp2StreamWritable继续读取
+    // onHttp2StreamWritable is triggered to read more once the data in the stream has been sent
+    sendHttp2Data(stream_id, buffer, end_stream);
+}
+
+void HttpSession::onHttp2Send(Buffer::Ptr buffer) {
+    send(std::move(buffer));
+}
+
+void HttpSession::onHttp2Error(const string &err) {
+    shutdown(SockException(Err_shutdown, err));
+}
+
+void HttpSession::onHttp2StreamWritable(uint32_t stream_id) {
+    readHttp2Body(stream_id);
+}
+
+void HttpSession::onHttp2StreamClosed(uint32_t stream_id) {
+    _h2_bodies.erase(stream_id);
+    if (stream_id == _h2_live_stream_id) {
+        shutdownLiveStream(SockException(Err_shutdown, "http2 stream closed"));
+    }
+}
+
+bool HttpSession::isHttp2SendBlocked() {
+    return isSocketBusy();
+}
+
 } /* namespace mediakit */
@@ -12,10 +12,12 @@
 #define SRC_HTTP_HTTPSESSION_H_
 
 #include <functional>
+#include <unordered_map>
 #include "Network/Session.h"
 #include "Rtmp/FlvMuxer.h"
 #include "HttpRequestSplitter.h"
 #include "WebSocketSplitter.h"
+#include "Http2Splitter.h"
 #include "HttpCookieManager.h"
 #include "HttpFileManager.h"
 #include "TS/TSMediaSource.h"
@@ -26,7 +28,8 @@ namespace mediakit {
 class HttpSession: public toolkit::Session,
                    public FlvMuxer,
                    public HttpRequestSplitter,
-                   public WebSocketSplitter {
+                   public WebSocketSplitter,
+                   public Http2Splitter {
 public:
     using Ptr = std::shared_ptr<HttpSession>;
     using KeyValue = StrCaseMap;
@@ -55,6 +58,8 @@ public:
 protected:
     //FlvMuxer override
     void onWrite(const toolkit::Buffer::Ptr &data, bool flush) override ;
+    void onWriteRaw(const toolkit::Buffer::Ptr &data, bool flush) override;
+    bool isWebSocketFlv() const override { return _live_over_websocket; }
     void onDetach() override;
     std::shared_ptr<FlvMuxer> getSharedPtr() override;
 
@@ -124,11 +129,22 @@ protected:
      */
     void onWebSocketDecodeComplete(const WebSocketHeader &header_in) override;
 
+    //Http2Splitter override
+    void onHttp2Request(uint32_t stream_id, Parser &parser) override;
+    void onHttp2Send(toolkit::Buffer::Ptr buffer) override;
+    void onHttp2Error(const std::string &err) override;
+    void onHttp2StreamWritable(uint32_t stream_id) override;
+    void onHttp2StreamClosed(uint32_t stream_id) override;
+    bool isHttp2SendBlocked() override;
+
     // 重载获取客户端ip  [AUTO-TRANSLATED:6e497ea4]
     // Overload to get client ip
     std::string get_peer_ip() override;
 
 private:
+    using HttpRequestHandler = void (HttpSession::*)();
+    static const std::unordered_map<std::string, HttpRequestHandler> &getRequestHandlers();
+
     void onHttpRequest_GET();
     void onHttpRequest_POST();
     void onHttpRequest_HEAD();
@@ -141,6 +157,14 @@ private:
     bool checkLiveStreamFMP4(const std::function<void()> &fmp4_list = nullptr);
 
     bool checkWebSocket();
+    bool checkHttp2Preface();
+    bool checkHttp2Upgrade();
+    void startHttp2Session();
+    void sendHttp2Response(int code, const KeyValue &header, const HttpBody::Ptr &body, bool no_content_length);
+    void readHttp2Body(uint32_t stream_id);
+    void onHttp2BodyData(uint32_t stream_id, const HttpBody::Ptr &body, const toolkit::Buffer::Ptr &buffer);
+    void shutdownLiveStream(const toolkit::SockException &ex);
+    void reportLiveStreamFlow(const toolkit::SockException &err);
     bool emitHttpEvent(bool doInvoke);
     void urlDecode(Parser &parser);
     void sendNotFound(bool bClose);
@@ -159,6 +183,9 @@ private:
     bool _is_live_stream = false;
     bool _live_over_websocket = false;
     bool _is_websocket = false;
+    // 客户端是否支持chunked编码(http/1.0不支持)
+    // Whether the client supports chunked encoding (not supported by http/1.0)
+    bool _support_chunked = true;
     // 超时时间  [AUTO-TRANSLATED:f15e2672]
     // Timeout
     size_t _keep_alive_sec = 0;
@@ -178,6 +205,17 @@ private:
     // 处理content数据的callback  [AUTO-TRANSLATED:38890e8d]
     // Callback to handle content data
     std::function<bool (const char *data,size_t len) > _on_recv_body;
+    // http/2下当前处理的请求所在的流，以及直播所在的流
+    // The stream of the request being handled under http/2, and the stream carrying the live stream
+    uint32_t _h2_stream_id = 0;
+    uint32_t _h2_live_stream_id = 0;
+    // http/2下各个流正在发送的body
+    // Bodies being sent on each stream under http/2
+    struct Http2Body {
+        HttpBody::Ptr body;
+        bool reading = false;
+    };
+    std::unordered_map<uint32_t, Http2Body> _h2_bodies;
 };
 
 using HttpsSession = toolkit::SessionWithSSL<HttpSession>;
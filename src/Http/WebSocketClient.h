@@ -289,7 +289,13 @@ protected:
      
      * [AUTO-TRANSLATED:7bc6b7c6]
      */
-    void onWebSocketDecodeHeader(const WebSocketHeader &header) override { _payload_section.clear(); }
+    void onWebSocketDecodeHeader(const WebSocketHeader &header) override {
+        _payload_section.clear();
+        // 预分配负载内存，避免分多次接收时反复扩容；预分配有上限，更大的负载随数据到达再扩容
+        // Pre-allocate payload memory to avoid repeated growth when received in multiple slices,
+        // the pre-allocation is capped and larger payloads grow as the data arrives
+        _payload_section.reserve(std::min<size_t>(header._payload_len, MAX_WS_RESERVE));
+    }
 
     /**
      * 收到webSocket数据包负载
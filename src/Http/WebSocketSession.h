@@ -198,6 +198,10 @@ protected:
         // 新包，原来的包残余数据清空掉  [AUTO-TRANSLATED:0fd23412]
         // New package, the residual data of the original package is cleared
         _payload_section.clear();
+        // 预分配负载内存，避免分多次接收时反复扩容；预分配有上限，更大的负载随数据到达再扩容
+        // Pre-allocate payload memory to avoid repeated growth when received in multiple slices,
+        // the pre-allocation is capped and larger payloads grow as the data arrives
+        _payload_section.reserve(std::min<size_t>(packet._payload_len, MAX_WS_RESERVE));
     }
 
     /**
@@ -9,6 +9,7 @@
  */
 
 #include "WebSocketSplitter.h"
+#include <cstring>
 #include <sys/types.h>
 #if !defined(_WIN32)
 #include <sys/socket.h>
@@ -17,6 +18,9 @@
 
 #include "Util/logger.h"
 #include "Util/util.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 using namespace toolkit;
@@ -45,118 +49,157 @@ namespace mediakit {
  +---------------------------------------------------------------+
  */
 
-#define CHECK_LEN(size) \
-do{ \
-    if(len - (ptr - data) < size){ \
-        if(_remain_data.empty()){ \
-            _remain_data.assign((char *)data,len); \
-        } \
-        return ; \
-    } \
-}while(0) \
-
-void WebSocketSplitter::decode(uint8_t *data, size_t len) {
-    uint8_t *ptr = data;
-    if(!_got_header) {
-        // 还没有获取数据头  [AUTO-TRANSLATED:2b50f282]
-        // No data header has been obtained yet
-        if(!_remain_data.empty()){
-            _remain_data.append((char *)data,len);
-            data = ptr = (uint8_t *)_remain_data.data();
-            len = _remain_data.size();
+// 不超过该长度的负载直接合并到包头中发送
+// Payloads not longer than this are merged into the header buffer
+static constexpr size_t kMergePayloadSize = 1024;
+
+void WebSocketSplitter::maskPayload(uint8_t *data, size_t len, const uint8_t *mask, size_t offset) {
+    size_t i = 0;
+    // 先逐字节处理到8字节对齐
+    // Process byte by byte until 8-byte aligned first
+    while (i < len && ((uintptr_t)(data + i) & 7)) {
+        data[i] ^= mask[(offset + i) & 3];
+        ++i;
+    }
+    if (len - i >= 8) {
+        // 对齐后按当前偏移旋转掩码，然后批量异或
+        // After alignment, rotate the mask according to the current offset, then xor in bulk
+        uint8_t rotated[16];
+        for (size_t j = 0; j < sizeof(rotated); ++j) {
+            rotated[j] = mask[(offset + i + j) & 3];
+        }
+#if defined(__SSE2__)
+        auto mask128 = _mm_loadu_si128((const __m128i *)rotated);
+        for (; i + 16 <= len; i += 16) {
+            auto ptr = (__m128i *)(data + i);
+            _mm_storeu_si128(ptr, _mm_xor_si128(_mm_loadu_si128(ptr), mask128));
         }
+#endif
+        uint64_t mask64;
+        memcpy(&mask64, rotated, 8);
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            word ^= mask64;
+            memcpy(data + i, &word, 8);
+        }
+    }
+    for (; i < len; ++i) {
+        data[i] ^= mask[(offset + i) & 3];
+    }
+}
 
-begin_decode:
-        CHECK_LEN(1);
-        _fin = (*ptr & 0x80) >> 7;
-        _reserved = (*ptr & 0x70) >> 4;
-        _opcode = (WebSocketHeader::Type) (*ptr & 0x0F);
-        ptr += 1;
-
-        CHECK_LEN(1);
-        _mask_flag = (*ptr & 0x80) >> 7;
-        _payload_len = (*ptr & 0x7F);
-        ptr += 1;
-
-        if (_payload_len == 126) {
-            CHECK_LEN(2);
-            _payload_len = (*ptr << 8) | *(ptr + 1);
-            ptr += 2;
-        } else if (_payload_len == 127) {
-            CHECK_LEN(8);
-            _payload_len = ((uint64_t) ptr[0] << (8 * 7)) |
-                            ((uint64_t) ptr[1] << (8 * 6)) |
-                            ((uint64_t) ptr[2] << (8 * 5)) |
-                            ((uint64_t) ptr[3] << (8 * 4)) |
-                            ((uint64_t) ptr[4] << (8 * 3)) |
-                            ((uint64_t) ptr[5] << (8 * 2)) |
-                            ((uint64_t) ptr[6] << (8 * 1)) |
-                            ((uint64_t) ptr[7] << (8 * 0));
-            ptr += 8;
+size_t WebSocketSplitter::decodeHeader(const uint8_t *data, size_t len) {
+    auto ptr = data;
+    if (len < 2) {
+        return 0;
+    }
+    _fin = (*ptr & 0x80) >> 7;
+    _reserved = (*ptr & 0x70) >> 4;
+    _opcode = (WebSocketHeader::Type) (*ptr & 0x0F);
+    ptr += 1;
+
+    _mask_flag = (*ptr & 0x80) >> 7;
+    _payload_len = (*ptr & 0x7F);
+    ptr += 1;
+
+    if (_payload_len == 126) {
+        if (len - (ptr - data) < 2) {
+            return 0;
         }
-        if (_mask_flag) {
-            CHECK_LEN(4);
-            _mask.assign(ptr, ptr + 4);
-            ptr += 4;
+        _payload_len = (*ptr << 8) | *(ptr + 1);
+        ptr += 2;
+    } else if (_payload_len == 127) {
+        if (len - (ptr - data) < 8) {
+            return 0;
         }
-        _got_header = true;
-        _mask_offset = 0;
-        _payload_offset = 0;
-        onWebSocketDecodeHeader(*this);
-        if(_payload_len == 0){
-            onWebSocketDecodeComplete(*this);
+        _payload_len = ((uint64_t) ptr[0] << (8 * 7)) |
+                        ((uint64_t) ptr[1] << (8 * 6)) |
+                        ((uint64_t) ptr[2] << (8 * 5)) |
+                        ((uint64_t) ptr[3] << (8 * 4)) |
+                        ((uint64_t) ptr[4] << (8 * 3)) |
+                        ((uint64_t) ptr[5] << (8 * 2)) |
+                        ((uint64_t) ptr[6] << (8 * 1)) |
+                        ((uint64_t) ptr[7] << (8 * 0));
+        ptr += 8;
+    }
+    if (_mask_flag) {
+        if (len - (ptr - data) < 4) {
+            return 0;
         }
+        _mask.assign(ptr, ptr + 4);
+        ptr += 4;
     }
+    return ptr - data;
+}
 
-    // 进入后面逻辑代表已经获取到了webSocket协议头，  [AUTO-TRANSLATED:e6bd2556]
-    // Entering the following logic means that the webSocket protocol header has been obtained,
+void WebSocketSplitter::decode(uint8_t *data, size_t len) {
+    if (!_remain_data.empty()) {
+        // 只有不完整的包头才会被缓存，负载数据总是直接回调
+        // Only incomplete headers are cached, payload data is always delivered directly
+        _remain_data.append((char *)data, len);
+        data = (uint8_t *)_remain_data.data();
+        len = _remain_data.size();
+    }
 
-    auto remain = len - (ptr - data);
-    if(remain > 0){
-        auto payload_slice_len = remain;
-        if(payload_slice_len + _payload_offset > _payload_len){
-            payload_slice_len = _payload_len - _payload_offset;
+    uint8_t *ptr = data;
+    uint8_t *end = data + len;
+    while (ptr < end) {
+        if (!_got_header) {
+            auto header_size = decodeHeader(ptr, end - ptr);
+            if (!header_size) {
+                // 包头不完整，缓存剩余数据等待下次输入
+                // The header is incomplete, cache the remaining data for the next input
+                if (data == (uint8_t *)_remain_data.data()) {
+                    _remain_data.erase(0, ptr - data);
+                } else {
+                    _remain_data.assign((char *)ptr, end - ptr);
+                }
+                return;
+            }
+            ptr += header_size;
+            _got_header = true;
+            _mask_offset = 0;
+            _payload_offset = 0;
+            onWebSocketDecodeHeader(*this);
+            if (_payload_len == 0) {
+                onWebSocketDecodeComplete(*this);
+                _got_header = false;
+                continue;
+            }
         }
+
+        // 进入后面逻辑代表已经获取到了webSocket协议头，负载数据直接在输入缓存上解掩码并回调，不再拷贝
+        // Entering the following logic means that the webSocket protocol header has been obtained,
+        // the payload is unmasked in place on the input buffer and delivered without copying
+        auto payload_slice_len = std::min<size_t>(end - ptr, _payload_len - _payload_offset);
         _payload_offset += payload_slice_len;
         onPayloadData(ptr, payload_slice_len);
+        ptr += payload_slice_len;
 
-        if(_payload_offset == _payload_len){
+        if (_payload_offset == _payload_len) {
             onWebSocketDecodeComplete(*this);
-
-            // 这是下一个包  [AUTO-TRANSLATED:bf657413]
-            // This is the next package
-            remain -= payload_slice_len;
-            ptr += payload_slice_len;
+            // 后续数据是下一个包
+            // The following data is the next package
             _got_header = false;
-
-            if(remain > 0){
-                // 剩余数据是下一个包，把它的数据放置在缓存中  [AUTO-TRANSLATED:7b2ebfad]
-                // The remaining data is the next package, place its data in the cache
-                string str((char *)ptr,remain);
-                _remain_data = str;
-
-                data = ptr = (uint8_t *)_remain_data.data();
-                len = _remain_data.size();
-                goto begin_decode;
-            }
         }
     }
     _remain_data.clear();
 }
 
 void WebSocketSplitter::onPayloadData(uint8_t *data, size_t len) {
-    if(_mask_flag){
-        for(size_t i = 0; i < len ; ++i,++data){
-            *(data) ^= _mask[(i + _mask_offset) % 4];
-        }
+    if (_mask_flag) {
+        maskPayload(data, len, _mask.data(), _mask_offset);
         _mask_offset = (_mask_offset + len) % 4;
     }
-    onWebSocketDecodePayload(*this, _mask_flag ? data - len : data, len, _payload_offset);
+    onWebSocketDecodePayload(*this, data, len, _payload_offset);
 }
 
 void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &buffer) {
     string ret;
     uint64_t len = buffer ? buffer->size() : 0;
+    bool merge = len <= kMergePayloadSize;
+    ret.reserve(14 + (merge ? len : 0));
     uint8_t byte = header._fin << 7 | ((header._reserved & 0x07) << 4) | (header._opcode & 0x0F) ;
     ret.push_back(byte);
 
@@ -185,24 +228,26 @@ void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &
         ret.append((char *)header._mask.data(),4);
     }
 
-    onWebSocketEncodeData(std::make_shared<BufferString>(std::move(ret)));
-
-    if(len > 0){
-        if(mask_flag){
-            uint8_t *ptr = (uint8_t*)buffer->data();
-            for(size_t i = 0; i < len ; ++i,++ptr){
-                *(ptr) ^= header._mask[i % 4];
+    if (merge) {
+        // 小包合并到包头中只回调一次，减少发送队列中的buffer个数(writev时的iovec个数)，且不修改调用者的数据
+        // Small payloads are merged into the header and called back only once, reducing the number of buffers
+        // in the send queue (the number of iovecs in writev), and the caller's data is not modified
+        if (len > 0) {
+            auto offset = ret.size();
+            ret.append(buffer->data(), len);
+            if (mask_flag) {
+                maskPayload((uint8_t *)&ret[offset], len, header._mask.data(), 0);
             }
         }
-        onWebSocketEncodeData(buffer);
+        onWebSocketEncodeData(std::make_shared<BufferString>(std::move(ret)));
+        return;
     }
 
+    onWebSocketEncodeData(std::make_shared<BufferString>(std::move(ret)));
+    if(mask_flag){
+        maskPayload((uint8_t *)buffer->data(), len, header._mask.data(), 0);
+    }
+    onWebSocketEncodeData(buffer);
 }
 
-
-
 } /* namespace mediakit */
-
-
-
-
@@ -12,6 +12,7 @@
 #define ZLMEDIAKIT_WEBSOCKETSPLITTER_H
 
 #include <cstdint>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <memory>
@@ -21,6 +22,11 @@
 // websocket combined package size must not exceed 4MB (to prevent memory explosion)
 #define MAX_WS_PACKET (4 * 1024 * 1024)
 
+// 按帧头声明的负载长度预分配内存的上限，更大的负载随数据到达再扩容，防止伪造的帧头占用大量内存
+// Upper limit of the memory pre-allocated by the payload length declared in the frame header, larger payloads grow
+// as the data arrives, so that forged frame headers can not occupy a lot of memory
+#define MAX_WS_RESERVE (64 * 1024)
+
 namespace mediakit {
 
 class WebSocketHeader {
@@ -103,11 +109,11 @@ public:
 
     /**
      * 编码一个数据包
-     * 将触发2次onWebSocketEncodeData回调
+     * 负载较小时合并到包头中触发1次onWebSocketEncodeData回调，否则触发2次
      * @param header 数据头
      * @param buffer 负载数据
      * Encode a data packet
-     * Will trigger 2 onWebSocketEncodeData callbacks
+     * Small payloads are merged into the header and trigger 1 onWebSocketEncodeData callback, otherwise 2 callbacks are triggered
      * @param header Data header
      * @param buffer Payload data
      
@@ -115,6 +121,20 @@ public:
      */
     void encode(const WebSocketHeader &header,const toolkit::Buffer::Ptr &buffer);
 
+    /**
+     * 对数据进行websocket掩码异或(掩码与解掩码相同)，按字长/SIMD批量处理
+     * @param data 数据指针
+     * @param len 数据长度
+     * @param mask 4字节掩码
+     * @param offset 数据起始位置在负载中的偏移(决定掩码起始字节)
+     * Xor the data with the websocket mask (masking and unmasking are the same), processed in bulk by word/SIMD
+     * @param data Data pointer
+     * @param len Data length
+     * @param mask 4-byte mask
+     * @param offset Offset of the data start in the payload (determines the starting mask byte)
+     */
+    static void maskPayload(uint8_t *data, size_t len, const uint8_t *mask, size_t offset);
+
 protected:
     /**
      * 收到一个webSocket数据包包头，后续将继续触发onWebSocketDecodePayload回调
@@ -166,6 +186,7 @@ protected:
     virtual void onWebSocketEncodeData(toolkit::Buffer::Ptr buffer){};
 
 private:
+    size_t decodeHeader(const uint8_t *data, size_t len);
     void onPayloadData(uint8_t *data, size_t len);
 
 private:
@@ -245,6 +245,14 @@ public:
         return std::dynamic_pointer_cast<toolkit::SockInfo>(_delegate);
     }
 
+    /**
+     * 获取实际执行播放的对象，需在播放器所在线程调用
+     * Get the object that actually plays, it must be called in the thread of the player
+     */
+    std::shared_ptr<Delegate> getDelegate() const {
+        return _delegate;
+    }
+
     void setMediaSource(const MediaSource::Ptr &src) override {
         if (_delegate) {
             _delegate->setMediaSource(src);
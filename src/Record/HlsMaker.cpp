@@ -112,6 +112,7 @@ void HlsMaker::inputData(const char *data, size_t len, uint64_t timestamp, bool
             // Write ts data only if there are slices
             onWriteSegment(data, len);
             _last_timestamp = timestamp;
+            _seg_key_frames += is_idr_fast_packet;
         }
     } else {
         // resetTracks时触发此逻辑  [AUTO-TRANSLATED:0ba915ed]
@@ -153,6 +154,7 @@ void HlsMaker::addNewSegment(uint64_t stamp) {
     // 新增切片  [AUTO-TRANSLATED:b8623419]
     // Add a new slice
     _last_file_name = onOpenSegment(_file_index++);
+    _seg_key_frames = 0;
     // 记录本次切片的起始时间戳  [AUTO-TRANSLATED:8eb776e9]
     // Record the starting timestamp of this slice
     _last_seg_timestamp = _last_timestamp ? _last_timestamp : stamp;
@@ -171,7 +173,8 @@ void HlsMaker::flushLastSegment(bool eof){
     if (seg_dur <= 0) {
         seg_dur = 100;
     }
-    _seg_dur_list.emplace_back(seg_dur, std::move(_last_file_name));
+    _seg_dur_list.emplace_back(seg_dur, getSegmentTags() + _last_file_name);
+    _last_file_name.clear();
     delOldSegment();
     // 先flush ts切片，否则可能存在ts文件未写入完毕就被访问的情况  [AUTO-TRANSLATED:f8d6dc87]
     // Flush the ts slice first, otherwise there may be a situation where the ts file is not written completely before it is accessed
@@ -198,6 +201,10 @@ bool HlsMaker::isFmp4() const {
     return _is_fmp4;
 }
 
+uint32_t HlsMaker::getSegmentKeyFrames() const {
+    return _seg_key_frames;
+}
+
 void HlsMaker::clear() {
     _file_index = 0;
     _last_timestamp = 0;
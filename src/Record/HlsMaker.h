@@ -160,6 +160,14 @@ protected:
      */
     virtual void onFlushLastSegment(uint64_t duration_ms) {};
 
+    /**
+     * 上一个切片在m3u8中位于uri之前的额外标签，例如切片位于归档文件中时的EXT-X-BYTERANGE
+     * @return 以换行结尾的标签，没有时返回空
+     * Extra tags of the previous segment before its uri in the m3u8, such as EXT-X-BYTERANGE when the segment is in an archive file
+     * @return tags ending with a line break, empty if there is none
+     */
+    virtual std::string getSegmentTags() { return ""; }
+
     /**
      * 关闭上个ts切片并且写入m3u8索引
      * @param eof HLS直播是否已结束
@@ -170,6 +178,12 @@ protected:
      */
     void flushLastSegment(bool eof);
 
+    /**
+     * 当前切片的视频关键帧数
+     * Number of video key frames in the current segment
+     */
+    uint32_t getSegmentKeyFrames() const;
+
 private:
     /**
      * 生成m3u8文件
@@ -207,6 +221,7 @@ private:
     uint64_t _last_timestamp = 0;
     uint64_t _last_seg_timestamp = 0;
     uint64_t _file_index = 0;
+    uint32_t _seg_key_frames = 0;
     std::string _last_file_name;
     std::deque<std::tuple<int,std::string> > _seg_dur_list;
 };
@@ -16,6 +16,7 @@
 #include "Util/uv_errno.h"
 #include "Util/File.h"
 #include "Common/config.h"
+#include "RecordCatalog.h"
 
 using namespace std;
 using namespace toolkit;
@@ -40,6 +41,19 @@ HlsMakerImp::HlsMakerImp(bool is_fmp4, const string &m3u8_file, const string &pa
     _buf_size = bufSize;
     _file_buf.reset(new char[bufSize], [](char *ptr) { delete[] ptr; });
     _info.folder = _path_prefix;
+    GET_CONFIG(bool, archive, Hls::kArchive);
+    // 只有保留的切片(录像)才写入归档文件，直播切片需要逐个删除
+    // Only kept segments (recordings) are written into archive files, live segments need to be deleted one by one
+    _archive = archive && (!isLive() || isKeep());
+}
+
+// 归档文件名(不含后缀)
+// Name of archive files without the suffix
+static constexpr char kArchiveName[] = "archive";
+
+bool HlsMakerImp::isArchiveFile(const string &path) {
+    auto name = path.substr(path.rfind('/') + 1);
+    return name == string(kArchiveName) + ".ts" || name == string(kArchiveName) + ".mp4";
 }
 
 HlsMakerImp::~HlsMakerImp() {
@@ -151,9 +165,15 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
         auto strHour = getTimeStr("%H");
         auto strTime = getTimeStr("%M-%S");
         auto current_dir = strDate + "/" + strHour + "/";
-        segment_name = current_dir + strTime + "_" + std::to_string(index) + (isFmp4() ? ".mp4" : ".ts");
+        if (_archive) {
+            // 同一小时内的切片写入同一个归档文件
+            // Segments within the same hour are written into the same archive file
+            segment_name = current_dir + kArchiveName + (isFmp4() ? ".mp4" : ".ts");
+        } else {
+            segment_name = current_dir + strTime + "_" + std::to_string(index) + (isFmp4() ? ".mp4" : ".ts");
+        }
         segment_path = _path_prefix + "/" + segment_name;
-        if (isLive()) {
+        if (isLive() && !_archive) {
             // 直播
             _segment_file_paths.emplace(index, segment_path);
         }
@@ -165,11 +185,17 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
             _current_dir = std::move(current_dir);
         }
     }
-    _file = makeFile(segment_path, true);
+    if (_archive) {
+        openArchiveSegment(segment_path);
+    } else {
+        _file = makeFile(segment_path, true);
+        _seg_size = 0;
+    }
 
     // 保存本切片的元数据  [AUTO-TRANSLATED:64e6f692]
     // Save metadata for this slice
     _info.start_time = ::time(NULL);
+    _seg_start_ms = getCurrentMillisecond(true);
     _info.file_name = segment_name;
     _info.file_path = segment_path;
     _info.url = _info.app + "/" + _info.stream + "/" + segment_name;
@@ -183,6 +209,29 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
     return segment_name + "?" + _params;
 }
 
+void HlsMakerImp::openArchiveSegment(const string &archive_path) {
+    if (_file && archive_path == _archive_path) {
+        // 继续追加写入本小时的归档文件
+        // Continue appending to the archive file of this hour
+        _seg_offset += _seg_size;
+        _seg_size = 0;
+        return;
+    }
+    // 进入新的小时(或者重启后续写已有的归档文件)
+    // A new hour begins (or an existing archive file is continued after restarting)
+    _file = makeFile(archive_path, true, "ab");
+    _archive_path = archive_path;
+    _seg_offset = File::fileSize(archive_path.data());
+    _seg_size = 0;
+}
+
+string HlsMakerImp::getSegmentTags() {
+    if (!_archive) {
+        return "";
+    }
+    return "#EXT-X-BYTERANGE:" + to_string(_seg_size) + "@" + to_string(_seg_offset) + "\n";
+}
+
 void HlsMakerImp::onDelSegment(uint64_t index) {
     auto it = _segment_file_paths.find(index);
     if (it == _segment_file_paths.end()) {
@@ -209,6 +258,7 @@ void HlsMakerImp::onWriteInitSegment(const char *data, size_t len) {
 void HlsMakerImp::onWriteSegment(const char *data, size_t len) {
     if (_file) {
         fwrite(data, len, 1, _file.get());
+        _seg_size += len;
     }
     if (_media_src) {
         _media_src->onSegmentSize(len);
@@ -230,23 +280,45 @@ void HlsMakerImp::onWriteHls(const std::string &data, bool include_delay) {
 }
 
 void HlsMakerImp::onFlushLastSegment(uint64_t duration_ms) {
-    // 关闭并flush文件到磁盘  [AUTO-TRANSLATED:9798ec4d]
-    // Close and flush file to disk
-    _file = nullptr;
+    if (_archive && _file) {
+        // 归档文件保持打开，flush后切片即可被访问
+        // The archive file is kept open, the segment can be accessed after flushing
+        fflush(_file.get());
+    } else {
+        // 关闭并flush文件到磁盘  [AUTO-TRANSLATED:9798ec4d]
+        // Close and flush file to disk
+        _file = nullptr;
+    }
+    auto seg_size = _seg_size;
     if (!isLive() || isKeep()) {
-        _current_dir_seg_list.emplace_back(duration_ms, _info.file_name.erase(0, _current_dir.size()));
+        _current_dir_seg_list.emplace_back(duration_ms, getSegmentTags() + _info.file_name.erase(0, _current_dir.size()));
+        GET_CONFIG(bool, enableCatalog, Record::kEnableCatalog);
+        if (enableCatalog) {
+            // 保留的切片即为hls录像，记入录像目录
+            // Kept segments are hls recordings, add them to the recording catalog
+            RecordCatalog::Item item;
+            item.start_ms = _seg_start_ms;
+            item.end_ms = _seg_start_ms + duration_ms;
+            item.size = seg_size;
+            item.key_frames = getSegmentKeyFrames();
+            item.path = _info.file_path.substr(_path_prefix.size() + 1);
+            item.offset = _archive ? _seg_offset : 0;
+            RecordCatalog::get(_path_prefix)->append(std::move(item));
+        }
     }
     GET_CONFIG(bool, broadcastRecordTs, Hls::kBroadcastRecordTs);
     if (broadcastRecordTs) {
         _info.time_len = duration_ms / 1000.0f;
-        _info.file_size = File::fileSize(_info.file_path.data());
+        _info.key_frames = getSegmentKeyFrames();
+        _info.file_size = seg_size;
+        _info.file_offset = _archive ? _seg_offset : 0;
         NOTICE_EMIT(BroadcastRecordTsArgs, Broadcast::kBroadcastRecordTs, _info);
     }
 }
 
-std::shared_ptr<FILE> HlsMakerImp::makeFile(const string &file, bool setbuf) {
+std::shared_ptr<FILE> HlsMakerImp::makeFile(const string &file, bool setbuf, const char *mode) {
     auto file_buf = _file_buf;
-    auto ret = shared_ptr<FILE>(File::create_file(file.data(), "wb"), [file_buf](FILE *fp) {
+    auto ret = shared_ptr<FILE>(File::create_file(file.data(), mode), [file_buf](FILE *fp) {
         if (fp) {
             fclose(fp);
         }
@@ -52,6 +52,12 @@ public:
       */
      void clearCache();
 
+    /**
+     * 是否为hls归档文件，归档文件持续追加写入，不可mmap缓存
+     * Whether it is an hls archive file, archive files are appended continuously and must not be mmap cached
+     */
+    static bool isArchiveFile(const std::string &path);
+
 protected:
     std::string onOpenSegment(uint64_t index) override ;
     void onDelSegment(uint64_t index) override;
@@ -59,9 +65,11 @@ protected:
     void onWriteSegment(const char *data, size_t len) override;
     void onWriteHls(const std::string &data, bool include_delay) override;
     void onFlushLastSegment(uint64_t duration_ms) override;
+    std::string getSegmentTags() override;
 
 private:
-    std::shared_ptr<FILE> makeFile(const std::string &file,bool setbuf = false);
+    std::shared_ptr<FILE> makeFile(const std::string &file, bool setbuf = false, const char *mode = "wb");
+    void openArchiveSegment(const std::string &current_dir);
     void clearCache(bool immediately, bool eof);
     void saveCurrentDir();
 
@@ -74,6 +82,15 @@ private:
     std::string _path_prefix;
     std::string _current_dir;
     std::string _current_dir_init_file;
+    uint64_t _seg_start_ms = 0;
+    // 切片追加写入每小时的归档文件
+    // Segments are appended into the archive file of each hour
+    bool _archive = false;
+    // 当前切片在归档文件中的偏移，以及当前切片已写入的大小
+    // Offset of the current segment in the archive file, and the size written to the current segment
+    uint64_t _seg_offset = 0;
+    uint64_t _seg_size = 0;
+    std::string _archive_path;
     RecordInfo _info;
     std::shared_ptr<FILE> _file;
     std::shared_ptr<char> _file_buf;
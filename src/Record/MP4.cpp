@@ -10,10 +10,22 @@
 
 #if defined(ENABLE_MP4)
 
+#include <vector>
+#include <cstring>
+#if defined(__linux__) || defined(__linux)
+#include <fcntl.h>
+#endif
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
 #include "MP4.h"
 #include "Util/File.h"
+#include "Util/util.h"
 #include "Util/logger.h"
+#include "Util/uv_errno.h"
 #include "Common/config.h"
+#include "Thread/WorkThreadPool.h"
+#include "Rtmp/utils.h"
 
 using namespace toolkit;
 using namespace std;
@@ -105,34 +117,408 @@ void MP4FileDisk::openFile(const char *file, const char *mode) {
         setvbuf(fp, file_buf.get(), _IOFBF, mp4BufSize);
     }
 
+    // 只有写入方式打开(w或a)的文件才计入磁盘的写入负载，以rb+打开读取的文件不计入
+    // Only files opened for writing (w or a) count towards the write load of the disk, files opened by rb+ for reading do not
+    _disk = strchr(mode, 'w') || strchr(mode, 'a') ? StoragePool::Instance().getDisk(file) : nullptr;
+    auto disk = _disk;
+    if (disk) {
+        disk->addWriter();
+    }
+
     // 创建智能指针  [AUTO-TRANSLATED:e7920ab2]
     // Create a smart pointer
-    _file.reset(fp,[file_buf](FILE *fp) {
-        fflush(fp);
-        fclose(fp);
+    _file.reset(fp,[file_buf, disk](FILE *fp) {
+        if (!disk) {
+            fflush(fp);
+            fclose(fp);
+            return;
+        }
+        // 关闭时刷新缓存的耗时计入磁盘的写入延时
+        // The time to flush the buffer on close is counted in the write latency of the disk
+        disk->onSyncBegin();
+        auto start = getCurrentMicrosecond(true);
+        auto ok = fflush(fp) == 0;
+        ok = fclose(fp) == 0 && ok;
+        disk->onFlushEnd(getCurrentMicrosecond(true) - start, ok);
+        disk->delWriter();
     });
 }
 
 void MP4FileDisk::closeFile() {
     _file = nullptr;
+    _disk = nullptr;
+}
+
+void MP4FileDisk::sync() {
+    if (!_file) {
+        return;
+    }
+    auto disk = _disk;
+    if (disk) {
+        disk->onSyncBegin();
+        auto start = getCurrentMicrosecond(true);
+        auto ret = fflush(_file.get());
+        disk->onFlushEnd(getCurrentMicrosecond(true) - start, ret == 0);
+    } else {
+        fflush(_file.get());
+    }
+#if !defined(_WIN32)
+    if (_syncing->exchange(true)) {
+        return;
+    }
+    // 复制fd，文件在同步完成前关闭也不受影响
+    // Duplicate the fd so that closing the file before the sync finishes does not matter
+    auto fd = dup(fileno(_file.get()));
+    if (fd == -1) {
+        *_syncing = false;
+        return;
+    }
+    ++_statistic.syncs;
+    auto syncing = _syncing;
+    if (disk) {
+        disk->onSyncBegin();
+    }
+    WorkThreadPool::Instance().getExecutor()->async([fd, syncing, disk]() {
+        auto start = getCurrentMicrosecond(true);
+#if defined(__linux__) || defined(__linux)
+        auto ret = fdatasync(fd);
+#else
+        auto ret = fsync(fd);
+#endif
+        if (disk) {
+            disk->onSyncEnd(getCurrentMicrosecond(true) - start, ret == 0);
+        }
+        close(fd);
+        *syncing = false;
+    });
+#endif
+}
+
+void MP4FileDisk::setMoovReserve(size_t bytes) {
+    // 至少要能容纳free box头
+    // At least the free box header must fit
+    _moov_reserve = bytes < 8 ? 0 : MIN(bytes, (size_t)UINT32_MAX);
+    _statistic.moov_reserved = _moov_reserve;
+}
+
+const MP4FileDisk::IOStatistic &MP4FileDisk::getIOStatistic() const {
+    return _statistic;
+}
+
+uint64_t MP4FileDisk::toPhysical(uint64_t offset) const {
+    return _insert_pos && offset >= _insert_pos ? offset + _moov_reserve : offset;
+}
+
+int MP4FileDisk::writeAt(uint64_t physical, const char *data, size_t bytes) {
+    if (_physical_pos != physical) {
+        if (fseek64(_file.get(), physical, SEEK_SET)) {
+            return -1;
+        }
+        _physical_pos = physical;
+    }
+    if (bytes != fwrite(data, 1, bytes, _file.get())) {
+        return 0 != ferror(_file.get()) ? ferror(_file.get()) : -1;
+    }
+    _physical_pos += bytes;
+    _statistic.write_bytes += bytes;
+    return 0;
+}
+
+static void appendBE32(string &out, uint32_t val) {
+    char buf[4];
+    set_be32(buf, val);
+    out.append(buf, 4);
+}
+
+static void appendBE64(string &out, uint64_t val) {
+    appendBE32(out, (uint32_t)(val >> 32));
+    appendBE32(out, (uint32_t)val);
+}
+
+static uint64_t loadBE64(const char *data) {
+    return ((uint64_t)load_be32(data) << 32) | load_be32(data + 4);
+}
+
+// 修正moov中stco/co64记录的chunk偏移量，stco溢出时改为co64
+// Fix the chunk offsets recorded by stco/co64 in moov, stco is converted to co64 on overflow
+static bool shiftChunkOffset(const char *data, size_t size, uint64_t shift, string &out) {
+    size_t offset = 0;
+    while (offset < size) {
+        if (size - offset < 8) {
+            return false;
+        }
+        uint64_t box_size = load_be32(data + offset);
+        size_t header_size = 8;
+        if (box_size == 1) {
+            if (size - offset < 16) {
+                return false;
+            }
+            box_size = loadBE64(data + offset + 8);
+            header_size = 16;
+        } else if (box_size == 0) {
+            box_size = size - offset;
+        }
+        if (box_size < header_size || box_size > size - offset) {
+            return false;
+        }
+        string type(data + offset + 4, 4);
+        auto body = data + offset + header_size;
+        auto body_size = box_size - header_size;
+        if (type == "moov" || type == "trak" || type == "mdia" || type == "minf" || type == "stbl") {
+            string children;
+            if (!shiftChunkOffset(body, body_size, shift, children)) {
+                return false;
+            }
+            appendBE32(out, (uint32_t)(8 + children.size()));
+            out.append(type);
+            out.append(children);
+        } else if (type == "stco" || type == "co64") {
+            // version(1) + flags(3) + entry_count(4)
+            if (body_size < 8) {
+                return false;
+            }
+            bool is_co64 = type == "co64";
+            uint64_t count = load_be32(body + 4);
+            if (body_size < 8 + count * (is_co64 ? 8 : 4)) {
+                return false;
+            }
+            vector<uint64_t> offsets(count);
+            bool to_co64 = is_co64;
+            for (uint64_t i = 0; i < count; ++i) {
+                offsets[i] = (is_co64 ? loadBE64(body + 8 + i * 8) : load_be32(body + 8 + i * 4)) + shift;
+                to_co64 = to_co64 || offsets[i] > UINT32_MAX;
+            }
+            appendBE32(out, (uint32_t)(16 + count * (to_co64 ? 8 : 4)));
+            out.append(to_co64 ? "co64" : "stco");
+            out.append(body, 8);
+            for (auto chunk_offset : offsets) {
+                if (to_co64) {
+                    appendBE64(out, chunk_offset);
+                } else {
+                    appendBE32(out, (uint32_t)chunk_offset);
+                }
+            }
+        } else {
+            out.append(data + offset, box_size);
+        }
+        offset += box_size;
+    }
+    return true;
+}
+
+int MP4FileDisk::writeReserved(const char *data, size_t bytes) {
+    if (_capture_moov && _pos >= _moov_offset) {
+        // moov先写入内存
+        // moov is written to memory first
+        auto offset = _pos - _moov_offset;
+        if (offset + bytes > _moov.size()) {
+            _moov.resize(offset + bytes);
+        }
+        memcpy(&_moov[offset], data, bytes);
+        _pos += bytes;
+        return 0;
+    }
+
+    if (!_insert_pos && _pos < sizeof(_ftyp_header)) {
+        // 根据ftyp头确定预留区域插入位置
+        // Determine where the reserved region is inserted according to the ftyp header
+        auto size = MIN(bytes, sizeof(_ftyp_header) - _pos);
+        memcpy(_ftyp_header + _pos, data, size);
+        if (_pos + size == sizeof(_ftyp_header)) {
+            auto ftyp_size = load_be32(_ftyp_header);
+            if (memcmp(_ftyp_header + 4, "ftyp", 4) || ftyp_size < sizeof(_ftyp_header)) {
+                WarnL << "The mp4 file does not start with ftyp, moov reservation is disabled";
+                _moov_reserve = 0;
+                _statistic.moov_reserved = 0;
+            } else {
+                _insert_pos = ftyp_size;
+            }
+        }
+    }
+
+    while (bytes) {
+        auto size = bytes;
+        if (_insert_pos && _pos < _insert_pos) {
+            // 跨越插入位置的写入需要拆分
+            // A write across the insert position needs to be split
+            size = MIN(size, _insert_pos - _pos);
+        } else if (_insert_pos && !_free_written) {
+            char free_box[8];
+            set_be32(free_box, _moov_reserve);
+            memcpy(free_box + 4, "free", 4);
+            if (writeAt(_insert_pos, free_box, sizeof(free_box))) {
+                return -1;
+            }
+            _free_written = true;
+        }
+        if (int ret = writeAt(toPhysical(_pos), data, size)) {
+            return ret;
+        }
+        _pos += size;
+        data += size;
+        bytes -= size;
+    }
+    _end = MAX(_end, _pos);
+    return 0;
+}
+
+void MP4FileDisk::beginWriteMoov() {
+    if (!_moov_reserve || !_insert_pos) {
+        return;
+    }
+    _capture_moov = true;
+    _moov_offset = _end;
+    _moov.clear();
+}
+
+void MP4FileDisk::endWriteMoov() {
+    if (!_capture_moov) {
+        return;
+    }
+    _capture_moov = false;
+    if (_moov.empty()) {
+        return;
+    }
+    // 复用器记录的chunk偏移量不含预留区域
+    // The chunk offsets recorded by the muxer do not include the reserved region
+    string moov;
+    if (!shiftChunkOffset(_moov.data(), _moov.size(), _moov_reserve, moov)) {
+        WarnL << "Parse moov failed, chunk offsets are not fixed";
+        moov = std::move(_moov);
+    }
+    _moov = string();
+    _statistic.moov_size = moov.size();
+    if (moov.size() == _moov_reserve || moov.size() + 8 <= _moov_reserve) {
+        // 原地写入预留区域，剩余部分仍然为free box
+        // Written in place into the reserved region, the remaining part is still a free box
+        if (writeAt(_insert_pos, moov.data(), moov.size())) {
+            WarnL << "Write moov failed: " << get_uv_errmsg();
+            return;
+        }
+        if (auto remain = _moov_reserve - moov.size()) {
+            char free_box[8];
+            set_be32(free_box, (uint32_t)remain);
+            memcpy(free_box + 4, "free", 4);
+            writeAt(_insert_pos + moov.size(), free_box, sizeof(free_box));
+        }
+        _statistic.moov_in_place = true;
+        return;
+    }
+    WarnL << "The moov size(" << moov.size() << ") exceeds the reserved size(" << _moov_reserve << "), append it to the end of the file";
+    if (writeAt(toPhysical(_moov_offset), moov.data(), moov.size())) {
+        WarnL << "Write moov failed: " << get_uv_errmsg();
+    }
 }
 
 int MP4FileDisk::onRead(void *data, size_t bytes) {
+    if (_moov_reserve) {
+        auto ptr = (char *)data;
+        while (bytes) {
+            if (_capture_moov && _pos >= _moov_offset) {
+                auto offset = _pos - _moov_offset;
+                if (offset + bytes > _moov.size()) {
+                    return -1;
+                }
+                memcpy(ptr, _moov.data() + offset, bytes);
+                _pos += bytes;
+                return 0;
+            }
+            auto size = bytes;
+            if (_insert_pos && _pos < _insert_pos) {
+                size = MIN(size, _insert_pos - _pos);
+            }
+            // 读写切换时必须seek
+            // A seek is required when switching between reading and writing
+            if (fseek64(_file.get(), toPhysical(_pos), SEEK_SET) || size != fread(ptr, 1, size, _file.get())) {
+                _physical_pos = UINT64_MAX;
+                return 0 != ferror(_file.get()) ? ferror(_file.get()) : -1 /*EOF*/;
+            }
+            _physical_pos = UINT64_MAX;
+            _statistic.read_bytes += size;
+            _pos += size;
+            ptr += size;
+            bytes -= size;
+        }
+        return 0;
+    }
+    if (_read_ahead) {
+        adviseReadAhead();
+    }
     if (bytes == fread(data, 1, bytes, _file.get())){
+        _statistic.read_bytes += bytes;
         return 0;
     }
     return 0 != ferror(_file.get()) ? ferror(_file.get()) : -1 /*EOF*/;
 }
 
+void MP4FileDisk::setReadAhead(size_t bytes) {
+    _read_ahead = bytes;
+    _advised_begin = _advised_end = 0;
+#if defined(__linux__) || defined(__linux)
+    if (_file && bytes) {
+        // 加大内核对该文件的预读窗口
+        // Enlarge the kernel read-ahead window of this file
+        posix_fadvise(fileno(_file.get()), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+}
+
+int MP4FileDisk::readAt(uint64_t offset, void *data, size_t bytes) {
+    // 顺序读取时不seek，避免丢弃文件io缓存
+    // Do not seek when reading sequentially, to avoid discarding the file io cache
+    if ((uint64_t)ftell64(_file.get()) != offset && onSeek(offset)) {
+        return -1;
+    }
+    return onRead(data, bytes);
+}
+
+void MP4FileDisk::adviseReadAhead() {
+#if defined(__linux__) || defined(__linux)
+    uint64_t pos = ftell64(_file.get());
+    if (pos >= _advised_begin && pos + _read_ahead / 2 <= _advised_end) {
+        return;
+    }
+    // 发生了seek或者已提示的数据剩余不足一半，提示内核异步加载后续数据，避免fread阻塞在磁盘io上
+    // A seek happened or less than half of the hinted data remains, hint the kernel to load the following data
+    // asynchronously so that fread does not block on disk io
+    posix_fadvise(fileno(_file.get()), pos, _read_ahead, POSIX_FADV_WILLNEED);
+    _advised_begin = pos;
+    _advised_end = pos + _read_ahead;
+#endif
+}
+
 int MP4FileDisk::onWrite(const void *data, size_t bytes) {
+    auto ret = writeData(data, bytes);
+    if (_disk) {
+        // 写入sample只是拷贝到stdio缓存，不计时，延时在刷新与同步时统计
+        // Writing a sample only copies it into the stdio buffer, so it is not timed, the latency is measured on flush and sync
+        _disk->onWrite(bytes, ret == 0);
+    }
+    return ret;
+}
+
+int MP4FileDisk::writeData(const void *data, size_t bytes) {
+    if (_moov_reserve) {
+        return writeReserved((const char *)data, bytes);
+    }
+    _statistic.write_bytes += bytes;
     return bytes == fwrite(data, 1, bytes, _file.get()) ? 0 : ferror(_file.get());
 }
 
 int MP4FileDisk::onSeek(uint64_t offset) {
+    if (_moov_reserve) {
+        // 实际seek推迟到读写时
+        // The actual seek is deferred until reading or writing
+        _pos = offset;
+        return 0;
+    }
     return fseek64(_file.get(), offset, SEEK_SET);
 }
 
 uint64_t MP4FileDisk::onTell() {
+    if (_moov_reserve) {
+        return _pos;
+    }
     return ftell64(_file.get());
 }
 
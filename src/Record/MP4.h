@@ -13,6 +13,7 @@
 
 #if defined(ENABLE_MP4)
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include "mp4-writer.h"
@@ -23,6 +24,7 @@
 #include "mpeg4-aac.h"
 #include "mov-buffer.h"
 #include "mov-format.h"
+#include "StoragePool.h"
 
 namespace mediakit {
 
@@ -115,6 +117,23 @@ class MP4FileDisk : public MP4FileIO {
 public:
     using Ptr = std::shared_ptr<MP4FileDisk>;
 
+    struct IOStatistic {
+        // 实际读写磁盘的字节数
+        // Bytes actually read from and written to the disk
+        uint64_t read_bytes = 0;
+        uint64_t write_bytes = 0;
+        // 头部为moov预留的大小以及moov实际大小
+        // Size reserved for moov at the head of the file, and the actual moov size
+        uint64_t moov_reserved = 0;
+        uint64_t moov_size = 0;
+        // moov是否原地写入了预留区域
+        // Whether moov was written in place into the reserved region
+        bool moov_in_place = false;
+        // 同步到磁盘的次数
+        // Number of syncs to the disk
+        uint64_t syncs = 0;
+    };
+
     /**
      * 打开磁盘文件
      * @param file 文件路径
@@ -135,6 +154,59 @@ public:
      */
     void closeFile();
 
+    /**
+     * 在ftyp之后为moov预留一个free box，需在创建复用器之前调用
+     * 复用器看到的是不含预留区域的文件，关闭时moov先写入内存，修正chunk偏移后原地写入预留区域，
+     * 预留不足时追加到文件末尾，从而避免MOV_FLAG_FASTSTART关闭时重写整个文件
+     * @param bytes 预留大小
+     * Reserve a free box for moov after ftyp, must be called before creating the muxer
+     * The muxer sees the file without the reserved region, on close moov is written to memory first,
+     * and after fixing the chunk offsets it is written in place into the reserved region,
+     * or appended to the end of the file if the reservation is too small,
+     * so that the whole file is not rewritten on close like MOV_FLAG_FASTSTART
+     * @param bytes reserved size
+     */
+    void setMoovReserve(size_t bytes);
+
+    /**
+     * 复用器即将写入moov，在销毁复用器之前调用
+     * The muxer is about to write moov, called before destroying the muxer
+     */
+    void beginWriteMoov();
+
+    /**
+     * 复用器已写完moov，将moov写入预留区域或文件末尾，在销毁复用器之后调用
+     * The muxer has finished writing moov, write it into the reserved region or the end of the file,
+     * called after destroying the muxer
+     */
+    void endWriteMoov();
+
+    /**
+     * 开启读文件预读提示，读取位置附近bytes大小的数据会提前由内核异步加载(posix_fadvise)
+     * @param bytes 预读大小
+     * Enable read-ahead hints, the kernel asynchronously loads bytes of data around the read position in advance (posix_fadvise)
+     * @param bytes read-ahead size
+     */
+    void setReadAhead(size_t bytes);
+
+    /**
+     * 从文件指定位置读取数据
+     * @return 是否成功(0成功)
+     * Read data from the specified position of the file
+     * @return Whether it is successful (0 successful)
+     */
+    int readAt(uint64_t offset, void *data, size_t bytes);
+
+    /**
+     * 将缓存的数据写入文件，并在后台线程中同步到磁盘(fdatasync)
+     * 上次同步尚未完成时只写入文件
+     * Write the buffered data to the file, and sync it to the disk (fdatasync) in a background thread
+     * Only write to the file if the last sync has not finished yet
+     */
+    void sync();
+
+    const IOStatistic &getIOStatistic() const;
+
 protected:
     uint64_t onTell() override;
     int onSeek(uint64_t offset) override;
@@ -142,7 +214,40 @@ protected:
     int onWrite(const void *data, size_t bytes) override;
 
 private:
+    uint64_t toPhysical(uint64_t offset) const;
+    int writeAt(uint64_t physical, const char *data, size_t bytes);
+    int writeReserved(const char *data, size_t bytes);
+    int writeData(const void *data, size_t bytes);
+    void adviseReadAhead();
+
+private:
+    bool _capture_moov = false;
+    bool _free_written = false;
+    size_t _moov_reserve = 0;
+    // 预留区域插入的位置(ftyp末尾)，为0时尚未确定
+    // Position where the reserved region is inserted (end of ftyp), 0 if not determined yet
+    uint64_t _insert_pos = 0;
+    // 复用器视角的读写位置与文件末尾
+    // Read/write position and end of file from the muxer's point of view
+    uint64_t _pos = 0;
+    uint64_t _end = 0;
+    uint64_t _physical_pos = 0;
+    uint64_t _moov_offset = 0;
+    // 已提示内核预读的区间
+    // Range the kernel has been hinted to read ahead
+    size_t _read_ahead = 0;
+    uint64_t _advised_begin = 0;
+    uint64_t _advised_end = 0;
+    char _ftyp_header[8];
+    std::string _moov;
+    IOStatistic _statistic;
     std::shared_ptr<FILE> _file;
+    // 文件所在的存储池磁盘，用于统计写入负载，不在存储池中时为空
+    // Disk of the storage pool where the file is, used to measure the write load, null if not in the storage pool
+    StoragePool::Disk::Ptr _disk;
+    // 后台同步是否进行中
+    // Whether a background sync is in progress
+    std::shared_ptr<std::atomic<bool> > _syncing = std::make_shared<std::atomic<bool> >(false);
 };
 
 class MP4FileMemory : public MP4FileIO{
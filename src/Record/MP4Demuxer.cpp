@@ -15,6 +15,7 @@
 #include "Util/File.h"
 #include "Util/logger.h"
 #include "Extension/Factory.h"
+#include "Common/config.h"
 
 using namespace std;
 using namespace toolkit;
@@ -30,13 +31,35 @@ void MP4Demuxer::openMP4(const string &file) {
 
     _mp4_file = std::make_shared<MP4FileDisk>();
     _mp4_file->openFile(file.data(), "rb+");
-    _mov_reader = _mp4_file->createReader();
-    getAllTracks();
-    _duration_ms = mov_reader_getduration(_mov_reader.get());
+    _index = MP4Index::load(file);
+    if (_index) {
+        for (auto &track : _index->getTracks()) {
+            if (track.type == TrackVideo) {
+                onVideoTrack(track.track_id, track.object, track.width, track.height, track.extra.data(), track.extra.size());
+            } else if (track.type == TrackAudio) {
+                onAudioTrack(track.track_id, track.object, track.channel_count, track.bit_per_sample, track.sample_rate, track.extra.data(), track.extra.size());
+            }
+        }
+        _duration_ms = _index->getDurationMS();
+    } else {
+        _mov_reader = _mp4_file->createReader();
+        getAllTracks();
+        _duration_ms = mov_reader_getduration(_mov_reader.get());
+    }
+
+    GET_CONFIG(uint32_t, readAheadMS, Record::kReadAheadMS);
+    if (readAheadMS && _duration_ms) {
+        // 按平均码率把预读时长换算为字节数
+        // Convert the read-ahead duration into bytes by the average bitrate
+        auto bytes = File::fileSize(file) * readAheadMS / _duration_ms;
+        _mp4_file->setReadAhead(MAX(MIN(bytes, 64 * 1024 * 1024), 1024 * 1024));
+    }
 }
 
 void MP4Demuxer::closeMP4() {
     _mov_reader.reset();
+    _index.reset();
+    _sample_pos = 0;
     _mp4_file.reset();
 }
 
@@ -84,6 +107,10 @@ void MP4Demuxer::onAudioTrack(uint32_t track, uint8_t object, int channel_count,
 }
 
 int64_t MP4Demuxer::seekTo(int64_t stamp_ms) {
+    if (_index) {
+        _sample_pos = _index->seek(stamp_ms);
+        return _index->getSamples()[_sample_pos].dts;
+    }
     if(0 != mov_reader_seek(_mov_reader.get(),&stamp_ms)){
         return -1;
     }
@@ -100,9 +127,44 @@ struct Context {
     BufferRaw::Ptr buffer;
 };
 
+Frame::Ptr MP4Demuxer::readIndexedFrame(bool &keyFrame, bool &eof) {
+    auto &samples = _index->getSamples();
+    if (_key_frame_only) {
+        // 跳到下一个视频关键帧，中间的sample不读取
+        // Jump to the next video key frame, the samples in between are not read
+        auto &key_frames = _index->getKeyFrames();
+        auto it = std::lower_bound(key_frames.begin(), key_frames.end(), _sample_pos);
+        _sample_pos = it == key_frames.end() ? samples.size() : *it;
+    }
+    if (_sample_pos >= samples.size()) {
+        eof = true;
+        return nullptr;
+    }
+    auto &sample = samples[_sample_pos++];
+    auto buffer = _buffer_pool.obtain2();
+    buffer->setCapacity(sample.size + 1);
+    buffer->setSize(sample.size);
+    if (_mp4_file->readAt(sample.offset, buffer->data(), sample.size)) {
+        eof = true;
+        _read_failed = true;
+        WarnL << "读取mp4文件数据失败, offset:" << sample.offset << ", size:" << sample.size;
+        return nullptr;
+    }
+    keyFrame = sample.key_frame;
+    return makeFrame(sample.track_id, std::move(buffer), sample.pts, sample.dts);
+}
+
+bool MP4Demuxer::readFailed() const {
+    return _read_failed;
+}
+
 Frame::Ptr MP4Demuxer::readFrame(bool &keyFrame, bool &eof) {
     keyFrame = false;
     eof = false;
+    _read_failed = false;
+    if (_index) {
+        return readIndexedFrame(keyFrame, eof);
+    }
 
     static mov_reader_onread2 mov_onalloc = [](void *param, uint32_t track_id, size_t bytes, int64_t pts, int64_t dts, int flags) -> void * {
         Context *ctx = (Context *) param;
@@ -127,11 +189,17 @@ Frame::Ptr MP4Demuxer::readFrame(bool &keyFrame, bool &eof) {
 
         case 1 : {
             keyFrame = ctx.flags & MOV_AV_FLAG_KEYFREAME;
+            if (_key_frame_only && !(keyFrame && isVideoTrack(ctx.track_id))) {
+                // 没有索引时只能读出sample后丢弃
+                // Without an index the sample can only be discarded after being read
+                return nullptr;
+            }
             return makeFrame(ctx.track_id, ctx.buffer, ctx.pts, ctx.dts);
         }
 
         default : {
             eof = true;
+            _read_failed = true;
             WarnL << "读取mp4文件数据失败:" << ret;
             return nullptr;
         }
@@ -192,6 +260,27 @@ uint64_t MP4Demuxer::getDurationMS() const {
     return _duration_ms;
 }
 
+const MP4Index::Ptr &MP4Demuxer::getIndex() const {
+    return _index;
+}
+
+void MP4Demuxer::seekToSample(size_t pos) {
+    _sample_pos = pos;
+}
+
+bool MP4Demuxer::isVideoTrack(uint32_t track_id) const {
+    auto it = _tracks.find(track_id);
+    return it != _tracks.end() && it->second->getTrackType() == TrackVideo;
+}
+
+void MP4Demuxer::setKeyFrameOnly(bool enable) {
+    auto have_video = false;
+    for (auto &pr : _tracks) {
+        have_video = have_video || pr.second->getTrackType() == TrackVideo;
+    }
+    _key_frame_only = enable && have_video;
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 
 void MultiMP4Demuxer::openMP4(const string &files_string) {
@@ -271,6 +360,12 @@ Frame::Ptr MultiMP4Demuxer::readFrame(bool &keyFrame, bool &eof) {
     }
 }
 
+void MultiMP4Demuxer::setKeyFrameOnly(bool enable) {
+    for (auto &pr : _demuxers) {
+        pr.second->setKeyFrameOnly(enable);
+    }
+}
+
 std::vector<Track::Ptr> MultiMP4Demuxer::getTracks(bool trackReady) const {
     std::vector<Track::Ptr> ret;
     for (auto &pr : _tracks) {
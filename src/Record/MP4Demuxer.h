@@ -14,6 +14,7 @@
 
 #include <map>
 #include "MP4.h"
+#include "MP4Index.h"
 #include "Extension/Track.h"
 #include "Util/ResourcePool.h"
 
@@ -69,6 +70,12 @@ public:
      */
     Frame::Ptr readFrame(bool &keyFrame, bool &eof);
 
+    /**
+     * 上次readFrame返回eof是否由读取出错导致，而不是文件正常读取完毕
+     * Whether the eof returned by the last readFrame was caused by a read error instead of the normal end of the file
+     */
+    bool readFailed() const;
+
     /**
      * 获取所有Track信息
      * @param trackReady 是否要求track为就绪状态
@@ -92,15 +99,44 @@ public:
      */
     uint64_t getDurationMS() const;
 
+    /**
+     * 获取sample索引，文件没有可用的索引时为空
+     * Get the sample index, null if the file has no usable index
+     */
+    const MP4Index::Ptr &getIndex() const;
+
+    /**
+     * 按索引定位到某个sample，下次readFrame从该sample开始读取
+     * @param pos sample下标
+     * Locate a sample by the index, the next readFrame starts reading from it
+     * @param pos sample index
+     */
+    void seekToSample(size_t pos);
+
+    /**
+     * 设置是否只读取视频关键帧(倍速快进)，有索引时直接跳过非关键帧sample，不读取其数据；没有视频时无效
+     * Set whether to read video key frames only (fast forward), samples of non key frames are skipped without reading
+     * their data if there is an index; no effect if there is no video
+     */
+    void setKeyFrameOnly(bool enable);
+
 private:
     int getAllTracks();
     void onVideoTrack(uint32_t track_id, uint8_t object, int width, int height, const void *extra, size_t bytes);
     void onAudioTrack(uint32_t track_id, uint8_t object, int channel_count, int bit_per_sample, int sample_rate, const void *extra, size_t bytes);
     Frame::Ptr makeFrame(uint32_t track_id, toolkit::Buffer::Ptr buf, int64_t pts, int64_t dts);
+    Frame::Ptr readIndexedFrame(bool &keyFrame, bool &eof);
+    bool isVideoTrack(uint32_t track_id) const;
 
 private:
     MP4FileDisk::Ptr _mp4_file;
     MP4FileDisk::Reader _mov_reader;
+    // 存在sample索引时直接按索引读取，不创建mov_reader
+    // Read by the sample index directly if it exists, no mov_reader is created
+    MP4Index::Ptr _index;
+    size_t _sample_pos = 0;
+    bool _key_frame_only = false;
+    bool _read_failed = false;
     uint64_t _duration_ms = 0;
     std::unordered_map<int, Track::Ptr> _tracks;
     toolkit::ResourcePool<toolkit::BufferRaw> _buffer_pool;
@@ -151,6 +187,12 @@ public:
      */
     uint64_t getDurationMS() const;
 
+    /**
+     * 设置所有文件是否只读取视频关键帧
+     * Set whether to read video key frames only for all the files
+     */
+    void setKeyFrameOnly(bool enable);
+
 private:
     std::map<int, Track::Ptr> _tracks;
     std::map<uint64_t, MP4Demuxer::Ptr>::iterator _it;
@@ -0,0 +1,192 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if defined(ENABLE_MP4)
+
+#include "MP4Exporter.h"
+#include "MP4Muxer.h"
+#include "Util/logger.h"
+#include "Thread/WorkThreadPool.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 纯音频时每个fmp4分片的时长
+// Duration of each fmp4 fragment for audio only
+static constexpr uint64_t kAudioFragmentMS = 1000;
+
+// 输出到内存的fmp4复用器，有视频时每个GOP一个分片，纯音频时按时长分片
+// fmp4 muxer which outputs to memory, one fragment per GOP with video, fragments by duration for audio only
+class FMP4ExportMuxer : public MP4MuxerInterface {
+public:
+    using Ptr = std::shared_ptr<FMP4ExportMuxer>;
+
+    FMP4ExportMuxer() { _memory_file = std::make_shared<MP4FileMemory>(); }
+
+    bool inputFrame(const Frame::Ptr &frame) override {
+        if (!haveVideo()) {
+            if (frame->dts() < _fragment_dts) {
+                _fragment_dts = frame->dts();
+            } else if (frame->dts() - _fragment_dts >= kAudioFragmentMS) {
+                saveSegment();
+                _fragment_dts = frame->dts();
+            }
+        }
+        return MP4MuxerInterface::inputFrame(frame);
+    }
+
+    // 复用器只在分片完成时写入数据，取出的总是完整的box
+    // The muxer only writes data when a fragment is completed, so complete boxes are always taken
+    string getAndClearMemory() { return _memory_file->getAndClearMemory(); }
+
+protected:
+    MP4FileIO::Writer createWriter() override { return _memory_file->createWriter(MOV_FLAG_SEGMENT, true); }
+
+private:
+    uint64_t _fragment_dts = 0;
+    MP4FileMemory::Ptr _memory_file;
+};
+
+// 边生成边输出的fmp4 body，每次读取时在固定的后台线程中读取sample直到攒够数据
+// fmp4 body which outputs data while it is being produced, samples are read in a fixed background thread
+// on every read until enough data is collected
+class FMP4ExportBody : public HttpBody {
+public:
+    FMP4ExportBody(MP4Exporter::Ptr exporter, FMP4ExportMuxer::Ptr muxer) {
+        _exporter = std::move(exporter);
+        _muxer = std::move(muxer);
+        _executor = WorkThreadPool::Instance().getExecutor();
+        // 先输出init segment(ftyp + moov)
+        // Output the init segment (ftyp + moov) first
+        _muxer->initSegment();
+        _muxer->saveSegment();
+        _data = _muxer->getAndClearMemory();
+    }
+
+    int64_t remainSize() override { return -1; }
+
+    Buffer::Ptr readData(size_t size) override {
+        while (_data.size() - _offset < size && !_eof) {
+            if (!_exporter->readFrame()) {
+                _eof = true;
+                _muxer->flush();
+                _muxer->saveSegment();
+            }
+            auto data = _muxer->getAndClearMemory();
+            if (data.empty()) {
+                continue;
+            }
+            if (_offset) {
+                _data.erase(0, _offset);
+                _offset = 0;
+            }
+            _data.append(data);
+        }
+        if (_offset == _data.size()) {
+            return nullptr;
+        }
+        auto bytes = MIN(size, _data.size() - _offset);
+        auto ret = std::make_shared<BufferString>(_data.substr(_offset, bytes));
+        _offset += bytes;
+        return ret;
+    }
+
+    void readDataAsync(size_t size, const function<void(const Buffer::Ptr &buf)> &cb) override {
+        weak_ptr<HttpBody> weak_self = shared_from_this();
+        _executor->async([weak_self, size, cb]() {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            cb(strong_self->readData(size));
+        });
+    }
+
+private:
+    bool _eof = false;
+    size_t _offset = 0;
+    string _data;
+    MP4Exporter::Ptr _exporter;
+    FMP4ExportMuxer::Ptr _muxer;
+    EventPoller::Ptr _executor;
+};
+
+MP4Exporter::MP4Exporter(const string &files) {
+    _demuxer.openMP4(files);
+    _end_ms = _demuxer.getDurationMS();
+}
+
+uint64_t MP4Exporter::getDurationMS() const {
+    return _demuxer.getDurationMS();
+}
+
+bool MP4Exporter::setRange(uint64_t start_ms, uint64_t end_ms) {
+    if (start_ms >= end_ms || _demuxer.seekTo(start_ms) < 0) {
+        return false;
+    }
+    _end_ms = end_ms;
+    return true;
+}
+
+void MP4Exporter::setSink(const std::shared_ptr<MediaSinkInterface> &sink) {
+    _sink = sink;
+    size_t tracks = 0;
+    for (auto &track : _demuxer.getTracks(false)) {
+        if (!_sink->addTrack(track)) {
+            continue;
+        }
+        ++tracks;
+        track->addDelegate([this](const Frame::Ptr &frame) {
+            if (frame->dts() >= _end_ms) {
+                // 导出区间之后的帧(如末尾帧之后的b帧)丢弃
+                // Frames after the export range are dropped
+                return false;
+            }
+            ++_frames;
+            return _sink->inputFrame(frame);
+        });
+    }
+    if (!tracks) {
+        throw std::runtime_error("no supported track in mp4 file");
+    }
+}
+
+bool MP4Exporter::readFrame() {
+    bool key_frame = false;
+    bool eof = false;
+    auto frame = _demuxer.readFrame(key_frame, eof);
+    if (eof || (frame && frame->dts() >= _end_ms)) {
+        InfoL << "Export mp4 finished, frames: " << _frames;
+        return false;
+    }
+    return true;
+}
+
+void MP4Exporter::exportFile(const string &path) {
+    auto muxer = std::make_shared<MP4Muxer>();
+    muxer->setFmp4(false);
+    muxer->openMP4(path);
+    setSink(muxer);
+    while (readFrame()) {
+    }
+    muxer->flush();
+    muxer->closeMP4();
+}
+
+HttpBody::Ptr MP4Exporter::exportFmp4() {
+    auto muxer = std::make_shared<FMP4ExportMuxer>();
+    setSink(muxer);
+    return std::make_shared<FMP4ExportBody>(shared_from_this(), muxer);
+}
+
+} // namespace mediakit
+#endif // defined(ENABLE_MP4)
@@ -0,0 +1,97 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MP4EXPORTER_H
+#define ZLMEDIAKIT_MP4EXPORTER_H
+
+#if defined(ENABLE_MP4)
+
+#include <memory>
+#include <string>
+#include "MP4Demuxer.h"
+#include "Common/MediaSink.h"
+#include "Http/HttpBody.h"
+
+namespace mediakit {
+
+/**
+ * 录像片段导出
+ * 从多个连续的mp4录像文件中按磁盘速度读取sample并复制到新的mp4/fmp4，不解码也不按实时速度回放；
+ * 导出起点向前对齐到关键帧
+ * Recording clip exporter
+ * Samples are read from several consecutive mp4 recordings at disk speed and copied into a new mp4/fmp4,
+ * without decoding or replaying in real time; the start of the clip is aligned backward to a key frame
+ */
+class MP4Exporter : public std::enable_shared_from_this<MP4Exporter> {
+public:
+    using Ptr = std::shared_ptr<MP4Exporter>;
+
+    /**
+     * 打开录像文件，失败时抛异常
+     * @param files 按时间顺序排列的mp4文件，以分号分隔
+     * Open the recordings, an exception is thrown on failure
+     * @param files mp4 files in time order, separated by semicolons
+     */
+    MP4Exporter(const std::string &files);
+
+    /**
+     * 所有文件的总时长，单位毫秒
+     * Total duration of all the files in milliseconds
+     */
+    uint64_t getDurationMS() const;
+
+    /**
+     * 设置导出区间，时间戳相对于第一个文件开头
+     * @param start_ms 导出开始位置，单位毫秒
+     * @param end_ms 导出结束位置，单位毫秒
+     * @return 区间超出文件范围时返回false
+     * Set the export range, the timestamps are relative to the beginning of the first file
+     * @param start_ms start position in milliseconds
+     * @param end_ms end position in milliseconds
+     * @return false if the range is out of the files
+     */
+    bool setRange(uint64_t start_ms, uint64_t end_ms);
+
+    /**
+     * 导出为普通mp4文件，阻塞直到完成，失败时抛异常
+     * @param path 输出文件路径
+     * Export as a plain mp4 file, it blocks until finished, an exception is thrown on failure
+     * @param path output file path
+     */
+    void exportFile(const std::string &path);
+
+    /**
+     * 导出为fmp4，返回边生成边输出的http body，数据在读取时于后台线程生成
+     * Export as fmp4, return an http body which outputs data while it is being produced,
+     * the data is produced in a background thread when read
+     */
+    HttpBody::Ptr exportFmp4();
+
+private:
+    friend class FMP4ExportBody;
+    /**
+     * 读取一帧并输入到sink
+     * @return 到达导出区间末尾时返回false
+     * Read a frame and input it into the sink
+     * @return false when the end of the export range is reached
+     */
+    bool readFrame();
+    void setSink(const std::shared_ptr<MediaSinkInterface> &sink);
+
+private:
+    uint64_t _end_ms = 0;
+    uint64_t _frames = 0;
+    MultiMP4Demuxer _demuxer;
+    std::shared_ptr<MediaSinkInterface> _sink;
+};
+
+} // namespace mediakit
+#endif // defined(ENABLE_MP4)
+#endif // ZLMEDIAKIT_MP4EXPORTER_H
@@ -0,0 +1,190 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if defined(ENABLE_MP4) && defined(ENABLE_HLS)
+
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include "MP4HlsPackager.h"
+#include "MP4Demuxer.h"
+#include "MPEG.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+static const string kMP4Suffix = ".mp4/";
+static const string kPlaylist = "index.m3u8";
+static const string kSegmentSuffix = ".ts";
+
+struct Segment {
+    // 第一个sample的下标
+    // Index of the first sample
+    size_t begin = 0;
+    // 单位毫秒
+    // In milliseconds
+    int64_t duration = 0;
+};
+
+// 在关键帧处按hls.segDur划分切片，第一个切片从第一个sample开始
+// Split segments at keyframes by hls.segDur, the first segment starts from the first sample
+static vector<Segment> makeSegments(const MP4Index &index) {
+    GET_CONFIG(float, segDur, Hls::kSegmentDuration);
+    auto target = (int64_t)(MAX(segDur, 1.0f) * 1000);
+    auto &samples = index.getSamples();
+    vector<Segment> ret;
+    if (samples.empty()) {
+        return ret;
+    }
+    ret.emplace_back();
+    auto start = samples[0].dts;
+    for (auto pos : index.getKeyFrames()) {
+        auto dts = samples[pos].dts;
+        if (pos == 0 || dts - start < target) {
+            continue;
+        }
+        ret.back().duration = dts - start;
+        ret.emplace_back();
+        ret.back().begin = pos;
+        start = dts;
+    }
+    ret.back().duration = MAX((int64_t)index.getDurationMS() - start, (int64_t)0);
+    return ret;
+}
+
+static string makePlaylist(const vector<Segment> &segments) {
+    int64_t max_duration = 0;
+    for (auto &seg : segments) {
+        max_duration = MAX(max_duration, seg.duration);
+    }
+    string index_str;
+    index_str.reserve(2048);
+    index_str += "#EXTM3U\n";
+    index_str += "#EXT-X-VERSION:3\n";
+    index_str += "#EXT-X-TARGETDURATION:" + std::to_string((max_duration + 999) / 1000) + "\n";
+    index_str += "#EXT-X-MEDIA-SEQUENCE:0\n";
+    index_str += "#EXT-X-PLAYLIST-TYPE:VOD\n";
+
+    stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        ss << "#EXTINF:" << segments[i].duration / 1000.0 << ",\n" << i << kSegmentSuffix << "\n";
+    }
+    index_str += ss.str();
+    index_str += "#EXT-X-ENDLIST\n";
+    return index_str;
+}
+
+class TSWriter : public MpegMuxer {
+public:
+    TSWriter(string &out) : MpegMuxer(false), _out(out) {}
+
+protected:
+    void onWrite(std::shared_ptr<Buffer> buffer, uint64_t timestamp, bool key_pos) override {
+        if (buffer) {
+            _out.append(buffer->data(), buffer->size());
+        }
+    }
+
+private:
+    string &_out;
+};
+
+static bool makeSegment(MP4Demuxer &demuxer, TSWriter &writer, const Segment &seg, size_t end) {
+    for (auto &track : demuxer.getTracks(false)) {
+        if (!writer.addTrack(track)) {
+            continue;
+        }
+        track->addDelegate([&writer](const Frame::Ptr &frame) { return writer.inputFrame(frame); });
+    }
+    // 从索引定位切片的第一个sample，顺序读取到下个切片开始，帧经track拆分后输出到ts
+    // Locate the first sample of the segment by the index and read until the next segment starts,
+    // frames are split by the tracks and then muxed into ts
+    demuxer.seekToSample(seg.begin);
+    for (auto pos = seg.begin; pos < end; ++pos) {
+        bool key_frame = false;
+        bool eof = false;
+        demuxer.readFrame(key_frame, eof);
+        if (eof) {
+            return false;
+        }
+    }
+    writer.flush();
+    return true;
+}
+
+bool MP4HlsPackager::parsePath(const string &file_path, string &mp4_file, string &resource) {
+    GET_CONFIG(bool, enable, Hls::kMP4Vod);
+    if (!enable) {
+        return false;
+    }
+    auto pos = file_path.rfind(kMP4Suffix);
+    if (pos == string::npos) {
+        return false;
+    }
+    resource = file_path.substr(pos + kMP4Suffix.size());
+    if (resource != kPlaylist) {
+        if (!end_with(resource, kSegmentSuffix) || resource.size() == kSegmentSuffix.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < resource.size() - kSegmentSuffix.size(); ++i) {
+            if (!isdigit((uint8_t)resource[i])) {
+                return false;
+            }
+        }
+    }
+    mp4_file = file_path.substr(0, pos + kMP4Suffix.size() - 1);
+    return File::fileExist(mp4_file) && !File::is_dir(mp4_file);
+}
+
+bool MP4HlsPackager::make(const string &mp4_file, const string &resource, string &content) {
+    // 先于demuxer构造，确保track持有的delegate先析构
+    // Constructed before the demuxer so that the delegates held by tracks are destroyed first
+    TSWriter writer(content);
+    MP4Demuxer demuxer;
+    try {
+        demuxer.openMP4(mp4_file);
+    } catch (std::exception &ex) {
+        WarnL << "Open mp4 file failed: " << mp4_file << ", " << ex.what();
+        return false;
+    }
+    auto index = demuxer.getIndex();
+    if (!index) {
+        // hls点播依赖录制时生成的sample索引
+        // Hls vod depends on the sample index generated while recording
+        WarnL << "Mp4 file has no sample index, hls vod is not available: " << mp4_file;
+        return false;
+    }
+    auto segments = makeSegments(*index);
+    if (resource == kPlaylist) {
+        content = makePlaylist(segments);
+        return !segments.empty();
+    }
+
+    auto seq = strtoull(resource.data(), nullptr, 10);
+    if (seq >= segments.size()) {
+        return false;
+    }
+    auto end = seq + 1 < segments.size() ? segments[seq + 1].begin : index->getSamples().size();
+    if (!makeSegment(demuxer, writer, segments[seq], end)) {
+        WarnL << "Read mp4 file failed: " << mp4_file << ", segment: " << seq;
+        return false;
+    }
+    return true;
+}
+
+} // namespace mediakit
+#endif // defined(ENABLE_MP4) && defined(ENABLE_HLS)
@@ -0,0 +1,64 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MP4HLSPACKAGER_H
+#define ZLMEDIAKIT_MP4HLSPACKAGER_H
+
+#if defined(ENABLE_MP4) && defined(ENABLE_HLS)
+
+#include <string>
+
+namespace mediakit {
+
+/**
+ * mp4录像的hls点播即时打包
+ * 根据mp4的sample索引生成m3u8，请求ts切片时直接按索引读取该切片的sample并封装为ts，
+ * 无需通过MP4Reader实时回放，可任意seek并以超过实时的速度下载，生成的内容可被cdn缓存
+ * 访问地址为 xxx.mp4/index.m3u8 与 xxx.mp4/{n}.ts
+ * Just-in-time hls packager for vod of mp4 recordings
+ * The m3u8 is generated from the sample index of the mp4, and a ts segment is muxed directly from its samples
+ * read by the index when requested, without real time replaying through MP4Reader, so it can be seeked freely
+ * and downloaded faster than real time, and the generated content can be cached by cdn
+ * The urls are xxx.mp4/index.m3u8 and xxx.mp4/{n}.ts
+ */
+class MP4HlsPackager {
+public:
+    /**
+     * 解析点播资源路径
+     * @param file_path 请求的文件路径
+     * @param mp4_file 返回mp4文件路径
+     * @param resource 返回资源名(index.m3u8或{n}.ts)
+     * @return 不是mp4 hls点播请求或未开启时返回false
+     * Parse the path of a vod resource
+     * @param file_path requested file path
+     * @param mp4_file returns the mp4 file path
+     * @param resource returns the resource name (index.m3u8 or {n}.ts)
+     * @return false if it is not an mp4 hls vod request or it is disabled
+     */
+    static bool parsePath(const std::string &file_path, std::string &mp4_file, std::string &resource);
+
+    /**
+     * 生成m3u8或ts切片，会读取文件，请勿在网络线程调用
+     * @param mp4_file mp4文件路径
+     * @param resource 资源名
+     * @param content 返回生成的内容
+     * @return mp4文件没有可用的索引或切片不存在时返回false
+     * Generate the m3u8 or a ts segment, it reads the file so do not call it on network threads
+     * @param mp4_file mp4 file path
+     * @param resource resource name
+     * @param content returns the generated content
+     * @return false if the mp4 file has no usable index or the segment does not exist
+     */
+    static bool make(const std::string &mp4_file, const std::string &resource, std::string &content);
+};
+
+} // namespace mediakit
+#endif // defined(ENABLE_MP4) && defined(ENABLE_HLS)
+#endif // ZLMEDIAKIT_MP4HLSPACKAGER_H
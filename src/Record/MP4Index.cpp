@@ -0,0 +1,466 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if defined(ENABLE_MP4)
+
+#include <list>
+#include <mutex>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <sys/stat.h>
+#include "MP4Index.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Extension/Frame.h"
+#include "Common/config.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseek
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 索引文件格式版本，格式变化时递增，旧版本的索引会被忽略
+// Version of the index file format, increase it when the format changes, indexes of old versions are ignored
+static constexpr uint32_t kIndexVersion = 1;
+static constexpr char kIndexMagic[] = "ZLMI";
+
+static bool statFile(const string &path, uint64_t &size, uint64_t &mtime) {
+    struct stat st;
+    if (stat(path.data(), &st) != 0) {
+        return false;
+    }
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+static void putLE(string &out, uint64_t val, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out.push_back((char)(val >> (8 * i)));
+    }
+}
+
+// 带越界检查的小端读取
+// Little-endian reader with bounds checking
+class IndexCursor {
+public:
+    IndexCursor(const string &data) : _data(data) {}
+
+    uint64_t get(size_t bytes) {
+        if (!check(bytes)) {
+            return 0;
+        }
+        uint64_t ret = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            ret |= (uint64_t)(uint8_t)_data[_pos + i] << (8 * i);
+        }
+        _pos += bytes;
+        return ret;
+    }
+
+    string getString(size_t bytes) {
+        if (!check(bytes)) {
+            return "";
+        }
+        _pos += bytes;
+        return _data.substr(_pos - bytes, bytes);
+    }
+
+    bool ok() const { return _ok; }
+
+private:
+    bool check(size_t bytes) {
+        if (_ok && _pos + bytes > _data.size()) {
+            _ok = false;
+        }
+        return _ok;
+    }
+
+private:
+    bool _ok = true;
+    size_t _pos = 0;
+    const string &_data;
+};
+
+// 已解析索引的lru缓存，总大小受record.indexCacheSize限制
+// Lru cache of parsed indexes, the total size is limited by record.indexCacheSize
+class MP4IndexCache {
+public:
+    static MP4IndexCache &Instance();
+
+    MP4Index::Ptr get(const string &path, uint64_t size, uint64_t mtime) {
+        lock_guard<mutex> lck(_mtx);
+        auto it = _entries.find(path);
+        if (it == _entries.end() || it->second.size != size || it->second.mtime != mtime) {
+            ++_statistic.misses;
+            return nullptr;
+        }
+        _lru.splice(_lru.begin(), _lru, it->second.lru);
+        ++_statistic.hits;
+        return it->second.index;
+    }
+
+    void put(const string &path, uint64_t size, uint64_t mtime, const MP4Index::Ptr &index) {
+        GET_CONFIG(size_t, cacheSizeMB, Record::kIndexCacheSize);
+        size_t bytes = index->getSamples().size() * sizeof(MP4Index::Sample);
+        for (auto &track : index->getTracks()) {
+            bytes += sizeof(track) + track.extra.size();
+        }
+        lock_guard<mutex> lck(_mtx);
+        ++_statistic.loads;
+        erase_l(path);
+        if (bytes > cacheSizeMB * 1024 * 1024) {
+            return;
+        }
+        auto &entry = _entries[path];
+        entry.index = index;
+        entry.size = size;
+        entry.mtime = mtime;
+        entry.bytes = bytes;
+        _lru.emplace_front(path);
+        entry.lru = _lru.begin();
+        _bytes += bytes;
+        while (_bytes > cacheSizeMB * 1024 * 1024 && !_lru.empty()) {
+            erase_l(_lru.back());
+        }
+    }
+
+    void erase(const string &path) {
+        lock_guard<mutex> lck(_mtx);
+        erase_l(path);
+    }
+
+    void onSave() {
+        lock_guard<mutex> lck(_mtx);
+        ++_statistic.saves;
+    }
+
+    MP4Index::Statistic getStatistic() {
+        lock_guard<mutex> lck(_mtx);
+        auto ret = _statistic;
+        ret.items = _entries.size();
+        ret.bytes = _bytes;
+        return ret;
+    }
+
+private:
+    MP4IndexCache() = default;
+
+    void erase_l(const string &path) {
+        auto it = _entries.find(path);
+        if (it == _entries.end()) {
+            return;
+        }
+        _bytes -= it->second.bytes;
+        _lru.erase(it->second.lru);
+        _entries.erase(it);
+    }
+
+private:
+    struct Entry {
+        uint64_t size = 0;
+        uint64_t mtime = 0;
+        size_t bytes = 0;
+        MP4Index::Ptr index;
+        list<string>::iterator lru;
+    };
+
+    mutex _mtx;
+    size_t _bytes = 0;
+    MP4Index::Statistic _statistic;
+    // 最近访问的在前
+    // Most recently used first
+    list<string> _lru;
+    unordered_map<string, Entry> _entries;
+};
+
+INSTANCE_IMP(MP4IndexCache);
+
+void MP4Index::addTrack(Track track) {
+    _tracks.emplace_back(std::move(track));
+}
+
+void MP4Index::addSample(uint32_t track_id, size_t size, int64_t pts, int64_t dts, bool key_frame) {
+    Sample sample;
+    sample.offset = _mdat_size;
+    sample.size = (uint32_t)size;
+    sample.track_id = track_id;
+    sample.dts = dts;
+    sample.pts = pts;
+    sample.key_frame = key_frame;
+    _samples.emplace_back(sample);
+    _mdat_size += size;
+}
+
+bool MP4Index::finish(const string &file) {
+    if (_samples.empty()) {
+        return false;
+    }
+    std::shared_ptr<FILE> fp(File::create_file(file, "rb"), [](FILE *fp) {
+        if (fp) {
+            fclose(fp);
+        }
+    });
+    if (!fp) {
+        return false;
+    }
+    auto file_size = File::fileSize(fp.get());
+    // 遍历顶层box查找mdat，普通mp4、faststart与预留moov的文件中sample都连续存放在唯一的mdat中
+    // Walk the top level boxes to find mdat, samples are stored contiguously in the only mdat
+    // for plain mp4, faststart and moov reserved files
+    uint64_t pos = 0;
+    uint64_t mdat = 0;
+    while (pos + 8 <= file_size) {
+        uint8_t header[16];
+        if (fseek64(fp.get(), pos, SEEK_SET) || fread(header, 1, 8, fp.get()) != 8) {
+            break;
+        }
+        uint64_t box_size = ((uint64_t)header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+        uint64_t header_size = 8;
+        if (box_size == 1) {
+            if (fread(header + 8, 1, 8, fp.get()) != 8) {
+                break;
+            }
+            box_size = 0;
+            for (int i = 8; i < 16; ++i) {
+                box_size = (box_size << 8) | header[i];
+            }
+            header_size = 16;
+        } else if (box_size == 0) {
+            box_size = file_size - pos;
+        }
+        if (box_size < header_size) {
+            break;
+        }
+        if (!memcmp(header + 4, "mdat", 4)) {
+            if (box_size - header_size == _mdat_size) {
+                mdat = pos + header_size;
+            }
+            break;
+        }
+        pos += box_size;
+    }
+    if (!mdat) {
+        WarnL << "The layout of mp4 file does not match its index: " << file;
+        return false;
+    }
+
+    unordered_map<uint32_t, int64_t> last_dts, last_delta;
+    for (auto &sample : _samples) {
+        sample.offset += mdat;
+        auto it = last_dts.find(sample.track_id);
+        if (it != last_dts.end()) {
+            last_delta[sample.track_id] = sample.dts - it->second;
+        }
+        last_dts[sample.track_id] = sample.dts;
+    }
+    // 与mov一致，最后一个sample的时长取前一个sample的时长
+    // Consistent with mov, the duration of the last sample is that of the previous sample
+    for (auto &pr : last_dts) {
+        auto duration = pr.second + last_delta[pr.first];
+        _duration_ms = MAX(_duration_ms, (uint64_t)MAX(duration, (int64_t)0));
+    }
+    buildKeyFrames();
+    return true;
+}
+
+bool MP4Index::save(const string &mp4_file) {
+    uint64_t file_size, file_mtime;
+    if (_samples.empty() || !statFile(mp4_file, file_size, file_mtime)) {
+        return false;
+    }
+    string out;
+    out.reserve(64 + _samples.size() * 29);
+    out.append(kIndexMagic, 4);
+    putLE(out, kIndexVersion, 4);
+    putLE(out, file_size, 8);
+    putLE(out, file_mtime, 8);
+    putLE(out, _duration_ms, 8);
+    putLE(out, _tracks.size(), 4);
+    for (auto &track : _tracks) {
+        putLE(out, track.track_id, 4);
+        putLE(out, track.type, 1);
+        putLE(out, track.object, 1);
+        putLE(out, (uint32_t)track.width, 4);
+        putLE(out, (uint32_t)track.height, 4);
+        putLE(out, (uint32_t)track.channel_count, 4);
+        putLE(out, (uint32_t)track.bit_per_sample, 4);
+        putLE(out, (uint32_t)track.sample_rate, 4);
+        putLE(out, track.extra.size(), 4);
+        out.append(track.extra);
+    }
+    putLE(out, _samples.size(), 8);
+    for (auto &sample : _samples) {
+        putLE(out, sample.offset, 8);
+        putLE(out, sample.size, 4);
+        putLE(out, sample.track_id, 4);
+        putLE(out, (uint64_t)sample.dts, 8);
+        putLE(out, (uint32_t)(int32_t)(sample.pts - sample.dts), 4);
+        putLE(out, sample.key_frame, 1);
+    }
+
+    // 先写临时文件再改名，防止读到不完整的索引
+    // Write a temporary file and then rename it, so that an incomplete index is never read
+    auto path = indexPath(mp4_file);
+    auto tmp = path + ".tmp";
+    auto fp = File::create_file(tmp, "wb");
+    if (!fp) {
+        WarnL << "Create mp4 index file failed: " << tmp;
+        return false;
+    }
+    auto ok = fwrite(out.data(), 1, out.size(), fp) == out.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp.data(), path.data()) != 0) {
+        WarnL << "Write mp4 index file failed: " << path;
+        File::delete_file(tmp);
+        return false;
+    }
+    MP4IndexCache::Instance().onSave();
+    return true;
+}
+
+bool MP4Index::parse(const string &data, uint64_t file_size, uint64_t file_mtime) {
+    IndexCursor cursor(data);
+    if (cursor.getString(4) != string(kIndexMagic, 4) || cursor.get(4) != kIndexVersion) {
+        return false;
+    }
+    // 索引生成后mp4文件被修改
+    // The mp4 file was modified after the index was generated
+    if (cursor.get(8) != file_size || cursor.get(8) != file_mtime) {
+        return false;
+    }
+    _duration_ms = cursor.get(8);
+    auto track_count = cursor.get(4);
+    for (uint64_t i = 0; i < track_count && cursor.ok(); ++i) {
+        Track track;
+        track.track_id = (uint32_t)cursor.get(4);
+        track.type = (uint8_t)cursor.get(1);
+        track.object = (uint8_t)cursor.get(1);
+        track.width = (int)cursor.get(4);
+        track.height = (int)cursor.get(4);
+        track.channel_count = (int)cursor.get(4);
+        track.bit_per_sample = (int)cursor.get(4);
+        track.sample_rate = (int)cursor.get(4);
+        track.extra = cursor.getString((size_t)cursor.get(4));
+        _tracks.emplace_back(std::move(track));
+    }
+    auto sample_count = cursor.get(8);
+    // 每个sample占29字节
+    // Each sample takes 29 bytes
+    if (!cursor.ok() || sample_count > data.size() / 29) {
+        return false;
+    }
+    _samples.resize((size_t)sample_count);
+    for (auto &sample : _samples) {
+        sample.offset = cursor.get(8);
+        sample.size = (uint32_t)cursor.get(4);
+        sample.track_id = (uint32_t)cursor.get(4);
+        sample.dts = (int64_t)cursor.get(8);
+        sample.pts = sample.dts + (int32_t)cursor.get(4);
+        sample.key_frame = cursor.get(1) != 0;
+        if (sample.offset + sample.size > file_size) {
+            return false;
+        }
+    }
+    if (!cursor.ok() || _samples.empty()) {
+        return false;
+    }
+    buildKeyFrames();
+    return true;
+}
+
+void MP4Index::buildKeyFrames() {
+    unordered_map<uint32_t, uint8_t> types;
+    bool have_video = false;
+    for (auto &track : _tracks) {
+        types[track.track_id] = track.type;
+        have_video = have_video || track.type == TrackVideo;
+    }
+    _key_frames.clear();
+    for (size_t i = 0; i < _samples.size(); ++i) {
+        auto &sample = _samples[i];
+        if (!have_video || (sample.key_frame && types[sample.track_id] == TrackVideo)) {
+            _key_frames.emplace_back((uint32_t)i);
+        }
+    }
+}
+
+size_t MP4Index::seek(int64_t stamp_ms) const {
+    if (_key_frames.empty()) {
+        return 0;
+    }
+    auto it = upper_bound(_key_frames.begin(), _key_frames.end(), stamp_ms, [this](int64_t stamp, uint32_t index) {
+        return stamp < _samples[index].dts;
+    });
+    return it == _key_frames.begin() ? *it : *prev(it);
+}
+
+MP4Index::Ptr MP4Index::load(const string &mp4_file) {
+    GET_CONFIG(bool, enableIndex, Record::kEnableIndex);
+    uint64_t file_size, file_mtime;
+    if (!enableIndex || !statFile(mp4_file, file_size, file_mtime)) {
+        return nullptr;
+    }
+    auto ret = MP4IndexCache::Instance().get(mp4_file, file_size, file_mtime);
+    if (ret) {
+        return ret;
+    }
+    auto data = File::loadFile(indexPath(mp4_file));
+    if (data.empty()) {
+        return nullptr;
+    }
+    ret = std::make_shared<MP4Index>();
+    if (!ret->parse(data, file_size, file_mtime)) {
+        WarnL << "Ignore invalid or outdated mp4 index: " << indexPath(mp4_file);
+        return nullptr;
+    }
+    MP4IndexCache::Instance().put(mp4_file, file_size, file_mtime, ret);
+    return ret;
+}
+
+string MP4Index::indexPath(const string &mp4_file) {
+    return mp4_file + ".idx";
+}
+
+void MP4Index::remove(const string &mp4_file) {
+    MP4IndexCache::Instance().erase(mp4_file);
+    File::delete_file(indexPath(mp4_file));
+}
+
+MP4Index::Statistic MP4Index::getStatistic() {
+    return MP4IndexCache::Instance().getStatistic();
+}
+
+const vector<MP4Index::Track> &MP4Index::getTracks() const {
+    return _tracks;
+}
+
+const vector<MP4Index::Sample> &MP4Index::getSamples() const {
+    return _samples;
+}
+
+const vector<uint32_t> &MP4Index::getKeyFrames() const {
+    return _key_frames;
+}
+
+uint64_t MP4Index::getDurationMS() const {
+    return _duration_ms;
+}
+
+} // namespace mediakit
+#endif // defined(ENABLE_MP4)
@@ -0,0 +1,156 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MP4INDEX_H
+#define ZLMEDIAKIT_MP4INDEX_H
+
+#if defined(ENABLE_MP4)
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace mediakit {
+
+/**
+ * mp4录像文件的sample索引
+ * 录制时由MP4Muxer生成，关闭文件后保存为mp4文件旁的二进制索引文件(xxx.mp4.idx)；
+ * 点播时MP4Demuxer优先加载该索引(进程内lru缓存)，无需解析moov即可读取sample与二分查找关键帧
+ * Sample index of a recorded mp4 file
+ * It is generated by MP4Muxer while recording and saved as a binary index file next to the mp4 file (xxx.mp4.idx)
+ * after the file is closed; MP4Demuxer prefers loading the index (lru cached in process) for vod,
+ * so samples can be read and keyframes binary searched without parsing moov
+ */
+class MP4Index {
+public:
+    using Ptr = std::shared_ptr<MP4Index>;
+
+    struct Track {
+        uint32_t track_id = 0;
+        // TrackType
+        uint8_t type = 0;
+        // mov object id
+        uint8_t object = 0;
+        int width = 0;
+        int height = 0;
+        int channel_count = 0;
+        int bit_per_sample = 0;
+        int sample_rate = 0;
+        std::string extra;
+    };
+
+    struct Sample {
+        // sample在文件中的偏移量
+        // Offset of the sample in the file
+        uint64_t offset = 0;
+        uint32_t size = 0;
+        uint32_t track_id = 0;
+        // 单位毫秒
+        // In milliseconds
+        int64_t dts = 0;
+        int64_t pts = 0;
+        bool key_frame = false;
+    };
+
+    struct Statistic {
+        size_t items = 0;
+        size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t loads = 0;
+        uint64_t saves = 0;
+    };
+
+    /**
+     * 录制时添加track
+     * Add a track while recording
+     */
+    void addTrack(Track track);
+
+    /**
+     * 录制时添加sample，sample在mdat中连续存放，偏移量先按mdat内的相对位置记录
+     * Add a sample while recording, samples are stored contiguously in mdat,
+     * the offset is recorded as the relative position in mdat first
+     */
+    void addSample(uint32_t track_id, size_t size, int64_t pts, int64_t dts, bool key_frame);
+
+    /**
+     * mp4文件关闭后，查找mdat位置并修正sample偏移量
+     * @param file 已关闭的mp4文件
+     * @return 文件布局与索引不符时返回false
+     * Find the position of mdat and fix the sample offsets after the mp4 file is closed
+     * @param file the closed mp4 file
+     * @return false if the file layout does not match the index
+     */
+    bool finish(const std::string &file);
+
+    /**
+     * 保存索引文件，mp4文件需已位于最终路径
+     * @param mp4_file mp4文件路径
+     * Save the index file, the mp4 file must already be at its final path
+     * @param mp4_file mp4 file path
+     */
+    bool save(const std::string &mp4_file);
+
+    /**
+     * 加载mp4文件的索引，优先从lru缓存获取
+     * @param mp4_file mp4文件路径
+     * @return 索引不存在或与mp4文件不匹配时返回nullptr
+     * Load the index of an mp4 file, from the lru cache first
+     * @param mp4_file mp4 file path
+     * @return nullptr if the index does not exist or does not match the mp4 file
+     */
+    static Ptr load(const std::string &mp4_file);
+
+    /**
+     * 索引文件路径
+     * Path of the index file
+     */
+    static std::string indexPath(const std::string &mp4_file);
+
+    /**
+     * 删除mp4文件的索引
+     * Delete the index of an mp4 file
+     */
+    static void remove(const std::string &mp4_file);
+
+    static Statistic getStatistic();
+
+    /**
+     * 二分查找dts不大于stamp_ms的最后一个关键帧
+     * @return sample下标
+     * Binary search the last keyframe whose dts is not greater than stamp_ms
+     * @return sample index
+     */
+    size_t seek(int64_t stamp_ms) const;
+
+    const std::vector<Track> &getTracks() const;
+    const std::vector<Sample> &getSamples() const;
+    const std::vector<uint32_t> &getKeyFrames() const;
+    uint64_t getDurationMS() const;
+
+private:
+    void buildKeyFrames();
+    bool parse(const std::string &data, uint64_t file_size, uint64_t file_mtime);
+
+private:
+    uint64_t _mdat_size = 0;
+    uint64_t _duration_ms = 0;
+    std::vector<Track> _tracks;
+    std::vector<Sample> _samples;
+    // 可seek的sample下标，有视频时为视频关键帧，否则为所有sample
+    // Indexes of seekable samples, video keyframes if there is video, otherwise all samples
+    std::vector<uint32_t> _key_frames;
+};
+
+} // namespace mediakit
+#endif // defined(ENABLE_MP4)
+#endif // ZLMEDIAKIT_MP4INDEX_H
@@ -27,17 +27,110 @@ void MP4Muxer::openMP4(const string &file) {
     _file_name = file;
     _mp4_file = std::make_shared<MP4FileDisk>();
     _mp4_file->openFile(_file_name.data(), "wb+");
+    GET_CONFIG(bool, enableIndex, Record::kEnableIndex);
+    _index = enableIndex ? std::make_shared<MP4Index>() : nullptr;
 }
 
 MP4FileIO::Writer MP4Muxer::createWriter() {
-    GET_CONFIG(bool, mp4FastStart, Record::kFastStart);
+    GET_CONFIG(int, mp4FastStart, Record::kFastStart);
     GET_CONFIG(bool, recordEnableFmp4, Record::kEnableFmp4);
-    return _mp4_file->createWriter(mp4FastStart ? MOV_FLAG_FASTSTART : 0, recordEnableFmp4);
+    auto fmp4 = _fmp4_mode < 0 ? recordEnableFmp4 : (bool)_fmp4_mode;
+    _fmp4 = fmp4;
+    _fragment_dts = 0;
+    _sync_ticker.resetTime();
+    if (fmp4) {
+        // fmp4的sample分散在多个moof/mdat中，不生成索引
+        // Samples of fmp4 are scattered in multiple moof/mdat boxes, no index is generated
+        _index = nullptr;
+    }
+    if (!fmp4 && _moov_reserve) {
+        // moov原地写入预留区域，无需MOV_FLAG_FASTSTART重写文件
+        // moov is written in place into the reserved region, no need to rewrite the file with MOV_FLAG_FASTSTART
+        _mp4_file->setMoovReserve(_moov_reserve);
+        return _mp4_file->createWriter(0, false);
+    }
+    return _mp4_file->createWriter(mp4FastStart == 1 ? MOV_FLAG_FASTSTART : 0, fmp4);
 }
 
 void MP4Muxer::closeMP4() {
+    auto opened = (bool)_mp4_file;
+    if (_mp4_file) {
+        _mp4_file->beginWriteMoov();
+    }
+    // 销毁复用器时写入moov
+    // moov is written when the muxer is destroyed
     MP4MuxerInterface::resetTracks();
+    if (_mp4_file) {
+        _mp4_file->endWriteMoov();
+        _io_statistic = _mp4_file->getIOStatistic();
+    }
     _mp4_file = nullptr;
+    if (opened && _index && !_index->finish(_file_name)) {
+        _index = nullptr;
+    }
+}
+
+void MP4Muxer::setMoovReserve(size_t bytes) {
+    _moov_reserve = bytes;
+}
+
+void MP4Muxer::setFmp4(bool enable) {
+    _fmp4_mode = enable;
+}
+
+bool MP4Muxer::isFmp4() const {
+    return _fmp4;
+}
+
+// 纯音频fmp4的分片时长，单位毫秒
+// Fragment duration of audio only fmp4 in milliseconds
+static constexpr uint64_t kAudioFragmentMS = 1000;
+
+bool MP4Muxer::inputFrame(const Frame::Ptr &frame) {
+    auto ret = MP4MuxerInterface::inputFrame(frame);
+    if (!ret || !_fmp4 || !_mp4_file) {
+        return ret;
+    }
+    if (!haveVideo()) {
+        // 有视频时复用器在每个关键帧处输出分片(每个GOP一个moof/mdat)，纯音频时按时长输出分片
+        // With video the muxer outputs a fragment at every key frame (one moof/mdat per GOP),
+        // for audio only fragments are output by duration
+        if (frame->dts() < _fragment_dts) {
+            _fragment_dts = frame->dts();
+        } else if (frame->dts() - _fragment_dts >= kAudioFragmentMS) {
+            saveSegment();
+            _fragment_dts = frame->dts();
+        }
+    }
+    GET_CONFIG(uint32_t, syncMS, Record::kFmp4SyncMS);
+    if (syncMS && _sync_ticker.elapsedTime() >= syncMS) {
+        // 复用器只在调用之间输出完整的分片，此时文件末尾总是分片边界，掉电后已同步的分片都可以正常播放
+        // The muxer only outputs complete fragments between calls, so the end of the file is always a fragment boundary,
+        // all synced fragments can be played after a power failure
+        _sync_ticker.resetTime();
+        _mp4_file->sync();
+    }
+    return ret;
+}
+
+const MP4FileDisk::IOStatistic &MP4Muxer::getIOStatistic() const {
+    return _io_statistic;
+}
+
+const MP4Index::Ptr &MP4Muxer::getIndex() const {
+    return _index;
+}
+
+void MP4Muxer::onTrack(const MP4Index::Track &track) {
+    if (_index) {
+        _index->addTrack(track);
+    }
+}
+
+void MP4Muxer::onSample(int track_id, size_t bytes, int64_t pts, int64_t dts, bool key_frame) {
+    if (_index) {
+        _index->addSample(track_id, bytes, pts, dts, key_frame);
+    }
 }
 
 void MP4Muxer::resetTracks() {
@@ -129,7 +222,9 @@ bool MP4MuxerInterface::inputFrame(const Frame::Ptr &frame) {
             track.merger.inputFrame(frame, [this, &track](uint64_t dts, uint64_t pts, const Buffer::Ptr &buffer, bool have_idr) {
                 int64_t dts_out, pts_out;
                 track.stamp.revise(dts, pts, dts_out, pts_out);
-                mp4_writer_write(_mov_writter.get(), track.track_id, buffer->data(), buffer->size(), pts_out, dts_out, have_idr ? MOV_AV_FLAG_KEYFREAME : 0);
+                if (0 == mp4_writer_write(_mov_writter.get(), track.track_id, buffer->data(), buffer->size(), pts_out, dts_out, have_idr ? MOV_AV_FLAG_KEYFREAME : 0)) {
+                    onSample(track.track_id, buffer->size(), pts_out, dts_out, have_idr);
+                }
             });
             break;
         }
@@ -137,7 +232,10 @@ bool MP4MuxerInterface::inputFrame(const Frame::Ptr &frame) {
         default: {
             int64_t dts_out, pts_out;
             track.stamp.revise(frame->dts(), frame->pts(), dts_out, pts_out);
-            mp4_writer_write(_mov_writter.get(), track.track_id, frame->data() + frame->prefixSize(), frame->size() - frame->prefixSize(), pts_out, dts_out, frame->keyFrame() ? MOV_AV_FLAG_KEYFREAME : 0);
+            auto size = frame->size() - frame->prefixSize();
+            if (0 == mp4_writer_write(_mov_writter.get(), track.track_id, frame->data() + frame->prefixSize(), size, pts_out, dts_out, frame->keyFrame() ? MOV_AV_FLAG_KEYFREAME : 0)) {
+                onSample(track.track_id, size, pts_out, dts_out, frame->keyFrame());
+            }
             break;
         }
     }
@@ -175,6 +273,12 @@ bool MP4MuxerInterface::addTrack(const Track::Ptr &track) {
     auto extra = track->getExtraData();
     auto extra_data = extra ? extra->data() : nullptr;
     auto extra_size = extra ? extra->size() : 0;
+    MP4Index::Track info;
+    info.type = track->getTrackType();
+    info.object = mp4_object;
+    if (extra_size) {
+        info.extra.assign(extra_data, extra_size);
+    }
     if (track->getTrackType() == TrackVideo) {
         auto video_track = dynamic_pointer_cast<VideoTrack>(track);
         CHECK(video_track);
@@ -186,6 +290,10 @@ bool MP4MuxerInterface::addTrack(const Track::Ptr &track) {
         _tracks[track->getIndex()].track_id = track_id;
         _have_video = true;
         _non_iframe_video_count = 0;
+        info.track_id = track_id;
+        info.width = video_track->getVideoWidth();
+        info.height = video_track->getVideoHeight();
+        onTrack(info);
     } else if (track->getTrackType() == TrackAudio) {
         auto audio_track = dynamic_pointer_cast<AudioTrack>(track);
         CHECK(audio_track);
@@ -195,6 +303,11 @@ bool MP4MuxerInterface::addTrack(const Track::Ptr &track) {
             return false;
         }
         _tracks[track->getIndex()].track_id = track_id;
+        info.track_id = track_id;
+        info.channel_count = audio_track->getAudioChannel();
+        info.bit_per_sample = audio_track->getAudioSampleBit() * audio_track->getAudioChannel();
+        info.sample_rate = audio_track->getAudioSampleRate();
+        onTrack(info);
     }
 
     // 尝试音视频同步  [AUTO-TRANSLATED:5f8b8040]
@@ -15,7 +15,9 @@
 
 #include "Common/MediaSink.h"
 #include "Common/Stamp.h"
+#include "Util/TimeTicker.h"
 #include "MP4.h"
+#include "MP4Index.h"
 
 namespace mediakit {
 
@@ -89,6 +91,18 @@ public:
 protected:
     virtual MP4FileIO::Writer createWriter() = 0;
 
+    /**
+     * 添加track成功后回调
+     * Callback after a track is added successfully
+     */
+    virtual void onTrack(const MP4Index::Track &track) {}
+
+    /**
+     * 写入sample成功后回调
+     * Callback after a sample is written successfully
+     */
+    virtual void onSample(int track_id, size_t bytes, int64_t pts, int64_t dts, bool key_frame) {}
+
 private:
     void stampSync();
 
@@ -141,12 +155,62 @@ public:
      */
     void closeMP4();
 
+    /**
+     * 在文件头部为moov预留空间，关闭时moov原地写入，需在添加track之前调用
+     * @param bytes 预留大小，为0时不预留
+     * Reserve space for moov at the head of the file so that moov is written in place on close,
+     * must be called before adding tracks
+     * @param bytes reserved size, 0 for no reservation
+     */
+    void setMoovReserve(size_t bytes);
+
+    /**
+     * 指定是否生成fmp4文件，未指定时由record.enableFmp4决定，需在添加track之前调用
+     * Specify whether to generate a fmp4 file, decided by record.enableFmp4 if not specified, must be called before adding tracks
+     */
+    void setFmp4(bool enable);
+
+    /**
+     * 当前文件是否为fmp4
+     * Whether the current file is fmp4
+     */
+    bool isFmp4() const;
+
+    /**
+     * 输入帧，fmp4录制时按record.fmp4SyncMS定期将已写入的分片同步到磁盘
+     * Input a frame, fragments written are synced to the disk periodically by record.fmp4SyncMS when recording fmp4
+     */
+    bool inputFrame(const Frame::Ptr &frame) override;
+
+    /**
+     * 获取最近一次关闭的文件的io统计
+     * Get the io statistic of the last closed file
+     */
+    const MP4FileDisk::IOStatistic &getIOStatistic() const;
+
+    /**
+     * 获取关闭文件时生成的sample索引，录制fmp4或未开启索引时为空
+     * Get the sample index generated when the file is closed, null when recording fmp4 or the index is disabled
+     */
+    const MP4Index::Ptr &getIndex() const;
+
 protected:
     MP4FileIO::Writer createWriter() override;
+    void onTrack(const MP4Index::Track &track) override;
+    void onSample(int track_id, size_t bytes, int64_t pts, int64_t dts, bool key_frame) override;
 
 private:
+    bool _fmp4 = false;
+    // 为-1时由配置决定
+    // Decided by the config when -1
+    int _fmp4_mode = -1;
+    size_t _moov_reserve = 0;
+    uint64_t _fragment_dts = 0;
+    toolkit::Ticker _sync_ticker;
     std::string _file_name;
     MP4FileDisk::Ptr _mp4_file;
+    MP4FileDisk::IOStatistic _io_statistic;
+    MP4Index::Ptr _index;
 };
 
 class MP4MuxerMemory : public MP4MuxerInterface{
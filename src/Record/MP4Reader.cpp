@@ -10,8 +10,10 @@
 
 #ifdef ENABLE_MP4
 
+#include <thread>
 #include "MP4Reader.h"
 #include "Common/config.h"
+#include "Thread/ThreadPool.h"
 #include "Thread/WorkThreadPool.h"
 #include "Util/File.h"
 
@@ -20,6 +22,264 @@ using namespace toolkit;
 
 namespace mediakit {
 
+// 预读缓存的最大帧数，防止时间戳异常时无限预读
+// Maximum number of read-ahead frames, prevent unlimited read-ahead when timestamps are abnormal
+static constexpr size_t kMaxPrefetchFrames = 16 * 1024;
+
+// mp4点播专用的读文件线程池，冷数据、网络存储等导致的磁盘io阻塞只影响这些线程，不影响poller上的其他流
+// Dedicated file reading thread pool of mp4 vod, disk io blocking caused by cold data, network storage etc.
+// only affects these threads instead of other streams on the poller
+class MP4ReadThreadPool : public TaskExecutorGetterImp {
+public:
+    static MP4ReadThreadPool &Instance();
+
+    EventPoller::Ptr getPoller() {
+        return static_pointer_cast<EventPoller>(getExecutor());
+    }
+
+private:
+    MP4ReadThreadPool() {
+        GET_CONFIG(size_t, readThreads, Record::kReadThreads);
+        auto size = readThreads ? readThreads : thread::hardware_concurrency();
+        addPoller("mp4 read", MAX(size, 1), ThreadPool::PRIORITY_LOWEST, false, false);
+    }
+};
+
+INSTANCE_IMP(MP4ReadThreadPool);
+
+// 在读文件线程中按时长提前解复用mp4，poller线程只从缓存取帧，不再阻塞于fread
+// Demultiplex the mp4 in advance by duration in the file reading thread,
+// the poller thread only takes frames from the cache and no longer blocks on fread
+class MP4Prefetcher : public std::enable_shared_from_this<MP4Prefetcher> {
+public:
+    MP4Prefetcher(MultiMP4Demuxer::Ptr demuxer, uint32_t read_ahead_ms) {
+        _read_ahead_ms = read_ahead_ms;
+        _demuxer = std::move(demuxer);
+        // 同一个文件始终在同一个线程读取
+        // The same file is always read in the same thread
+        _poller = MP4ReadThreadPool::Instance().getPoller();
+    }
+
+    /**
+     * 缓存不足时在读文件线程中继续预读
+     * @param speed 播放倍速，倍速播放时按比例加大预读时长
+     * Continue reading ahead in the file reading thread when the cache is insufficient
+     * @param speed playback speed, the read-ahead duration is enlarged proportionally
+     */
+    void prefetch(float speed) {
+        auto window_ms = (uint32_t)(_read_ahead_ms * MAX(speed, 1.0f));
+        uint32_t generation;
+        {
+            lock_guard<mutex> lck(_mtx);
+            if (_reading || _eof || isFull(window_ms)) {
+                return;
+            }
+            _reading = true;
+            generation = _generation;
+        }
+        weak_ptr<MP4Prefetcher> weak_self = shared_from_this();
+        _poller->async([weak_self, generation, window_ms]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->readFrames(generation, window_ms);
+            }
+        });
+    }
+
+    /**
+     * 取出dts小于stamp的帧
+     * @param stamp 当前播放时间戳
+     * @param last_dts 最后取出帧的dts
+     * @param frames 取出的帧
+     * @param eof 文件是否已读完且缓存已取空
+     * @return 缓存已空但文件未读完时返回false(预读不及时)，seek中返回true
+     * Take out the frames whose dts is less than stamp
+     * @param stamp current playback timestamp
+     * @param last_dts dts of the last frame taken out
+     * @param frames frames taken out
+     * @param eof whether the file has been read completely and the cache is empty
+     * @return false if the cache is empty but the file has not been read completely (read-ahead is late), true while seeking
+     */
+    bool pop(uint32_t stamp, uint32_t &last_dts, vector<Frame::Ptr> &frames, bool &eof) {
+        lock_guard<mutex> lck(_mtx);
+        if (_seeking) {
+            // seek结果处理前不输出seek后读取的帧
+            // Do not output the frames read after seeking before the seek result is handled
+            return true;
+        }
+        while (last_dts < stamp) {
+            if (_frames.empty()) {
+                eof = _eof;
+                return eof;
+            }
+            frames.emplace_back(std::move(_frames.front()));
+            _frames.pop_front();
+            last_dts = frames.back()->dts();
+        }
+        return true;
+    }
+
+    // seek完成回调，stamp为-1表示seek失败，key_frame为定位到的关键帧(无视频时为空)
+    // Seek completion callback, stamp is -1 if the seek failed, key_frame is the located key frame (empty without video)
+    using onSeek = function<void(uint32_t generation, int64_t stamp, const Frame::Ptr &key_frame)>;
+
+    /**
+     * 丢弃预读的数据，在读文件线程中seek，有视频时定位到下一个关键帧，完成后在读文件线程回调
+     * @param stamp_seek seek的时间戳
+     * @param key_frame_only 是否只读取关键帧
+     * @param have_video 是否有视频
+     * @param cb 完成回调，被后续的seek取代时不回调
+     * Discard the read-ahead data and seek in the file reading thread, locate the next key frame when there is video,
+     * the callback is invoked in the file reading thread when finished
+     * @param stamp_seek timestamp to seek to
+     * @param key_frame_only whether to read key frames only
+     * @param have_video whether there is video
+     * @param cb completion callback, not invoked if superseded by a later seek
+     */
+    void seekTo(uint32_t stamp_seek, bool key_frame_only, bool have_video, onSeek cb) {
+        uint32_t generation;
+        {
+            lock_guard<mutex> lck(_mtx);
+            // 正在进行的预读任务发现generation变化后退出
+            // The ongoing read-ahead task exits when it finds that the generation has changed
+            generation = ++_generation;
+            _frames.clear();
+            _reading = false;
+            _eof = false;
+            _seeking = true;
+        }
+        weak_ptr<MP4Prefetcher> weak_self = shared_from_this();
+        _poller->async([weak_self, generation, stamp_seek, key_frame_only, have_video, cb]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->doSeek(generation, stamp_seek, key_frame_only, have_video, cb);
+            }
+        });
+    }
+
+    /**
+     * seek结果已被处理，恢复取帧
+     * @return 该seek已被后续的seek取代时返回false
+     * The seek result has been handled, resume taking frames
+     * @return false if the seek has been superseded by a later seek
+     */
+    bool onSeeked(uint32_t generation) {
+        lock_guard<mutex> lck(_mtx);
+        if (generation != _generation) {
+            return false;
+        }
+        _seeking = false;
+        return true;
+    }
+
+    void getStatistic(MP4Reader::ReadStatistic &stat) {
+        lock_guard<mutex> lck(_mtx);
+        stat.read_ahead_ms = _read_ahead_ms;
+        stat.buffered_ms = bufferedMS();
+        stat.read_frames = _read_frames;
+        stat.read_ms = _read_us / 1000;
+    }
+
+private:
+    uint32_t bufferedMS() const {
+        if (_frames.size() < 2 || _frames.back()->dts() < _frames.front()->dts()) {
+            return 0;
+        }
+        return (uint32_t)(_frames.back()->dts() - _frames.front()->dts());
+    }
+
+    bool isFull(uint32_t window_ms) const {
+        return _frames.size() >= kMaxPrefetchFrames || bufferedMS() >= window_ms;
+    }
+
+    bool isCurrent(uint32_t generation) {
+        lock_guard<mutex> lck(_mtx);
+        return generation == _generation;
+    }
+
+    void doSeek(uint32_t generation, uint32_t stamp_seek, bool key_frame_only, bool have_video, const onSeek &cb) {
+        int64_t stamp = -1;
+        Frame::Ptr key_frame;
+        {
+            lock_guard<mutex> lck(_demuxer_mtx);
+            if (!isCurrent(generation)) {
+                return;
+            }
+            _demuxer->setKeyFrameOnly(key_frame_only);
+            stamp = _demuxer->seekTo(stamp_seek);
+            if (stamp != -1 && have_video) {
+                // 搜索到下一帧关键帧
+                // Search for the next keyframe
+                stamp = -1;
+                bool key = false;
+                bool eof = false;
+                while (!eof) {
+                    auto frame = _demuxer->readFrame(key, eof);
+                    if (frame && (key || frame->keyFrame() || frame->configFrame())) {
+                        key_frame = std::move(frame);
+                        stamp = key_frame->dts();
+                        break;
+                    }
+                }
+            }
+        }
+        if (isCurrent(generation)) {
+            cb(generation, stamp, key_frame);
+        }
+    }
+
+    void readFrames(uint32_t generation, uint32_t window_ms) {
+        while (true) {
+            bool key_frame = false;
+            bool eof = false;
+            Frame::Ptr frame;
+            uint64_t read_us;
+            {
+                lock_guard<mutex> lck(_demuxer_mtx);
+                if (generation != _generation) {
+                    return;
+                }
+                auto start = getCurrentMicrosecond(true);
+                frame = _demuxer->readFrame(key_frame, eof);
+                read_us = getCurrentMicrosecond(true) - start;
+            }
+
+            lock_guard<mutex> lck(_mtx);
+            if (generation != _generation) {
+                // 已经seek，丢弃该帧
+                // Seeked already, discard the frame
+                return;
+            }
+            _read_us += read_us;
+            if (frame) {
+                ++_read_frames;
+                _frames.emplace_back(std::move(frame));
+            }
+            if (eof || isFull(window_ms)) {
+                _eof = eof;
+                _reading = false;
+                return;
+            }
+        }
+    }
+
+private:
+    bool _eof = false;
+    bool _reading = false;
+    bool _seeking = false;
+    uint32_t _generation = 0;
+    uint32_t _read_ahead_ms;
+    uint64_t _read_frames = 0;
+    uint64_t _read_us = 0;
+    // 保护_demuxer，读文件线程与seek互斥
+    // Protect _demuxer, the file reading thread and seek are mutually exclusive
+    mutex _demuxer_mtx;
+    // 保护预读缓存与状态
+    // Protect the read-ahead cache and the state
+    mutex _mtx;
+    deque<Frame::Ptr> _frames;
+    MultiMP4Demuxer::Ptr _demuxer;
+    EventPoller::Ptr _poller;
+};
+
 MP4Reader::MP4Reader(const MediaTuple &tuple, const string &file_path,
                      toolkit::EventPoller::Ptr poller) {
     ProtocolOption option;
@@ -57,6 +317,11 @@ void MP4Reader::setup(const MediaTuple &tuple, const std::string &file_path, con
     _demuxer = std::make_shared<MultiMP4Demuxer>();
     _demuxer->openMP4(_file_path);
 
+    GET_CONFIG(uint32_t, readAheadMS, Record::kReadAheadMS);
+    if (readAheadMS) {
+        _prefetcher = std::make_shared<MP4Prefetcher>(_demuxer, readAheadMS);
+    }
+
     if (tuple.stream.empty()) {
         return;
     }
@@ -77,24 +342,35 @@ void MP4Reader::setup(const MediaTuple &tuple, const std::string &file_path, con
     _muxer->addTrackCompleted();
 }
 
+MP4Reader::~MP4Reader() {
+    auto stat = getReadStatistic();
+    if (stat.stall_count) {
+        WarnL << "mp4 read-ahead stalled " << stat.stall_count << " times, " << stat.stall_ms << "ms in total, read "
+              << stat.read_frames << " frames in " << stat.read_ms << "ms: " << _file_path;
+    }
+}
+
 bool MP4Reader::readSample() {
     if (_paused) {
         // 确保暂停时，时间轴不走动  [AUTO-TRANSLATED:3d38dd31]
         // Ensure that the timeline does not move when paused
         _seek_ticker.resetTime();
+        onStall(false);
         return true;
     }
 
-    bool keyFrame = false;
     bool eof = false;
-    while (!eof && _last_dts < getCurrentStamp()) {
-        auto frame = _demuxer->readFrame(keyFrame, eof);
-        if (!frame) {
-            continue;
-        }
-        _last_dts = frame->dts();
-        if (_muxer) {
-            _muxer->inputFrame(frame);
+    if (_prefetcher) {
+        readAheadSample(eof);
+    } else {
+        bool keyFrame = false;
+        while (!eof && _last_dts < getCurrentStamp()) {
+            auto frame = _demuxer->readFrame(keyFrame, eof);
+            if (!frame) {
+                continue;
+            }
+            _last_dts = frame->dts();
+            outputFrame(frame);
         }
     }
 
@@ -109,6 +385,82 @@ bool MP4Reader::readSample() {
     return !eof;
 }
 
+void MP4Reader::readAheadSample(bool &eof) {
+    vector<Frame::Ptr> frames;
+    auto stall = !_prefetcher->pop(getCurrentStamp(), _last_dts, frames, eof);
+    for (auto &frame : frames) {
+        outputFrame(frame);
+    }
+    onStall(stall);
+    if (stall) {
+        // 预读数据未就绪，时间轴停在最后输出的帧，数据就绪后继续播放，而不是突发输出积压的帧
+        // The read-ahead data is not ready, hold the timeline at the last output frame and continue playing
+        // when the data is ready, instead of bursting the backlog frames
+        _seek_to = _last_dts;
+        _seek_ticker.resetTime();
+    }
+    if (!eof) {
+        _prefetcher->prefetch(_speed);
+    }
+}
+
+void MP4Reader::outputFrame(const Frame::Ptr &frame) {
+    if (!_muxer) {
+        return;
+    }
+    auto dts = (int64_t)frame->dts();
+    if (_last_output_dts >= 0) {
+        if (_stamp_rejoin) {
+            // seek后的首帧紧接上一输出帧(时间戳加1)，避免与上一帧时间戳相同导致播放器丢帧
+            // The first frame after seeking follows the last output frame (stamp plus 1),
+            // so that it does not share the stamp of the previous frame and get dropped by players
+            _stamp_offset += dts - _last_output_dts - 1;
+        } else if (_key_frame_only && dts > _last_output_dts) {
+            // 关键帧间隔按倍速压缩，播放器按正常速度播放即为快进画面
+            // The key frame interval is compressed by the speed, so the player shows fast forward at normal speed
+            auto delta = dts - _last_output_dts;
+            _stamp_offset += delta - (int64_t)(delta / _speed);
+        }
+    }
+    _stamp_rejoin = false;
+    _last_output_dts = dts;
+    if (!_stamp_offset) {
+        _muxer->inputFrame(frame);
+        return;
+    }
+    auto ret = std::make_shared<FrameStamp>(frame);
+    ret->setStamp(dts - _stamp_offset, frame->pts() - _stamp_offset);
+    _muxer->inputFrame(ret);
+}
+
+void MP4Reader::updateTrickPlay() {
+    GET_CONFIG(float, trickPlaySpeed, Record::kTrickPlaySpeed);
+    auto key_frame_only = _have_video && trickPlaySpeed > 0 && _speed >= trickPlaySpeed;
+    if (key_frame_only == _key_frame_only) {
+        return;
+    }
+    _key_frame_only = key_frame_only;
+    InfoL << (key_frame_only ? "Enter" : "Leave") << " key frame only mode, speed: " << _speed << ", " << _file_path;
+    // 丢弃按原模式预读的数据，从当前位置所在的关键帧开始按新模式读取，输出时间戳保持连续
+    // Discard the data read ahead in the previous mode and read in the new mode from the key frame at the current position,
+    // the output timestamps are kept continuous
+    _stamp_rejoin = true;
+    seekTo(getCurrentStamp());
+}
+
+void MP4Reader::onStall(bool stall) {
+    if (stall == _stalling) {
+        return;
+    }
+    _stalling = stall;
+    if (stall) {
+        ++_stall_count;
+        _stall_ticker.resetTime();
+    } else {
+        _stall_ms += _stall_ticker.elapsedTime();
+    }
+}
+
 bool MP4Reader::readNextSample() {
     bool keyFrame = false;
     bool eof = false;
@@ -116,9 +468,7 @@ bool MP4Reader::readNextSample() {
     if (!frame) {
         return false;
     }
-    if (_muxer) {
-        _muxer->inputFrame(frame);
-    }
+    outputFrame(frame);
     setCurrentStamp(frame->dts());
     return true;
 }
@@ -162,12 +512,26 @@ void MP4Reader::startReadMP4(uint64_t sample_ms, bool ref_self, bool file_repeat
     }
 
     _file_repeat = file_repeat;
+    if (_prefetcher) {
+        _prefetcher->prefetch(_speed);
+    }
 }
 
 const MultiMP4Demuxer::Ptr &MP4Reader::getDemuxer() const {
     return _demuxer;
 }
 
+MP4Reader::ReadStatistic MP4Reader::getReadStatistic() {
+    lock_guard<recursive_mutex> lck(_mtx);
+    ReadStatistic ret;
+    if (_prefetcher) {
+        _prefetcher->getStatistic(ret);
+    }
+    ret.stall_count = _stall_count;
+    ret.stall_ms = _stall_ms + (_stalling ? _stall_ticker.elapsedTime() : 0);
+    return ret;
+}
+
 uint32_t MP4Reader::getCurrentStamp() {
     return (uint32_t) (_seek_to + !_paused * _speed * _seek_ticker.elapsedTime());
 }
@@ -189,6 +553,10 @@ bool MP4Reader::seekTo(MediaSource &sender, uint32_t stamp) {
     // Playback should resume after dragging the progress bar
     pause(sender, false);
     TraceL << getOriginUrl(sender) << ",stamp:" << stamp;
+    // 拖动后输出时间戳恢复为文件时间戳
+    // The output timestamps are restored to the file timestamps after seeking
+    _stamp_offset = 0;
+    _last_output_dts = -1;
     return seekTo(stamp);
 }
 
@@ -220,11 +588,57 @@ bool MP4Reader::speed(MediaSource &sender, float speed) {
     }
     _speed = speed;
     TraceL << getOriginUrl(sender) << ",speed:" << speed;
+    updateTrickPlay();
     return true;
 }
 
 bool MP4Reader::seekTo(uint32_t stamp_seek) {
     lock_guard<recursive_mutex> lck(_mtx);
+    if (!_prefetcher) {
+        return seekTo_l(stamp_seek);
+    }
+    if (stamp_seek > _demuxer->getDurationMS()) {
+        // 超过文件长度
+        // Exceeds the file length
+        return false;
+    }
+    // 在读文件线程中seek，不阻塞poller线程，完成后回到poller线程输出关键帧
+    // Seek in the file reading thread without blocking the poller thread, and output the key frame back in the poller thread when finished
+    weak_ptr<MP4Reader> weak_self = shared_from_this();
+    auto poller = _poller;
+    _prefetcher->seekTo(stamp_seek, _key_frame_only, _have_video, [weak_self, poller](uint32_t generation, int64_t stamp, const Frame::Ptr &key_frame) {
+        poller->async([weak_self, generation, stamp, key_frame]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->onSeekTo(generation, stamp, key_frame);
+            }
+        });
+    });
+    // 继续预读seek位置之后的数据
+    // Keep reading ahead the data after the seek position
+    _prefetcher->prefetch(_speed);
+    return true;
+}
+
+void MP4Reader::onSeekTo(uint32_t generation, int64_t stamp, const Frame::Ptr &key_frame) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    if (!_prefetcher->onSeeked(generation)) {
+        // 已被后续的seek取代
+        // Superseded by a later seek
+        return;
+    }
+    if (stamp == -1) {
+        WarnL << "Seek failed: " << _file_path;
+    } else {
+        if (key_frame) {
+            outputFrame(key_frame);
+        }
+        setCurrentStamp((uint32_t)stamp);
+    }
+    _prefetcher->prefetch(_speed);
+}
+
+bool MP4Reader::seekTo_l(uint32_t stamp_seek) {
+    _demuxer->setKeyFrameOnly(_key_frame_only);
     if (stamp_seek > _demuxer->getDurationMS()) {
         // 超过文件长度  [AUTO-TRANSLATED:b4361054]
         // Exceeds the file length
@@ -257,9 +671,7 @@ bool MP4Reader::seekTo(uint32_t stamp_seek) {
         if (keyFrame || frame->keyFrame() || frame->configFrame()) {
             // 定位到key帧  [AUTO-TRANSLATED:0300901d]
             // Locate to the keyframe
-            if (_muxer) {
-                _muxer->inputFrame(frame);
-            }
+            outputFrame(frame);
             // 设置当前时间戳  [AUTO-TRANSLATED:88949974]
             // Set the current timestamp
             setCurrentStamp(frame->dts());
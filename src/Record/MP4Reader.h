@@ -17,10 +17,27 @@
 
 namespace mediakit {
 
+class MP4Prefetcher;
+
 class MP4Reader : public std::enable_shared_from_this<MP4Reader>, public MediaSourceEvent {
 public:
     using Ptr = std::shared_ptr<MP4Reader>;
 
+    struct ReadStatistic {
+        // 预读时长与当前已缓存的时长，单位毫秒
+        // Read-ahead duration and the currently buffered duration in milliseconds
+        uint32_t read_ahead_ms = 0;
+        uint32_t buffered_ms = 0;
+        // 读线程读取的帧数与耗时，单位毫秒
+        // Frames read by the reading thread and the time spent in milliseconds
+        uint64_t read_frames = 0;
+        uint64_t read_ms = 0;
+        // 预读数据不足导致播放卡顿的次数与总时长，单位毫秒
+        // Number and total duration in milliseconds of playback stalls caused by insufficient read-ahead data
+        uint64_t stall_count = 0;
+        uint64_t stall_ms = 0;
+    };
+
     /**
      * 点播一个mp4文件，使之转换成MediaSource流媒体
      * @param vhost 虚拟主机
@@ -39,6 +56,8 @@ public:
 
     MP4Reader(const MediaTuple &tuple, const std::string &file_path, const ProtocolOption &option, toolkit::EventPoller::Ptr poller = nullptr);
 
+    ~MP4Reader() override;
+
     /**
      * 开始解复用MP4文件
      * @param sample_ms 每次读取文件数据量，单位毫秒，置0时采用配置文件配置
@@ -70,6 +89,12 @@ public:
      */
     const MultiMP4Demuxer::Ptr& getDemuxer() const;
 
+    /**
+     * 获取预读统计
+     * Get the read-ahead statistics
+     */
+    ReadStatistic getReadStatistic();
+
 private:
     //MediaSourceEvent override
     bool seekTo(MediaSource &sender,uint32_t stamp) override;
@@ -86,6 +111,12 @@ private:
     uint32_t getCurrentStamp();
     void setCurrentStamp(uint32_t stamp);
     bool seekTo(uint32_t stamp_seek);
+    bool seekTo_l(uint32_t stamp_seek);
+    void onSeekTo(uint32_t generation, int64_t stamp, const Frame::Ptr &key_frame);
+    void readAheadSample(bool &eof);
+    void onStall(bool stall);
+    void outputFrame(const Frame::Ptr &frame);
+    void updateTrickPlay();
 
     void setup(const MediaTuple &tuple, const std::string &file_path, const ProtocolOption &option, toolkit::EventPoller::Ptr poller);
 
@@ -96,9 +127,24 @@ private:
     float _speed = 1.0;
     uint32_t _last_dts = 0;
     uint32_t _seek_to = 0;
+    // 关键帧快进模式，只输出关键帧并按倍速压缩时间戳
+    // Key frame only fast forward mode, only key frames are output with timestamps compressed by the speed
+    bool _key_frame_only = false;
+    // 切换快进模式后，下一帧的输出时间戳接续上一帧
+    // The output timestamp of the next frame continues from the previous frame after the fast forward mode is switched
+    bool _stamp_rejoin = false;
+    // 输入(文件)时间戳与输出时间戳的差值
+    // Difference between the input (file) timestamp and the output timestamp
+    int64_t _stamp_offset = 0;
+    int64_t _last_output_dts = -1;
     std::string _file_path;
     std::recursive_mutex _mtx;
     toolkit::Ticker _seek_ticker;
+    bool _stalling = false;
+    uint64_t _stall_count = 0;
+    uint64_t _stall_ms = 0;
+    toolkit::Ticker _stall_ticker;
+    std::shared_ptr<MP4Prefetcher> _prefetcher;
     toolkit::Timer::Ptr _timer;
     MultiMP4Demuxer::Ptr _demuxer;
     MultiMediaSourceMuxer::Ptr _muxer;
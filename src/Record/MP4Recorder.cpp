@@ -14,8 +14,12 @@
 #include "Util/File.h"
 #include "Common/config.h"
 #include "MP4Recorder.h"
+#include "Thread/ThreadPool.h"
 #include "Thread/WorkThreadPool.h"
 #include "MP4Muxer.h"
+#include "MP4Demuxer.h"
+#include "RecordCatalog.h"
+#include "StoragePool.h"
 
 using namespace std;
 using namespace toolkit;
@@ -40,8 +44,38 @@ MP4Recorder::~MP4Recorder() {
     }
 }
 
+// 估算moov大小，每个sample在moov中约占用stsz(4) + stts(8) + co64(8)字节，视频另有ctts(8)
+// Estimate the moov size, each sample takes about stsz(4) + stts(8) + co64(8) bytes in moov, plus ctts(8) for video
+static size_t estimateMoovSize(const list<Track::Ptr> &tracks, size_t max_second) {
+    double ret = 64 * 1024;
+    for (auto &track : tracks) {
+        switch (track->getTrackType()) {
+            case TrackVideo: {
+                auto fps = static_pointer_cast<VideoTrack>(track)->getVideoFps();
+                ret += (fps > 0 ? fps : 30) * max_second * 28;
+                break;
+            }
+            case TrackAudio: {
+                // aac每帧1024个采样，其他编码按每帧20ms估算
+                // aac has 1024 samples per frame, other codecs are estimated as 20ms per frame
+                auto sample_rate = static_pointer_cast<AudioTrack>(track)->getAudioSampleRate();
+                ret += (track->getCodecId() == CodecAAC && sample_rate > 0 ? sample_rate / 1024.0 : 50) * max_second * 20;
+                break;
+            }
+            default: break;
+        }
+    }
+    // 等待关键帧切片时录制时长会超出，多预留25%
+    // The recording duration exceeds when waiting for a key frame to slice, reserve 25% more
+    return (size_t)(ret * 1.25);
+}
+
 void MP4Recorder::createFile() {
     closeFile();
+    // 配置了存储池时每个录像文件重新选择磁盘，磁盘空间不足或写入出错时后续文件不再写入该盘
+    // With the storage pool configured each recording file selects the disk again,
+    // so later files leave a disk that is low on space or has write errors
+    _info.folder = StoragePool::Instance().selectPath(_info.folder);
     auto date = getTimeStr("%Y-%m-%d");
     auto file_name = date + "-" + getTimeStr("%H-%M-%S") + "-" + std::to_string(_file_index++) + ".mp4";
     auto full_path = _info.folder + date + "/" + file_name;
@@ -50,6 +84,8 @@ void MP4Recorder::createFile() {
     // ///record 业务逻辑//////  [AUTO-TRANSLATED:2e78931a]
     // ///record Business Logic//////
     _info.start_time = ::time(NULL);
+    _info.key_frames = 0;
+    _start_ms = getCurrentMillisecond(true);
     _info.file_name = file_name;
     _info.file_path = full_path;
     GET_CONFIG(string, appName, Record::kAppName);
@@ -57,6 +93,19 @@ void MP4Recorder::createFile() {
 
     try {
         _muxer = std::make_shared<MP4Muxer>();
+        GET_CONFIG(int, fastStart, Record::kFastStart);
+        GET_CONFIG(size_t, moovReserveMaxKB, Record::kMoovReserveMaxSize);
+        if (fastStart == 2) {
+            auto moov_reserve = estimateMoovSize(_tracks, _max_second);
+            if (moov_reserve > moovReserveMaxKB * 1024) {
+                // 预留空间过大，改用fmp4，无需在关闭时写入moov
+                // The reservation is too large, use fmp4 instead, which does not need to write moov on close
+                WarnL << "Estimated moov size(" << moov_reserve << ") exceeds record.moovReserveMaxSize, record fmp4 instead: " << full_path;
+                _muxer->setFmp4(true);
+            } else {
+                _muxer->setMoovReserve(moov_reserve);
+            }
+        }
         TraceL << "Open tmp mp4 file: " << full_path_tmp;
         _muxer->openMP4(full_path_tmp);
         for (auto &track :_tracks) {
@@ -70,18 +119,102 @@ void MP4Recorder::createFile() {
     }
 }
 
+// fmp4转换为普通mp4需要完整读写一遍文件，在专用的最低优先级线程中串行执行，不占用共享的后台线程池
+// Converting fmp4 into a plain mp4 reads and writes the whole file, so it runs serially in a dedicated lowest priority thread
+// instead of occupying the shared background thread pool
+class MP4DefragmentThread : public TaskExecutorGetterImp {
+public:
+    static MP4DefragmentThread &Instance();
+
+private:
+    MP4DefragmentThread() {
+        addPoller("mp4 defrag", 1, ThreadPool::PRIORITY_LOWEST, false, false);
+    }
+};
+
+INSTANCE_IMP(MP4DefragmentThread);
+
+// 将录制完成的fmp4文件转换为普通mp4，成功时返回新文件的复用器
+// Convert a finished fmp4 recording into a plain mp4, return the muxer of the new file on success
+static MP4Muxer::Ptr defragment(const string &src, const string &dst) {
+    auto muxer = std::make_shared<MP4Muxer>();
+    try {
+        MP4Demuxer demuxer;
+        demuxer.openMP4(src);
+        muxer->setFmp4(false);
+        muxer->openMP4(dst);
+        for (auto &track : demuxer.getTracks(false)) {
+            if (muxer->addTrack(track)) {
+                track->addDelegate([muxer](const Frame::Ptr &frame) { return muxer->inputFrame(frame); });
+            }
+        }
+        bool eof = false;
+        while (!eof) {
+            bool key_frame = false;
+            demuxer.readFrame(key_frame, eof);
+        }
+        if (demuxer.readFailed()) {
+            // 读取出错时转换结果不完整，不能替换原文件
+            // The result is incomplete if reading fails, it must not replace the original file
+            throw std::runtime_error("read fmp4 samples failed");
+        }
+        muxer->flush();
+        muxer->closeMP4();
+    } catch (std::exception &ex) {
+        WarnL << "Defragment mp4 file failed: " << src << ", " << ex.what();
+        File::delete_file(dst);
+        return nullptr;
+    }
+    return muxer;
+}
+
+// 临时文件改为正式文件名，保存索引、添加到录像目录并触发录制事件
+// Rename the temporary file to the official name, save the index, add it to the recording catalog and emit the record event
+static void finishRecord(const MP4Muxer::Ptr &muxer, const string &full_path_tmp, RecordInfo &info, uint64_t start_ms, uint64_t duration_ms) {
+    if (!full_path_tmp.empty()) {
+        // 临时文件名改成正式文件名，防止mp4未完成时被访问  [AUTO-TRANSLATED:541a6f00]
+        // Change the temporary file name to the official file name to prevent access to the mp4 before it is completed
+        rename(full_path_tmp.data(), info.file_path.data());
+        if (auto index = muxer->getIndex()) {
+            // 改名后保存索引，索引记录的是最终文件的大小与修改时间
+            // Save the index after renaming, the index records the size and modification time of the final file
+            index->save(info.file_path);
+        }
+        GET_CONFIG(bool, enableCatalog, Record::kEnableCatalog);
+        if (enableCatalog && start_with(info.file_path, info.folder)) {
+            RecordCatalog::Item item;
+            item.start_ms = start_ms;
+            item.end_ms = start_ms + duration_ms;
+            item.size = info.file_size;
+            item.key_frames = info.key_frames;
+            item.path = info.file_path.substr(info.folder.size());
+            RecordCatalog::get(info.folder)->append(std::move(item));
+        }
+    }
+    TraceL << "Emit mp4 record event: " << info.file_path;
+    // 触发mp4录制切片生成事件  [AUTO-TRANSLATED:9959dcd4]
+    // Trigger mp4 recording slice generation event
+    NOTICE_EMIT(BroadcastRecordMP4Args, Broadcast::kBroadcastRecordMP4, info);
+}
+
 void MP4Recorder::asyncClose() {
     auto muxer = _muxer;
     auto full_path_tmp = _full_path_tmp;
     auto info = _info;
+    auto start_ms = _start_ms;
     TraceL << "Start close tmp mp4 file: " << full_path_tmp;
-    WorkThreadPool::Instance().getExecutor()->async([muxer, full_path_tmp, info]() mutable {
-        info.time_len = muxer->getDuration() / 1000.0f;
+    WorkThreadPool::Instance().getExecutor()->async([muxer, full_path_tmp, info, start_ms]() mutable {
+        auto duration_ms = muxer->getDuration();
+        info.time_len = duration_ms / 1000.0f;
         // 关闭mp4可能非常耗时，所以要放在后台线程执行  [AUTO-TRANSLATED:a7378a11]
         // Closing mp4 can be very time-consuming, so it should be executed in the background thread
         TraceL << "Closing tmp mp4 file: " << full_path_tmp;
         muxer->closeMP4();
-        TraceL << "Closed tmp mp4 file: " << full_path_tmp;
+        auto &io = muxer->getIOStatistic();
+        info.io_bytes = io.read_bytes + io.write_bytes;
+        info.moov_in_place = io.moov_in_place;
+        TraceL << "Closed tmp mp4 file: " << full_path_tmp << ", read bytes: " << io.read_bytes << ", write bytes: " << io.write_bytes
+               << ", moov size: " << io.moov_size << ", moov reserved: " << io.moov_reserved << ", syncs: " << io.syncs;
         if (!full_path_tmp.empty()) {
             // 获取文件大小  [AUTO-TRANSLATED:7b90eb41]
             // Get file size
@@ -92,14 +225,29 @@ void MP4Recorder::asyncClose() {
                 File::delete_file(full_path_tmp);
                 return;
             }
-            // 临时文件名改成正式文件名，防止mp4未完成时被访问  [AUTO-TRANSLATED:541a6f00]
-            // Change the temporary file name to the official file name to prevent access to the mp4 before it is completed
-            rename(full_path_tmp.data(), info.file_path.data());
+            GET_CONFIG(bool, fmp4Defragment, Record::kFmp4Defragment);
+            if (fmp4Defragment && muxer->isFmp4()) {
+                MP4DefragmentThread::Instance().getExecutor()->async([muxer, full_path_tmp, info, start_ms, duration_ms]() mutable {
+                    // 转换期间仍为隐藏的临时文件，转换失败时保留fmp4文件
+                    // It is still a hidden temporary file during the conversion, the fmp4 file is kept if the conversion fails
+                    auto defrag_path = full_path_tmp + ".defrag";
+                    auto plain = defragment(full_path_tmp, defrag_path);
+                    if (plain && !rename(defrag_path.data(), full_path_tmp.data())) {
+                        auto &plain_io = plain->getIOStatistic();
+                        info.io_bytes += info.file_size + plain_io.read_bytes + plain_io.write_bytes;
+                        info.moov_in_place = plain_io.moov_in_place;
+                        info.file_size = File::fileSize(full_path_tmp);
+                        muxer = plain;
+                        TraceL << "Defragmented tmp mp4 file: " << full_path_tmp;
+                    } else if (plain) {
+                        File::delete_file(defrag_path);
+                    }
+                    finishRecord(muxer, full_path_tmp, info, start_ms, duration_ms);
+                });
+                return;
+            }
         }
-        TraceL << "Emit mp4 record event: " << info.file_path;
-        // 触发mp4录制切片生成事件  [AUTO-TRANSLATED:9959dcd4]
-        // Trigger mp4 recording slice generation event
-        NOTICE_EMIT(BroadcastRecordMP4Args, Broadcast::kBroadcastRecordMP4, info);
+        finishRecord(muxer, full_path_tmp, info, start_ms, duration_ms);
     });
 }
 
@@ -134,6 +282,12 @@ bool MP4Recorder::inputFrame(const Frame::Ptr &frame) {
     }
 
     if (_muxer) {
+        if (frame->getTrackType() == TrackVideo && frame->keyFrame() && (!_info.key_frames || frame->dts() != _last_key_dts)) {
+            // 同一关键帧的多个slice只计数一次
+            // Multiple slices of the same key frame are counted once
+            ++_info.key_frames;
+            _last_key_dts = frame->dts();
+        }
         // 生成mp4文件  [AUTO-TRANSLATED:76a8d77c]
         // Generate mp4 file
         return _muxer->inputFrame(frame);
@@ -70,6 +70,8 @@ private:
 private:
     bool _have_video = false;
     size_t _max_second;
+    uint64_t _start_ms = 0;
+    uint64_t _last_key_dts = 0;
     DeltaStamp _delta_stamp[TrackMax];
     std::atomic<uint64_t> _file_index { 0 };
     std::string _full_path_tmp;
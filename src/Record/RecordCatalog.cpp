@@ -0,0 +1,261 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cstdio>
+#include <cinttypes>
+#include <algorithm>
+#include <unordered_map>
+#include "RecordCatalog.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+#include "Util/TimeTicker.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 超过该时长未被访问的目录从内存中移除，再次访问时从文件重新加载
+// Catalogs not accessed for this duration are removed from memory, and reloaded from the file on next access
+static constexpr uint64_t kIdleEvictMS = 10 * 60 * 1000;
+// 添加录像时检查头部录像文件是否已被删除的间隔
+// Interval of checking whether the leading recording files have been deleted when adding recordings
+static constexpr uint64_t kPruneIntervalMS = 10 * 60 * 1000;
+
+struct CatalogEntry {
+    RecordCatalog::Ptr catalog;
+    Ticker ticker;
+};
+
+static mutex s_mtx;
+static unordered_map<string, CatalogEntry> s_catalogs;
+static Ticker s_evict_ticker;
+
+static void addGap(vector<RecordCatalog::Gap> &gaps, uint64_t start_ms, uint64_t end_ms) {
+    RecordCatalog::Gap gap;
+    gap.start_ms = start_ms;
+    gap.end_ms = end_ms;
+    gaps.emplace_back(gap);
+}
+
+static string toLine(const RecordCatalog::Item &item) {
+    _StrPrinter printer;
+    printer << item.start_ms << " " << item.end_ms << " " << item.size << " " << item.key_frames << " " << item.path;
+    if (item.offset) {
+        printer << " " << item.offset;
+    }
+    printer << "\n";
+    return std::move(printer);
+}
+
+static bool startLess(const RecordCatalog::Item &item, uint64_t stamp) {
+    return item.start_ms < stamp;
+}
+
+RecordCatalog::Ptr RecordCatalog::get(const string &folder) {
+    auto key = end_with(folder, "/") ? folder : folder + "/";
+    lock_guard<mutex> lck(s_mtx);
+    if (s_evict_ticker.elapsedTime() >= kIdleEvictMS) {
+        s_evict_ticker.resetTime();
+        for (auto it = s_catalogs.begin(); it != s_catalogs.end();) {
+            // 仍被外部引用的目录保留，防止同一文件夹出现两个目录对象
+            // Catalogs still referenced outside are kept, so that a folder never has two catalog objects
+            if (it->second.ticker.elapsedTime() >= kIdleEvictMS && it->second.catalog.use_count() == 1) {
+                it = s_catalogs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    auto &entry = s_catalogs[key];
+    if (!entry.catalog) {
+        entry.catalog.reset(new RecordCatalog(key));
+        entry.catalog->load();
+    }
+    entry.ticker.resetTime();
+    return entry.catalog;
+}
+
+string RecordCatalog::catalogPath(const string &folder) {
+    return (end_with(folder, "/") ? folder : folder + "/") + ".catalog";
+}
+
+RecordCatalog::RecordCatalog(const string &folder) : _folder(folder) {}
+
+const string &RecordCatalog::getFolder() const {
+    return _folder;
+}
+
+void RecordCatalog::load() {
+    // 每行一条记录: 开始时间 结束时间 文件大小 关键帧数 相对路径 [归档文件中的字节偏移]
+    // One record per line: start time, end time, file size, key frame count, relative path [byte offset in the archive file]
+    auto content = File::loadFile(catalogPath(_folder));
+    _tail_newline = content.empty() || content.back() == '\n';
+    for (auto &line : split(content, "\n")) {
+        Item item;
+        char path[1024];
+        if (sscanf(line.data(), "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu32 " %1023s %" SCNu64, &item.start_ms, &item.end_ms, &item.size,
+                   &item.key_frames, path, &item.offset) < 5 || item.end_ms < item.start_ms) {
+            // 掉电等原因导致的不完整记录
+            // Incomplete records caused by power failure etc.
+            continue;
+        }
+        item.path = path;
+        _max_duration = MAX(_max_duration, item.end_ms - item.start_ms);
+        _items.emplace_back(std::move(item));
+    }
+    // 录像基本按时间顺序追加，此处一般无需移动元素
+    // Recordings are mostly appended in time order, so elements seldom move here
+    stable_sort(_items.begin(), _items.end(), [](const Item &a, const Item &b) { return a.start_ms < b.start_ms; });
+    if (!_items.empty()) {
+        DebugL << "Load record catalog: " << _folder << ", items: " << _items.size();
+    }
+}
+
+void RecordCatalog::append(Item item) {
+    if (item.end_ms < item.start_ms || item.path.empty() || item.path.find_first_of(" \t\r\n") != string::npos) {
+        WarnL << "Invalid record catalog item: " << _folder << item.path;
+        return;
+    }
+    auto line = toLine(item);
+    lock_guard<mutex> lck(_mtx);
+    auto fp = File::create_file(catalogPath(_folder), "ab");
+    if (!fp) {
+        WarnL << "Open record catalog failed: " << catalogPath(_folder) << " " << get_uv_errmsg();
+    } else {
+        if (!_tail_newline) {
+            // 上次写入不完整，另起一行避免与本条记录粘连
+            // The last write is incomplete, start a new line so that it does not stick to this record
+            fputc('\n', fp);
+        }
+        _tail_newline = fwrite(line.data(), line.size(), 1, fp) == 1;
+        fclose(fp);
+    }
+    _max_duration = MAX(_max_duration, item.end_ms - item.start_ms);
+    auto it = upper_bound(_items.begin(), _items.end(), item.start_ms, [](uint64_t stamp, const Item &item) { return stamp < item.start_ms; });
+    _items.emplace(it, std::move(item));
+    if (_prune_ticker.elapsedTime() >= kPruneIntervalMS) {
+        _prune_ticker.resetTime();
+        if (pruneFront_l()) {
+            save_l();
+        }
+    }
+}
+
+bool RecordCatalog::pruneFront_l() {
+    // 录像按时间顺序被删除，遇到第一个仍存在的文件即停止，每次只需少量stat
+    // Recordings are deleted in time order, stop at the first file that still exists, so only a few stats are needed
+    size_t count = 0;
+    string last_missing;
+    while (count < _items.size()) {
+        auto &path = _items[count].path;
+        // 归档文件中的多个切片共用同一个文件
+        // Several segments in an archive file share the same file
+        if (path != last_missing) {
+            if (File::fileExist(_folder + path)) {
+                break;
+            }
+            last_missing = path;
+        }
+        ++count;
+    }
+    if (!count) {
+        return false;
+    }
+    _items.erase(_items.begin(), _items.begin() + count);
+    DebugL << "Prune record catalog: " << _folder << ", removed: " << count << ", remain: " << _items.size();
+    return true;
+}
+
+vector<RecordCatalog::Item> RecordCatalog::query(uint64_t start_ms, uint64_t end_ms) {
+    vector<Item> ret;
+    lock_guard<mutex> lck(_mtx);
+    auto pruned = pruneFront_l();
+    // 开始时间早于start_ms - _max_duration的录像不可能与查询区间相交
+    // Recordings starting before start_ms - _max_duration can not intersect the query range
+    auto from = start_ms > _max_duration ? start_ms - _max_duration : 0;
+    string last_path;
+    bool last_exist = true;
+    for (auto it = lower_bound(_items.begin(), _items.end(), from, startLess); it != _items.end() && it->start_ms < end_ms;) {
+        if (it->end_ms <= start_ms) {
+            ++it;
+            continue;
+        }
+        if (it->path != last_path) {
+            last_path = it->path;
+            last_exist = File::fileExist(_folder + last_path);
+        }
+        if (!last_exist) {
+            // 文件已被删除(例如被手动删除)，从目录中移除
+            // The file has been deleted (e.g. manually), remove it from the catalog
+            it = _items.erase(it);
+            pruned = true;
+            continue;
+        }
+        ret.emplace_back(*it);
+        ++it;
+    }
+    if (pruned) {
+        save_l();
+    }
+    return ret;
+}
+
+void RecordCatalog::erase(const string &prefix) {
+    lock_guard<mutex> lck(_mtx);
+    auto size = _items.size();
+    _items.erase(remove_if(_items.begin(), _items.end(), [&](const Item &item) {
+        return start_with(item.path, prefix) && !File::fileExist(_folder + item.path);
+    }), _items.end());
+    if (_items.size() != size) {
+        save_l();
+    }
+}
+
+void RecordCatalog::save_l() {
+    auto path = catalogPath(_folder);
+    if (_items.empty()) {
+        File::delete_file(path);
+        _tail_newline = true;
+        return;
+    }
+    string content;
+    for (auto &item : _items) {
+        content += toLine(item);
+    }
+    // 先写临时文件再改名，防止重写过程中掉电丢失整个目录
+    // Write a temporary file and then rename it, so that the whole catalog is not lost on power failure while rewriting
+    auto tmp = path + ".tmp";
+    if (!File::saveFile(content, tmp) || rename(tmp.data(), path.data())) {
+        WarnL << "Save record catalog failed: " << path << " " << get_uv_errmsg();
+        File::delete_file(tmp);
+        return;
+    }
+    _tail_newline = true;
+}
+
+vector<RecordCatalog::Gap> RecordCatalog::findGaps(const vector<Item> &items, uint64_t start_ms, uint64_t end_ms, uint64_t tolerance_ms) {
+    vector<Gap> ret;
+    auto covered = start_ms;
+    for (auto &item : items) {
+        if (item.start_ms > covered + tolerance_ms) {
+            addGap(ret, covered, item.start_ms);
+        }
+        covered = MAX(covered, item.end_ms);
+    }
+    if (end_ms > covered + tolerance_ms) {
+        addGap(ret, covered, end_ms);
+    }
+    return ret;
+}
+
+} // namespace mediakit
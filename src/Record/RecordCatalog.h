@@ -0,0 +1,124 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_RECORDCATALOG_H
+#define ZLMEDIAKIT_RECORDCATALOG_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Util/TimeTicker.h"
+
+namespace mediakit {
+
+/**
+ * 单个流的录像目录
+ * 录像文件(mp4文件或hls切片)生成后，其起止时间等信息追加写入流录像文件夹下的.catalog文件，
+ * 内存中按开始时间排序，按时间段查询与缺失区间检测为O(log n)，无需遍历录像文件夹
+ * Recording catalog of a stream
+ * After a recording file (mp4 file or hls segment) is generated, its start/end time etc. are appended to the .catalog file
+ * in the record folder of the stream; it is sorted by start time in memory, so time range queries and gap detection
+ * take O(log n) without scanning the record folder
+ */
+class RecordCatalog {
+public:
+    using Ptr = std::shared_ptr<RecordCatalog>;
+
+    struct Item {
+        // unix时间戳，单位毫秒
+        // Unix timestamp in milliseconds
+        uint64_t start_ms = 0;
+        uint64_t end_ms = 0;
+        uint64_t size = 0;
+        uint32_t key_frames = 0;
+        // 相对录像文件夹的路径
+        // Path relative to the record folder
+        std::string path;
+        // 在文件中的字节偏移，hls切片位于归档文件中时与size组成其byte range
+        // Byte offset in the file, together with size it is the byte range of an hls segment in an archive file
+        uint64_t offset = 0;
+    };
+
+    struct Gap {
+        uint64_t start_ms = 0;
+        uint64_t end_ms = 0;
+    };
+
+    /**
+     * 获取录像文件夹的目录，首次获取时从文件加载，长时间未访问的目录会从内存中移除
+     * @param folder 流的录像文件夹
+     * Get the catalog of a record folder, it is loaded from the file on first access,
+     * catalogs not accessed for a long time are removed from memory
+     * @param folder record folder of the stream
+     */
+    static Ptr get(const std::string &folder);
+
+    /**
+     * 录像文件夹中的目录文件路径
+     * Path of the catalog file in the record folder
+     */
+    static std::string catalogPath(const std::string &folder);
+
+    /**
+     * 添加一个录像文件并追加写入目录文件
+     * 持续录制的流不会因空闲从内存中移除，因此定期从头部移除文件已被删除(如超过录像保留时长)的录像
+     * Add a recording file and append it to the catalog file
+     * Streams being recorded are never evicted as idle, so the leading recordings whose files have been deleted
+     * (e.g. beyond the retention time) are removed periodically
+     */
+    void append(Item item);
+
+    /**
+     * 查询与[start_ms, end_ms)有交集的录像，按开始时间排序，文件已被删除的录像从目录中移除且不返回
+     * Query the recordings intersecting [start_ms, end_ms), sorted by start time,
+     * recordings whose files have been deleted are removed from the catalog and not returned
+     */
+    std::vector<Item> query(uint64_t start_ms, uint64_t end_ms);
+
+    /**
+     * 移除路径以prefix开头且文件已被删除的录像并重写目录文件，prefix为空时检查所有录像
+     * Remove the recordings whose path starts with prefix and whose files have been deleted, then rewrite the catalog file,
+     * all recordings are checked if prefix is empty
+     */
+    void erase(const std::string &prefix);
+
+    const std::string &getFolder() const;
+
+    /**
+     * 检测[start_ms, end_ms)内未被录像覆盖的区间
+     * @param items query返回的录像
+     * @param tolerance_ms 小于该时长的间隔不视为缺失
+     * Detect the ranges in [start_ms, end_ms) not covered by recordings
+     * @param items recordings returned by query
+     * @param tolerance_ms intervals shorter than this are not regarded as gaps
+     */
+    static std::vector<Gap> findGaps(const std::vector<Item> &items, uint64_t start_ms, uint64_t end_ms, uint64_t tolerance_ms);
+
+private:
+    RecordCatalog(const std::string &folder);
+    void load();
+    void save_l();
+    bool pruneFront_l();
+
+private:
+    mutable std::mutex _mtx;
+    bool _tail_newline = true;
+    uint64_t _max_duration = 0;
+    toolkit::Ticker _prune_ticker;
+    std::string _folder;
+    // 按开始时间排序
+    // Sorted by start time
+    std::vector<Item> _items;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_RECORDCATALOG_H
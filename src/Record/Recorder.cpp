@@ -14,6 +14,7 @@
 #include "Common/MediaSource.h"
 #include "MP4Recorder.h"
 #include "HlsRecorder.h"
+#include "StoragePool.h"
 #include "FMP4/FMP4MediaSourceMuxer.h"
 #include "TS/TSMediaSourceMuxer.h"
 
@@ -22,6 +23,28 @@ using namespace toolkit;
 
 namespace mediakit {
 
+static string absoluteDir(const string &path) {
+    auto ret = File::absolutePath("", path, true);
+    if (!end_with(ret, "/")) {
+        ret += "/";
+    }
+    return ret;
+}
+
+static string mp4RelativePath(const MediaTuple &tuple) {
+    GET_CONFIG(bool, enableVhost, General::kEnableVhost);
+    GET_CONFIG(string, recordAppName, Record::kAppName);
+    if (enableVhost) {
+        return tuple.vhost + "/" + recordAppName + "/" + tuple.app + "/" + tuple.stream + "/";
+    }
+    return recordAppName + "/" + tuple.app + "/" + tuple.stream + "/";
+}
+
+static bool isCustomizedPath(const string &customized_path) {
+    GET_CONFIG(string, recordPath, Protocol::kMP4SavePath);
+    return !customized_path.empty() && absoluteDir(customized_path) != absoluteDir(recordPath);
+}
+
 string Recorder::getRecordPath(Recorder::type type, const MediaTuple& tuple, const string &customized_path) {
     GET_CONFIG(bool, enableVhost, General::kEnableVhost);
     switch (type) {
@@ -41,17 +64,19 @@ string Recorder::getRecordPath(Recorder::type type, const MediaTuple& tuple, con
         }
         case Recorder::type_mp4: {
             GET_CONFIG(string, recordPath, Protocol::kMP4SavePath);
-            GET_CONFIG(string, recordAppName, Record::kAppName);
-            string mp4FilePath;
-            if (enableVhost) {
-                mp4FilePath = tuple.vhost + "/" + recordAppName + "/" + tuple.app + "/" + tuple.stream + "/";
-            } else {
-                mp4FilePath = recordAppName + "/" + tuple.app + "/" + tuple.stream + "/";
-            }
+            auto mp4FilePath = mp4RelativePath(tuple);
+            // ProtocolOption::mp4_save_path缺省为配置文件中的录像目录，与之相同时不视为自定义路径
+            // ProtocolOption::mp4_save_path defaults to the record path in the config file, it is not a customized path if they are the same
             //Here we use the customized file path.
-            if (!customized_path.empty()) {
+            if (isCustomizedPath(customized_path)) {
                 return File::absolutePath(mp4FilePath, customized_path);
             }
+            // 配置了存储池时由存储池为新的录像选择磁盘，之后每个录像文件都会重新选择
+            // Let the storage pool select the disk for new recordings when it is configured, each recording file selects again later
+            auto root = StoragePool::Instance().selectRoot();
+            if (!root.empty()) {
+                return File::absolutePath(mp4FilePath, root);
+            }
             return File::absolutePath(mp4FilePath, recordPath);
         }
         case Recorder::type_hls_fmp4: {
@@ -72,6 +97,21 @@ string Recorder::getRecordPath(Recorder::type type, const MediaTuple& tuple, con
     }
 }
 
+vector<string> Recorder::getRecordPaths(Recorder::type type, const MediaTuple &tuple, const string &customized_path) {
+    vector<string> ret { getRecordPath(type, tuple, customized_path) };
+    if (type != Recorder::type_mp4 || isCustomizedPath(customized_path)) {
+        return ret;
+    }
+    auto mp4FilePath = mp4RelativePath(tuple);
+    for (auto &root : StoragePool::Instance().getRoots()) {
+        auto path = File::absolutePath(mp4FilePath, root);
+        if (path != ret.front()) {
+            ret.emplace_back(std::move(path));
+        }
+    }
+    return ret;
+}
+
 std::shared_ptr<MediaSinkInterface> Recorder::createRecorder(type type, const MediaTuple& tuple, const ProtocolOption &option){
     switch (type) {
         case Recorder::type_hls: {
@@ -13,6 +13,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include <cstdint>
 
 namespace mediakit {
@@ -34,10 +35,14 @@ public:
     time_t start_time;  // GMT 标准时间，单位秒
     float time_len;     // 录像长度，单位秒
     uint64_t file_size;    // 文件大小，单位 BYTE
+    uint64_t file_offset = 0; // 在file_path中的字节偏移，hls切片位于归档文件中时与file_size组成其byte range
     std::string file_path;   // 文件路径
     std::string file_name;   // 文件名称
     std::string folder;      // 文件夹路径
     std::string url;         // 播放路径
+    uint64_t io_bytes = 0;   // 生成文件过程中读写磁盘的总字节数，单位 BYTE
+    bool moov_in_place = false; // mp4的moov是否原地写入了文件头部的预留区域
+    uint32_t key_frames = 0; // 视频关键帧数
 };
 
 class Recorder{
@@ -80,6 +85,15 @@ public:
      */
     static std::string getRecordPath(type type, const MediaTuple& tuple, const std::string &customized_path = "");
 
+    /**
+     * 获取流的录像可能所在的所有文件夹，用于按流查询与删除录像
+     * 配置了存储池时mp4录像按文件分布在各磁盘上，返回各磁盘上的录像文件夹(第一个为getRecordPath的结果)，否则只有getRecordPath的结果
+     * Get all folders where the recordings of a stream may be, used to query or delete recordings by stream
+     * With the storage pool configured, mp4 recordings are spread over the disks file by file, so the record folders on all disks
+     * are returned (the first one is the result of getRecordPath), otherwise only the result of getRecordPath is returned
+     */
+    static std::vector<std::string> getRecordPaths(type type, const MediaTuple& tuple, const std::string &customized_path = "");
+
     /**
      * 创建录制器对象
      * @param type hls还是MP4录制
@@ -0,0 +1,238 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/statvfs.h>
+#endif
+#include <algorithm>
+#include "StoragePool.h"
+#include "Util/util.h"
+#include "Util/File.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 写入出错后，该时长内的磁盘不参与新录像的选择
+// After a write error, the disk does not take new recordings within this duration
+static constexpr uint64_t kErrorHoldMS = 60 * 1000;
+
+// 写入延时的基准值，延时都很低时按负载均衡分配
+// Baseline of the write latency, recordings are balanced by load when all latencies are low
+static constexpr uint64_t kBaseLatencyUS = 1000;
+
+static bool getDiskSpace(const string &root, uint64_t &total_bytes, uint64_t &free_bytes) {
+#if defined(_WIN32)
+    ULARGE_INTEGER free_to_caller, total, total_free;
+    if (!GetDiskFreeSpaceExA(root.data(), &free_to_caller, &total, &total_free)) {
+        return false;
+    }
+    total_bytes = total.QuadPart;
+    free_bytes = free_to_caller.QuadPart;
+#else
+    struct statvfs st;
+    if (statvfs(root.data(), &st)) {
+        return false;
+    }
+    total_bytes = (uint64_t)st.f_blocks * st.f_frsize;
+    free_bytes = (uint64_t)st.f_bavail * st.f_frsize;
+#endif
+    return true;
+}
+
+StoragePool::Disk::Disk(string root) {
+    _root = std::move(root);
+}
+
+const string &StoragePool::Disk::getRoot() const {
+    return _root;
+}
+
+void StoragePool::Disk::addWriter() {
+    ++_writers;
+}
+
+void StoragePool::Disk::delWriter() {
+    --_writers;
+}
+
+void StoragePool::Disk::onWrite(size_t bytes, bool ok) {
+    ++_writes;
+    _write_bytes += bytes;
+    if (!ok) {
+        onError();
+    }
+}
+
+void StoragePool::Disk::onSyncBegin() {
+    ++_queue_depth;
+}
+
+void StoragePool::Disk::onFlushEnd(uint64_t us, bool ok) {
+    --_queue_depth;
+    if (!ok) {
+        onError();
+    }
+    lock_guard<mutex> lck(_mtx);
+    _flush_latency_us = (_flush_latency_us * 7 + us) / 8;
+}
+
+void StoragePool::Disk::onSyncEnd(uint64_t us, bool ok) {
+    --_queue_depth;
+    if (!ok) {
+        onError();
+    }
+    lock_guard<mutex> lck(_mtx);
+    _sync_latency_us = (_sync_latency_us * 7 + us) / 8;
+}
+
+void StoragePool::Disk::onError() {
+    ++_write_errors;
+    _last_error_ms = getCurrentMillisecond(true);
+}
+
+StoragePool::Disk::Statistic StoragePool::Disk::getStatistic() {
+    GET_CONFIG(uint32_t, minFreeMB, Record::kStorageMinFreeMB);
+    Statistic ret;
+    ret.root = _root;
+    auto space_ok = getDiskSpace(_root, ret.total_bytes, ret.free_bytes);
+    ret.writers = _writers;
+    ret.queue_depth = _queue_depth;
+    ret.writes = _writes;
+    ret.write_bytes = _write_bytes;
+    ret.write_errors = _write_errors;
+    uint64_t last_error_ms = _last_error_ms;
+    lock_guard<mutex> lck(_mtx);
+    // 距上次计算超过1秒时按字节数的增量更新速率
+    // Update the rate by the byte increment when more than 1 second has passed since the last calculation
+    auto elapsed = _rate_ticker.elapsedTime();
+    if (elapsed >= 1000) {
+        _write_rate = (ret.write_bytes - _rate_bytes) * 1000 / elapsed;
+        _rate_bytes = ret.write_bytes;
+        _rate_ticker.resetTime();
+    }
+    ret.write_rate = _write_rate;
+    ret.flush_latency_us = _flush_latency_us;
+    ret.sync_latency_us = _sync_latency_us;
+    ret.healthy = space_ok && ret.free_bytes >= ((uint64_t)minFreeMB << 20)
+        && (!last_error_ms || getCurrentMillisecond(true) - last_error_ms >= kErrorHoldMS);
+    return ret;
+}
+
+INSTANCE_IMP(StoragePool)
+
+vector<StoragePool::Disk::Ptr> StoragePool::getDisks() {
+    GET_CONFIG_FUNC(vector<string>, roots, Record::kStoragePool, [](const string &str) {
+        vector<string> ret;
+        for (auto &item : split(str, ";")) {
+            if (item.empty()) {
+                continue;
+            }
+            auto root = File::absolutePath("", item, true);
+            if (!end_with(root, "/")) {
+                root += "/";
+            }
+            ret.emplace_back(std::move(root));
+        }
+        return ret;
+    });
+
+    lock_guard<mutex> lck(_mtx);
+    if (roots != _roots) {
+        // 配置变更，保留仍在存储池中的磁盘的统计
+        // The config changed, keep the statistics of the disks still in the pool
+        vector<Disk::Ptr> disks;
+        for (auto &root : roots) {
+            auto it = find_if(_disks.begin(), _disks.end(), [&](const Disk::Ptr &disk) { return disk->getRoot() == root; });
+            disks.emplace_back(it == _disks.end() ? std::make_shared<Disk>(root) : *it);
+        }
+        _disks = std::move(disks);
+        _roots = roots;
+        for (auto &root : _roots) {
+            InfoL << "Record storage pool disk: " << root;
+        }
+    }
+    return _disks;
+}
+
+string StoragePool::selectRoot() {
+    auto disks = getDisks();
+    if (disks.empty()) {
+        return "";
+    }
+    Disk::Ptr best;
+    uint64_t best_score = 0;
+    uint64_t best_free = 0;
+    Disk::Ptr most_free;
+    uint64_t most_free_bytes = 0;
+    for (auto &disk : disks) {
+        auto stat = disk->getStatistic();
+        if (!most_free || stat.free_bytes > most_free_bytes) {
+            most_free = disk;
+            most_free_bytes = stat.free_bytes;
+        }
+        if (!stat.healthy) {
+            continue;
+        }
+        // 写入越慢、正在写入的录像越多，得分越高
+        // The slower the writes and the more recordings being written, the higher the score
+        auto score = (stat.writers + stat.queue_depth + 1) * (kBaseLatencyUS + stat.flush_latency_us + stat.sync_latency_us);
+        if (!best || score < best_score || (score == best_score && stat.free_bytes > best_free)) {
+            best = disk;
+            best_score = score;
+            best_free = stat.free_bytes;
+        }
+    }
+    if (best) {
+        return best->getRoot();
+    }
+    WarnL << "No usable disk in the record storage pool, use the disk with the most free space: " << most_free->getRoot();
+    return most_free->getRoot();
+}
+
+string StoragePool::selectPath(const string &path) {
+    auto disk = getDisk(path);
+    if (!disk) {
+        return path;
+    }
+    auto root = selectRoot();
+    return root.empty() ? path : root + path.substr(disk->getRoot().size());
+}
+
+vector<string> StoragePool::getRoots() {
+    getDisks();
+    lock_guard<mutex> lck(_mtx);
+    return _roots;
+}
+
+StoragePool::Disk::Ptr StoragePool::getDisk(const string &path) {
+    Disk::Ptr ret;
+    for (auto &disk : getDisks()) {
+        if (start_with(path, disk->getRoot()) && (!ret || disk->getRoot().size() > ret->getRoot().size())) {
+            ret = disk;
+        }
+    }
+    return ret;
+}
+
+vector<StoragePool::Disk::Statistic> StoragePool::getStatistic() {
+    vector<Disk::Statistic> ret;
+    for (auto &disk : getDisks()) {
+        ret.emplace_back(disk->getStatistic());
+    }
+    return ret;
+}
+
+} // namespace mediakit
@@ -0,0 +1,167 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_STORAGEPOOL_H
+#define ZLMEDIAKIT_STORAGEPOOL_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Util/TimeTicker.h"
+
+namespace mediakit {
+
+/**
+ * mp4录像存储池
+ * 配置多个磁盘挂载点后，每个新的录像文件按各磁盘的写入延时、负载与剩余空间选择磁盘，空间不足或写入出错的磁盘不参与选择；
+ * 流的录像在各磁盘上使用相同的相对路径，按流查询与删除录像时遍历所有磁盘
+ * Storage pool of mp4 recordings
+ * With multiple disk mount points configured, each new recording file selects a disk by the write latency, load and free space
+ * of each disk, disks low on space or with write errors are not selected;
+ * recordings of a stream use the same relative path on every disk, and all disks are searched to query or delete them by stream
+ */
+class StoragePool {
+public:
+    class Disk {
+    public:
+        using Ptr = std::shared_ptr<Disk>;
+
+        struct Statistic {
+            std::string root;
+            uint64_t total_bytes = 0;
+            uint64_t free_bytes = 0;
+            // 正在写入的录像文件数
+            // Number of recording files being written
+            uint32_t writers = 0;
+            // 正在进行的刷新(fflush)与同步(fdatasync)操作数
+            // Number of flush (fflush) and sync (fdatasync) operations in progress
+            uint32_t queue_depth = 0;
+            uint64_t writes = 0;
+            uint64_t write_bytes = 0;
+            uint64_t write_errors = 0;
+            // 最近的写入速率，单位字节每秒
+            // Recent write rate in bytes per second
+            uint64_t write_rate = 0;
+            // 刷新与同步操作的平均耗时(指数移动平均)，单位微秒
+            // Average time of flush and sync operations (exponential moving average) in microseconds
+            uint64_t flush_latency_us = 0;
+            uint64_t sync_latency_us = 0;
+            // 剩余空间充足且最近没有写入错误
+            // Enough free space and no recent write errors
+            bool healthy = false;
+        };
+
+        Disk(std::string root);
+
+        const std::string &getRoot() const;
+
+        /**
+         * 录像文件打开与关闭
+         * A recording file is opened or closed
+         */
+        void addWriter();
+        void delWriter();
+
+        /**
+         * 写入一个sample，只累计字节数，不计时
+         * @param bytes 写入字节数
+         * @param ok 是否成功
+         * A sample is written, only the bytes are counted without timing
+         * @param bytes bytes written
+         * @param ok whether it succeeded
+         */
+        void onWrite(size_t bytes, bool ok);
+
+        /**
+         * 刷新(fflush)或同步(fdatasync)开始与结束，写入延时在此统计
+         * @param us 耗时，单位微秒
+         * @param ok 是否成功
+         * A flush (fflush) or sync (fdatasync) begins or ends, the write latency is measured here
+         * @param us time spent in microseconds
+         * @param ok whether it succeeded
+         */
+        void onSyncBegin();
+        void onFlushEnd(uint64_t us, bool ok);
+        void onSyncEnd(uint64_t us, bool ok);
+
+        Statistic getStatistic();
+
+    private:
+        void onError();
+
+    private:
+        std::string _root;
+        std::atomic<uint32_t> _writers { 0 };
+        std::atomic<uint32_t> _queue_depth { 0 };
+        std::atomic<uint64_t> _writes { 0 };
+        std::atomic<uint64_t> _write_bytes { 0 };
+        std::atomic<uint64_t> _write_errors { 0 };
+        std::atomic<uint64_t> _last_error_ms { 0 };
+        std::mutex _mtx;
+        uint64_t _flush_latency_us = 0;
+        uint64_t _sync_latency_us = 0;
+        // 写入速率在获取统计时按字节数的增量计算
+        // The write rate is calculated from the byte increment when the statistics are got
+        uint64_t _write_rate = 0;
+        uint64_t _rate_bytes = 0;
+        toolkit::Ticker _rate_ticker;
+    };
+
+    static StoragePool &Instance();
+
+    /**
+     * 为新的录像文件选择根目录
+     * @return 根目录，未配置存储池时返回空
+     * Select the root directory for a new recording file
+     * @return the root directory, empty if the storage pool is not configured
+     */
+    std::string selectRoot();
+
+    /**
+     * 为新的录像文件重新选择磁盘
+     * @param path 位于某个存储池磁盘上的录像文件夹
+     * @return 当前最合适的磁盘上相同相对路径的文件夹，path不在存储池中时原样返回
+     * Select the disk again for a new recording file
+     * @param path record folder on one of the disks of the storage pool
+     * @return the folder with the same relative path on the most suitable disk now, path itself if it is not in the storage pool
+     */
+    std::string selectPath(const std::string &path);
+
+    /**
+     * 获取文件所在的存储池磁盘
+     * @return 文件不在存储池中时返回nullptr
+     * Get the disk of the storage pool where the file is
+     * @return nullptr if the file is not in the storage pool
+     */
+    Disk::Ptr getDisk(const std::string &path);
+
+    /**
+     * 获取存储池的所有根目录，未配置存储池时为空
+     * Get all root directories of the storage pool, empty if the storage pool is not configured
+     */
+    std::vector<std::string> getRoots();
+
+    std::vector<Disk::Statistic> getStatistic();
+
+private:
+    StoragePool() = default;
+    std::vector<Disk::Ptr> getDisks();
+
+private:
+    std::mutex _mtx;
+    std::vector<std::string> _roots;
+    std::vector<Disk::Ptr> _disks;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_STORAGEPOOL_H
@@ -480,9 +480,16 @@ FCI_TWCC::TwccPacketStatus FCI_TWCC::getPacketChunkList(size_t total_size) const
         }
         ptr += 2;
     }
-    for (auto &pr : ret) {
+    // recv delta按包序排列，seq回环时不能按map的顺序遍历
+    // Recv deltas are in packet order, the map order can not be used when seq wraps around
+    seq = getBaseSeq();
+    for (uint16_t i = 0; i < rtp_count; ++i, ++seq) {
+        auto it = ret.find(seq);
+        if (it == ret.end()) {
+            break;
+        }
         CHECK(ptr <= end);
-        pr.second.second = getRecvDelta(pr.second.first, ptr, end);
+        it->second.second = getRecvDelta(it->second.first, ptr, end);
     }
     return ret;
 }
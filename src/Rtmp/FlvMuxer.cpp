@@ -41,6 +41,9 @@ void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr
         return;
     }
 
+    // 开启共享flv tag头，避免每个播放器为每个rtmp包生成tag头
+    // Enable the shared flv tag header, avoiding generating the tag header for every rtmp packet in every player
+    media->enableFlvTag(isWebSocketFlv());
     onWriteFlvHeader(media);
 
     std::weak_ptr<FlvMuxer> weak_self = getSharedPtr();
@@ -84,12 +87,6 @@ BufferRaw::Ptr FlvMuxer::obtainBuffer() {
     return _packet_pool.obtain2();
 }
 
-BufferRaw::Ptr FlvMuxer::obtainBuffer(const void *data, size_t len) {
-    auto buffer = obtainBuffer();
-    buffer->assign((const char *) data, len);
-    return buffer;
-}
-
 void FlvMuxer::onWriteFlvHeader(const RtmpMediaSource::Ptr &src) {
     // 发送flv文件头  [AUTO-TRANSLATED:ee2c5556]
     // Send the flv file header.
@@ -127,25 +124,29 @@ void FlvMuxer::onWriteFlvHeader(const RtmpMediaSource::Ptr &src) {
 }
 
 void FlvMuxer::onWriteFlvTag(const RtmpPacket::Ptr &pkt, uint32_t time_stamp, bool flush) {
+    auto &tag = pkt->flv_tag;
+    if (tag && time_stamp == pkt->time_stamp && tag->header(isWebSocketFlv())) {
+        // 使用RtmpMediaSource生成的共享tag头
+        // Use the shared tag header generated by RtmpMediaSource
+        onWriteFlvTag(*tag, pkt, flush);
+        return;
+    }
     onWriteFlvTag(pkt->type_id, pkt, time_stamp, flush);
 }
 
 void FlvMuxer::onWriteFlvTag(uint8_t type, const Buffer::Ptr &buffer, uint32_t time_stamp, bool flush) {
-    RtmpTagHeader header;
-    header.type = type;
-    set_be24(header.data_size, (uint32_t) buffer->size());
-    header.timestamp_ex = (time_stamp >> 24) & 0xff;
-    set_be24(header.timestamp, time_stamp & 0xFFFFFF);
+    onWriteFlvTag(FlvTag(type, buffer->size(), time_stamp, isWebSocketFlv()), buffer, flush);
+}
 
+void FlvMuxer::onWriteFlvTag(const FlvTag &tag, const Buffer::Ptr &buffer, bool flush) {
     //tag header
-    onWrite(obtainBuffer((char *) &header, sizeof(header)), false);
+    onWriteRaw(tag.header(isWebSocketFlv()), false);
 
     //tag data
-    onWrite(buffer, false);
+    onWriteRaw(buffer, false);
 
     //PreviousTagSize
-    uint32_t size = htonl((uint32_t) (buffer->size() + sizeof(header)));
-    onWrite(obtainBuffer((char *) &size, 4), flush);
+    onWriteRaw(tag.tail(), flush);
 }
 
 void FlvMuxer::onWriteRtmp(const RtmpPacket::Ptr &pkt, bool flush) {
@@ -31,12 +31,24 @@ protected:
     virtual void onDetach() = 0;
     virtual std::shared_ptr<FlvMuxer> getSharedPtr() = 0;
 
+    /**
+     * 是否为websocket-flv，是则每个flv tag打包为一个websocket帧并通过onWriteRaw输出
+     * Whether it is websocket-flv, if so each flv tag is packed into one websocket frame and output through onWriteRaw
+     */
+    virtual bool isWebSocketFlv() const { return false; }
+
+    /**
+     * 输出已打包好的数据，websocket-flv时不再封装websocket帧
+     * Output already packed data, no more websocket frame wrapping for websocket-flv
+     */
+    virtual void onWriteRaw(const toolkit::Buffer::Ptr &data, bool flush) { onWrite(data, flush); }
+
 private:
     void onWriteFlvHeader(const RtmpMediaSource::Ptr &src);
     void onWriteRtmp(const RtmpPacket::Ptr &pkt, bool flush);
     void onWriteFlvTag(const RtmpPacket::Ptr &pkt, uint32_t time_stamp, bool flush);
     void onWriteFlvTag(uint8_t type, const toolkit::Buffer::Ptr &buffer, uint32_t time_stamp, bool flush);
-    toolkit::BufferRaw::Ptr obtainBuffer(const void *data, size_t len);
+    void onWriteFlvTag(const FlvTag &tag, const toolkit::Buffer::Ptr &buffer, bool flush);
     toolkit::BufferRaw::Ptr obtainBuffer();
 
 private:
@@ -9,6 +9,7 @@
  */
 
 #include "Rtmp.h"
+#include "utils.h"
 #include "Common/config.h"
 #include "Extension/Factory.h"
 
@@ -127,6 +128,42 @@ void Metadata::addTrack(AMFValue &metadata, const Track::Ptr &track) {
     new_metadata->getMetadata().object_for_each([&](const std::string &key, const AMFValue &value) { metadata.set(key, value); });
 }
 
+FlvTag::FlvTag(uint8_t type, size_t size, uint32_t time_stamp, bool websocket) {
+    RtmpTagHeader tag;
+    tag.type = type;
+    set_be24(tag.data_size, (uint32_t)size);
+    tag.timestamp_ex = (time_stamp >> 24) & 0xff;
+    set_be24(tag.timestamp, time_stamp & 0xFFFFFF);
+    _header = std::make_shared<BufferString>(string((char *)&tag, sizeof(tag)));
+
+    uint32_t tag_size = htonl((uint32_t)(size + sizeof(tag)));
+    _tail = std::make_shared<BufferString>(string((char *)&tag_size, 4));
+
+    if (!websocket) {
+        return;
+    }
+    // 服务端发送的websocket二进制帧，fin=1且不加掩码
+    // Websocket binary frame sent by the server, fin=1 and unmasked
+    string ws_header;
+    uint64_t len = size + sizeof(tag) + 4;
+    ws_header.push_back((char)0x82);
+    if (len < 126) {
+        ws_header.push_back((char)len);
+    } else if (len <= 0xFFFF) {
+        ws_header.push_back((char)126);
+        uint16_t len_low = htons((uint16_t)len);
+        ws_header.append((char *)&len_low, 2);
+    } else {
+        ws_header.push_back((char)127);
+        uint32_t len_high = htonl(len >> 32);
+        uint32_t len_low = htonl(len & 0xFFFFFFFF);
+        ws_header.append((char *)&len_high, 4);
+        ws_header.append((char *)&len_low, 4);
+    }
+    ws_header.append((char *)&tag, sizeof(tag));
+    _ws_header = std::make_shared<BufferString>(std::move(ws_header));
+}
+
 RtmpPacket::Ptr RtmpPacket::create() {
 #if 0
     static ResourcePool<RtmpPacket> packet_pool;
@@ -147,6 +184,7 @@ void RtmpPacket::clear() {
     ts_field = 0;
     body_size = 0;
     buffer.clear();
+    flv_tag = nullptr;
 }
 
 bool RtmpPacket::isVideoKeyFrame() const {
@@ -171,6 +171,46 @@ struct RtmpVideoHeaderClassic {
 
 #pragma pack(pop)
 
+/**
+ * rtmp包对应的flv tag头与PreviousTagSize，只依赖包类型、长度与时间戳，
+ * 由RtmpMediaSource在写入环形缓存前生成一次，所有http-flv/ws-flv播放器共享引用
+ * The flv tag header and PreviousTagSize of a rtmp packet, which only depend on the packet type, size and timestamp.
+ * Generated once by RtmpMediaSource before writing to the ring buffer, all http-flv/ws-flv players share references to it
+ */
+class FlvTag {
+public:
+    using Ptr = std::shared_ptr<FlvTag>;
+
+    /**
+     * @param type tag类型
+     * @param size tag data长度
+     * @param time_stamp 时间戳
+     * @param websocket 是否生成websocket-flv使用的帧头
+     * @param type tag type
+     * @param size tag data size
+     * @param time_stamp timestamp
+     * @param websocket Whether to generate the frame header used by websocket-flv
+     */
+    FlvTag(uint8_t type, size_t size, uint32_t time_stamp, bool websocket);
+
+    /**
+     * 获取tag头，websocket-flv时包含websocket帧头(整个tag为一个websocket帧)
+     * Get the tag header, the websocket frame header is included for websocket-flv (the whole tag is one websocket frame)
+     */
+    const toolkit::Buffer::Ptr &header(bool websocket) const { return websocket ? _ws_header : _header; }
+
+    /**
+     * 获取PreviousTagSize
+     * Get PreviousTagSize
+     */
+    const toolkit::Buffer::Ptr &tail() const { return _tail; }
+
+private:
+    toolkit::Buffer::Ptr _header;
+    toolkit::Buffer::Ptr _ws_header;
+    toolkit::Buffer::Ptr _tail;
+};
+
 class RtmpPacket : public toolkit::Buffer{
 public:
     friend class RtmpProtocol;
@@ -183,6 +223,9 @@ public:
     uint32_t chunk_id;
     size_t body_size;
     toolkit::BufferLikeString buffer;
+    // 共享的flv tag头，写入RtmpMediaSource后不再修改
+    // Shared flv tag header, not modified after being written to RtmpMediaSource
+    FlvTag::Ptr flv_tag;
 
 public:
     static Ptr create();
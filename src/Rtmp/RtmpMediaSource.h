@@ -12,6 +12,7 @@
 #define SRC_RTMP_RTMPMEDIASOURCE_H_
 
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <functional>
@@ -160,6 +161,19 @@ public:
         return _have_video;
     }
 
+    /**
+     * 开启共享flv tag头，此后写入的rtmp包都会预先生成flv tag头供所有flv播放器共享
+     * @param websocket 是否同时生成websocket-flv的帧头
+     * Enable the shared flv tag header, after that every written rtmp packet carries a pre-generated flv tag header shared by all flv players
+     * @param websocket Whether to also generate the websocket-flv frame header
+     */
+    void enableFlvTag(bool websocket) {
+        _flv_tag = true;
+        if (websocket) {
+            _ws_flv_tag = true;
+        }
+    }
+
     bool haveAudio() const {
         return _have_audio;
     }
@@ -184,6 +198,8 @@ private:
 private:
     bool _have_video = false;
     bool _have_audio = false;
+    std::atomic<bool> _flv_tag { false };
+    std::atomic<bool> _ws_flv_tag { false };
     int _ring_size;
     uint32_t _track_stamps[TrackMax] = {0};
     AMFValue _metadata;
@@ -116,6 +116,11 @@ void RtmpMediaSource::onWrite(RtmpPacket::Ptr pkt, bool /*= true*/) {
             regist();
         }
     }
+    if (_flv_tag && !pkt->flv_tag) {
+        // 只在源线程生成一次，所有flv播放器共享
+        // Generated only once in the source thread, shared by all flv players
+        pkt->flv_tag = std::make_shared<FlvTag>(pkt->type_id, pkt->size(), pkt->time_stamp, _ws_flv_tag);
+    }
     bool key = pkt->isVideoKeyFrame();
     auto stamp = pkt->time_stamp;
     PacketCache<RtmpPacket>::inputPacket(stamp, is_video, std::move(pkt), key);
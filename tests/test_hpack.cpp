@@ -0,0 +1,159 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */#include <string>
+#include <vector>
+#include <utility>
+#include "Util/logger.h"
+#include "Common/macros.h"
+#include "Http/Hpack.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 使用rfc7541附录C的示例测试hpack编解码
+// Test hpack encoding and decoding with the examples in rfc7541 appendix C
+
+using Headers = vector<pair<string, string> >;
+
+static string fromHex(const string &hex) {
+    string ret;
+    for (size_t i = 0; i < hex.size();) {
+        if (hex[i] == ' ') {
+            ++i;
+            continue;
+        }
+        ret.push_back((char)stoi(hex.substr(i, 2), nullptr, 16));
+        i += 2;
+    }
+    return ret;
+}
+
+static Headers decode(HpackDecoder &decoder, const string &block) {
+    Headers ret;
+    auto ok = decoder.decode((const uint8_t *)block.data(), block.size(), [&](string &name, string &value) {
+        ret.emplace_back(name, value);
+    });
+    CHECK(ok, "decode failed");
+    return ret;
+}
+
+static const Headers kRequests[] = {
+    { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" } },
+    { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" }, { "cache-control", "no-cache" } },
+    { { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" }, { ":authority", "www.example.com" }, { "custom-key", "custom-value" } },
+};
+
+static const Headers kResponses[] = {
+    { { ":status", "302" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:21 GMT" }, { "location", "https://www.example.com" } },
+    { { ":status", "307" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:21 GMT" }, { "location", "https://www.example.com" } },
+    { { ":status", "200" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:22 GMT" }, { "location", "https://www.example.com" },
+      { "content-encoding", "gzip" }, { "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" } },
+};
+
+// C.1 整数表示
+// C.1 integer representation
+static void testInteger() {
+    string out;
+    Hpack::encodeInteger(out, 0, 5, 10);
+    CHECK(out == fromHex("0a"));
+    out.clear();
+    Hpack::encodeInteger(out, 0, 5, 1337);
+    CHECK(out == fromHex("1f 9a 0a"));
+    out.clear();
+    Hpack::encodeInteger(out, 0, 8, 42);
+    CHECK(out == fromHex("2a"));
+}
+
+// C.3/C.4 请求，C.4的编码结果也应与示例一致
+// C.3/C.4 requests, the encoding result should also match the C.4 example
+static void testRequests() {
+    static const char *plain[] = {
+        "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d",
+        "8286 84be 5808 6e6f 2d63 6163 6865",
+        "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65",
+    };
+    static const char *huffman[] = {
+        "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff",
+        "8286 84be 5886 a8eb 1064 9cbf",
+        "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf",
+    };
+    HpackDecoder plain_decoder, huffman_decoder;
+    HpackEncoder encoder;
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK(decode(plain_decoder, fromHex(plain[i])) == kRequests[i], "C.3.", i + 1);
+        CHECK(decode(huffman_decoder, fromHex(huffman[i])) == kRequests[i], "C.4.", i + 1);
+        string block;
+        encoder.beginBlock(block);
+        for (auto &pr : kRequests[i]) {
+            encoder.encode(block, pr.first, pr.second);
+        }
+        CHECK(block == fromHex(huffman[i]), "encode C.4.", i + 1);
+    }
+}
+
+// C.5/C.6 回复，动态表大小为256，第三个回复会淘汰表项
+// C.5/C.6 responses, the dynamic table size is 256, the third response evicts entries
+static void testResponses() {
+    static const char *plain[] = {
+        "4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3120 474d 546e 1768 7474 7073 3a2f 2f77 7777 2e65 7861 6d70 6c65 2e63 6f6d",
+        "4803 3330 37c1 c0bf",
+        "88c1 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3220 474d 54c0 5a04 677a 6970 7738 666f 6f3d 4153 444a 4b48 514b 425a 584f 5157 454f 5049 5541 5851 5745 4f49 553b 206d 6178 2d61 6765 3d33 3630 303b 2076 6572 7369 6f6e 3d31",
+    };
+    static const char *huffman[] = {
+        "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0 82a6 2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 e9ae 82ae 43d3",
+        "4883 640e ffc1 c0bf",
+        "88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 a62d 1bff c05a 839b d9ab 77ad 94e7 821d d7f2 e6c7 b335 dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27 0fb5 291f 9587 3160 65c0 03ed 4ee5 b106 3d50 07",
+    };
+    HpackDecoder plain_decoder, huffman_decoder;
+    for (size_t i = 0; i < 3; ++i) {
+        // 示例的动态表大小由SETTINGS约定，这里在首个header block前加上动态表大小更新(256)
+        // The table size of the example is agreed through SETTINGS, here a table size update (256) is prepended to the first block
+        string size_update = i ? "" : fromHex("3fe1 01");
+        CHECK(decode(plain_decoder, size_update + fromHex(plain[i])) == kResponses[i], "C.5.", i + 1);
+        CHECK(decode(huffman_decoder, size_update + fromHex(huffman[i])) == kResponses[i], "C.6.", i + 1);
+    }
+}
+
+// 编码器输出(包括表大小变化与不入表的头)能被解码器还原
+// The encoder output (including table size changes and headers not indexed) is restored by the decoder
+static void testRoundTrip() {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    for (size_t i = 0; i < 6; ++i) {
+        if (i == 2) {
+            encoder.setMaxTableSize(0);
+            encoder.setMaxTableSize(256);
+        }
+        string block;
+        encoder.beginBlock(block);
+        for (auto &pr : kResponses[i % 3]) {
+            encoder.encode(block, pr.first, pr.second);
+        }
+        CHECK(decode(decoder, block) == kResponses[i % 3], "round trip ", i);
+    }
+
+    // 非法的huffman填充与越界索引必须报错
+    // Invalid huffman padding and out of range indexes must fail
+    string out;
+    auto bad_padding = fromHex("f1e3 c2e5 f23a 6ba0 ab90 f400");
+    CHECK(!Hpack::huffmanDecode((const uint8_t *)bad_padding.data(), bad_padding.size(), out));
+    auto bad_index = fromHex("be");
+    CHECK(!HpackDecoder().decode((const uint8_t *)bad_index.data(), bad_index.size(), [](string &, string &) {}));
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    testInteger();
+    testRequests();
+    testResponses();
+    testRoundTrip();
+    InfoL << "ok";
+    return 0;
+}
@@ -0,0 +1,234 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */#include <string>
+#include <vector>
+#include <algorithm>
+#include "Util/logger.h"
+#include "Common/macros.h"
+#include "Http/Http2Splitter.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 测试http/2帧在任意位置被拆分输入时的解析结果，以及回复的分帧与超大body的处理
+// Test the parse result when http/2 frames are input split at arbitrary positions,
+// the framing of responses and the handling of oversize bodies
+
+struct Frame {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t stream_id;
+    string payload;
+};
+
+struct Request {
+    uint32_t stream_id;
+    string method;
+    string url;
+    string host;
+    string content_type;
+    string body;
+
+    bool operator==(const Request &that) const {
+        return stream_id == that.stream_id && method == that.method && url == that.url && host == that.host
+            && content_type == that.content_type && body == that.body;
+    }
+};
+
+class TestSplitter : public Http2Splitter {
+public:
+    vector<Request> requests;
+    vector<string> errors;
+    string output;
+
+    // 解析已发送的数据(跳过本端不需要关心的帧)
+    // Parse the sent data (frames not interesting here are skipped)
+    vector<Frame> takeFrames(bool skip_control = true) {
+        vector<Frame> ret;
+        size_t pos = 0;
+        while (pos + 9 <= output.size()) {
+            auto ptr = (const uint8_t *)output.data() + pos;
+            Frame frame;
+            size_t len = (ptr[0] << 16) | (ptr[1] << 8) | ptr[2];
+            frame.type = ptr[3];
+            frame.flags = ptr[4];
+            frame.stream_id = ((ptr[5] & 0x7F) << 24) | (ptr[6] << 16) | (ptr[7] << 8) | ptr[8];
+            frame.payload = output.substr(pos + 9, len);
+            pos += 9 + len;
+            if (skip_control && (frame.type == SETTINGS || frame.type == WINDOW_UPDATE)) {
+                continue;
+            }
+            ret.emplace_back(std::move(frame));
+        }
+        CHECK(pos == output.size(), "incomplete frame in output");
+        output.clear();
+        return ret;
+    }
+
+protected:
+    void onHttp2Request(uint32_t stream_id, Parser &parser) override {
+        Request req;
+        req.stream_id = stream_id;
+        req.method = parser.method();
+        req.url = parser.fullUrl();
+        req.host = parser["Host"];
+        req.content_type = parser["Content-Type"];
+        req.body = parser.content();
+        requests.emplace_back(std::move(req));
+    }
+    void onHttp2Send(Buffer::Ptr buffer) override { output.append(buffer->data(), buffer->size()); }
+    void onHttp2Error(const string &err) override { errors.emplace_back(err); }
+};
+
+static string makeFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const string &payload) {
+    string ret;
+    ret.push_back((char)(payload.size() >> 16));
+    ret.push_back((char)(payload.size() >> 8));
+    ret.push_back((char)payload.size());
+    ret.push_back((char)type);
+    ret.push_back((char)flags);
+    ret.push_back((char)(stream_id >> 24));
+    ret.push_back((char)(stream_id >> 16));
+    ret.push_back((char)(stream_id >> 8));
+    ret.push_back((char)stream_id);
+    return ret + payload;
+}
+
+static const uint8_t kEndStream = 0x01;
+static const uint8_t kEndHeaders = 0x04;
+static const uint8_t kPadded = 0x08;
+
+// 客户端连接序言、SETTINGS，一个带分段body(含填充)的POST和一个header block被CONTINUATION拆分的GET
+// Client connection preface, SETTINGS, a POST with a body in several DATA frames (with padding)
+// and a GET whose header block is split by CONTINUATION
+static string makeClientData() {
+    HpackEncoder encoder;
+    string post;
+    encoder.encode(post, ":method", "POST");
+    encoder.encode(post, ":scheme", "http");
+    encoder.encode(post, ":path", "/index/api/test?key=value");
+    encoder.encode(post, ":authority", "127.0.0.1:80");
+    encoder.encode(post, "content-type", "application/json");
+
+    string get;
+    encoder.encode(get, ":method", "GET");
+    encoder.encode(get, ":scheme", "http");
+    encoder.encode(get, ":path", "/live/test.live.flv");
+    encoder.encode(get, ":authority", "127.0.0.1:80");
+
+    string ret = Http2Splitter::kPreface;
+    ret += makeFrame(Http2Splitter::SETTINGS, 0, 0, "");
+    ret += makeFrame(Http2Splitter::HEADERS, kEndHeaders, 1, post);
+    ret += makeFrame(Http2Splitter::DATA, 0, 1, "{\"a\":");
+    ret += makeFrame(Http2Splitter::DATA, kEndStream | kPadded, 1, string(1, '\x03') + "1}" + string(3, '\0'));
+    ret += makeFrame(Http2Splitter::HEADERS, kEndStream, 3, get.substr(0, 5));
+    ret += makeFrame(Http2Splitter::CONTINUATION, kEndHeaders, 3, get.substr(5));
+    return ret;
+}
+
+static void testSplit() {
+    vector<Request> expected(2);
+    expected[0] = { 1, "POST", "/index/api/test?key=value", "127.0.0.1:80", "application/json", "{\"a\":1}" };
+    expected[1] = { 3, "GET", "/live/test.live.flv", "127.0.0.1:80", "", "" };
+
+    auto data = makeClientData();
+    for (size_t slice : { 1, 2, 7, 100, 100000 }) {
+        TestSplitter splitter;
+        splitter.startHttp2(100, 1024);
+        for (size_t pos = 0; pos < data.size(); pos += slice) {
+            splitter.inputHttp2(data.data() + pos, std::min(slice, data.size() - pos));
+        }
+        CHECK(splitter.errors.empty(), "unexpected error, slice: ", slice);
+        CHECK(splitter.requests == expected, "request mismatch, slice: ", slice);
+    }
+}
+
+static void testResponse() {
+    TestSplitter splitter;
+    splitter.startHttp2(100, 1024);
+    auto data = makeClientData();
+    splitter.inputHttp2(data.data(), data.size());
+    splitter.takeFrames();
+
+    // body超过对端最大帧长时拆分为多个DATA帧，最后一帧携带END_STREAM
+    // The body is split into several DATA frames beyond the peer maximum frame size, the last one carries END_STREAM
+    StrCaseMap headers;
+    headers.emplace("Content-Type", "text/plain");
+    headers.emplace("Connection", "keep-alive");
+    splitter.sendHttp2Headers(1, 200, headers, false);
+    string body(40000, 'x');
+    splitter.sendHttp2Data(1, std::make_shared<BufferString>(body), true);
+    auto frames = splitter.takeFrames();
+    CHECK(frames.size() == 4 && frames[0].type == Http2Splitter::HEADERS && frames[0].flags == kEndHeaders);
+
+    HpackDecoder decoder;
+    vector<pair<string, string> > response;
+    CHECK(decoder.decode((const uint8_t *)frames[0].payload.data(), frames[0].payload.size(), [&](string &name, string &value) {
+        response.emplace_back(name, value);
+    }));
+    // 连接相关的头被忽略
+    // Connection specific headers are ignored
+    CHECK(response.size() == 2 && response[0].first == ":status" && response[0].second == "200");
+    CHECK(response[1].first == "content-type" && response[1].second == "text/plain");
+
+    string received;
+    for (size_t i = 1; i < frames.size(); ++i) {
+        CHECK(frames[i].type == Http2Splitter::DATA && frames[i].stream_id == 1 && frames[i].payload.size() <= 16384);
+        CHECK((frames[i].flags == kEndStream) == (i + 1 == frames.size()));
+        received += frames[i].payload;
+    }
+    CHECK(received == body);
+}
+
+static void testOversizeBody() {
+    HpackEncoder encoder;
+    string block;
+    encoder.encode(block, ":method", "POST");
+    encoder.encode(block, ":scheme", "http");
+    encoder.encode(block, ":path", "/upload");
+
+    TestSplitter splitter;
+    splitter.startHttp2(100, 10);
+    auto data = Http2Splitter::kPreface + makeFrame(Http2Splitter::HEADERS, kEndHeaders, 1, block);
+    splitter.inputHttp2(data.data(), data.size());
+    splitter.takeFrames();
+
+    // 超过body上限时回复413并以NO_ERROR重置流
+    // 413 is replied and the stream is reset with NO_ERROR beyond the body limit
+    data = makeFrame(Http2Splitter::DATA, 0, 1, string(20, 'x'));
+    splitter.inputHttp2(data.data(), data.size());
+    auto frames = splitter.takeFrames();
+    CHECK(frames.size() == 2, "expect HEADERS and RST_STREAM");
+    CHECK(frames[0].type == Http2Splitter::HEADERS && frames[0].flags == (kEndStream | kEndHeaders));
+    string status;
+    HpackDecoder decoder;
+    CHECK(decoder.decode((const uint8_t *)frames[0].payload.data(), frames[0].payload.size(), [&](string &name, string &value) {
+        if (name == ":status") {
+            status = value;
+        }
+    }));
+    CHECK(status == "413");
+    CHECK(frames[1].type == Http2Splitter::RST_STREAM && frames[1].stream_id == 1 && frames[1].payload == string(4, '\0'));
+
+    // 之后该流的DATA帧被忽略，不再回复413
+    // Later DATA frames of the stream are ignored, 413 is not replied again
+    data = makeFrame(Http2Splitter::DATA, 0, 1, string(20, 'x')) + makeFrame(Http2Splitter::DATA, kEndStream, 1, "x");
+    splitter.inputHttp2(data.data(), data.size());
+    CHECK(splitter.takeFrames().empty() && splitter.requests.empty() && splitter.errors.empty());
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    testSplit();
+    testResponse();
+    testOversizeBody();
+    InfoL << "ok";
+    return 0;
+}
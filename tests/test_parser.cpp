@@ -0,0 +1,86 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <cstring>
+#include "Util/logger.h"
+#include "Common/Parser.h"
+#include "Common/macros.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 测试Parser对http/rtsp请求的解析结果
+// Test the parse result of Parser for http/rtsp requests
+
+static const char kHttpRequest[] = "GET /live/test.live.flv?token=abcdef&vhost=__defaultVhost__ HTTP/1.1\r\n"
+                                   "Host: 127.0.0.1:8080\r\n"
+                                   "Connection:keep-alive\r\n"
+                                   "X-Forwarded-For: 10.0.0.1\r\n"
+                                   "x-forwarded-for: 10.0.0.2\r\n"
+                                   "Content-Length: 5\r\n"
+                                   "\r\n"
+                                   "hello";
+
+static const char kRtspRequest[] = "SETUP rtsp://127.0.0.1:554/live/test/trackID=0 RTSP/1.0\r\n"
+                                   "CSeq: 4\r\n"
+                                   "Transport:  RTP/AVP/TCP;unicast;interleaved=0-1 \r\n"
+                                   "Session: 0123456789abcdef\r\n"
+                                   "\r\n";
+
+static void testHttp() {
+    Parser parser;
+    parser.parse(kHttpRequest, strlen(kHttpRequest));
+    CHECK(parser.method() == "GET" && parser.protocol() == "HTTP/1.1");
+    CHECK(parser.url() == "/live/test.live.flv" && parser.params() == "token=abcdef&vhost=__defaultVhost__");
+    CHECK(parser.fullUrl() == "/live/test.live.flv?token=abcdef&vhost=__defaultVhost__");
+    CHECK(parser.content() == "hello");
+    // header名不区分大小写，冒号后可以没有空格，同名header取第一个
+    // Header names are case-insensitive, the space after the colon is optional, the first of duplicated headers wins
+    CHECK(parser["host"] == "127.0.0.1:8080");
+    CHECK(parser["Connection"] == "keep-alive");
+    CHECK(parser["X-FORWARDED-FOR"] == "10.0.0.1");
+    CHECK(parser["Range"].empty());
+    CHECK(parser.getUrlArgs()["token"] == "abcdef" && parser.getUrlArgs()["vhost"] == "__defaultVhost__");
+
+    // getHeader()构建map后，先前返回的引用仍然有效，同名header全部保留
+    // After getHeader() builds the map, references returned earlier stay valid and all duplicated headers are kept
+    auto &connection = parser["Connection"];
+    auto &headers = parser.getHeader();
+    CHECK(connection == "keep-alive", "reference invalidated by getHeader()");
+    CHECK(headers.size() == 5 && headers.count("X-Forwarded-For") == 2);
+    // 此后以map为准
+    // From now on the map is authoritative
+    headers["Connection"] = "close";
+    CHECK(parser["Connection"] == "close");
+
+    parser.clear();
+    CHECK(parser.url().empty() && parser["Host"].empty() && parser.getHeader().empty());
+}
+
+static void testRtsp() {
+    Parser parser;
+    parser.parse(kRtspRequest, strlen(kRtspRequest));
+    CHECK(parser.method() == "SETUP" && parser.protocol() == "RTSP/1.0");
+    CHECK(parser.url() == "rtsp://127.0.0.1:554/live/test/trackID=0" && parser.params().empty());
+    CHECK(parser["CSeq"] == "4");
+    CHECK(parser["Transport"] == "RTP/AVP/TCP;unicast;interleaved=0-1", "header value is not trimmed");
+    CHECK(parser["Session"] == "0123456789abcdef");
+    CHECK(parser.content().empty());
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    testHttp();
+    testRtsp();
+    InfoL << "ok";
+    return 0;
+}
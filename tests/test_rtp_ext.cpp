@@ -0,0 +1,109 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <cstring>
+#include "Util/logger.h"
+#include "Common/macros.h"
+#include "../webrtc/RtpExt.h"
+#include "../webrtc/Sdp.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 测试rtp ext id改写表的改写结果
+// Test the rewrite result of the rtp ext id rewrite table
+
+static void addExtmap(RtcMedia &media, uint8_t id, RtpExtType type) {
+    SdpAttrExtmap ext;
+    ext.id = id;
+    ext.ext = RtpExt::getExtUrl(type);
+    media.extmap.emplace_back(std::move(ext));
+}
+
+// 构造带one byte扩展的rtp包，ids依次为audio level, abs send time, transport cc, mid, video orientation的扩展id
+// Build a rtp packet with one byte extensions, ids are the ext ids of audio level, abs send time, transport cc, mid
+// and video orientation in order
+static vector<uint8_t> makeRtp(const vector<uint8_t> &ids) {
+    vector<uint8_t> ret = { 0x90, 96, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x12, 0x34, 0x56, 0x78 };
+    vector<uint8_t> ext = {
+        (uint8_t)(ids[0] << 4 | 0), 0x80,
+        (uint8_t)(ids[1] << 4 | 2), 0x01, 0x02, 0x03,
+        (uint8_t)(ids[2] << 4 | 1), 0x00, 0x10,
+        (uint8_t)(ids[3] << 4 | 0), '0',
+        (uint8_t)(ids[4] << 4 | 0), 0x01,
+    };
+    // id为0表示该扩展已被清除(填充为padding)
+    // Id 0 means the extension has been cleared (filled with padding)
+    for (size_t i = 0, pos = 0; i < ids.size(); ++i) {
+        auto size = (ext[pos] & 0x0F) + 2;
+        if (!ids[i]) {
+            memset(&ext[pos], 0, size);
+        }
+        pos += size;
+    }
+    while (ext.size() % 4) {
+        ext.push_back(0);
+    }
+    ret.push_back(0xBE);
+    ret.push_back(0xDE);
+    ret.push_back((ext.size() / 4) >> 8);
+    ret.push_back((ext.size() / 4) & 0xFF);
+    ret.insert(ret.end(), ext.begin(), ext.end());
+    ret.resize(ret.size() + 100, 0xAA);
+    return ret;
+}
+
+static void test(const char *name, const RtcMedia &media, bool is_recv, const vector<uint8_t> &in_ids, const vector<uint8_t> &out_ids) {
+    RtpExtContext ctx(media);
+    auto rtp = makeRtp(in_ids);
+    auto ext = ctx.changeRtpExtId((RtpHeader *)rtp.data(), is_recv, nullptr, RtpExtType::transport_cc);
+    CHECK(rtp == makeRtp(out_ids), "rewrite result mismatch: ", name);
+    CHECK(ext && ext.getTransportCCSeq() == 0x0010, "transport cc mismatch: ", name);
+    InfoL << name << ": ok";
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    auto audio_level = (uint8_t)RtpExtType::ssrc_audio_level;
+    auto abs_send_time = (uint8_t)RtpExtType::abs_send_time;
+    auto transport_cc = (uint8_t)RtpExtType::transport_cc;
+    auto mid = (uint8_t)RtpExtType::sdes_mid;
+    auto orientation = (uint8_t)RtpExtType::video_orientation;
+
+    {
+        // 客户端声明的id与服务器内部id一致，无需改写
+        // The ids declared by the client match the ids inside the server, no rewriting needed
+        RtcMedia media;
+        addExtmap(media, audio_level, RtpExtType::ssrc_audio_level);
+        addExtmap(media, abs_send_time, RtpExtType::abs_send_time);
+        addExtmap(media, transport_cc, RtpExtType::transport_cc);
+        addExtmap(media, mid, RtpExtType::sdes_mid);
+        addExtmap(media, orientation, RtpExtType::video_orientation);
+        vector<uint8_t> ids = { audio_level, abs_send_time, transport_cc, mid, orientation };
+        test("send, ids match", media, false, ids, ids);
+        test("recv, ids match", media, true, ids, ids);
+    }
+
+    {
+        // chrome常见的id分配，需要改写，并清除客户端未声明的扩展
+        // The common id allocation of chrome, ids are rewritten and extensions not declared by the client are cleared
+        RtcMedia media;
+        addExtmap(media, 1, RtpExtType::ssrc_audio_level);
+        addExtmap(media, 2, RtpExtType::abs_send_time);
+        addExtmap(media, 3, RtpExtType::transport_cc);
+        addExtmap(media, 9, RtpExtType::sdes_mid);
+        test("send, ids remap", media, false, { audio_level, abs_send_time, transport_cc, mid, orientation }, { 1, 2, 3, 9, 0 });
+        test("recv, ids remap", media, true, { 1, 2, 3, 9, 14 }, { audio_level, abs_send_time, transport_cc, mid, 0 });
+    }
+    return 0;
+}
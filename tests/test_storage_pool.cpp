@@ -0,0 +1,104 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <cstdint>
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/NoticeCenter.h"
+#include "Common/config.h"
+#include "Common/macros.h"
+#include "Record/Recorder.h"
+#include "Record/StoragePool.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 测试录像存储池的磁盘选择：每个新的录像文件选择可用磁盘，写入出错的磁盘不再被选择，按流查询时遍历所有磁盘
+// Test the disk selection of the record storage pool: each new recording file selects a usable disk,
+// a disk with write errors is no longer selected, and all disks are searched when querying by stream
+
+static void setConfig(const string &key, const string &value) {
+    mINI::Instance()[key] = value;
+    NOTICE_EMIT(BroadcastReloadConfigArgs, Broadcast::kBroadcastReloadConfig);
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    auto base = File::absolutePath("storage_pool_test_" + to_string(getCurrentMicrosecond()) + "/", exeDir(), true);
+    auto disk_a = base + "a/";
+    auto disk_b = base + "b/";
+    File::create_path(disk_a, 0777);
+    File::create_path(disk_b, 0777);
+    setConfig(Record::kStorageMinFreeMB, "0");
+    setConfig(Record::kStoragePool, disk_a + ";" + disk_b);
+
+    auto &pool = StoragePool::Instance();
+    auto roots = pool.getRoots();
+    CHECK(roots.size() == 2 && roots[0] == disk_a && roots[1] == disk_b);
+
+    // 新的录像文件选择任一可用磁盘
+    // A new recording file selects any usable disk
+    auto root = pool.selectRoot();
+    CHECK(root == disk_a || root == disk_b);
+
+    // 文件归属于最长匹配的磁盘
+    // A file belongs to the disk with the longest matching root
+    auto disk = pool.getDisk(disk_b + "record/live/old/2024-01-01/00-00-00-0.mp4");
+    CHECK(disk && disk->getRoot() == disk_b);
+    CHECK(!pool.getDisk(base + "c/record/live/old/00-00-00-0.mp4"));
+
+    // 写入出错的磁盘不再被选择，已在该盘上录制的流的下一个文件换到其他磁盘
+    // A disk with write errors is no longer selected, the next file of a stream recording on it moves to another disk
+    disk->onWrite(0, false);
+    CHECK(pool.selectRoot() == disk_a);
+    CHECK(pool.selectPath(disk_b + "record/live/old/") == disk_a + "record/live/old/");
+    // 不在存储池中的路径原样返回
+    // A path outside the storage pool is returned as is
+    CHECK(pool.selectPath(base + "c/record/live/old/") == base + "c/record/live/old/");
+
+    // 所有磁盘都不可用时仍然返回存储池中的磁盘
+    // A disk of the pool is still returned when no disk is usable
+    setConfig(Record::kStorageMinFreeMB, to_string(UINT32_MAX));
+    for (auto &stat : pool.getStatistic()) {
+        CHECK(!stat.healthy);
+    }
+    root = pool.selectRoot();
+    CHECK(root == disk_a || root == disk_b);
+    setConfig(Record::kStorageMinFreeMB, "0");
+
+    // 录像路径为配置的缺省值时由存储池选择磁盘，查询接口遍历所有磁盘上的录像文件夹
+    // The storage pool selects the disk when the record path is the configured default,
+    // the query apis search the record folders on all disks
+    GET_CONFIG(string, recordPath, Protocol::kMP4SavePath);
+    GET_CONFIG(string, recordAppName, Record::kAppName);
+    setConfig(General::kEnableVhost, "0");
+    MediaTuple tuple { DEFAULT_VHOST, "live", "old", "" };
+    auto relative = recordAppName + "/live/old/";
+    CHECK(Recorder::getRecordPath(Recorder::type_mp4, tuple, recordPath) == disk_a + relative);
+    CHECK(Recorder::getRecordPath(Recorder::type_mp4, tuple, "") == disk_a + relative);
+    auto folders = Recorder::getRecordPaths(Recorder::type_mp4, tuple, "");
+    CHECK(folders.size() == 2 && folders[0] == disk_a + relative && folders[1] == disk_b + relative);
+    // 自定义路径不经过存储池
+    // A customized path bypasses the storage pool
+    CHECK(Recorder::getRecordPath(Recorder::type_mp4, tuple, base + "c") == base + "c/" + relative);
+    folders = Recorder::getRecordPaths(Recorder::type_mp4, tuple, base + "c");
+    CHECK(folders.size() == 1 && folders[0] == base + "c/" + relative);
+
+    setConfig(Record::kStoragePool, "");
+    CHECK(pool.getRoots().empty() && pool.selectRoot().empty());
+    CHECK(pool.selectPath(disk_b + "record/live/old/") == disk_b + "record/live/old/");
+    File::delete_file(base, true);
+    InfoL << "ok";
+    return 0;
+}
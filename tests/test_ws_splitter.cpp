@@ -0,0 +1,108 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Util/logger.h"
+#include "Common/macros.h"
+#include "Http/WebSocketSplitter.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 测试websocket掩码与分片输入时的解包结果
+// Test websocket masking and the decode result when the input is sliced
+
+static const uint8_t kMask[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+// 按RFC 6455逐字节异或的参考实现
+// Byte by byte xor reference implementation per RFC 6455
+static void referenceMask(uint8_t *data, size_t len, const uint8_t *mask, size_t offset) {
+    for (size_t i = 0; i < len; ++i) {
+        data[i] ^= mask[(i + offset) % 4];
+    }
+}
+
+// 记录解包出的每一帧负载
+// Record the payload of every decoded frame
+class TestSplitter : public WebSocketSplitter {
+public:
+    string data;
+    string payload;
+    vector<string> frames;
+
+protected:
+    void onWebSocketDecodePayload(const WebSocketHeader &header, const uint8_t *ptr, size_t len, size_t recved) override {
+        payload.append((const char *)ptr, len);
+    }
+    void onWebSocketDecodeComplete(const WebSocketHeader &header) override {
+        frames.emplace_back(std::move(payload));
+        payload.clear();
+    }
+    void onWebSocketEncodeData(Buffer::Ptr buffer) override { data.append(buffer->data(), buffer->size()); }
+};
+
+static void testMask() {
+    // 覆盖非对齐的起始地址、各个掩码偏移以及不足一个字长的尾部
+    // Cover unaligned start addresses, every mask offset and tails shorter than a word
+    vector<uint8_t> buf(1024);
+    for (size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = (uint8_t)i;
+    }
+    for (size_t offset = 0; offset < 4; ++offset) {
+        for (size_t start = 0; start < 16; ++start) {
+            for (size_t len : { (size_t)0, (size_t)1, (size_t)7, (size_t)33, buf.size() - start }) {
+                auto a = buf, b = buf;
+                referenceMask(a.data() + start, len, kMask, offset);
+                WebSocketSplitter::maskPayload(b.data() + start, len, kMask, offset);
+                CHECK(a == b, "mask result mismatch, offset: ", offset, ", start: ", start, ", len: ", len);
+            }
+        }
+    }
+}
+
+static void testDecode() {
+    // 编码不同长度(含7位、16位、64位长度字段)的带掩码帧，再以各种大小分片输入解包
+    // Encode masked frames of various sizes (with 7, 16 and 64 bit length fields), then decode them in slices of various sizes
+    TestSplitter encoder;
+    WebSocketHeader header;
+    header._fin = true;
+    header._reserved = 0;
+    header._opcode = WebSocketHeader::BINARY;
+    header._mask_flag = true;
+    vector<string> frames;
+    for (size_t size : { 0, 1, 125, 126, 1000, 65535, 65536, 100000 }) {
+        string frame(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            frame[i] = (char)(i * 7 + size);
+        }
+        encoder.encode(header, std::make_shared<BufferString>(frame));
+        frames.emplace_back(std::move(frame));
+    }
+
+    for (size_t slice : { 1, 3, 1000, 64 * 1024 }) {
+        TestSplitter decoder;
+        for (size_t pos = 0; pos < encoder.data.size(); pos += slice) {
+            auto len = std::min(slice, encoder.data.size() - pos);
+            decoder.decode((uint8_t *)&encoder.data[pos], len);
+        }
+        CHECK(decoder.frames == frames, "decode result mismatch, slice: ", slice);
+    }
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    testMask();
+    testDecode();
+    InfoL << "ok";
+    return 0;
+}
@@ -0,0 +1,190 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <algorithm>
+#include "RtcPacer.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+namespace Rtc {
+#define RTC_FIELD "rtc."
+const string kPacerEnable = RTC_FIELD "pacerEnable";
+const string kPacingFactor = RTC_FIELD "pacingFactor";
+const string kPacerMaxQueueMs = RTC_FIELD "pacerMaxQueueMs";
+static onceToken token([]() {
+    mINI::Instance()[kPacerEnable] = 1;
+    mINI::Instance()[kPacingFactor] = 2.5;
+    mINI::Instance()[kPacerMaxQueueMs] = 2000;
+});
+} // namespace Rtc
+
+// 定时发送间隔
+// Interval of the send timer
+static constexpr uint64_t kProcessIntervalMS = 5;
+// 预算最多累积的时长，限制队列清空后的突发
+// Maximum accumulated budget duration, limits the burst after the queue drains
+static constexpr uint64_t kMaxBudgetMS = 2 * kProcessIntervalMS;
+// 预算下限，保证至少能发送一个mtu大小的包
+// Lower bound of the budget cap, ensures at least one mtu sized packet can be sent
+static constexpr int64_t kMinBudgetBytes = 1500;
+
+RtcPacer::RtcPacer(EventPoller::Ptr poller, onSend cb) {
+    _poller = std::move(poller);
+    _cb = std::move(cb);
+}
+
+RtcPacer::~RtcPacer() {
+    if (_task) {
+        _task->cancel();
+    }
+}
+
+void RtcPacer::setPacingRate(uint32_t bitrate_bps) {
+    _pacing_bps = bitrate_bps;
+}
+
+const char *RtcPacer::getPriorityName(Priority priority) {
+    switch (priority) {
+        case Priority::audio: return "audio";
+        case Priority::rtx: return "rtx";
+        case Priority::video: return "video";
+        default: return "invalid";
+    }
+}
+
+bool RtcPacer::empty() const {
+    for (auto &queue : _queues) {
+        if (!queue.packets.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RtcPacer::refreshBudget(uint64_t now_ms) {
+    if (!_last_refresh_ms || now_ms <= _last_refresh_ms) {
+        _last_refresh_ms = now_ms;
+        return;
+    }
+    GET_CONFIG(uint32_t, max_queue_ms, Rtc::kPacerMaxQueueMs);
+    uint64_t rate = _pacing_bps;
+    if (max_queue_ms) {
+        // 排队过长时提高发送速率，保证在最大排队时长内发送完毕
+        // Increase the pacing rate when the queue is too long, so that it drains within the maximum queuing time
+        rate = std::max<uint64_t>(rate, _queue_bytes * 8 * 1000 / max_queue_ms);
+    }
+    auto elapsed = now_ms - _last_refresh_ms;
+    _last_refresh_ms = now_ms;
+    auto max_budget = std::max<int64_t>(rate * kMaxBudgetMS / 8000, kMinBudgetBytes);
+    _budget = std::min<int64_t>(_budget + rate * elapsed / 8000, max_budget);
+}
+
+void RtcPacer::onSent(Queue &queue, const QueuedPacket &pkt, uint64_t now_ms) {
+    auto delay = now_ms - pkt.enqueue_ms;
+    auto &stats = queue.stats;
+    ++stats.sent;
+    stats.avg_delay_ms += (delay - stats.avg_delay_ms) / 16;
+    stats.max_delay_ms = std::max(stats.max_delay_ms, delay);
+    _budget -= pkt.rtp->size() - RtpPacket::kRtpTcpHeaderSize;
+}
+
+void RtcPacer::enqueue(const RtpPacket::Ptr &rtp, bool rtx, bool flush) {
+    auto priority = rtx ? Priority::rtx : (rtp->type == TrackAudio ? Priority::audio : Priority::video);
+    auto &queue = _queues[(int)priority];
+    ++queue.stats.enqueued;
+    auto now_ms = getCurrentMillisecond();
+    if (!_pacing_bps) {
+        ++queue.stats.sent;
+        _cb(rtp, rtx, flush);
+        return;
+    }
+    refreshBudget(now_ms);
+    if (_budget > 0 && empty()) {
+        // 队列为空且有发送预算时直接发送，不引入额外延时
+        // Send directly when the queue is empty and there is budget, without introducing extra delay
+        onSent(queue, QueuedPacket { rtp, now_ms }, now_ms);
+        _cb(rtp, rtx, flush);
+        return;
+    }
+    auto size = rtp->size() - RtpPacket::kRtpTcpHeaderSize;
+    queue.packets.emplace_back(QueuedPacket { rtp, now_ms });
+    ++queue.stats.packets;
+    queue.stats.bytes += size;
+    _queue_bytes += size;
+    startTimer();
+}
+
+void RtcPacer::startTimer() {
+    if (_task) {
+        return;
+    }
+    weak_ptr<RtcPacer> weak_self = shared_from_this();
+    _task = _poller->doDelayTask(kProcessIntervalMS, [weak_self]() -> uint64_t {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return 0;
+        }
+        strong_self->process();
+        if (strong_self->empty()) {
+            // 队列清空后停止定时器，有新包排队时再启动
+            // Stop the timer after the queue drains, restart it when new packets are queued
+            strong_self->_task = nullptr;
+            return 0;
+        }
+        return kProcessIntervalMS;
+    });
+}
+
+void RtcPacer::process() {
+    GET_CONFIG(uint32_t, max_queue_ms, Rtc::kPacerMaxQueueMs);
+    auto now_ms = getCurrentMillisecond();
+    refreshBudget(now_ms);
+
+    // 延后发送上一个包，以便最后一个包刷新socket缓存
+    // Delay sending the previous packet so that the last packet flushes the socket buffer
+    bool has_last = false;
+    bool last_rtx = false;
+    RtpPacket::Ptr last_rtp;
+    for (int i = 0; i < (int)Priority::max; ++i) {
+        auto &queue = _queues[i];
+        while (!queue.packets.empty()) {
+            auto &pkt = queue.packets.front();
+            auto size = pkt.rtp->size() - RtpPacket::kRtpTcpHeaderSize;
+            auto expired = max_queue_ms && now_ms - pkt.enqueue_ms > max_queue_ms;
+            if (!expired && _budget <= 0) {
+                break;
+            }
+            if (expired) {
+                ++queue.stats.dropped;
+            } else {
+                onSent(queue, pkt, now_ms);
+                if (has_last) {
+                    _cb(last_rtp, last_rtx, false);
+                }
+                has_last = true;
+                last_rtp = std::move(pkt.rtp);
+                last_rtx = i == (int)Priority::rtx;
+            }
+            --queue.stats.packets;
+            queue.stats.bytes -= size;
+            _queue_bytes -= size;
+            queue.packets.pop_front();
+        }
+    }
+    if (has_last) {
+        _cb(last_rtp, last_rtx, true);
+    }
+}
+
+} // namespace mediakit
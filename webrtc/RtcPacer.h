@@ -0,0 +1,125 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_RTCPACER_H
+#define ZLMEDIAKIT_RTCPACER_H
+
+#include <deque>
+#include <memory>
+#include <functional>
+#include "Rtsp/Rtsp.h"
+#include "Poller/EventPoller.h"
+
+namespace mediakit {
+
+// RTC配置项目
+// RTC configuration project
+namespace Rtc {
+// 是否开启发送平滑(仅在开启带宽估计时有效)
+// Whether to enable send pacing (only valid when the bandwidth estimation is enabled)
+extern const std::string kPacerEnable;
+// 发送速率相对估计带宽的倍数
+// Multiplier of the pacing rate over the estimated bandwidth
+extern const std::string kPacingFactor;
+// 发送队列最大排队时长，单位毫秒
+// Maximum queuing time of the send queue, in milliseconds
+extern const std::string kPacerMaxQueueMs;
+} // namespace Rtc
+
+/**
+ * rtp发送平滑器，按优先级(音频>重传>视频)分队列排队，由poller定时器按发送速率匀速发送
+ * 避免关键帧等大帧一次性突发导致丢包，同时让重传包优先于新的视频包发送
+ * Rtp send pacer, packets are queued by priority (audio > rtx > video) and sent at the pacing rate by the poller timer.
+ * This avoids packet loss caused by bursts of large frames such as keyframes, and lets retransmissions go out before new video packets.
+ */
+class RtcPacer : public std::enable_shared_from_this<RtcPacer> {
+public:
+    using Ptr = std::shared_ptr<RtcPacer>;
+    using onSend = std::function<void(const RtpPacket::Ptr &rtp, bool rtx, bool flush)>;
+
+    enum class Priority : int {
+        audio = 0,
+        rtx,
+        video,
+        max,
+    };
+
+    struct QueueStats {
+        // 当前排队的包数和字节数
+        // Packets and bytes currently queued
+        size_t packets = 0;
+        size_t bytes = 0;
+        uint64_t enqueued = 0;
+        uint64_t sent = 0;
+        // 排队超时被丢弃的包数
+        // Packets dropped because of queuing timeout
+        uint64_t dropped = 0;
+        double avg_delay_ms = 0;
+        uint64_t max_delay_ms = 0;
+    };
+
+    RtcPacer(toolkit::EventPoller::Ptr poller, onSend cb);
+    ~RtcPacer();
+
+    /**
+     * 设置发送速率，为0时不做平滑直接发送
+     * Set the pacing rate, send directly without pacing when it is 0
+     */
+    void setPacingRate(uint32_t bitrate_bps);
+    uint32_t getPacingRate() const { return _pacing_bps; }
+
+    /**
+     * 输入待发送的rtp包
+     * @param rtp rtp包
+     * @param rtx 是否为重传包
+     * @param flush 是否刷新socket缓存
+     * Input the rtp packet to be sent
+     * @param rtp rtp packet
+     * @param rtx whether it is a retransmission packet
+     * @param flush whether to flush the socket buffer
+     */
+    void enqueue(const RtpPacket::Ptr &rtp, bool rtx, bool flush);
+
+    const QueueStats &getStats(Priority priority) const { return _queues[(int)priority].stats; }
+
+    static const char *getPriorityName(Priority priority);
+
+private:
+    struct QueuedPacket {
+        RtpPacket::Ptr rtp;
+        uint64_t enqueue_ms;
+    };
+
+    struct Queue {
+        std::deque<QueuedPacket> packets;
+        QueueStats stats;
+    };
+
+    bool empty() const;
+    void refreshBudget(uint64_t now_ms);
+    void process();
+    void startTimer();
+    void onSent(Queue &queue, const QueuedPacket &pkt, uint64_t now_ms);
+
+private:
+    uint32_t _pacing_bps = 0;
+    // 剩余可发送字节数，允许为负(透支一个包)
+    // Remaining bytes allowed to send, may be negative (overdraw one packet)
+    int64_t _budget = 0;
+    uint64_t _last_refresh_ms = 0;
+    size_t _queue_bytes = 0;
+    onSend _cb;
+    toolkit::EventPoller::Ptr _poller;
+    toolkit::EventPoller::DelayTask::Ptr _task;
+    Queue _queues[(int)Priority::max];
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_RTCPACER_H
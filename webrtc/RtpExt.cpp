@@ -363,6 +363,13 @@ uint16_t RtpExt::getTransportCCSeq() const {
     return ret;
 }
 
+void RtpExt::setTransportCCSeq(uint16_t seq) {
+    CHECK(_type == RtpExtType::transport_cc && size() >= 2);
+    auto ptr = (uint8_t *)_data;
+    ptr[0] = seq >> 8;
+    ptr[1] = seq & 0xFF;
+}
+
 //https://tools.ietf.org/html/draft-ietf-avtext-sdes-hdr-ext-07
 //    0                   1                   2                   3
 //    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -561,10 +568,32 @@ RtpExt::operator bool() const {
 }
 
 RtpExtContext::RtpExtContext(const RtcMedia &m){
+    memset(&_send_table, 0, sizeof(_send_table));
+    memset(&_recv_table, 0, sizeof(_recv_table));
     for (auto &ext : m.extmap) {
         auto ext_type = RtpExt::getExtType(ext.ext);
-        _rtp_ext_id_to_type.emplace(ext.id, ext_type);
-        _rtp_ext_type_to_id.emplace(ext_type, ext.id);
+        if (ext_type == RtpExtType::padding) {
+            continue;
+        }
+        // 重复声明时以第一个为准
+        // The first one takes effect when declared repeatedly
+        if (!_recv_table.two_byte[ext.id]) {
+            _recv_table.two_byte[ext.id] = (uint8_t)ext_type;
+        }
+        if (!_send_table.two_byte[(uint8_t)ext_type]) {
+            _send_table.two_byte[(uint8_t)ext_type] = ext.id;
+        }
+    }
+    compileTable(_send_table);
+    compileTable(_recv_table);
+}
+
+void RtpExtContext::compileTable(ExtIdTable &table) {
+    // one byte扩展只能存放1~14的id，超出范围的清除
+    // One byte extensions can only store ids 1~14, clear the ones out of range
+    for (int id = 0; id < 16; ++id) {
+        auto new_id = table.two_byte[id];
+        table.one_byte[id] = new_id < (int)RtpExtType::reserved ? new_id : 0;
     }
 }
 
@@ -580,43 +609,67 @@ void RtpExtContext::setRid(uint32_t ssrc, const string &rid) {
     _ssrc_to_rid[ssrc] = rid;
 }
 
-RtpExt RtpExtContext::changeRtpExtId(const RtpHeader *header, bool is_recv, string *rid_ptr, RtpExtType type) {
-    string rid, repaired_rid;
+template <typename Type>
+RtpExt RtpExtContext::rewriteExtId(uint8_t *ptr, const uint8_t *end, const uint8_t *table, bool is_recv, RtpExtType type, string &rid, string &repaired_rid) const {
     RtpExt ret;
-    auto ext_map = RtpExt::getExtValue(header);
-    for (auto &pr : ext_map) {
-        if (is_recv) {
-            auto it = _rtp_ext_id_to_type.find(pr.first);
-            if (it == _rtp_ext_id_to_type.end()) {
-                // TraceL << "接收rtp时,忽略不识别的rtp ext, id=" << (int) pr.first;  [AUTO-TRANSLATED:284d8a38]
-                // TraceL << "Receiving rtp, ignoring unrecognized rtp ext, id=" << (int) pr.first;
-                pr.second.clearExt();
-                continue;
-            }
-            pr.second.setType(it->second);
-            // 重新赋值ext id为 ext type，作为后面处理ext的统一中间类型  [AUTO-TRANSLATED:ab825878]
-            // Reassign ext id to ext type, as a unified intermediate type for processing ext later
-            pr.second.setExtId((uint8_t) it->second);
-            switch (it->second) {
-                case RtpExtType::sdes_rtp_stream_id : rid = pr.second.getRtpStreamId(); break;
-                case RtpExtType::sdes_repaired_rtp_stream_id : repaired_rid = pr.second.getRepairedRtpStreamId(); break;
-                default : break;
+    while (ptr < end) {
+        auto ext = reinterpret_cast<Type *>(ptr);
+        auto id = ext->getId();
+        if (id == (uint8_t) RtpExtType::padding) {
+            // padding，忽略  [AUTO-TRANSLATED:a7fda608]
+            // padding, ignore
+            ++ptr;
+            continue;
+        }
+        CHECK(reinterpret_cast<uint8_t *>(ext) + Type::kMinSize <= end);
+        CHECK(ext->getData() + ext->getSize() <= end);
+        auto size = ext->getSize();
+        ptr += Type::kMinSize + size;
+
+        auto new_id = table[id];
+        if (!new_id) {
+            // 接收时忽略不识别的rtp ext，发送时忽略不被客户端支持的rtp ext
+            // Ignore unrecognized rtp ext when receiving, and rtp ext not supported by the client when sending
+            memset(ext, (int) RtpExtType::padding, Type::kMinSize + size);
+            continue;
+        }
+        if (new_id != id) {
+            // id已与对端一致时不做任何写入
+            // Nothing is written when the id already matches the remote peer
+            ext->setId(new_id);
+        }
+        // 接收时改写后的id为ext type，发送时改写前的id为ext type
+        // The rewritten id is the ext type when receiving, the original id is the ext type when sending
+        auto ext_type = (RtpExtType)(is_recv ? new_id : id);
+        if (ext_type == type || (is_recv && (ext_type == RtpExtType::sdes_rtp_stream_id || ext_type == RtpExtType::sdes_repaired_rtp_stream_id))) {
+            RtpExt item(ext, isOneByteExt<Type>(), reinterpret_cast<char *>(ext->getData()), size);
+            item.setType(ext_type);
+            switch (ext_type) {
+                case RtpExtType::sdes_rtp_stream_id: rid = item.getRtpStreamId(); break;
+                case RtpExtType::sdes_repaired_rtp_stream_id: repaired_rid = item.getRepairedRtpStreamId(); break;
+                default: break;
             }
-        } else {
-            pr.second.setType((RtpExtType) pr.first);
-            auto it = _rtp_ext_type_to_id.find((RtpExtType) pr.first);
-            if (it == _rtp_ext_type_to_id.end()) {
-                // TraceL << "发送rtp时, 忽略不被客户端支持rtp ext:" << pr.second.dumpString();  [AUTO-TRANSLATED:5d9fd8cc]
-                // TraceL << "Sending rtp, ignoring rtp ext not supported by client:" << pr.second.dumpString();
-                pr.second.clearExt();
-                continue;
+            if (ext_type == type && !ret) {
+                ret = item;
             }
-            // 重新赋值ext id为客户端sdp声明的类型  [AUTO-TRANSLATED:06d60796]
-            // Reassign ext id to the type declared in client sdp
-            pr.second.setExtId(it->second);
         }
-        if (pr.second.getType() == type) {
-            ret = pr.second;
+    }
+    return ret;
+}
+
+RtpExt RtpExtContext::changeRtpExtId(const RtpHeader *header, bool is_recv, string *rid_ptr, RtpExtType type) {
+    string rid, repaired_rid;
+    RtpExt ret;
+    auto ext_size = header->getExtSize();
+    if (ext_size) {
+        auto &table = is_recv ? _recv_table : _send_table;
+        auto reserved = header->getExtReserved();
+        auto ptr = const_cast<RtpHeader *>(header)->getExtData();
+        auto end = ptr + ext_size;
+        if (reserved == kOneByteHeader) {
+            ret = rewriteExtId<RtpExtOneByte>(ptr, end, table.one_byte, is_recv, type, rid, repaired_rid);
+        } else if ((reserved & 0xFFF0) == kTwoByteHeader) {
+            ret = rewriteExtId<RtpExtTwoByte>(ptr, end, table.two_byte, is_recv, type, rid, repaired_rid);
         }
     }
 
@@ -646,6 +699,71 @@ RtpExt RtpExtContext::changeRtpExtId(const RtpHeader *header, bool is_recv, stri
     return ret;
 }
 
+uint8_t RtpExtContext::getExtId(RtpExtType type) const {
+    return _send_table.two_byte[(uint8_t)type];
+}
+
+bool RtpExtContext::addTransportCCExt(RtpHeader *header, int &len, uint16_t seq) const {
+    auto id = getExtId(RtpExtType::transport_cc);
+    if (!id) {
+        // 对方不支持twcc
+        // The remote peer does not support twcc
+        return false;
+    }
+    auto ptr = reinterpret_cast<uint8_t *>(header);
+    auto end = ptr + len;
+    if (!header->ext) {
+        if (id >= (int)RtpExtType::reserved) {
+            return false;
+        }
+        // 没有扩展头，插入one byte扩展头与twcc扩展，共8个字节
+        // No extension header, insert a one byte extension header and the twcc extension, 8 bytes in total
+        auto pos = &header->payload + header->getCsrcSize();
+        memmove(pos + 8, pos, end - pos);
+        pos[0] = kOneByteHeader >> 8;
+        pos[1] = kOneByteHeader & 0xFF;
+        pos[2] = 0;
+        pos[3] = 1;
+        pos[4] = (id << 4) | 0x01;
+        pos[5] = seq >> 8;
+        pos[6] = seq & 0xFF;
+        pos[7] = 0;
+        header->ext = 1;
+        len += 8;
+        return true;
+    }
+
+    // 已有扩展头，在末尾追加一个32位字
+    // There is already an extension header, append a 32 bit word at the end
+    auto reserved = header->getExtReserved();
+    auto ext_words = header->getExtSize() >> 2;
+    auto pos = header->getExtData() + header->getExtSize();
+    if (reserved == kOneByteHeader) {
+        if (id >= (int)RtpExtType::reserved) {
+            return false;
+        }
+        memmove(pos + 4, pos, end - pos);
+        pos[0] = (id << 4) | 0x01;
+        pos[1] = seq >> 8;
+        pos[2] = seq & 0xFF;
+        pos[3] = 0;
+    } else if ((reserved & 0xFFF0) == kTwoByteHeader) {
+        memmove(pos + 4, pos, end - pos);
+        pos[0] = id;
+        pos[1] = 2;
+        pos[2] = seq >> 8;
+        pos[3] = seq & 0xFF;
+    } else {
+        return false;
+    }
+    ++ext_words;
+    auto ext_len = header->getExtData() - 2;
+    ext_len[0] = ext_words >> 8;
+    ext_len[1] = ext_words & 0xFF;
+    len += 4;
+    return true;
+}
+
 void RtpExtContext::setOnGetRtp(OnGetRtp cb) {
     _cb = std::move(cb);
 }
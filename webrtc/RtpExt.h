@@ -67,6 +67,7 @@ public:
     uint8_t getAudioLevel(bool *vad) const;
     uint32_t getAbsSendTime() const;
     uint16_t getTransportCCSeq() const;
+    void setTransportCCSeq(uint16_t seq);
     std::string getSdesMid() const;
     std::string getRtpStreamId() const;
     std::string getRepairedRtpStreamId() const;
@@ -118,6 +119,10 @@ public:
     using Ptr = std::shared_ptr<RtpExtContext>;
     using OnGetRtp = std::function<void(uint8_t pt, uint32_t ssrc, const std::string &rid)>;
 
+    // 插入twcc扩展时最多增加的字节数
+    // The maximum number of bytes added when inserting the twcc extension
+    static constexpr size_t kMaxTransportCCExtSize = 8;
+
     RtpExtContext(const RtcMedia &media);
 
     void setOnGetRtp(OnGetRtp cb);
@@ -125,17 +130,50 @@ public:
     void setRid(uint32_t ssrc, const std::string &rid);
     RtpExt changeRtpExtId(const RtpHeader *header, bool is_recv, std::string *rid_ptr = nullptr, RtpExtType type = RtpExtType::padding);
 
+    /**
+     * 获取对方sdp中声明的rtp ext id
+     * @return 0代表不支持该扩展
+     * Get the rtp ext id declared in the remote sdp
+     * @return 0 means the extension is not supported
+     */
+    uint8_t getExtId(RtpExtType type) const;
+
+    /**
+     * 发送rtp时追加transport-wide cc扩展，调用者需保证内存预留了kMaxTransportCCExtSize个字节
+     * @param header rtp头
+     * @param len rtp长度，追加成功后会被修改
+     * @param seq transport-wide seq
+     * @return 是否追加成功
+     * Append the transport-wide cc extension when sending rtp, the caller must reserve kMaxTransportCCExtSize bytes
+     * @param header rtp header
+     * @param len rtp length, modified after appending successfully
+     * @param seq transport-wide seq
+     * @return whether the appending succeeded
+     */
+    bool addTransportCCExt(RtpHeader *header, int &len, uint16_t seq) const;
+
 private:
+    // 根据协商的sdp预先编译的ext id改写表，下标为原id，值为新id，0代表清除该扩展
+    // Ext id rewrite table compiled from the negotiated sdp, indexed by the original id, the value is the new id, 0 means clearing the extension
+    struct ExtIdTable {
+        uint8_t one_byte[16];
+        uint8_t two_byte[256];
+    };
+
     void onGetRtp(uint8_t pt, uint32_t ssrc, const std::string &rid);
+    static void compileTable(ExtIdTable &table);
+
+    template <typename Type>
+    RtpExt rewriteExtId(uint8_t *ptr, const uint8_t *end, const uint8_t *table, bool is_recv, RtpExtType type, std::string &rid, std::string &repaired_rid) const;
 
 private:
     OnGetRtp _cb;
     // 发送rtp时需要修改rtp ext id  [AUTO-TRANSLATED:b92a494b]
     // Modify the rtp ext id when sending rtp
-    std::map<RtpExtType, uint8_t> _rtp_ext_type_to_id;
+    ExtIdTable _send_table;
     // 接收rtp时需要修改rtp ext id  [AUTO-TRANSLATED:685e7a01]
     // Modify the rtp ext id when receiving rtp
-    std::unordered_map<uint8_t, RtpExtType> _rtp_ext_id_to_type;
+    ExtIdTable _recv_table;
     //ssrc --> rid
     std::unordered_map<uint32_t/*simulcast ssrc*/, std::string/*rid*/> _ssrc_to_rid;
 };
@@ -0,0 +1,337 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "SendSideBwe.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+namespace Rtc {
+#define RTC_FIELD "rtc."
+const string kBweEnable = RTC_FIELD "bweEnable";
+static onceToken token([]() { mINI::Instance()[kBweEnable] = 1; });
+} // namespace Rtc
+
+// 发送历史记录个数，需为2的幂
+// Number of send history records, must be a power of 2
+static constexpr size_t kHistorySize = 1 << 13;
+// 发送间隔小于该值的包归为同一包组
+// Packets sent within this interval are grouped into one packet group
+static constexpr uint64_t kBurstDeltaMS = 5;
+// trendline线性回归窗口大小
+// Trendline linear regression window size
+static constexpr size_t kTrendlineWindowSize = 20;
+static constexpr double kTrendlineSmoothingCoeff = 0.9;
+static constexpr double kTrendlineThresholdGain = 4.0;
+static constexpr size_t kMinNumDeltas = 60;
+// 自适应阈值参数
+// Adaptive threshold parameters
+static constexpr double kInitialThreshold = 12.5;
+static constexpr double kMinThreshold = 6;
+static constexpr double kMaxThreshold = 600;
+static constexpr double kMaxAdaptOffsetMS = 15;
+static constexpr double kThresholdUp = 0.0087;
+static constexpr double kThresholdDown = 0.039;
+static constexpr double kOverUsingTimeThreshold = 10;
+// aimd参数
+// Aimd parameters
+static constexpr double kDecreaseFactor = 0.85;
+static constexpr double kIncreaseFactorPerSecond = 1.08;
+static constexpr uint64_t kMinDecreaseIntervalMS = 200;
+// 丢包控制参数
+// Loss controller parameters
+static constexpr uint32_t kMinLossPackets = 20;
+static constexpr float kLowLossRate = 0.02f;
+static constexpr float kHighLossRate = 0.1f;
+// 码率统计窗口
+// Bitrate statistic window
+static constexpr uint64_t kRateWindowMS = 1000;
+// 估计码率变化超过该比例才触发通知
+// Notify only when the estimated bitrate changes more than this ratio
+static constexpr float kNotifyChangeRatio = 0.1f;
+
+SendSideBwe::SendSideBwe(uint32_t start_bps, uint32_t min_bps, uint32_t max_bps) {
+    _min_bps = min_bps;
+    _max_bps = std::max(min_bps, max_bps);
+    _target_bps = _delay_bps = _loss_bps = std::min(std::max(start_bps, _min_bps), _max_bps);
+    _last_notify_bps = _target_bps;
+    _threshold = kInitialThreshold;
+    _history.resize(kHistorySize);
+}
+
+void SendSideBwe::setOnBitrateChanged(onBitrateChanged cb) {
+    _cb = std::move(cb);
+}
+
+const char *SendSideBwe::getStateName(BandwidthUsage state) {
+    switch (state) {
+        case BandwidthUsage::normal: return "normal";
+        case BandwidthUsage::underusing: return "underusing";
+        case BandwidthUsage::overusing: return "overusing";
+        default: return "unknown";
+    }
+}
+
+void SendSideBwe::onSendPacket(uint16_t twcc_seq, size_t size, uint64_t send_ms) {
+    auto &pkt = _history[twcc_seq & (kHistorySize - 1)];
+    pkt.seq = twcc_seq;
+    pkt.valid = true;
+    pkt.size = (uint32_t)size;
+    pkt.send_ms = send_ms;
+    updateSendBitrate((uint32_t)size, send_ms);
+}
+
+void SendSideBwe::onTwccFeedback(const FCI_TWCC &fci, size_t fci_size, uint64_t now_ms) {
+    auto status = fci.getPacketChunkList(fci_size);
+    // 参考时间的单位为64ms，recv delta的单位为250us
+    // The unit of the reference time is 64ms, and the unit of recv delta is 250us
+    double recv_ms = (double)fci.getReferenceTime() * 64;
+    uint32_t lost = 0;
+    uint32_t total = 0;
+    uint32_t acked_bytes = 0;
+    auto seq = fci.getBaseSeq();
+    auto count = fci.getPacketCount();
+    for (uint16_t i = 0; i < count; ++i, ++seq) {
+        auto it = status.find(seq);
+        if (it == status.end()) {
+            continue;
+        }
+        if (it->second.first != SymbolStatus::not_received) {
+            recv_ms += it->second.second / 4.0;
+        }
+        auto &pkt = _history[seq & (kHistorySize - 1)];
+        if (!pkt.valid || pkt.seq != seq) {
+            // 发送记录已经被覆盖或已经反馈过
+            // The send record has been overwritten or already acknowledged
+            continue;
+        }
+        ++total;
+        if (it->second.first == SymbolStatus::not_received) {
+            ++lost;
+            continue;
+        }
+        acked_bytes += pkt.size;
+        onPacketFeedback(pkt, recv_ms);
+        pkt.valid = false;
+    }
+    if (!total) {
+        return;
+    }
+    updateAckedBitrate(acked_bytes, now_ms);
+    updateLossBasedBitrate(lost, total, now_ms);
+    updateDelayBasedBitrate(now_ms);
+    updateTargetBitrate();
+}
+
+void SendSideBwe::onPacketFeedback(const SentPacket &pkt, double recv_ms) {
+    if (!_cur_group.valid) {
+        _cur_group.valid = true;
+        _cur_group.first_send_ms = _cur_group.last_send_ms = pkt.send_ms;
+        _cur_group.last_recv_ms = recv_ms;
+        return;
+    }
+    if (pkt.send_ms < _cur_group.first_send_ms) {
+        // 乱序到达的旧包，忽略
+        // Reordered old packet, ignore
+        return;
+    }
+    if (pkt.send_ms - _cur_group.first_send_ms > kBurstDeltaMS) {
+        // 当前包组结束，与上一个包组比较延时变化
+        // The current group is complete, compare the delay variation with the previous group
+        if (_prev_group.valid) {
+            double send_delta = (double)(_cur_group.last_send_ms - _prev_group.last_send_ms);
+            double recv_delta = _cur_group.last_recv_ms - _prev_group.last_recv_ms;
+            updateTrendline(recv_delta, send_delta, _cur_group.last_recv_ms);
+        }
+        _prev_group = _cur_group;
+        _cur_group.first_send_ms = _cur_group.last_send_ms = pkt.send_ms;
+        _cur_group.last_recv_ms = recv_ms;
+        return;
+    }
+    _cur_group.last_send_ms = std::max(_cur_group.last_send_ms, pkt.send_ms);
+    _cur_group.last_recv_ms = std::max(_cur_group.last_recv_ms, recv_ms);
+}
+
+void SendSideBwe::updateTrendline(double recv_delta_ms, double send_delta_ms, double arrival_ms) {
+    _num_deltas = std::min(_num_deltas + 1, (size_t)1000);
+    if (_first_arrival_ms < 0) {
+        _first_arrival_ms = arrival_ms;
+    }
+    _accumulated_delay += recv_delta_ms - send_delta_ms;
+    _smoothed_delay = kTrendlineSmoothingCoeff * _smoothed_delay + (1 - kTrendlineSmoothingCoeff) * _accumulated_delay;
+    _delay_hist.emplace_back(arrival_ms - _first_arrival_ms, _smoothed_delay);
+    if (_delay_hist.size() > kTrendlineWindowSize) {
+        _delay_hist.pop_front();
+    }
+    if (_delay_hist.size() == kTrendlineWindowSize) {
+        // 线性回归求延时变化斜率
+        // Linear regression to get the slope of the delay variation
+        double sum_x = 0, sum_y = 0;
+        for (auto &pr : _delay_hist) {
+            sum_x += pr.first;
+            sum_y += pr.second;
+        }
+        double avg_x = sum_x / _delay_hist.size();
+        double avg_y = sum_y / _delay_hist.size();
+        double numerator = 0, denominator = 0;
+        for (auto &pr : _delay_hist) {
+            numerator += (pr.first - avg_x) * (pr.second - avg_y);
+            denominator += (pr.first - avg_x) * (pr.first - avg_x);
+        }
+        if (denominator != 0) {
+            _trend = numerator / denominator;
+        }
+    }
+    detect(send_delta_ms, arrival_ms);
+}
+
+void SendSideBwe::detect(double send_delta_ms, double now_ms) {
+    if (_num_deltas < 2) {
+        _state = BandwidthUsage::normal;
+        return;
+    }
+    double modified_trend = std::min(_num_deltas, kMinNumDeltas) * _trend * kTrendlineThresholdGain;
+    if (modified_trend > _threshold) {
+        if (_time_over_using < 0) {
+            _time_over_using = send_delta_ms / 2;
+        } else {
+            _time_over_using += send_delta_ms;
+        }
+        ++_overuse_counter;
+        if (_time_over_using > kOverUsingTimeThreshold && _overuse_counter > 1 && _trend >= _prev_trend) {
+            _time_over_using = 0;
+            _overuse_counter = 0;
+            _state = BandwidthUsage::overusing;
+        }
+    } else if (modified_trend < -_threshold) {
+        _time_over_using = -1;
+        _overuse_counter = 0;
+        _state = BandwidthUsage::underusing;
+    } else {
+        _time_over_using = -1;
+        _overuse_counter = 0;
+        _state = BandwidthUsage::normal;
+    }
+    _prev_trend = _trend;
+    updateThreshold(modified_trend, now_ms);
+}
+
+void SendSideBwe::updateThreshold(double modified_trend, double now_ms) {
+    if (_last_threshold_update_ms < 0) {
+        _last_threshold_update_ms = now_ms;
+    }
+    if (fabs(modified_trend) > _threshold + kMaxAdaptOffsetMS) {
+        // 突发的大延时不参与阈值调整
+        // Sudden large delay does not participate in threshold adjustment
+        _last_threshold_update_ms = now_ms;
+        return;
+    }
+    double k = fabs(modified_trend) < _threshold ? kThresholdDown : kThresholdUp;
+    double time_delta = std::min(now_ms - _last_threshold_update_ms, 100.0);
+    _threshold += k * (fabs(modified_trend) - _threshold) * time_delta;
+    _threshold = std::min(std::max(_threshold, kMinThreshold), kMaxThreshold);
+    _last_threshold_update_ms = now_ms;
+}
+
+void SendSideBwe::updateDelayBasedBitrate(uint64_t now_ms) {
+    if (!_last_update_ms) {
+        _last_update_ms = now_ms;
+        return;
+    }
+    auto elapsed_ms = std::min<uint64_t>(now_ms - _last_update_ms, 1000);
+    _last_update_ms = now_ms;
+    switch (_state) {
+        case BandwidthUsage::overusing: {
+            if (now_ms - _last_decrease_ms < kMinDecreaseIntervalMS) {
+                // 反馈有滞后，避免连续降码率
+                // Feedback lags behind, avoid continuous decrease
+                break;
+            }
+            auto base = _acked_bps ? _acked_bps : _delay_bps;
+            _delay_bps = std::min(_delay_bps, (uint32_t)(base * kDecreaseFactor));
+            _last_decrease_ms = now_ms;
+            break;
+        }
+        case BandwidthUsage::normal: {
+            auto bps = (uint32_t)(_delay_bps * pow(kIncreaseFactorPerSecond, elapsed_ms / 1000.0)) + 1000;
+            if (_acked_bps) {
+                // 估计码率不超过实际吞吐量太多
+                // The estimated bitrate should not exceed the actual throughput too much
+                bps = std::min(bps, (uint32_t)(1.5 * _acked_bps + 10000));
+            }
+            _delay_bps = bps;
+            break;
+        }
+        // 排空网络队列中，保持码率
+        // Draining the network queue, hold the bitrate
+        case BandwidthUsage::underusing:
+        default: break;
+    }
+    _delay_bps = std::min(std::max(_delay_bps, _min_bps), _max_bps);
+}
+
+void SendSideBwe::updateLossBasedBitrate(uint32_t lost, uint32_t total, uint64_t now_ms) {
+    _loss_lost += lost;
+    _loss_total += total;
+    if (_loss_total < kMinLossPackets) {
+        return;
+    }
+    _loss_rate = (float)_loss_lost / _loss_total;
+    _loss_lost = _loss_total = 0;
+
+    if (_loss_rate > kHighLossRate) {
+        if (now_ms - _last_loss_decrease_ms >= kMinDecreaseIntervalMS) {
+            _loss_bps = (uint32_t)(_loss_bps * (1 - 0.5 * _loss_rate));
+            _last_loss_decrease_ms = now_ms;
+        }
+    } else if (_loss_rate < kLowLossRate) {
+        _loss_bps = (uint32_t)(_loss_bps * 1.05) + 1000;
+    }
+    _loss_bps = std::min(std::max(_loss_bps, _min_bps), _max_bps);
+}
+
+static uint32_t updateRate(deque<pair<uint64_t, uint32_t>> &window, uint64_t &window_bytes, uint32_t bytes, uint64_t now_ms) {
+    window.emplace_back(now_ms, bytes);
+    window_bytes += bytes;
+    while (window.size() > 1 && now_ms - window.front().first > kRateWindowMS) {
+        window_bytes -= window.front().second;
+        window.pop_front();
+    }
+    auto span = std::max<uint64_t>(now_ms - window.front().first, kRateWindowMS / 5);
+    return (uint32_t)(window_bytes * 8 * 1000 / span);
+}
+
+void SendSideBwe::updateAckedBitrate(uint32_t bytes, uint64_t now_ms) {
+    _acked_bps = updateRate(_acked_window, _acked_window_bytes, bytes, now_ms);
+}
+
+void SendSideBwe::updateSendBitrate(uint32_t bytes, uint64_t now_ms) {
+    _send_bps = updateRate(_send_window, _send_window_bytes, bytes, now_ms);
+}
+
+void SendSideBwe::updateTargetBitrate() {
+    _target_bps = std::min(std::max(std::min(_delay_bps, _loss_bps), _min_bps), _max_bps);
+    auto diff = _target_bps > _last_notify_bps ? _target_bps - _last_notify_bps : _last_notify_bps - _target_bps;
+    if (diff < _last_notify_bps * kNotifyChangeRatio && _state == _last_notify_state) {
+        return;
+    }
+    _last_notify_bps = _target_bps;
+    _last_notify_state = _state;
+    if (_cb) {
+        _cb(_target_bps, _loss_rate, _state);
+    }
+}
+
+} // namespace mediakit
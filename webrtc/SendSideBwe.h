@@ -0,0 +1,180 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_SENDSIDEBWE_H
+#define ZLMEDIAKIT_SENDSIDEBWE_H
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "Rtcp/RtcpFCI.h"
+
+namespace mediakit {
+
+// RTC配置项目
+// RTC configuration project
+namespace Rtc {
+// 是否开启基于twcc反馈的发送端带宽估计(仅rtc播放有效)
+// Whether to enable send-side bandwidth estimation driven by twcc feedback (only valid for rtc players)
+extern const std::string kBweEnable;
+} // namespace Rtc
+
+/**
+ * 发送端带宽估计(GCC风格)，由基于延时的trendline检测器和基于丢包的控制器组成
+ * 输入为发送的rtp包(带transport-wide seq)和对端回复的twcc反馈
+ * Send-side bandwidth estimation (GCC style), composed of a delay-based trendline detector and a loss-based controller.
+ * Inputs are the sent rtp packets (stamped with transport-wide seq) and the twcc feedback from the remote peer.
+ */
+class SendSideBwe {
+public:
+    using Ptr = std::shared_ptr<SendSideBwe>;
+
+    enum class BandwidthUsage : int {
+        normal = 0,
+        underusing,
+        overusing,
+    };
+
+    using onBitrateChanged = std::function<void(uint32_t bitrate_bps, float loss_rate, BandwidthUsage state)>;
+
+    /**
+     * @param start_bps 初始估计码率
+     * @param min_bps 最小估计码率
+     * @param max_bps 最大估计码率
+     * @param start_bps initial estimated bitrate
+     * @param min_bps minimum estimated bitrate
+     * @param max_bps maximum estimated bitrate
+     */
+    SendSideBwe(uint32_t start_bps, uint32_t min_bps, uint32_t max_bps);
+
+    /**
+     * 记录发送的rtp包
+     * @param twcc_seq transport-wide seq
+     * @param size rtp包大小
+     * @param send_ms 发送时间戳，单位毫秒
+     * Record a sent rtp packet
+     * @param twcc_seq transport-wide seq
+     * @param size rtp packet size
+     * @param send_ms send timestamp, in milliseconds
+     */
+    void onSendPacket(uint16_t twcc_seq, size_t size, uint64_t send_ms);
+
+    /**
+     * 收到twcc rtcp反馈
+     * @param fci twcc fci
+     * @param fci_size fci长度
+     * @param now_ms 当前时间戳，单位毫秒
+     * Received twcc rtcp feedback
+     * @param fci twcc fci
+     * @param fci_size fci length
+     * @param now_ms current timestamp, in milliseconds
+     */
+    void onTwccFeedback(const FCI_TWCC &fci, size_t fci_size, uint64_t now_ms);
+
+    /**
+     * 估计码率发生较大变化或网络状态变化时触发
+     * Triggered when the estimated bitrate changes significantly or the network state changes
+     */
+    void setOnBitrateChanged(onBitrateChanged cb);
+
+    uint32_t getTargetBitrate() const { return _target_bps; }
+    uint32_t getDelayBasedBitrate() const { return _delay_bps; }
+    uint32_t getLossBasedBitrate() const { return _loss_bps; }
+    uint32_t getAckedBitrate() const { return _acked_bps; }
+    uint32_t getSendBitrate() const { return _send_bps; }
+    float getLossRate() const { return _loss_rate; }
+    BandwidthUsage getState() const { return _state; }
+    double getTrend() const { return _trend; }
+    double getThreshold() const { return _threshold; }
+
+    static const char *getStateName(BandwidthUsage state);
+
+private:
+    struct SentPacket {
+        uint16_t seq = 0;
+        bool valid = false;
+        uint32_t size = 0;
+        uint64_t send_ms = 0;
+    };
+
+    struct PacketGroup {
+        bool valid = false;
+        uint64_t first_send_ms = 0;
+        uint64_t last_send_ms = 0;
+        double last_recv_ms = 0;
+    };
+
+    void onPacketFeedback(const SentPacket &pkt, double recv_ms);
+    void updateTrendline(double recv_delta_ms, double send_delta_ms, double arrival_ms);
+    void detect(double send_delta_ms, double now_ms);
+    void updateThreshold(double modified_trend, double now_ms);
+    void updateDelayBasedBitrate(uint64_t now_ms);
+    void updateLossBasedBitrate(uint32_t lost, uint32_t total, uint64_t now_ms);
+    void updateAckedBitrate(uint32_t bytes, uint64_t now_ms);
+    void updateSendBitrate(uint32_t bytes, uint64_t now_ms);
+    void updateTargetBitrate();
+
+private:
+    uint32_t _min_bps;
+    uint32_t _max_bps;
+    uint32_t _target_bps;
+    uint32_t _delay_bps;
+    uint32_t _loss_bps;
+    uint32_t _acked_bps = 0;
+    uint32_t _send_bps = 0;
+    uint32_t _last_notify_bps = 0;
+    float _loss_rate = 0;
+    BandwidthUsage _state = BandwidthUsage::normal;
+    BandwidthUsage _last_notify_state = BandwidthUsage::normal;
+    onBitrateChanged _cb;
+
+    // 发送历史，以transport-wide seq为下标的环形缓存
+    // Send history, a ring buffer indexed by transport-wide seq
+    std::vector<SentPacket> _history;
+
+    // 包组，发送间隔小于kBurstDeltaMS的包归为一组
+    // Packet group, packets sent within kBurstDeltaMS are grouped together
+    PacketGroup _cur_group;
+    PacketGroup _prev_group;
+
+    // trendline滤波器状态
+    // Trendline filter state
+    size_t _num_deltas = 0;
+    double _first_arrival_ms = -1;
+    double _accumulated_delay = 0;
+    double _smoothed_delay = 0;
+    std::deque<std::pair<double /*arrival ms*/, double /*smoothed delay*/>> _delay_hist;
+    double _trend = 0;
+    double _prev_trend = 0;
+    double _threshold;
+    double _last_threshold_update_ms = -1;
+    double _time_over_using = -1;
+    uint32_t _overuse_counter = 0;
+
+    // aimd状态
+    // Aimd state
+    uint64_t _last_update_ms = 0;
+    uint64_t _last_decrease_ms = 0;
+
+    // 丢包统计
+    // Loss statistics
+    uint32_t _loss_lost = 0;
+    uint32_t _loss_total = 0;
+    uint64_t _last_loss_decrease_ms = 0;
+
+    std::deque<std::pair<uint64_t /*stamp*/, uint32_t /*bytes*/>> _acked_window;
+    uint64_t _acked_window_bytes = 0;
+    std::deque<std::pair<uint64_t /*stamp*/, uint32_t /*bytes*/>> _send_window;
+    uint64_t _send_window_bytes = 0;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_SENDSIDEBWE_H
@@ -9,6 +9,7 @@
  */
 
 #include "WebRtcPlayer.h"
+#include <algorithm>
 
 #include "Common/config.h"
 #include "Extension/Factory.h"
@@ -21,9 +22,109 @@ namespace mediakit {
 namespace Rtc {
 #define RTC_FIELD "rtc."
 const string kBfilter = RTC_FIELD "bfilter";
-static onceToken token([]() { mINI::Instance()[kBfilter] = 0; });
+const string kSimulcastAutoLayer = RTC_FIELD "simulcastAutoLayer";
+static onceToken token([]() {
+    mINI::Instance()[kBfilter] = 0;
+    mINI::Instance()[kSimulcastAutoLayer] = 1;
+});
 } // namespace Rtc
 
+static bool canSwitchLayer(CodecId codec) {
+    switch (codec) {
+        case CodecH264:
+        case CodecH265:
+        case CodecVP8:
+        case CodecVP9: return true;
+        default: return false;
+    }
+}
+
+// 判断rtp包是否为关键帧的第一个包(h264/h265包含参数集的包也认为是关键帧起始)
+// Determine whether the rtp packet is the first packet of a keyframe (h264/h265 packets with parameter sets are also considered keyframe starts)
+static bool isKeyFrameStart(CodecId codec, const RtpPacket::Ptr &rtp) {
+    auto payload = rtp->getPayload();
+    auto size = rtp->getPayloadSize();
+    if (size < 1) {
+        return false;
+    }
+    switch (codec) {
+        case CodecH264: {
+            auto is_key = [](uint8_t type) { return type == 5 || type == 7; };
+            auto type = payload[0] & 0x1F;
+            if (type == 24) {
+                // STAP-A
+                for (size_t offset = 1; offset + 3 <= size;) {
+                    uint16_t nalu_size = (payload[offset] << 8) | payload[offset + 1];
+                    if (is_key(payload[offset + 2] & 0x1F)) {
+                        return true;
+                    }
+                    offset += 2 + nalu_size;
+                }
+                return false;
+            }
+            if (type == 28) {
+                // FU-A
+                return size >= 2 && (payload[1] & 0x80) && is_key(payload[1] & 0x1F);
+            }
+            return is_key(type);
+        }
+        case CodecH265: {
+            auto is_key = [](uint8_t type) { return (type >= 16 && type <= 21) || (type >= 32 && type <= 34); };
+            auto type = (payload[0] >> 1) & 0x3F;
+            if (type == 48) {
+                // AP
+                for (size_t offset = 2; offset + 3 <= size;) {
+                    uint16_t nalu_size = (payload[offset] << 8) | payload[offset + 1];
+                    if (is_key((payload[offset + 2] >> 1) & 0x3F)) {
+                        return true;
+                    }
+                    offset += 2 + nalu_size;
+                }
+                return false;
+            }
+            if (type == 49) {
+                // FU
+                return size >= 3 && (payload[2] & 0x80) && is_key(payload[2] & 0x3F);
+            }
+            return is_key(type);
+        }
+        case CodecVP8: {
+            // rfc7741 payload descriptor, S=1 && PID=0且payload header中P=0为关键帧
+            // rfc7741 payload descriptor, keyframe when S=1 && PID=0 and P=0 in the payload header
+            if (!(payload[0] & 0x10) || (payload[0] & 0x07)) {
+                return false;
+            }
+            size_t offset = 1;
+            if (payload[0] & 0x80) {
+                if (size < 2) {
+                    return false;
+                }
+                auto ext = payload[1];
+                offset = 2;
+                if (ext & 0x80) {
+                    if (offset >= size) {
+                        return false;
+                    }
+                    offset += (payload[offset] & 0x80) ? 2 : 1;
+                }
+                if (ext & 0x40) {
+                    ++offset;
+                }
+                if (ext & 0x30) {
+                    ++offset;
+                }
+            }
+            return offset < size && !(payload[offset] & 0x01);
+        }
+        case CodecVP9: {
+            // B=1且P=0为关键帧起始
+            // Keyframe start when B=1 and P=0
+            return (payload[0] & 0x08) && !(payload[0] & 0x40);
+        }
+        default: return false;
+    }
+}
+
 H264BFrameFilter::H264BFrameFilter()
     : _last_seq(0)
     , _last_stamp(0)
@@ -198,70 +299,330 @@ void WebRtcPlayer::onStartWebRTC() {
         return;
     }
     WebRtcTransportImp::onStartWebRTC();
+    auto video = _answer_sdp->getMedia(TrackVideo);
+    if (video && !video->plan.empty()) {
+        _video_codec = getCodecId(video->plan[0].codec);
+        _is_h264 = _video_codec == CodecH264;
+    }
     if (canSendRtp()) {
         playSrc->pause(false);
-        _reader = playSrc->getRing()->attach(getPoller(), true);
+        GET_CONFIG(bool, simulcast_auto, Rtc::kSimulcastAutoLayer);
+        _simulcast = simulcast_auto && refreshLayers();
+        if (!_simulcast) {
+            _reader = attachReader(playSrc, -1);
+            return;
+        }
+        // 先选择初始层并直接使用gop缓存秒开，后续由定时器根据带宽估计切换
+        // Select the initial layer first and use the gop cache for instant playback, then switch by timer according to the bandwidth estimation
+        updateLayer();
         weak_ptr<WebRtcPlayer> weak_self = static_pointer_cast<WebRtcPlayer>(shared_from_this());
-        weak_ptr<Session> weak_session = static_pointer_cast<Session>(getSession());
-        _reader->setGetInfoCB([weak_session]() {
-            Any ret;
-            ret.set(static_pointer_cast<Session>(weak_session.lock()));
-            return ret;
-        });
-        _reader->setReadCB([weak_self](const RtspMediaSource::RingDataType &pkt) {
+        _layer_timer = std::make_shared<Timer>(1.0f, [weak_self]() {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
-                return;
+                return false;
             }
+            strong_self->updateLayer();
+            return true;
+        }, getPoller());
+    }
+}
 
-            if (strong_self->_send_config_frames_once && !pkt->empty()) {
-                const auto &first_rtp = pkt->front();
-                strong_self->sendConfigFrames(first_rtp->getSeq(), first_rtp->sample_rate, first_rtp->getStamp(), first_rtp->ntp_stamp);
-                strong_self->_send_config_frames_once = false;
-            }
+RtspMediaSource::RingType::RingReader::Ptr WebRtcPlayer::attachReader(const RtspMediaSource::Ptr &src, int layer) {
+    // 切换层时不使用gop缓存，等待新层的下一个关键帧
+    // Do not use the gop cache when switching layers, wait for the next keyframe of the new layer
+    auto reader = src->getRing()->attach(getPoller(), _cur_layer == -1);
+    weak_ptr<WebRtcPlayer> weak_self = static_pointer_cast<WebRtcPlayer>(shared_from_this());
+    weak_ptr<Session> weak_session = static_pointer_cast<Session>(getSession());
+    reader->setGetInfoCB([weak_session]() {
+        Any ret;
+        ret.set(static_pointer_cast<Session>(weak_session.lock()));
+        return ret;
+    });
+    reader->setReadCB([weak_self, layer](const RtspMediaSource::RingDataType &pkt) {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        strong_self->onReadRtp(layer, pkt);
+    });
+    reader->setDetachCB([weak_self, layer]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        strong_self->onReaderDetach(layer);
+    });
 
-            size_t i = 0;
-            pkt->for_each([&](const RtpPacket::Ptr &rtp) {
-                if (strong_self->_bfliter_flag) {
-                    if (TrackVideo == rtp->type && strong_self->_is_h264) {
-                        auto rtp_filter = strong_self->_bfilter->processPacket(rtp);
-                        if (rtp_filter) {
-                            strong_self->onSendRtp(rtp_filter, ++i == pkt->size());
-                        }
-                    } else {
-                        strong_self->onSendRtp(rtp, ++i == pkt->size());
-                    }
-                } else {
-                    strong_self->onSendRtp(rtp, ++i == pkt->size());
+    reader->setMessageCB([weak_self](const toolkit::Any &data) {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        if (data.is<Buffer>()) {
+            auto &buffer = data.get<Buffer>();
+            // PPID 51: 文本string  [AUTO-TRANSLATED:69a8cf81]
+            // PPID 51: Text string
+            // PPID 53: 二进制  [AUTO-TRANSLATED:faf00c3e]
+            // PPID 53: Binary
+            strong_self->sendDatachannel(0, 51, buffer.data(), buffer.size());
+        } else {
+            WarnL << "Send unknown message type to webrtc player: " << data.type_name();
+        }
+    });
+    return reader;
+}
+
+void WebRtcPlayer::onReadRtp(int layer, const RtspMediaSource::RingDataType &pkt) {
+    if (pkt->empty()) {
+        return;
+    }
+    if (_send_config_frames_once) {
+        const auto &first_rtp = pkt->front();
+        sendConfigFrames(first_rtp->getSeq(), first_rtp->sample_rate, first_rtp->getStamp(), first_rtp->ntp_stamp);
+        _send_config_frames_once = false;
+    }
+
+    if (layer == -1) {
+        size_t i = 0;
+        pkt->for_each([&](const RtpPacket::Ptr &rtp) { sendRtp(rtp, ++i == pkt->size()); });
+        return;
+    }
+
+    if (layer == _pending_layer) {
+        // 等待目标层的关键帧，从关键帧第一个rtp包开始切换
+        // Wait for the keyframe of the target layer, switch from the first rtp packet of the keyframe
+        bool switched = false;
+        size_t i = 0;
+        pkt->for_each([&](const RtpPacket::Ptr &rtp) {
+            ++i;
+            if (!switched) {
+                if (rtp->type != TrackVideo || !isKeyFrameStart(_video_codec, rtp)) {
+                    return;
                 }
-            });
+                InfoL << getIdentifier() << " switch simulcast layer from " << _layers[_cur_layer].rid << " to " << _layers[layer].rid
+                      << ", bwe bitrate:" << (getBwe() ? getBwe()->getTargetBitrate() : 0);
+                switched = true;
+                _cur_layer = layer;
+                _pending_layer = -1;
+                _reader = std::move(_pending_reader);
+                _switch_ticker.resetTime();
+                if (_video_started) {
+                    // 新层的时间戳从上一个包加上实际经过的时间开始
+                    // The timestamp of the new layer starts from the last packet plus the actually elapsed time
+                    auto elapsed = std::max<uint64_t>(_last_video_ticker.elapsedTime(), 1);
+                    _seq_offset = (uint16_t)(_last_video_seq + 1 - rtp->getSeq());
+                    _stamp_offset = (uint32_t)(_last_video_stamp + elapsed * rtp->sample_rate / 1000 - rtp->getStamp());
+                }
+            }
+            sendLayerRtp(rtp, i == pkt->size());
         });
-        _reader->setDetachCB([weak_self]() {
-            auto strong_self = weak_self.lock();
-            if (!strong_self) {
+        return;
+    }
+
+    if (layer == _cur_layer) {
+        size_t i = 0;
+        pkt->for_each([&](const RtpPacket::Ptr &rtp) { sendLayerRtp(rtp, ++i == pkt->size()); });
+    }
+}
+
+void WebRtcPlayer::onReaderDetach(int layer) {
+    if (layer != -1) {
+        if (layer == _pending_layer) {
+            _pending_layer = -1;
+            _pending_reader = nullptr;
+            return;
+        }
+        if (layer != _cur_layer) {
+            return;
+        }
+        // 当前层已注销，如果还有其他层则切换过去
+        // The current layer has been unregistered, switch to another one if any
+        for (size_t i = 0; i < _layers.size(); ++i) {
+            if ((int)i != layer && startSwitchLayer(i)) {
                 return;
             }
-            strong_self->onShutdown(SockException(Err_shutdown, "rtsp ring buffer detached"));
-        });
+        }
+    }
+    onShutdown(SockException(Err_shutdown, "rtsp ring buffer detached"));
+}
 
-        _reader->setMessageCB([weak_self](const toolkit::Any &data) {
-            auto strong_self = weak_self.lock();
-            if (!strong_self) {
+void WebRtcPlayer::sendRtp(const RtpPacket::Ptr &rtp, bool flush) {
+    if ((_bfliter_flag || _congested) && TrackVideo == rtp->type && _is_h264) {
+        auto rtp_filter = _bfilter->processPacket(rtp);
+        if (rtp_filter) {
+            onSendRtp(rtp_filter, flush);
+        }
+        return;
+    }
+    onSendRtp(rtp, flush);
+}
+
+void WebRtcPlayer::sendLayerRtp(const RtpPacket::Ptr &rtp, bool flush) {
+    if (rtp->type != TrackVideo) {
+        // 推流端把音频写入了所有层，切换时可能重复或乱序，丢弃旧包
+        // The pusher writes audio to all layers, packets may be duplicated or reordered when switching, drop old ones
+        auto seq = rtp->getSeq();
+        if (_audio_started && (int16_t)(seq - _last_audio_seq) <= 0) {
+            return;
+        }
+        _audio_started = true;
+        _last_audio_seq = seq;
+        sendRtp(rtp, flush);
+        return;
+    }
+
+    auto out = rtp;
+    if (_seq_offset || _stamp_offset) {
+        // ring中的rtp包被所有播放器共享，不能直接修改
+        // Rtp packets in the ring are shared by all players and must not be modified in place
+        out = RtpPacket::create();
+        out->assign(rtp->data(), rtp->size());
+        out->type = rtp->type;
+        out->sample_rate = rtp->sample_rate;
+        out->ntp_stamp = rtp->ntp_stamp;
+        out->track_index = rtp->track_index;
+        auto header = out->getHeader();
+        header->seq = htons((uint16_t)(rtp->getSeq() + _seq_offset));
+        header->stamp = htonl(rtp->getStamp() + _stamp_offset);
+    }
+    _video_started = true;
+    _last_video_seq = out->getSeq();
+    _last_video_stamp = out->getStamp();
+    _last_video_ticker.resetTime();
+    sendRtp(out, flush);
+}
+
+bool WebRtcPlayer::refreshLayers() {
+    auto play_src = _play_src.lock();
+    if (!play_src) {
+        return false;
+    }
+    // simulcast的各层由推流端克隆为stream_rid的rtsp源
+    // Simulcast layers are cloned by the pusher as rtsp sources named stream_rid
+    auto &tuple = play_src->getMediaTuple();
+    auto prefix = tuple.stream + '_';
+    auto origin_url = play_src->getOriginUrl();
+    MediaSource::for_each_media([&](const MediaSource::Ptr &src) {
+        auto rtsp_src = dynamic_pointer_cast<RtspMediaSource>(src);
+        if (!rtsp_src || rtsp_src == play_src) {
+            return;
+        }
+        auto &stream = src->getMediaTuple().stream;
+        if (stream.size() <= prefix.size() || stream.compare(0, prefix.size(), prefix) != 0) {
+            return;
+        }
+        if (src->getOriginType() != MediaOriginType::rtc_push || src->getOriginUrl() != origin_url) {
+            return;
+        }
+        auto rid = stream.substr(prefix.size());
+        for (auto &layer : _layers) {
+            if (layer.rid == rid) {
+                layer.src = rtsp_src;
                 return;
             }
-            if (data.is<Buffer>()) {
-                auto &buffer = data.get<Buffer>();
-                // PPID 51: 文本string  [AUTO-TRANSLATED:69a8cf81]
-                // PPID 51: Text string
-                // PPID 53: 二进制  [AUTO-TRANSLATED:faf00c3e]
-                // PPID 53: Binary
-                strong_self->sendDatachannel(0, 51, buffer.data(), buffer.size());
-            } else {
-                WarnL << "Send unknown message type to webrtc player: " << data.type_name();
+        }
+        _layers.emplace_back(SimulcastLayer { rid, rtsp_src });
+    }, RTSP_SCHEMA, tuple.vhost, tuple.app);
+    return !_layers.empty();
+}
+
+void WebRtcPlayer::updateLayer() {
+    if (_pending_reader) {
+        if (_pending_ticker.elapsedTime() < 5 * 1000) {
+            return;
+        }
+        // 长时间等不到关键帧，放弃本次切换
+        // Give up this switch if no keyframe arrives for a long time
+        WarnL << getIdentifier() << " wait keyframe of simulcast layer " << _layers[_pending_layer].rid << " timeout";
+        _pending_reader = nullptr;
+        _pending_layer = -1;
+    }
+    refreshLayers();
+
+    // 按视频码率从低到高排序
+    // Sort by video bitrate from low to high
+    std::vector<std::pair<size_t /*bitrate*/, int /*layer*/>> layers;
+    for (size_t i = 0; i < _layers.size(); ++i) {
+        auto src = _layers[i].src.lock();
+        if (src) {
+            layers.emplace_back(src->getBytesSpeed(TrackVideo) * 8, i);
+        }
+    }
+    if (layers.empty()) {
+        return;
+    }
+    std::sort(layers.begin(), layers.end());
+
+    auto &bwe = getBwe();
+    int cur_pos = -1;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (layers[i].second == _cur_layer) {
+            cur_pos = i;
+        }
+    }
+
+    int target_pos;
+    if (!bwe) {
+        // 没有带宽估计时固定使用最高层
+        // Always use the highest layer without bandwidth estimation
+        target_pos = layers.size() - 1;
+    } else {
+        // 选择码率不超过估计带宽90%的最高层
+        // Select the highest layer whose bitrate does not exceed 90% of the estimated bandwidth
+        target_pos = 0;
+        auto budget = bwe->getTargetBitrate() * 0.9;
+        for (size_t i = 0; i < layers.size(); ++i) {
+            if (layers[i].first <= budget) {
+                target_pos = i;
             }
-        });
+        }
+        if (cur_pos != -1) {
+            if (bwe->getLossRate() > 0.1f && cur_pos > 0) {
+                // 丢包严重时至少降一层
+                // Step down at least one layer when packet loss is heavy
+                target_pos = std::min(target_pos, cur_pos - 1);
+            }
+            if (target_pos > cur_pos) {
+                // 升层需要网络持续稳定，且每次只升一层
+                // Stepping up requires the network to stay stable, and only one layer at a time
+                if (_switch_ticker.elapsedTime() < 5 * 1000 || bwe->getState() == SendSideBwe::BandwidthUsage::overusing) {
+                    return;
+                }
+                target_pos = cur_pos + 1;
+            } else if (target_pos < cur_pos && _switch_ticker.elapsedTime() < 1000) {
+                return;
+            }
+        }
+    }
+
+    auto target = layers[target_pos].second;
+    if (cur_pos == -1) {
+        // 首次选择或当前层已注销
+        // The first selection or the current layer has been unregistered
+        if (_cur_layer == -1) {
+            InfoL << getIdentifier() << " select simulcast layer " << _layers[target].rid;
+            _switch_ticker.resetTime();
+            _reader = attachReader(_layers[target].src.lock(), target);
+            _cur_layer = target;
+            return;
+        }
+    }
+    if (target != _cur_layer && canSwitchLayer(_video_codec)) {
+        startSwitchLayer(target);
     }
 }
+
+bool WebRtcPlayer::startSwitchLayer(int layer) {
+    auto src = _layers[layer].src.lock();
+    if (!src || !canSwitchLayer(_video_codec)) {
+        return false;
+    }
+    _pending_layer = layer;
+    _pending_ticker.resetTime();
+    _pending_reader = attachReader(src, layer);
+    return true;
+}
+
 void WebRtcPlayer::onDestory() {
     auto duration = getDuration();
     auto bytes_usage = getBytesUsage();
@@ -289,6 +650,24 @@ void WebRtcPlayer::onRtcConfigure(RtcConfigure &configure) const {
     configure.setPlayRtspInfo(playSrc->getSdp());
 }
 
+void WebRtcPlayer::onBweChanged(uint32_t bitrate_bps, float loss_rate, SendSideBwe::BandwidthUsage state) {
+    WebRtcTransportImp::onBweChanged(bitrate_bps, loss_rate, state);
+    auto &bwe = getBwe();
+    // 网络过载或者估计带宽明显低于实际发送码率时认为拥塞
+    // Considered congested when the network is overused or the estimated bandwidth is significantly lower than the actual send bitrate
+    auto congested = state == SendSideBwe::BandwidthUsage::overusing || bitrate_bps < bwe->getSendBitrate() * 0.9;
+    if (congested != _congested) {
+        InfoL << getIdentifier() << " " << (congested ? "start" : "stop") << " dropping b frames, bwe bitrate:" << bitrate_bps
+              << ", send bitrate:" << bwe->getSendBitrate();
+        _congested = congested;
+    }
+    if (_simulcast && state == SendSideBwe::BandwidthUsage::overusing) {
+        // 过载时立即尝试降层，不等待定时器
+        // Try to step down immediately when overusing, without waiting for the timer
+        updateLayer();
+    }
+}
+
 void WebRtcPlayer::sendConfigFrames(uint32_t before_seq, uint32_t sample_rate, uint32_t timestamp, uint64_t ntp_timestamp) {
     auto play_src = _play_src.lock();
     if (!play_src) {
@@ -15,6 +15,13 @@
 #include "WebRtcTransport.h"
 
 namespace mediakit {
+
+namespace Rtc {
+// 播放simulcast推流时，是否订阅所有rid层并根据带宽估计自动切换
+// Whether to subscribe to all rid layers and switch automatically according to the bandwidth estimation when playing a simulcast stream
+extern const std::string kSimulcastAutoLayer;
+} // namespace Rtc
+
 /**
  * @brief H.264 B 帧过滤器
  * 用于从 H.264 RTP 流中移除 B 帧
@@ -133,12 +140,25 @@ protected:
     void onStartWebRTC() override;
     void onDestory() override;
     void onRtcConfigure(RtcConfigure &configure) const override;
+    void onBweChanged(uint32_t bitrate_bps, float loss_rate, SendSideBwe::BandwidthUsage state) override;
 
 private:
     WebRtcPlayer(const EventPoller::Ptr &poller, const RtspMediaSource::Ptr &src, const MediaInfo &info);
 
     void sendConfigFrames(uint32_t before_seq, uint32_t sample_rate, uint32_t timestamp, uint64_t ntp_timestamp);
 
+    RtspMediaSource::RingType::RingReader::Ptr attachReader(const RtspMediaSource::Ptr &src, int layer);
+    void onReadRtp(int layer, const RtspMediaSource::RingDataType &pkt);
+    void onReaderDetach(int layer);
+    void sendRtp(const RtpPacket::Ptr &rtp, bool flush);
+
+    ///////simulcast相关///////
+    ///////simulcast related///////
+    bool refreshLayers();
+    void updateLayer();
+    bool startSwitchLayer(int layer);
+    void sendLayerRtp(const RtpPacket::Ptr &rtp, bool flush);
+
 private:
     // 媒体相关元数据  [AUTO-TRANSLATED:f4cf8045]
     // Media related metadata
@@ -157,7 +177,39 @@ private:
 
     bool _is_h264 { false };
     bool _bfliter_flag { false };
+    // 带宽估计判定网络拥塞时，丢弃b帧降低码率
+    // Drop b frames to reduce the bitrate when the bandwidth estimation detects congestion
+    bool _congested { false };
     std::shared_ptr<H264BFrameFilter> _bfilter;
+
+    struct SimulcastLayer {
+        std::string rid;
+        std::weak_ptr<RtspMediaSource> src;
+    };
+    // 推流端开启simulcast时，同时订阅各个rid层并根据带宽估计在关键帧处切换
+    // When the pusher enables simulcast, subscribe to all rid layers and switch at keyframes according to the bandwidth estimation
+    bool _simulcast = false;
+    CodecId _video_codec = CodecInvalid;
+    // 下标固定，读取回调中通过下标区分所属的层
+    // Indexes are fixed, read callbacks use them to identify the layer
+    std::vector<SimulcastLayer> _layers;
+    int _cur_layer = -1;
+    int _pending_layer = -1;
+    RtspMediaSource::RingType::RingReader::Ptr _pending_reader;
+    Ticker _pending_ticker;
+    Ticker _switch_ticker;
+    std::shared_ptr<toolkit::Timer> _layer_timer;
+
+    // 切换层后保持seq和时间戳连续
+    // Keep seq and timestamp continuous after switching layers
+    bool _video_started = false;
+    uint16_t _seq_offset = 0;
+    uint32_t _stamp_offset = 0;
+    uint16_t _last_video_seq = 0;
+    uint32_t _last_video_stamp = 0;
+    Ticker _last_video_ticker;
+    bool _audio_started = false;
+    uint16_t _last_audio_seq = 0;
 };
 
 }// namespace mediakit
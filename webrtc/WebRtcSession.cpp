@@ -19,30 +19,56 @@ using namespace std;
 
 namespace mediakit {
 
-static string getUserName(const char *buf, size_t len) {
+// 直接从stun binding request中定位username属性里的本端ufrag，不解析整个stun包，也不分配内存
+// 完整的stun解析和校验由IceServer负责
+// Locate the local ufrag in the username attribute of the stun binding request directly, without parsing the whole stun packet or allocating memory.
+// The full stun parsing and validation is done by IceServer
+static bool getUserName(const char *buf, size_t len, const char *&user_name, size_t &user_name_len) {
     if (!RTC::StunPacket::IsStun((const uint8_t *) buf, len)) {
-        return "";
-    }
-    std::unique_ptr<RTC::StunPacket> packet(RTC::StunPacket::Parse((const uint8_t *) buf, len));
-    if (!packet) {
-        return "";
-    }
-    if (packet->GetClass() != RTC::StunPacket::Class::REQUEST ||
-        packet->GetMethod() != RTC::StunPacket::Method::BINDING) {
-        return "";
+        return false;
     }
+    auto data = (const uint8_t *)buf;
     // 收到binding request请求  [AUTO-TRANSLATED:eff4d773]
     // Received binding request
-    auto vec = split(packet->GetUsername(), ":");
-    return vec[0];
+    if (((data[0] << 8) | data[1]) != 0x0001) {
+        return false;
+    }
+    size_t offset = 20;
+    while (offset + 4 <= len) {
+        auto type = (data[offset] << 8) | data[offset + 1];
+        size_t attr_len = (data[offset + 2] << 8) | data[offset + 3];
+        offset += 4;
+        if (offset + attr_len > len) {
+            return false;
+        }
+        if (type == 0x0006) {
+            // USERNAME: 本端ufrag:对端ufrag
+            // USERNAME: local ufrag:remote ufrag
+            auto colon = (const char *)memchr(data + offset, ':', attr_len);
+            user_name = (const char *)data + offset;
+            user_name_len = colon ? colon - user_name : attr_len;
+            return true;
+        }
+        // 属性按4字节对齐
+        // Attributes are aligned to 4 bytes
+        offset += (attr_len + 3) & ~3;
+    }
+    return false;
 }
 
-EventPoller::Ptr WebRtcSession::queryPoller(const Buffer::Ptr &buffer) {
-    auto user_name = getUserName(buffer->data(), buffer->size());
-    if (user_name.empty()) {
-        return nullptr;
+static WebRtcTransportImp::Ptr findTransport(const char *buf, size_t len, const struct sockaddr *addr) {
+    const char *user_name;
+    size_t user_name_len;
+    if (getUserName(buf, len, user_name, user_name_len)) {
+        return WebRtcTransportManager::Instance().getItem(user_name, user_name_len);
     }
-    auto ret = WebRtcTransportManager::Instance().getItem(user_name);
+    // 非stun包(如连接迁移或会话超时重建后的srtp包)，按已通过ice检查的对端地址查找
+    // Non-stun packets (such as srtp packets after connection migration or session rebuild), look up by the peer address that passed the ice check
+    return addr ? WebRtcTransportManager::Instance().getItemByAddr(addr) : nullptr;
+}
+
+EventPoller::Ptr WebRtcSession::queryPoller(const Buffer::Ptr &buffer, const struct sockaddr *addr) {
+    auto ret = findTransport(buffer->data(), buffer->size(), addr);
     return ret ? ret->getPoller() : nullptr;
 }
 
@@ -61,8 +87,11 @@ void WebRtcSession::onRecv_l(const char *data, size_t len) {
         // 只允许寻找一次transport  [AUTO-TRANSLATED:446fae53]
         // Only allow searching for transport once
         _find_transport = false;
-        auto user_name = getUserName(data, len);
-        auto transport = WebRtcTransportManager::Instance().getItem(user_name);
+        struct sockaddr_storage peer_addr;
+        if (!_over_tcp) {
+            peer_addr = SockUtil::make_sockaddr(get_peer_ip().data(), get_peer_port());
+        }
+        auto transport = findTransport(data, len, _over_tcp ? nullptr : (struct sockaddr *)&peer_addr);
         CHECK(transport);
 
         // WebRtcTransport在其他poller线程上，需要切换poller线程并重新创建WebRtcSession对象  [AUTO-TRANSLATED:7e5534cf]
@@ -32,7 +32,15 @@ public:
     void onRecv(const Buffer::Ptr &) override;
     void onError(const SockException &err) override;
     void onManager() override;
-    static EventPoller::Ptr queryPoller(const Buffer::Ptr &buffer);
+    /**
+     * udp服务器收到新对端的数据时，查找对应transport所在的poller
+     * @param buffer 收到的数据
+     * @param addr 对端地址，用于非stun包的查找
+     * Find the poller of the corresponding transport when the udp server receives data from a new peer
+     * @param buffer received data
+     * @param addr peer address, used to look up non-stun packets
+     */
+    static EventPoller::Ptr queryPoller(const Buffer::Ptr &buffer, const struct sockaddr *addr = nullptr);
 
 protected:
     WebRtcTransportImp::Ptr _transport;
@@ -9,6 +9,7 @@
  */
 
 #include <iostream>
+#include <algorithm>
 #include <srtp2/srtp.h>
 #include "Util/base64.h"
 #include "Network/sockutil.h"
@@ -188,6 +189,13 @@ void WebRtcTransportImp::OnIceServerSelectedTuple(const RTC::IceServer *iceServe
     InfoL << getIdentifier() << " select tuple " << sockTypeStr(tuple) << " " << tuple->get_peer_ip() << ":" << tuple->get_peer_port();
     tuple->setSendFlushFlag(false);
     unrefSelf();
+    if (tuple->getSock()->sockType() == SockNum::Sock_UDP) {
+        // 登记已通过ice检查的对端地址，后续该地址的数据无需解析stun即可找到本对象
+        // Register the peer address that passed the ice check, later data from it can find this object without parsing stun
+        auto addr = SockUtil::make_sockaddr(tuple->get_peer_ip().data(), tuple->get_peer_port());
+        WebRtcTransportManager::Instance().addAddr((struct sockaddr *)&addr, static_pointer_cast<WebRtcTransportImp>(shared_from_this()));
+        _peer_addrs.emplace_back(addr);
+    }
 }
 
 void WebRtcTransport::OnIceServerConnected(const RTC::IceServer *iceServer) {
@@ -498,7 +506,9 @@ void WebRtcTransport::sendRtpPacket(const char *buf, int len, bool flush, void *
         auto pkt = _packet_pool.obtain2();
         // 预留rtx加入的两个字节  [AUTO-TRANSLATED:d1eb5cd7]
         // Reserve two bytes for rtx joining
-        pkt->setCapacity((size_t)len + SRTP_MAX_TRAILER_LEN + 2);
+        // 以及twcc扩展可能插入的字节
+        // And the bytes that may be inserted by the twcc extension
+        pkt->setCapacity((size_t)len + SRTP_MAX_TRAILER_LEN + 2 + RtpExtContext::kMaxTransportCCExtSize);
         memcpy(pkt->data(), buf, len);
         onBeforeEncryptRtp(pkt->data(), len, ctx);
         if (_srtp_session_send->EncryptRtp(reinterpret_cast<uint8_t *>(pkt->data()), &len)) {
@@ -692,6 +702,53 @@ void WebRtcTransportImp::onStartWebRTC() {
             ++index;
         }
     }
+    createBwe();
+}
+
+void WebRtcTransportImp::createBwe() {
+    GET_CONFIG(bool, bwe_enable, Rtc::kBweEnable);
+    if (!bwe_enable || !canSendRtp() || !_answer_sdp->supportRtcpFb(SdpConst::kTWCCRtcpFb)) {
+        return;
+    }
+    GET_CONFIG(uint32_t, start_bitrate, Rtc::kStartBitrate);
+    GET_CONFIG(uint32_t, max_bitrate, Rtc::kMaxBitrate);
+    GET_CONFIG(uint32_t, min_bitrate, Rtc::kMinBitrate);
+    // 比特率配置单位为kbps，未配置时使用默认值
+    // The bitrate configuration unit is kbps, use the default value if not configured
+    _bwe = std::make_shared<SendSideBwe>(
+        (start_bitrate ? start_bitrate : 2000) * 1000, (min_bitrate ? min_bitrate : 50) * 1000, (max_bitrate ? max_bitrate : 20000) * 1000);
+    _bwe->setOnBitrateChanged([this](uint32_t bitrate_bps, float loss_rate, SendSideBwe::BandwidthUsage state) {
+        onBweChanged(bitrate_bps, loss_rate, state);
+    });
+
+    GET_CONFIG(bool, pacer_enable, Rtc::kPacerEnable);
+    if (!pacer_enable) {
+        return;
+    }
+    GET_CONFIG(float, pacing_factor, Rtc::kPacingFactor);
+    _pacer = std::make_shared<RtcPacer>(getPoller(), [this](const RtpPacket::Ptr &rtp, bool rtx, bool flush) {
+        sendRtpNow(rtp, flush, rtx);
+    });
+    _pacer->setPacingRate(_bwe->getTargetBitrate() * pacing_factor);
+}
+
+const SendSideBwe::Ptr &WebRtcTransportImp::getBwe() const {
+    return _bwe;
+}
+
+const RtcPacer::Ptr &WebRtcTransportImp::getPacer() const {
+    return _pacer;
+}
+
+void WebRtcTransportImp::onBweChanged(uint32_t bitrate_bps, float loss_rate, SendSideBwe::BandwidthUsage state) {
+    DebugL << getIdentifier() << " bwe changed, bitrate:" << bitrate_bps << ", loss:" << loss_rate
+           << ", state:" << SendSideBwe::getStateName(state);
+    if (_pacer) {
+        GET_CONFIG(float, pacing_factor, Rtc::kPacingFactor);
+        _pacer->setPacingRate(bitrate_bps * pacing_factor);
+    }
+    int state_int = (int)state;
+    NOTICE_EMIT(BroadcastRtcBweChangedArgs, Broadcast::kBroadcastRtcBweChanged, *this, bitrate_bps, loss_rate, state_int);
 }
 
 void WebRtcTransportImp::onCheckAnswer(RtcSession &sdp) {
@@ -1019,6 +1076,10 @@ void WebRtcTransportImp::onRtcp(const char *buf, size_t len) {
                 });
                 break;
             }
+            case RTPFBType::RTCP_RTPFB_TWCC: {
+                onRecvTwcc((RtcpFB *)rtcp);
+                break;
+            }
             default:
                 break;
             }
@@ -1169,6 +1230,18 @@ void WebRtcTransportImp::onSendTwcc(uint32_t ssrc, const string &twcc_fci) {
     sendRtcpPacket((char *)rtcp.get(), rtcp->getSize(), true);
 }
 
+void WebRtcTransportImp::onRecvTwcc(const RtcpFB *fb) {
+    if (!_bwe) {
+        return;
+    }
+    try {
+        auto &fci = fb->getFci<FCI_TWCC>();
+        _bwe->onTwccFeedback(fci, fb->getFciSize(), getCurrentMillisecond());
+    } catch (std::exception &ex) {
+        WarnL << "parse twcc rtcp failed:" << ex.what();
+    }
+}
+
 ///////////////////////////////////////////////////////////////////
 
 void WebRtcTransportImp::onSortedRtp(MediaTrack &track, const string &rid, RtpPacket::Ptr rtp) {
@@ -1217,6 +1290,20 @@ void WebRtcTransportImp::onSendRtp(const RtpPacket::Ptr &rtp, bool flush, bool r
         // Send RTX retransmission packets
         // TraceL << "send rtx rtp:" << rtp->getSeq();
     }
+    if (_pacer) {
+        // 经过平滑器排队后再发送，transport-wide seq在实际发送时才分配
+        // Send after queuing in the pacer, the transport-wide seq is assigned when it is actually sent
+        _pacer->enqueue(rtp, rtx, flush);
+        return;
+    }
+    sendRtpNow(rtp, flush, rtx);
+}
+
+void WebRtcTransportImp::sendRtpNow(const RtpPacket::Ptr &rtp, bool flush, bool rtx) {
+    auto &track = _type_to_track[rtp->type];
+    if (!track) {
+        return;
+    }
     pair<bool /*rtx*/, MediaTrack *> ctx { rtx, track.get() };
     sendRtpPacket(rtp->data() + RtpPacket::kRtpTcpHeaderSize, rtp->size() - RtpPacket::kRtpTcpHeaderSize, flush, &ctx);
     _bytes_usage += rtp->size() - RtpPacket::kRtpTcpHeaderSize;
@@ -1225,17 +1312,18 @@ void WebRtcTransportImp::onSendRtp(const RtpPacket::Ptr &rtp, bool flush, bool r
 void WebRtcTransportImp::onBeforeEncryptRtp(const char *buf, int &len, void *ctx) {
     auto pr = (pair<bool /*rtx*/, MediaTrack *> *)ctx;
     auto header = (RtpHeader *)buf;
+    // 未开启带宽估计时无需查找twcc扩展
+    // No need to find the twcc extension without bandwidth estimation
+    auto twcc_ext = pr->second->rtp_ext_ctx->changeRtpExtId(header, false, nullptr, _bwe ? RtpExtType::transport_cc : RtpExtType::padding);
 
     if (!pr->first || !pr->second->plan_rtx) {
         // 普通的rtp,或者不支持rtx, 修改目标pt和ssrc  [AUTO-TRANSLATED:e1264971]
         // Ordinary RTP, or does not support RTX, modify the target PT and SSRC
-        pr->second->rtp_ext_ctx->changeRtpExtId(header, false);
         header->pt = pr->second->plan_rtp->pt;
         header->ssrc = htonl(pr->second->answer_ssrc_rtp);
     } else {
         // 重传的rtp, rtx  [AUTO-TRANSLATED:e863a518]
         // Retransmitted RTP, RTX
-        pr->second->rtp_ext_ctx->changeRtpExtId(header, false);
         header->pt = pr->second->plan_rtx->pt;
         if (pr->second->answer_ssrc_rtx) {
             // 有rtx单独的ssrc,有些情况下，浏览器支持rtx，但是未指定rtx单独的ssrc  [AUTO-TRANSLATED:181cee9a]
@@ -1265,6 +1353,18 @@ void WebRtcTransportImp::onBeforeEncryptRtp(const char *buf, int &len, void *ctx
         payload[1] = origin_seq & 0xFF;
         len += 2;
     }
+
+    if (!_bwe) {
+        return;
+    }
+    // 重写或插入transport-wide seq，并记录发送情况供带宽估计使用
+    // Rewrite or insert the transport-wide seq, and record the sending status for bandwidth estimation
+    if (twcc_ext) {
+        twcc_ext.setTransportCCSeq(_twcc_send_seq);
+    } else if (!pr->second->rtp_ext_ctx->addTransportCCExt(header, len, _twcc_send_seq)) {
+        return;
+    }
+    _bwe->onSendPacket(_twcc_send_seq++, len, getCurrentMillisecond());
 }
 
 void WebRtcTransportImp::safeShutdown(const SockException &ex) {
@@ -1289,6 +1389,13 @@ void WebRtcTransportImp::removeTuple(RTC::TransportTuple *tuple) {
     this->_ice_server->RemoveTuple(tuple);
 }
 
+void WebRtcTransportImp::removePeerAddrs() {
+    for (auto &addr : _peer_addrs) {
+        WebRtcTransportManager::Instance().removeAddr((struct sockaddr *)&addr, this);
+    }
+    _peer_addrs.clear();
+}
+
 uint64_t WebRtcTransportImp::getBytesUsage() const {
     return _bytes_usage;
 }
@@ -1312,6 +1419,7 @@ void WebRtcTransportImp::unrefSelf() {
 
 void WebRtcTransportImp::unregisterSelf() {
     unrefSelf();
+    removePeerAddrs();
     WebRtcTransportManager::Instance().removeItem(getIdentifier());
 }
 
@@ -1320,26 +1428,118 @@ WebRtcTransportManager &WebRtcTransportManager::Instance() {
     return s_instance;
 }
 
+// FNV-1a
+static uint64_t hashUfrag(const char *key, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+WebRtcTransportManager::PeerAddr::PeerAddr(const struct sockaddr *addr) {
+    family = addr->sa_family;
+    switch (addr->sa_family) {
+        case AF_INET: {
+            auto in = (const struct sockaddr_in *)addr;
+            port = in->sin_port;
+            memcpy(ip, &in->sin_addr, 4);
+            break;
+        }
+        case AF_INET6: {
+            auto in6 = (const struct sockaddr_in6 *)addr;
+            port = in6->sin6_port;
+            memcpy(ip, &in6->sin6_addr, 16);
+            break;
+        }
+        default: break;
+    }
+}
+
+bool WebRtcTransportManager::PeerAddr::operator==(const PeerAddr &that) const {
+    return family == that.family && port == that.port && !memcmp(ip, that.ip, sizeof(ip));
+}
+
+size_t WebRtcTransportManager::PeerAddrHash::operator()(const PeerAddr &addr) const {
+    return (size_t)hashUfrag((const char *)&addr, sizeof(addr));
+}
+
 void WebRtcTransportManager::addItem(const string &key, const WebRtcTransportImp::Ptr &ptr) {
-    lock_guard<mutex> lck(_mtx);
-    _map[key] = ptr;
+    _map.modify(hashUfrag(key.data(), key.size()), [&](decltype(_map)::Map &map) {
+        auto &items = map[hashUfrag(key.data(), key.size())];
+        for (auto &item : items) {
+            if (item.key == key) {
+                item.transport = ptr;
+                return;
+            }
+        }
+        items.emplace_back(UfragItem { key, ptr });
+    });
 }
 
 WebRtcTransportImp::Ptr WebRtcTransportManager::getItem(const string &key) {
-    if (key.empty()) {
+    return getItem(key.data(), key.size());
+}
+
+WebRtcTransportImp::Ptr WebRtcTransportManager::getItem(const char *key, size_t len) {
+    if (!len) {
         return nullptr;
     }
-    lock_guard<mutex> lck(_mtx);
-    auto it = _map.find(key);
-    if (it == _map.end()) {
+    auto hash = hashUfrag(key, len);
+    auto map = _map.snapshot(hash);
+    auto it = map->find(hash);
+    if (it == map->end()) {
         return nullptr;
     }
-    return it->second.lock();
+    for (auto &item : it->second) {
+        if (item.key.size() == len && !memcmp(item.key.data(), key, len)) {
+            return item.transport.lock();
+        }
+    }
+    return nullptr;
 }
 
 void WebRtcTransportManager::removeItem(const string &key) {
-    lock_guard<mutex> lck(_mtx);
-    _map.erase(key);
+    auto hash = hashUfrag(key.data(), key.size());
+    _map.modify(hash, [&](decltype(_map)::Map &map) {
+        auto it = map.find(hash);
+        if (it == map.end()) {
+            return;
+        }
+        auto &items = it->second;
+        items.erase(std::remove_if(items.begin(), items.end(), [&](const UfragItem &item) { return item.key == key; }), items.end());
+        if (items.empty()) {
+            map.erase(it);
+        }
+    });
+}
+
+WebRtcTransportImp::Ptr WebRtcTransportManager::getItemByAddr(const struct sockaddr *addr) {
+    PeerAddr key(addr);
+    auto map = _addr_map.snapshot(key);
+    auto it = map->find(key);
+    return it == map->end() ? nullptr : it->second.lock();
+}
+
+void WebRtcTransportManager::addAddr(const struct sockaddr *addr, const WebRtcTransportImp::Ptr &ptr) {
+    PeerAddr key(addr);
+    _addr_map.modify(key, [&](decltype(_addr_map)::Map &map) { map[key] = ptr; });
+}
+
+void WebRtcTransportManager::removeAddr(const struct sockaddr *addr, const WebRtcTransportImp *ptr) {
+    PeerAddr key(addr);
+    _addr_map.modify(key, [&](decltype(_addr_map)::Map &map) {
+        auto it = map.find(key);
+        // 该地址可能已经被其他transport重新登记
+        // The address may have been re-registered by another transport
+        if (it != map.end()) {
+            auto transport = it->second.lock();
+            if (!transport || transport.get() == ptr) {
+                map.erase(it);
+            }
+        }
+    });
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -10,8 +10,11 @@
 
 #pragma once
 
+#include <mutex>
 #include <memory>
 #include <string>
+#include <vector>
+#include <unordered_map>
 #include "DtlsTransport.hpp"
 #include "IceServer.hpp"
 #include "SrtpSession.hpp"
@@ -23,6 +26,8 @@
 #include "Network/Session.h"
 #include "Nack.h"
 #include "TwccContext.h"
+#include "SendSideBwe.h"
+#include "RtcPacer.h"
 #include "SctpAssociation.hpp"
 #include "Rtcp/RtcpContext.h"
 
@@ -284,6 +289,18 @@ public:
     void removeTuple(RTC::TransportTuple* tuple);
     void safeShutdown(const SockException &ex);
 
+    /**
+     * 获取发送端带宽估计对象，未开启或对方不支持twcc时为空
+     * Get the send-side bandwidth estimator, null if disabled or the remote peer does not support twcc
+     */
+    const SendSideBwe::Ptr &getBwe() const;
+
+    /**
+     * 获取发送平滑器，未开启带宽估计或平滑时为空
+     * Get the send pacer, null if the bandwidth estimation or pacing is disabled
+     */
+    const RtcPacer::Ptr &getPacer() const;
+
     void setPreferredTcp(bool flag) override;
     void setLocalIp(std::string local_ip) override;
     void setIceCandidate(std::vector<SdpAttrCandidate> cands) override;
@@ -308,14 +325,19 @@ protected:
     void updateTicker();
     float getLossRate(TrackType type);
     void onRtcpBye() override;
+    virtual void onBweChanged(uint32_t bitrate_bps, float loss_rate, SendSideBwe::BandwidthUsage state);
 
 private:
     void onSortedRtp(MediaTrack &track, const std::string &rid, RtpPacket::Ptr rtp);
     void onSendNack(MediaTrack &track, const FCI_NACK &nack, uint32_t ssrc);
     void onSendTwcc(uint32_t ssrc, const std::string &twcc_fci);
+    void onRecvTwcc(const RtcpFB *fb);
+    void createBwe();
+    void sendRtpNow(const RtpPacket::Ptr &rtp, bool flush, bool rtx);
 
     void registerSelf();
     void unregisterSelf();
+    void removePeerAddrs();
     void unrefSelf();
     void onCheckAnswer(RtcSession &sdp);
 
@@ -340,6 +362,15 @@ private:
     // twcc rtcp发送上下文对象  [AUTO-TRANSLATED:aef6476a]
     // twcc rtcp send context object
     TwccContext _twcc_ctx;
+    // 发送rtp时的transport-wide seq
+    // Transport-wide seq of the sent rtp
+    uint16_t _twcc_send_seq = 0;
+    // 根据twcc反馈估计发送带宽
+    // Estimate the send bandwidth from twcc feedback
+    SendSideBwe::Ptr _bwe;
+    // 按估计带宽平滑发送rtp
+    // Pace the rtp sending according to the estimated bandwidth
+    RtcPacer::Ptr _pacer;
     // 根据发送rtp的track类型获取相关信息  [AUTO-TRANSLATED:ff31c272]
     // Get relevant information based on the track type of the sent rtp
     MediaTrack::Ptr _type_to_track[2];
@@ -353,6 +384,9 @@ private:
     // http访问时的host ip  [AUTO-TRANSLATED:e8fe6957]
     // Host ip for http access
     std::string _local_ip;
+    // 已登记到WebRtcTransportManager的udp对端地址
+    // Udp peer addresses registered to WebRtcTransportManager
+    std::vector<struct sockaddr_storage> _peer_addrs;
 };
 
 class WebRtcTransportManager {
@@ -361,14 +395,91 @@ public:
     static WebRtcTransportManager &Instance();
     WebRtcTransportImp::Ptr getItem(const std::string &key);
 
+    /**
+     * 根据ice ufrag查找transport，查找过程不竞争全局锁且无内存分配
+     * Find the transport by ice ufrag, the lookup does not contend on a global lock and is allocation-free
+     */
+    WebRtcTransportImp::Ptr getItem(const char *key, size_t len);
+
+    /**
+     * 根据udp对端地址查找已通过ice连通性检查的transport
+     * Find the transport whose ice connectivity check has passed by the udp peer address
+     */
+    WebRtcTransportImp::Ptr getItemByAddr(const struct sockaddr *addr);
+
 private:
+    // 对端地址，本端地址和协议对于同一个udp服务器是固定的，因此可以唯一确定一个5元组
+    // Peer address, the local address and protocol are fixed for the same udp server, so it identifies a 5-tuple
+    struct PeerAddr {
+        uint16_t family = 0;
+        uint16_t port = 0;
+        uint8_t ip[16] = { 0 };
+
+        PeerAddr() = default;
+        PeerAddr(const struct sockaddr *addr);
+        bool operator==(const PeerAddr &that) const;
+    };
+
+    struct PeerAddrHash {
+        size_t operator()(const PeerAddr &addr) const;
+    };
+
+    struct UfragItem {
+        std::string key;
+        std::weak_ptr<WebRtcTransportImp> transport;
+    };
+
+    /**
+     * 分片的写时复制哈希表，读取只需原子地获取当前分片的快照，不会等待写入方复制分片
+     * 注意shared_ptr的atomic_load/atomic_store在libstdc++中由全局的互斥锁池实现，并非无锁，但临界区只有引用计数操作
+     * 写入(transport创建和销毁)加分片锁并复制该分片，适合读多写少的场景
+     * Sharded copy-on-write hash table, readers only atomically load the snapshot of the shard and never wait for
+     * a writer copying the shard.
+     * Note that atomic_load/atomic_store of shared_ptr are implemented with a global mutex pool in libstdc++,
+     * so they are not lock-free, but the critical section is only the reference count update.
+     * Writers (transport creation and destruction) take the shard lock and copy that shard, suitable for read-mostly workloads
+     */
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class ShardedMap {
+    public:
+        using Map = std::unordered_map<Key, Value, Hash>;
+
+        std::shared_ptr<const Map> snapshot(const Key &key) const {
+            return std::atomic_load(&getShard(key).map);
+        }
+
+        void modify(const Key &key, const std::function<void(Map &map)> &cb) {
+            auto &shard = getShard(key);
+            std::lock_guard<std::mutex> lck(shard.mtx);
+            auto map = std::make_shared<Map>(*shard.map);
+            cb(*map);
+            std::atomic_store(&shard.map, std::shared_ptr<const Map>(std::move(map)));
+        }
+
+    private:
+        static constexpr size_t kShardCount = 64;
+        struct Shard {
+            std::mutex mtx;
+            std::shared_ptr<const Map> map = std::make_shared<Map>();
+        };
+
+        Shard &getShard(const Key &key) const { return _shards[Hash()(key) % kShardCount]; }
+
+    private:
+        mutable Shard _shards[kShardCount];
+    };
+
     WebRtcTransportManager() = default;
     void addItem(const std::string &key, const WebRtcTransportImp::Ptr &ptr);
     void removeItem(const std::string &key);
+    void addAddr(const struct sockaddr *addr, const WebRtcTransportImp::Ptr &ptr);
+    void removeAddr(const struct sockaddr *addr, const WebRtcTransportImp *ptr);
 
 private:
-    mutable std::mutex _mtx;
-    std::unordered_map<std::string, std::weak_ptr<WebRtcTransportImp> > _map;
+    // ufrag哈希值 -> transport列表(处理哈希冲突)
+    // Ufrag hash -> transport list (handles hash collisions)
+    ShardedMap<uint64_t, std::vector<UfragItem>> _map;
+    ShardedMap<PeerAddr, std::weak_ptr<WebRtcTransportImp>, PeerAddrHash> _addr_map;
 };
 
 class WebRtcArgs : public std::enable_shared_from_this<WebRtcArgs> {